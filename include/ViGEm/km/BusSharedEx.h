@@ -0,0 +1,1102 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+//
+// Extensions to the shared bus interface declared in the SDK (ViGEm/km/BusShared.h).
+// 
+// Everything in here is additive; existing IOCTLs and structures keep their layout.
+// 
+
+#pragma once
+
+#include <ViGEm/Common.h>
+
+#pragma region I/O control codes
+
+#define IOCTL_VIGEM_EX_BASE     0xB01
+
+#define VIGEM_EX_RW_IOCTL(_index_) \
+    CTL_CODE(FILE_DEVICE_BUS_EXTENDER, IOCTL_VIGEM_EX_BASE + (_index_), METHOD_BUFFERED, FILE_READ_DATA | FILE_WRITE_DATA)
+
+#define IOCTL_VIGEM_GET_TARGET_SNAPSHOT     VIGEM_EX_RW_IOCTL(0x000)
+#define IOCTL_VIGEM_SUBMIT_REPORT_BATCH     VIGEM_EX_RW_IOCTL(0x001)
+#define IOCTL_VIGEM_SET_MIRROR_GROUP        VIGEM_EX_RW_IOCTL(0x002)
+#define IOCTL_VIGEM_SET_MERGE_POLICY        VIGEM_EX_RW_IOCTL(0x003)
+#define IOCTL_VIGEM_SUBMIT_LAYER            VIGEM_EX_RW_IOCTL(0x004)
+#define IOCTL_VIGEM_SCHEDULE_REPORTS        VIGEM_EX_RW_IOCTL(0x005)
+#define IOCTL_VIGEM_SET_INTERPOLATION       VIGEM_EX_RW_IOCTL(0x006)
+#define IOCTL_VIGEM_SUBMIT_IMU_SAMPLES      VIGEM_EX_RW_IOCTL(0x007)
+#define IOCTL_VIGEM_SET_ORDERED_DELIVERY    VIGEM_EX_RW_IOCTL(0x008)
+#define IOCTL_VIGEM_GET_DELIVERY_COUNTERS   VIGEM_EX_RW_IOCTL(0x009)
+#define IOCTL_VIGEM_GET_MEMORY_FOOTPRINT    VIGEM_EX_RW_IOCTL(0x00A)
+
+#pragma endregion
+
+#pragma region Target enumeration snapshot
+
+//
+// Reported as UserIndex if no XInput slot is assigned (or target isn't an Xbox 360 one)
+// 
+#define VIGEM_USER_INDEX_UNKNOWN    ((ULONG)-1)
+
+//
+// State of a single target at the time of the snapshot
+// 
+typedef struct _VIGEM_TARGET_SNAPSHOT_ENTRY
+{
+	ULONG SerialNo;
+
+	VIGEM_TARGET_TYPE TargetType;
+
+	LONG SessionId;
+
+	USHORT VendorId;
+
+	USHORT ProductId;
+
+	//
+	// XInput slot (Xbox 360 only)
+	// 
+	ULONG UserIndex;
+
+	//
+	// TRUE once the host stack finished booting the device
+	// 
+	BOOLEAN IsReady;
+
+	//
+	// Last vibration values sent by the host
+	// 
+	UCHAR LargeMotor;
+
+	UCHAR SmallMotor;
+
+	//
+	// Last lightbar color sent by the host (DualShock 4 only)
+	// 
+	DS4_LIGHTBAR_COLOR LightbarColor;
+
+	//
+	// Bus generation of the last state change of this target
+	// 
+	ULONG64 Generation;
+
+} VIGEM_TARGET_SNAPSHOT_ENTRY, * PVIGEM_TARGET_SNAPSHOT_ENTRY;
+
+//
+// Request and response header of IOCTL_VIGEM_GET_TARGET_SNAPSHOT. The output
+// buffer receives this header immediately followed by EntryCount entries.
+// 
+typedef struct _VIGEM_TARGET_SNAPSHOT
+{
+	//
+	// sizeof(struct _VIGEM_TARGET_SNAPSHOT)
+	// 
+	ULONG Size;
+
+	//
+	// [out] Number of entries following this header
+	// 
+	ULONG EntryCount;
+
+	//
+	// [in] Only report targets changed after this generation, 0 reports all
+	// 
+	ULONG64 SinceGeneration;
+
+	//
+	// [out] Pass as SinceGeneration on the next call
+	// 
+	ULONG64 Generation;
+
+	//
+	// [out] Generation of the last target removal. If greater than SinceGeneration,
+	// targets disappeared and a full snapshot should be requested.
+	// 
+	ULONG64 RemovalGeneration;
+
+	//
+	// [out] Number of matching entries, including those not fitting the buffer
+	// 
+	ULONG TotalCount;
+
+} VIGEM_TARGET_SNAPSHOT, * PVIGEM_TARGET_SNAPSHOT;
+
+#define VIGEM_TARGET_SNAPSHOT_ENTRIES(_snapshot_) \
+    ((PVIGEM_TARGET_SNAPSHOT_ENTRY)((PUCHAR)(_snapshot_) + sizeof(VIGEM_TARGET_SNAPSHOT)))
+
+//
+// Initializes a VIGEM_TARGET_SNAPSHOT structure.
+// 
+VOID FORCEINLINE VIGEM_TARGET_SNAPSHOT_INIT(
+	PVIGEM_TARGET_SNAPSHOT Snapshot,
+	ULONG64 SinceGeneration
+)
+{
+	RtlZeroMemory(Snapshot, sizeof(VIGEM_TARGET_SNAPSHOT));
+
+	Snapshot->Size = sizeof(VIGEM_TARGET_SNAPSHOT);
+	Snapshot->SinceGeneration = SinceGeneration;
+}
+
+#pragma endregion
+
+#pragma region Atomic multi-target report submission
+
+//
+// Maximum number of reports committed in one batch
+// 
+#define VIGEM_SUBMIT_REPORT_BATCH_MAX   32
+
+//
+// Header of IOCTL_VIGEM_SUBMIT_REPORT_BATCH. Followed by Count XUSB_SUBMIT_REPORT,
+// DS4_SUBMIT_REPORT or DS4_SUBMIT_REPORT_EX structures packed back to back, each
+// with its Size and SerialNo set. Either all reports get committed or none.
+// 
+typedef struct _VIGEM_SUBMIT_REPORT_BATCH
+{
+	//
+	// sizeof(struct _VIGEM_SUBMIT_REPORT_BATCH)
+	// 
+	ULONG Size;
+
+	//
+	// Number of reports following this header
+	// 
+	ULONG Count;
+
+} VIGEM_SUBMIT_REPORT_BATCH, * PVIGEM_SUBMIT_REPORT_BATCH;
+
+//
+// Initializes a VIGEM_SUBMIT_REPORT_BATCH structure.
+// 
+VOID FORCEINLINE VIGEM_SUBMIT_REPORT_BATCH_INIT(
+	PVIGEM_SUBMIT_REPORT_BATCH Batch,
+	ULONG Count
+)
+{
+	RtlZeroMemory(Batch, sizeof(VIGEM_SUBMIT_REPORT_BATCH));
+
+	Batch->Size = sizeof(VIGEM_SUBMIT_REPORT_BATCH);
+	Batch->Count = Count;
+}
+
+#pragma endregion
+
+#pragma region Report mirror groups
+
+//
+// Maximum number of targets mirroring one primary target
+// 
+#define VIGEM_MIRROR_GROUP_MAX_MEMBERS  8
+
+//
+// Reports submitted to the primary target get copied to all members, converted
+// between XUSB_REPORT and DS4_REPORT where the target types differ. All members
+// must belong to the same session as the primary. A MemberCount of 0 dissolves
+// the group.
+// 
+typedef struct _VIGEM_MIRROR_GROUP
+{
+	//
+	// sizeof(struct _VIGEM_MIRROR_GROUP)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target reports get submitted to
+	// 
+	ULONG PrimarySerialNo;
+
+	//
+	// Number of valid entries in MemberSerialNo
+	// 
+	ULONG MemberCount;
+
+	//
+	// Serial numbers of the mirroring targets
+	// 
+	ULONG MemberSerialNo[VIGEM_MIRROR_GROUP_MAX_MEMBERS];
+
+} VIGEM_MIRROR_GROUP, * PVIGEM_MIRROR_GROUP;
+
+//
+// Initializes a VIGEM_MIRROR_GROUP structure.
+// 
+VOID FORCEINLINE VIGEM_MIRROR_GROUP_INIT(
+	PVIGEM_MIRROR_GROUP Group,
+	ULONG PrimarySerialNo
+)
+{
+	RtlZeroMemory(Group, sizeof(VIGEM_MIRROR_GROUP));
+
+	Group->Size = sizeof(VIGEM_MIRROR_GROUP);
+	Group->PrimarySerialNo = PrimarySerialNo;
+}
+
+#pragma endregion
+
+#pragma region Multi-source input layers
+
+//
+// Maximum number of sessions contributing to one target
+// 
+#define VIGEM_MERGE_MAX_LAYERS          8
+
+//
+// Releases the layer of the calling session instead of updating it
+// 
+#define VIGEM_LAYER_FLAG_RELEASE        0x00000001
+
+//
+// How layer contributions to the same axis or trigger get combined.
+// Buttons are always OR-ed together.
+// 
+typedef enum _VIGEM_MERGE_AXIS_RULE
+{
+	//
+	// Value furthest from neutral wins
+	// 
+	VigemMergeAxisMaxMagnitude = 0,
+
+	//
+	// Highest priority layer deflecting the axis wins
+	// 
+	VigemMergeAxisPriority = 1
+
+} VIGEM_MERGE_AXIS_RULE, * PVIGEM_MERGE_AXIS_RULE;
+
+//
+// Opts a target in (or out) of accepting input layers from other sessions.
+// Only the owner of the target may change the policy. While enabled, reports
+// submitted by the owner become the owner's own layer.
+// 
+typedef struct _VIGEM_MERGE_POLICY
+{
+	//
+	// sizeof(struct _VIGEM_MERGE_POLICY)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target
+	// 
+	ULONG SerialNo;
+
+	//
+	// TRUE to accept layers, FALSE drops all layers
+	// 
+	BOOLEAN Enable;
+
+	//
+	// Axis and trigger merge rule
+	// 
+	VIGEM_MERGE_AXIS_RULE AxisRule;
+
+	//
+	// Priority of the layer fed by the owner's regular report submissions
+	// 
+	LONG OwnerPriority;
+
+} VIGEM_MERGE_POLICY, * PVIGEM_MERGE_POLICY;
+
+//
+// Initializes a VIGEM_MERGE_POLICY structure.
+// 
+VOID FORCEINLINE VIGEM_MERGE_POLICY_INIT(
+	PVIGEM_MERGE_POLICY Policy,
+	ULONG SerialNo,
+	VIGEM_MERGE_AXIS_RULE AxisRule
+)
+{
+	RtlZeroMemory(Policy, sizeof(VIGEM_MERGE_POLICY));
+
+	Policy->Size = sizeof(VIGEM_MERGE_POLICY);
+	Policy->SerialNo = SerialNo;
+	Policy->Enable = TRUE;
+	Policy->AxisRule = AxisRule;
+}
+
+//
+// Input contributed by one session. Report must match the target type.
+// Layers get released automatically when the contributing handle is closed.
+// 
+typedef struct _VIGEM_SUBMIT_LAYER
+{
+	//
+	// sizeof(struct _VIGEM_SUBMIT_LAYER)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target
+	// 
+	ULONG SerialNo;
+
+	//
+	// Priority used by VigemMergeAxisPriority, higher wins
+	// 
+	LONG Priority;
+
+	//
+	// VIGEM_LAYER_FLAG_* values
+	// 
+	ULONG Flags;
+
+	//
+	// Input state of this layer, initialize DS4 reports with DS4_REPORT_INIT
+	// 
+	union
+	{
+		XUSB_REPORT Xusb;
+
+		DS4_REPORT Ds4;
+	} Report;
+
+} VIGEM_SUBMIT_LAYER, * PVIGEM_SUBMIT_LAYER;
+
+//
+// Initializes a VIGEM_SUBMIT_LAYER structure.
+// 
+VOID FORCEINLINE VIGEM_SUBMIT_LAYER_INIT(
+	PVIGEM_SUBMIT_LAYER Layer,
+	ULONG SerialNo,
+	LONG Priority
+)
+{
+	RtlZeroMemory(Layer, sizeof(VIGEM_SUBMIT_LAYER));
+
+	Layer->Size = sizeof(VIGEM_SUBMIT_LAYER);
+	Layer->SerialNo = SerialNo;
+	Layer->Priority = Priority;
+}
+
+#pragma endregion
+
+#pragma region Scheduled report playback
+
+//
+// Maximum number of reports in one playback sequence
+// 
+#define VIGEM_SCHEDULE_MAX_REPORTS      4096
+
+//
+// Maximum start delay and report offset in microseconds (one hour)
+// 
+#define VIGEM_SCHEDULE_MAX_DELAY_US     3600000000ULL
+
+//
+// One report of a playback sequence
+// 
+typedef struct _VIGEM_SCHEDULED_REPORT
+{
+	//
+	// In: release instant in microseconds relative to the start of playback.
+	// Must not decrease from one entry to the next or exceed VIGEM_SCHEDULE_MAX_DELAY_US.
+	// 
+	ULONG64 OffsetUs;
+
+	//
+	// Out: how many microseconds after its scheduled instant the report got released
+	// 
+	ULONG SkewUs;
+
+	//
+	// Report matching the target type, initialize DS4 reports with DS4_REPORT_INIT
+	// 
+	union
+	{
+		XUSB_REPORT Xusb;
+
+		DS4_REPORT Ds4;
+	} Report;
+
+} VIGEM_SCHEDULED_REPORT, * PVIGEM_SCHEDULED_REPORT;
+
+//
+// Header of IOCTL_VIGEM_SCHEDULE_REPORTS, followed by Count VIGEM_SCHEDULED_REPORT
+// structures. The request stays pending until the last report got released.
+// Use the same buffer for input and output to receive per-report skew values,
+// an output buffer of header size only receives the totals.
+// 
+typedef struct _VIGEM_SCHEDULE_REPORTS
+{
+	//
+	// sizeof(struct _VIGEM_SCHEDULE_REPORTS)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target
+	// 
+	ULONG SerialNo;
+
+	//
+	// Number of reports following this header
+	// 
+	ULONG Count;
+
+	//
+	// Out: number of reports released
+	// 
+	ULONG Released;
+
+	//
+	// Delay in microseconds between the driver accepting the request and the start of playback,
+	// at most VIGEM_SCHEDULE_MAX_DELAY_US
+	// 
+	ULONG64 StartDelayUs;
+
+	//
+	// Out: largest release skew in microseconds
+	// 
+	ULONG64 MaxSkewUs;
+
+	//
+	// Out: sum of all release skews in microseconds
+	// 
+	ULONG64 TotalSkewUs;
+
+} VIGEM_SCHEDULE_REPORTS, * PVIGEM_SCHEDULE_REPORTS;
+
+#define VIGEM_SCHEDULE_REPORTS_ENTRIES(_schedule_) \
+    ((PVIGEM_SCHEDULED_REPORT)((PUCHAR)(_schedule_) + sizeof(VIGEM_SCHEDULE_REPORTS)))
+
+//
+// Initializes a VIGEM_SCHEDULE_REPORTS structure.
+// 
+VOID FORCEINLINE VIGEM_SCHEDULE_REPORTS_INIT(
+	PVIGEM_SCHEDULE_REPORTS Schedule,
+	ULONG SerialNo,
+	ULONG Count
+)
+{
+	RtlZeroMemory(Schedule, sizeof(VIGEM_SCHEDULE_REPORTS));
+
+	Schedule->Size = sizeof(VIGEM_SCHEDULE_REPORTS);
+	Schedule->SerialNo = SerialNo;
+	Schedule->Count = Count;
+}
+
+#pragma endregion
+
+#pragma region Analog interpolation
+
+//
+// How a DualShock 4 target renders sticks and triggers between submitted reports
+// 
+typedef enum _VIGEM_INTERPOLATION_MODE
+{
+	//
+	// Repeat the latest submitted values (default)
+	// 
+	VigemInterpolationNone = 0,
+
+	//
+	// Glide linearly towards the latest values over one submission interval
+	// 
+	VigemInterpolationLinear = 1,
+
+	//
+	// Extrapolate the last slope for up to one submission interval, clamped to range
+	// 
+	VigemInterpolationExtrapolate = 2
+
+} VIGEM_INTERPOLATION_MODE, * PVIGEM_INTERPOLATION_MODE;
+
+//
+// Selects the interpolation mode of a DualShock 4 target. Buttons are never interpolated.
+// 
+typedef struct _VIGEM_SET_INTERPOLATION
+{
+	//
+	// sizeof(struct _VIGEM_SET_INTERPOLATION)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target
+	// 
+	ULONG SerialNo;
+
+	//
+	// Requested mode
+	// 
+	VIGEM_INTERPOLATION_MODE Mode;
+
+} VIGEM_SET_INTERPOLATION, * PVIGEM_SET_INTERPOLATION;
+
+//
+// Initializes a VIGEM_SET_INTERPOLATION structure.
+// 
+VOID FORCEINLINE VIGEM_SET_INTERPOLATION_INIT(
+	PVIGEM_SET_INTERPOLATION Request,
+	ULONG SerialNo,
+	VIGEM_INTERPOLATION_MODE Mode
+)
+{
+	RtlZeroMemory(Request, sizeof(VIGEM_SET_INTERPOLATION));
+
+	Request->Size = sizeof(VIGEM_SET_INTERPOLATION);
+	Request->SerialNo = SerialNo;
+	Request->Mode = Mode;
+}
+
+#pragma endregion
+
+#pragma region DS4 motion sensor streaming
+
+//
+// Maximum number of samples accepted per IOCTL_VIGEM_SUBMIT_IMU_SAMPLES call
+// 
+#define VIGEM_IMU_SAMPLES_MAX           64
+
+//
+// One gyroscope and accelerometer reading in DS4 input report units
+// 
+typedef struct _VIGEM_DS4_IMU_SAMPLE
+{
+	SHORT GyroX;
+	SHORT GyroY;
+	SHORT GyroZ;
+
+	SHORT AccelX;
+	SHORT AccelY;
+	SHORT AccelZ;
+
+} VIGEM_DS4_IMU_SAMPLE, * PVIGEM_DS4_IMU_SAMPLE;
+
+//
+// Header of IOCTL_VIGEM_SUBMIT_IMU_SAMPLES, followed by Count VIGEM_DS4_IMU_SAMPLE
+// structures. The samples get queued on the DualShock 4 target and each
+// delivered input report carries the next one, stamped with the driver clock.
+// 
+typedef struct _VIGEM_SUBMIT_IMU_SAMPLES
+{
+	//
+	// sizeof(struct _VIGEM_SUBMIT_IMU_SAMPLES)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target
+	// 
+	ULONG SerialNo;
+
+	//
+	// Number of samples following this header
+	// 
+	ULONG Count;
+
+	//
+	// Out: number of samples queued, less than Count if the queue ran full
+	// 
+	ULONG Accepted;
+
+} VIGEM_SUBMIT_IMU_SAMPLES, * PVIGEM_SUBMIT_IMU_SAMPLES;
+
+#define VIGEM_SUBMIT_IMU_SAMPLES_ENTRIES(_submit_) \
+    ((PVIGEM_DS4_IMU_SAMPLE)((PUCHAR)(_submit_) + sizeof(VIGEM_SUBMIT_IMU_SAMPLES)))
+
+//
+// Initializes a VIGEM_SUBMIT_IMU_SAMPLES structure.
+// 
+VOID FORCEINLINE VIGEM_SUBMIT_IMU_SAMPLES_INIT(
+	PVIGEM_SUBMIT_IMU_SAMPLES Submit,
+	ULONG SerialNo,
+	ULONG Count
+)
+{
+	RtlZeroMemory(Submit, sizeof(VIGEM_SUBMIT_IMU_SAMPLES));
+
+	Submit->Size = sizeof(VIGEM_SUBMIT_IMU_SAMPLES);
+	Submit->SerialNo = SerialNo;
+	Submit->Count = Count;
+}
+
+#pragma endregion
+
+#pragma region Ordered report delivery
+
+//
+// Upper bound of pending reports per target
+// 
+#define VIGEM_ORDERED_DELIVERY_MAX_DEPTH    32
+
+//
+// What happens to a report with a button edge while the queue is full
+// 
+typedef enum _VIGEM_OVERFLOW_POLICY
+{
+	//
+	// Discard the oldest pending report
+	// 
+	VigemOverflowDropOldest = 0,
+
+	//
+	// Discard the new report
+	// 
+	VigemOverflowDropNewest = 1,
+
+	//
+	// Replace the newest pending report
+	// 
+	VigemOverflowOverwriteNewest = 2
+
+} VIGEM_OVERFLOW_POLICY, * PVIGEM_OVERFLOW_POLICY;
+
+//
+// Enables a bounded FIFO of submitted reports on a target. Every interrupt IN
+// request gets the next pending report; consecutive reports only collapse into
+// one if their button state is identical, so taps shorter than the host poll
+// interval reach the host.
+// 
+typedef struct _VIGEM_SET_ORDERED_DELIVERY
+{
+	//
+	// sizeof(struct _VIGEM_SET_ORDERED_DELIVERY)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target
+	// 
+	ULONG SerialNo;
+
+	//
+	// TRUE to enable, FALSE drops pending reports and returns to latest-state delivery
+	// 
+	BOOLEAN Enable;
+
+	//
+	// Maximum pending reports, 1 to VIGEM_ORDERED_DELIVERY_MAX_DEPTH
+	// 
+	ULONG Depth;
+
+	//
+	// Behaviour once Depth reports are pending
+	// 
+	VIGEM_OVERFLOW_POLICY Overflow;
+
+} VIGEM_SET_ORDERED_DELIVERY, * PVIGEM_SET_ORDERED_DELIVERY;
+
+//
+// Initializes a VIGEM_SET_ORDERED_DELIVERY structure.
+// 
+VOID FORCEINLINE VIGEM_SET_ORDERED_DELIVERY_INIT(
+	PVIGEM_SET_ORDERED_DELIVERY Request,
+	ULONG SerialNo,
+	ULONG Depth,
+	VIGEM_OVERFLOW_POLICY Overflow
+)
+{
+	RtlZeroMemory(Request, sizeof(VIGEM_SET_ORDERED_DELIVERY));
+
+	Request->Size = sizeof(VIGEM_SET_ORDERED_DELIVERY);
+	Request->SerialNo = SerialNo;
+	Request->Enable = TRUE;
+	Request->Depth = Depth;
+	Request->Overflow = Overflow;
+}
+
+//
+// Cumulative ordered delivery statistics of a target
+// 
+typedef struct _VIGEM_DELIVERY_COUNTERS
+{
+	//
+	// sizeof(struct _VIGEM_DELIVERY_COUNTERS)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target
+	// 
+	ULONG SerialNo;
+
+	//
+	// Out: reports appended to the queue
+	// 
+	ULONG64 Enqueued;
+
+	//
+	// Out: reports merged into the newest pending state as they had no button edge
+	// 
+	ULONG64 Collapsed;
+
+	//
+	// Out: reports lost due to overflow
+	// 
+	ULONG64 Dropped;
+
+	//
+	// Out: reports handed to the host from the queue
+	// 
+	ULONG64 Delivered;
+
+} VIGEM_DELIVERY_COUNTERS, * PVIGEM_DELIVERY_COUNTERS;
+
+//
+// Initializes a VIGEM_DELIVERY_COUNTERS structure.
+// 
+VOID FORCEINLINE VIGEM_DELIVERY_COUNTERS_INIT(
+	PVIGEM_DELIVERY_COUNTERS Counters,
+	ULONG SerialNo
+)
+{
+	RtlZeroMemory(Counters, sizeof(VIGEM_DELIVERY_COUNTERS));
+
+	Counters->Size = sizeof(VIGEM_DELIVERY_COUNTERS);
+	Counters->SerialNo = SerialNo;
+}
+
+#pragma endregion
+
+#pragma region Memory footprint
+
+//
+// Memory held by one or all targets of the caller, broken down by subsystem. Byte counts
+// cover non-paged pool the bus allocates itself; framework objects are
+// allocated by WDF under the driver's tag and only get counted.
+// 
+typedef struct _VIGEM_MEMORY_FOOTPRINT
+{
+	//
+	// sizeof(struct _VIGEM_MEMORY_FOOTPRINT)
+	// 
+	ULONG Size;
+
+	//
+	// Serial number of the target, 0 sums up all targets the calling process owns
+	// 
+	ULONG SerialNo;
+
+	//
+	// Out: number of targets accounted
+	// 
+	ULONG TargetCount;
+
+	//
+	// Out: report submission state shared by all target types
+	// 
+	ULONG64 SubmissionBytes;
+
+	//
+	// Out: reports pending for ordered delivery
+	// 
+	ULONG64 OrderedDeliveryBytes;
+
+	//
+	// Out: input layers and mirror group members
+	// 
+	ULONG64 MergeBytes;
+
+	//
+	// Out: output callback and notification state
+	// 
+	ULONG64 OutputBytes;
+
+	//
+	// Out: scheduled report playback
+	// 
+	ULONG64 PlaybackBytes;
+
+	//
+	// Out: capabilities and plugin bookkeeping
+	// 
+	ULONG64 SetupBytes;
+
+	//
+	// Out: state specific to the target type (report caches, motion samples, ...)
+	// 
+	ULONG64 TargetBytes;
+
+	//
+	// Out: bus output pool blocks held by interrupt OUT transfers awaiting pick-up
+	// 
+	ULONG64 OutputBufferBytes;
+
+	//
+	// Out: sum of all byte counts above
+	// 
+	ULONG64 TotalBytes;
+
+	//
+	// Out: framework I/O queues created
+	// 
+	ULONG QueueCount;
+
+	//
+	// Out: framework timers created
+	// 
+	ULONG TimerCount;
+
+	//
+	// Out: interrupt OUT transfers dropped above the soft quota as the bus output pool ran low
+	// 
+	ULONG OutputBufferThrottled;
+
+	//
+	// Out: interrupt OUT transfers dropped at the hard quota or with the bus output pool exhausted
+	// 
+	ULONG OutputBufferOverruns;
+
+} VIGEM_MEMORY_FOOTPRINT, * PVIGEM_MEMORY_FOOTPRINT;
+
+//
+// Initializes a VIGEM_MEMORY_FOOTPRINT structure.
+// 
+VOID FORCEINLINE VIGEM_MEMORY_FOOTPRINT_INIT(
+	PVIGEM_MEMORY_FOOTPRINT Footprint,
+	ULONG SerialNo
+)
+{
+	RtlZeroMemory(Footprint, sizeof(VIGEM_MEMORY_FOOTPRINT));
+
+	Footprint->Size = sizeof(VIGEM_MEMORY_FOOTPRINT);
+	Footprint->SerialNo = SerialNo;
+}
+
+#pragma endregion
+
+#pragma region Notification requests with server-side deadline
+
+//
+// Extended XUSB_REQUEST_NOTIFICATION. The bus completes the request with
+// STATUS_TIMEOUT if no notification arrived within TimeoutMs milliseconds.
+// A TimeoutMs of 0 keeps the request pending indefinitely.
+// 
+typedef struct _XUSB_REQUEST_NOTIFICATION_EX
+{
+	//
+	// Size member must be set to sizeof(struct _XUSB_REQUEST_NOTIFICATION_EX)
+	// 
+	XUSB_REQUEST_NOTIFICATION Notification;
+
+	//
+	// Relative deadline in milliseconds
+	// 
+	ULONG TimeoutMs;
+
+} XUSB_REQUEST_NOTIFICATION_EX, * PXUSB_REQUEST_NOTIFICATION_EX;
+
+//
+// Initializes a XUSB_REQUEST_NOTIFICATION_EX structure.
+// 
+VOID FORCEINLINE XUSB_REQUEST_NOTIFICATION_EX_INIT(
+	PXUSB_REQUEST_NOTIFICATION_EX Request,
+	ULONG SerialNo,
+	ULONG TimeoutMs
+)
+{
+	RtlZeroMemory(Request, sizeof(XUSB_REQUEST_NOTIFICATION_EX));
+
+	Request->Notification.Size = sizeof(XUSB_REQUEST_NOTIFICATION_EX);
+	Request->Notification.SerialNo = SerialNo;
+	Request->TimeoutMs = TimeoutMs;
+}
+
+//
+// Extended DS4_REQUEST_NOTIFICATION, see XUSB_REQUEST_NOTIFICATION_EX.
+// 
+typedef struct _DS4_REQUEST_NOTIFICATION_EX
+{
+	//
+	// Size member must be set to sizeof(struct _DS4_REQUEST_NOTIFICATION_EX)
+	// 
+	DS4_REQUEST_NOTIFICATION Notification;
+
+	//
+	// Relative deadline in milliseconds
+	// 
+	ULONG TimeoutMs;
+
+} DS4_REQUEST_NOTIFICATION_EX, * PDS4_REQUEST_NOTIFICATION_EX;
+
+//
+// Initializes a DS4_REQUEST_NOTIFICATION_EX structure.
+// 
+VOID FORCEINLINE DS4_REQUEST_NOTIFICATION_EX_INIT(
+	PDS4_REQUEST_NOTIFICATION_EX Request,
+	ULONG SerialNo,
+	ULONG TimeoutMs
+)
+{
+	RtlZeroMemory(Request, sizeof(DS4_REQUEST_NOTIFICATION_EX));
+
+	Request->Notification.Size = sizeof(DS4_REQUEST_NOTIFICATION_EX);
+	Request->Notification.SerialNo = SerialNo;
+	Request->TimeoutMs = TimeoutMs;
+}
+
+//
+// Extended DS4_AWAIT_OUTPUT, see XUSB_REQUEST_NOTIFICATION_EX. Unlike the plain
+// request it only completes with output of the target named by SerialNo, which
+// the caller must own.
+// 
+typedef struct _DS4_AWAIT_OUTPUT_EX
+{
+	//
+	// Size member must be set to sizeof(struct _DS4_AWAIT_OUTPUT_EX)
+	// 
+	DS4_AWAIT_OUTPUT Output;
+
+	//
+	// Relative deadline in milliseconds
+	// 
+	ULONG TimeoutMs;
+
+} DS4_AWAIT_OUTPUT_EX, * PDS4_AWAIT_OUTPUT_EX;
+
+//
+// Initializes a DS4_AWAIT_OUTPUT_EX structure.
+// 
+VOID FORCEINLINE DS4_AWAIT_OUTPUT_EX_INIT(
+	PDS4_AWAIT_OUTPUT_EX Request,
+	ULONG SerialNo,
+	ULONG TimeoutMs
+)
+{
+	RtlZeroMemory(Request, sizeof(DS4_AWAIT_OUTPUT_EX));
+
+	Request->Output.Size = sizeof(DS4_AWAIT_OUTPUT_EX);
+	Request->Output.SerialNo = SerialNo;
+	Request->TimeoutMs = TimeoutMs;
+}
+
+#pragma endregion
+
+#pragma region Direct-call bus interface (kernel-mode clients only)
+
+#if defined(_KERNEL_MODE)
+
+//
+// {8090FA3D-4AF5-49B9-87F1-CBCD95CE8C7E}
+// 
+// Interface type to request from the bus FDO via IRP_MN_QUERY_INTERFACE
+// 
+DEFINE_GUID(GUID_VIGEM_INTERFACE_BUS_DIRECT,
+	0x8090fa3d, 0x4af5, 0x49b9, 0x87, 0xf1, 0xcb, 0xcd, 0x95, 0xce, 0x8c, 0x7e);
+
+#define VIGEM_BUS_INTERFACE_VERSION_1   0x0001
+
+//
+// Invoked on output (rumble, LED, lightbar) data sent by the host to a target.
+// Buffer holds the raw interrupt OUT transfer and is only valid during the call.
+// Called at IRQL <= DISPATCH_LEVEL, must not block.
+// 
+typedef
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+(*PFN_VIGEM_BUS_OUTPUT_CALLBACK)(
+	_In_opt_ PVOID CallbackContext,
+	_In_ ULONG SerialNo,
+	_In_reads_bytes_(BufferLength) PVOID Buffer,
+	_In_ ULONG BufferLength
+	);
+
+//
+// Plugs in a new target owned by the calling driver.
+// 
+typedef
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+(*PFN_VIGEM_BUS_PLUGIN_TARGET)(
+	_In_ PVOID Context,
+	_In_ ULONG SerialNo,
+	_In_ VIGEM_TARGET_TYPE TargetType,
+	_In_ USHORT VendorId,
+	_In_ USHORT ProductId
+	);
+
+//
+// Unplugs a target previously plugged in via this interface, or with SerialNo
+// set to 0 all of them.
+// 
+typedef
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+(*PFN_VIGEM_BUS_UNPLUG_TARGET)(
+	_In_ PVOID Context,
+	_In_ ULONG SerialNo
+	);
+
+//
+// Submits an input report. Report points to a XUSB_SUBMIT_REPORT, DS4_SUBMIT_REPORT
+// or DS4_SUBMIT_REPORT_EX structure with Size and SerialNo set, same as via IOCTL.
+// 
+typedef
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+(*PFN_VIGEM_BUS_SUBMIT_REPORT)(
+	_In_ PVOID Context,
+	_In_ PVOID Report
+	);
+
+//
+// Registers (or with Callback set to NULL removes) the output callback of a target.
+// Returns once a previously registered callback is no longer executing.
+// 
+typedef
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+(*PFN_VIGEM_BUS_REGISTER_OUTPUT_CALLBACK)(
+	_In_ PVOID Context,
+	_In_ ULONG SerialNo,
+	_In_opt_ PFN_VIGEM_BUS_OUTPUT_CALLBACK Callback,
+	_In_opt_ PVOID CallbackContext
+	);
+
+typedef struct _VIGEM_BUS_INTERFACE_V1
+{
+	//
+	// Standard interface header, Context identifies the querying driver; every
+	// query returns a new one, which only reaches the targets plugged in through it
+	// 
+	INTERFACE InterfaceHeader;
+
+	PFN_VIGEM_BUS_PLUGIN_TARGET PlugInTarget;
+
+	PFN_VIGEM_BUS_UNPLUG_TARGET UnPlugTarget;
+
+	PFN_VIGEM_BUS_SUBMIT_REPORT SubmitReport;
+
+	PFN_VIGEM_BUS_REGISTER_OUTPUT_CALLBACK RegisterOutputCallback;
+
+} VIGEM_BUS_INTERFACE_V1, * PVIGEM_BUS_INTERFACE_V1;
+
+#endif
+
+#pragma endregion
@@ -0,0 +1,563 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#include "UsbDescriptors.hpp"
+
+namespace ViGEm::Bus::Core::Ds4ReportSchema
+{
+	//
+	// One input main item of the report: Count elements of Size bits each,
+	// packed LSB first in declaration order after the report ID byte
+	// 
+	struct Field
+	{
+		unsigned short UsagePage;
+
+		//
+		// Explicit usages, or minimum and maximum if IsUsageRange is set
+		// 
+		unsigned char Usages[4];
+		unsigned char UsageCount;
+		bool IsUsageRange;
+
+		int LogicalMin;
+		int LogicalMax;
+
+		bool HasPhysical;
+		int PhysicalMin;
+		int PhysicalMax;
+
+		//
+		// Scoped to this field, reset to none after its main item
+		// 
+		unsigned char Unit;
+
+		unsigned char Size;
+		unsigned char Count;
+
+		//
+		// Data of the Input main item
+		// 
+		unsigned char Flags;
+
+		//
+		// Emits Report Size/Count before the logical range, as the hardware descriptor does in places
+		// 
+		bool IsSizeFirst;
+
+		//
+		// Resting elements packed like on the wire, or raw bytes for opaque blocks
+		// 
+		unsigned long long NeutralValue;
+		const unsigned char* NeutralBytes;
+
+		template <typename... T>
+		constexpr Field Use(T... Usage) const
+		{
+			static_assert(sizeof...(T) <= 4, "Too many usages");
+
+			Field result = *this;
+			unsigned char usages[] = { static_cast<unsigned char>(Usage)... };
+
+			for (unsigned int i = 0; i < sizeof...(T); i++)
+				result.Usages[i] = usages[i];
+
+			result.UsageCount = sizeof...(T);
+
+			return result;
+		}
+
+		constexpr Field UseRange(unsigned char Minimum, unsigned char Maximum) const
+		{
+			Field result = Use(Minimum, Maximum);
+			result.IsUsageRange = true;
+			return result;
+		}
+
+		constexpr Field Logical(int Minimum, int Maximum) const
+		{
+			Field result = *this;
+			result.LogicalMin = Minimum;
+			result.LogicalMax = Maximum;
+			return result;
+		}
+
+		constexpr Field Physical(int Minimum, int Maximum) const
+		{
+			Field result = *this;
+			result.HasPhysical = true;
+			result.PhysicalMin = Minimum;
+			result.PhysicalMax = Maximum;
+			return result;
+		}
+
+		constexpr Field WithUnit(unsigned char Value) const
+		{
+			Field result = *this;
+			result.Unit = Value;
+			return result;
+		}
+
+		constexpr Field WithNullState() const
+		{
+			Field result = *this;
+			result.Flags |= 0x40;
+			return result;
+		}
+
+		constexpr Field SizeFirst() const
+		{
+			Field result = *this;
+			result.IsSizeFirst = true;
+			return result;
+		}
+
+		template <typename... T>
+		constexpr Field Neutral(T... Values) const
+		{
+			Field result = *this;
+			unsigned long long values[] = { static_cast<unsigned long long>(Values)... };
+
+			result.NeutralValue = 0;
+
+			for (unsigned int i = 0; i < sizeof...(T); i++)
+				result.NeutralValue |= values[i] << (i * Size);
+
+			return result;
+		}
+
+		constexpr Field NeutralFrom(const unsigned char* Bytes) const
+		{
+			Field result = *this;
+			result.NeutralBytes = Bytes;
+			return result;
+		}
+
+		constexpr unsigned int Bits() const
+		{
+			return Size * Count;
+		}
+	};
+
+	//
+	// Data, Variable, Absolute field without usages or range set yet
+	// 
+	constexpr Field Variable(unsigned short UsagePage, unsigned char Size, unsigned char Count)
+	{
+		return { UsagePage, {}, 0, false, 0, 0, false, 0, 0, 0x00, Size, Count, 0x02, false, 0, nullptr };
+	}
+
+	constexpr unsigned short GenericDesktop = 0x01;
+	constexpr unsigned short Button = 0x09;
+	constexpr unsigned short Vendor = 0xFF00;
+
+	constexpr unsigned char GamePad = 0x05;
+	constexpr unsigned char ReportId = 0x01;
+
+	//
+	// Wire size of the input report including its ID
+	// 
+	constexpr unsigned int ReportSize = 64;
+
+	//
+	// Resting content of the vendor block as sent by real hardware: sensor
+	// timestamp, battery, motion and touch data with all fingers lifted
+	// 
+	inline constexpr unsigned char ExtensionNeutral[] =
+	{
+		0xFD, 0x63, 0x06, 0x03, 0x00, 0xFE, 0xFF, 0xFC,
+		0xFF, 0x79, 0xFD, 0x1B, 0x14, 0xD1, 0xE9, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x1B, 0x00, 0x00, 0x00,
+		0x00, 0x80, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00,
+		0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x80, 0x00,
+		0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x80,
+		0x00, 0x00, 0x00, 0x00, 0x80, 0x00
+	};
+
+	enum FieldIndex : unsigned int
+	{
+		Sticks,
+		DPad,
+		Buttons,
+		Counter,
+		Triggers,
+		Extension,
+		FieldCount
+	};
+
+	inline constexpr Field Fields[FieldCount] =
+	{
+		// X, Y, Z, Rz; resting values as reported by real hardware
+		Variable(GenericDesktop, 8, 4).Use(0x30, 0x31, 0x32, 0x35).Logical(0, 255)
+			.Neutral(0x82, 0x7F, 0x7E, 0x80),
+
+		// Hat switch, 8 (null state) when released
+		Variable(GenericDesktop, 4, 1).Use(0x39).Logical(0, 7).Physical(0, 315).WithUnit(0x14).WithNullState()
+			.Neutral(0x08),
+
+		// Face, shoulder, stick, share/options, PS and touchpad click
+		Variable(Button, 1, 14).UseRange(0x01, 0x0E).Logical(0, 1),
+
+		// Frame counter
+		Variable(Vendor, 6, 1).Use(0x20).SizeFirst().Logical(0, 127)
+			.Neutral(0x16),
+
+		// Rx, Ry (analog triggers)
+		Variable(GenericDesktop, 8, 2).Use(0x33, 0x34).Logical(0, 255),
+
+		Variable(Vendor, 8, 54).Use(0x21).Logical(0, 255)
+			.NeutralFrom(ExtensionNeutral),
+	};
+
+	//
+	// Location of a value in the report, reads and writes handle up to 32 bits
+	// 
+	struct Element
+	{
+		unsigned int BitOffset;
+		unsigned int BitSize;
+
+		constexpr unsigned int ByteOffset() const
+		{
+			return BitOffset / 8;
+		}
+	};
+
+	constexpr unsigned int BitOffsetOf(unsigned int Index)
+	{
+		unsigned int offset = 8;
+
+		for (unsigned int i = 0; i < Index; i++)
+			offset += Fields[i].Bits();
+
+		return offset;
+	}
+
+	constexpr Element ElementOf(unsigned int Index, unsigned int Position = 0)
+	{
+		return { BitOffsetOf(Index) + Position * Fields[Index].Size, Fields[Index].Size };
+	}
+
+	//
+	// All elements of fields First to Last as one value
+	// 
+	constexpr Element Span(unsigned int First, unsigned int Last)
+	{
+		return { BitOffsetOf(First), BitOffsetOf(Last + 1) - BitOffsetOf(First) };
+	}
+
+	//
+	// Byte range within a byte-aligned field
+	// 
+	constexpr Element BytesOf(unsigned int Index, unsigned int Offset, unsigned int Length)
+	{
+		return { BitOffsetOf(Index) + Offset * 8, Length * 8 };
+	}
+
+	inline constexpr Element LeftThumbX = ElementOf(Sticks, 0);
+	inline constexpr Element LeftThumbY = ElementOf(Sticks, 1);
+	inline constexpr Element RightThumbX = ElementOf(Sticks, 2);
+	inline constexpr Element RightThumbY = ElementOf(Sticks, 3);
+	inline constexpr Element LeftTrigger = ElementOf(Triggers, 0);
+	inline constexpr Element RightTrigger = ElementOf(Triggers, 1);
+
+	//
+	// Hat switch in bits 0-3 followed by the 14 buttons
+	// 
+	inline constexpr Element ButtonState = Span(DPad, Buttons);
+
+	//
+	// PS and touchpad click, the last two buttons, laid out as DS4_SPECIAL_BUTTONS
+	// 
+	inline constexpr Element SpecialButtons = { ElementOf(Buttons, 12).BitOffset, 2 * Fields[Buttons].Size };
+
+	inline constexpr Element FrameCounter = ElementOf(Counter);
+
+	inline constexpr Element Timestamp = BytesOf(Extension, 0, 2);
+	inline constexpr Element Imu = BytesOf(Extension, 3, 12);
+
+	constexpr unsigned long long Mask(unsigned int Bits)
+	{
+		return Bits >= 64 ? ~0ULL : (1ULL << Bits) - 1;
+	}
+
+	constexpr unsigned int Get(const unsigned char* Report, Element Value)
+	{
+		if (Value.BitOffset % 8 == 0 && Value.BitSize == 8)
+			return Report[Value.ByteOffset()];
+
+		unsigned long long bits = 0;
+
+		for (unsigned int i = (Value.BitOffset + Value.BitSize + 7) / 8; i-- > Value.ByteOffset();)
+			bits = (bits << 8) | Report[i];
+
+		return static_cast<unsigned int>((bits >> (Value.BitOffset % 8)) & Mask(Value.BitSize));
+	}
+
+	constexpr void Set(unsigned char* Report, Element Value, unsigned int Data)
+	{
+		if (Value.BitOffset % 8 == 0 && Value.BitSize == 8)
+		{
+			Report[Value.ByteOffset()] = static_cast<unsigned char>(Data);
+			return;
+		}
+
+		const unsigned int shift = Value.BitOffset % 8;
+		const unsigned long long mask = Mask(Value.BitSize) << shift;
+		const unsigned long long bits = (static_cast<unsigned long long>(Data) << shift) & mask;
+
+		for (unsigned int i = Value.ByteOffset(), s = 0; i < (Value.BitOffset + Value.BitSize + 7) / 8; i++, s += 8)
+			Report[i] = static_cast<unsigned char>((Report[i] & ~(mask >> s)) | (bits >> s));
+	}
+
+	//
+	// Input report with every field at rest
+	// 
+	constexpr UsbDescriptors::Blob<ReportSize> NeutralReport()
+	{
+		UsbDescriptors::Blob<ReportSize> report{};
+
+		report.Bytes[0] = ReportId;
+
+		for (unsigned int i = 0; i < FieldCount; i++)
+		{
+			const Field& field = Fields[i];
+
+			if (field.NeutralBytes != nullptr)
+			{
+				for (unsigned int b = 0; b < field.Bits() / 8; b++)
+					report.Bytes[BitOffsetOf(i) / 8 + b] = field.NeutralBytes[b];
+
+				continue;
+			}
+
+			for (unsigned int e = 0; e < field.Count && e * field.Size < 64; e++)
+				Set(report.Bytes, ElementOf(i, e), static_cast<unsigned int>((field.NeutralValue >> (e * field.Size)) & Mask(field.Size)));
+		}
+
+		return report;
+	}
+
+	namespace Detail
+	{
+		struct Counter
+		{
+			unsigned int Size;
+
+			constexpr void operator()(unsigned char)
+			{
+				Size++;
+			}
+		};
+
+		template <unsigned int N>
+		struct Writer
+		{
+			UsbDescriptors::Blob<N> Out;
+			unsigned int Position;
+
+			constexpr void operator()(unsigned char Byte)
+			{
+				Out.Bytes[Position++] = Byte;
+			}
+		};
+
+		constexpr unsigned char UsagePageTag = 0x04;
+		constexpr unsigned char UsageTag = 0x08;
+		constexpr unsigned char UsageMinimumTag = 0x18;
+		constexpr unsigned char UsageMaximumTag = 0x28;
+		constexpr unsigned char LogicalMinimumTag = 0x14;
+		constexpr unsigned char LogicalMaximumTag = 0x24;
+		constexpr unsigned char PhysicalMinimumTag = 0x34;
+		constexpr unsigned char PhysicalMaximumTag = 0x44;
+		constexpr unsigned char UnitTag = 0x64;
+		constexpr unsigned char ReportSizeTag = 0x74;
+		constexpr unsigned char ReportIdTag = 0x84;
+		constexpr unsigned char ReportCountTag = 0x94;
+		constexpr unsigned char InputTag = 0x80;
+		constexpr unsigned char CollectionTag = 0xA0;
+
+		//
+		// Short item with the smallest data size holding Value
+		// 
+		template <typename TSink>
+		constexpr void Item(TSink& Sink, unsigned char Tag, long Value, bool Signed = false)
+		{
+			const unsigned int size = Signed
+				? (Value >= -0x80 && Value <= 0x7F ? 1 : Value >= -0x8000 && Value <= 0x7FFF ? 2 : 4)
+				: (Value <= 0xFF ? 1 : Value <= 0xFFFF ? 2 : 4);
+
+			Sink(static_cast<unsigned char>(Tag | (size == 4 ? 3 : size)));
+
+			for (unsigned int i = 0; i < size; i++)
+				Sink(static_cast<unsigned char>((static_cast<unsigned long>(Value) >> (i * 8)) & 0xFF));
+		}
+
+		//
+		// Application collection header and all input fields, global items
+		// are only repeated where they change like in the hardware descriptor
+		// 
+		template <typename TSink>
+		constexpr void EmitInput(TSink& Sink)
+		{
+			unsigned int page = GenericDesktop;
+			int logicalMin = -1, logicalMax = -1, physicalMin = -1, physicalMax = -1;
+			unsigned int size = 0, count = 0;
+
+			Item(Sink, UsagePageTag, page);
+			Item(Sink, UsageTag, GamePad);
+			Item(Sink, CollectionTag, 0x01);
+			Item(Sink, ReportIdTag, ReportId);
+
+			for (const Field& field : Fields)
+			{
+				if (field.UsagePage != page)
+					Item(Sink, UsagePageTag, page = field.UsagePage);
+
+				if (field.IsUsageRange)
+				{
+					Item(Sink, UsageMinimumTag, field.Usages[0]);
+					Item(Sink, UsageMaximumTag, field.Usages[1]);
+				}
+				else
+				{
+					for (unsigned int i = 0; i < field.UsageCount; i++)
+						Item(Sink, UsageTag, field.Usages[i]);
+				}
+
+				for (unsigned int pass = 0; pass < 2; pass++)
+				{
+					if ((pass == 0) == field.IsSizeFirst)
+					{
+						if (field.Size != size)
+							Item(Sink, ReportSizeTag, size = field.Size);
+
+						if (field.Count != count)
+							Item(Sink, ReportCountTag, count = field.Count);
+
+						continue;
+					}
+
+					if (field.LogicalMin != logicalMin || field.LogicalMax != logicalMax)
+					{
+						Item(Sink, LogicalMinimumTag, logicalMin = field.LogicalMin, true);
+						Item(Sink, LogicalMaximumTag, logicalMax = field.LogicalMax, true);
+					}
+
+					if (field.HasPhysical && (field.PhysicalMin != physicalMin || field.PhysicalMax != physicalMax))
+					{
+						Item(Sink, PhysicalMinimumTag, physicalMin = field.PhysicalMin, true);
+						Item(Sink, PhysicalMaximumTag, physicalMax = field.PhysicalMax, true);
+					}
+
+					if (field.Unit != 0x00)
+						Item(Sink, UnitTag, field.Unit);
+				}
+
+				Item(Sink, InputTag, field.Flags);
+
+				if (field.Unit != 0x00)
+					Item(Sink, UnitTag, 0x00);
+			}
+		}
+
+		constexpr unsigned int InputDescriptorSize()
+		{
+			Counter counter{};
+			EmitInput(counter);
+			return counter.Size;
+		}
+
+		constexpr bool IsConsistent()
+		{
+			if (BitOffsetOf(FieldCount) != ReportSize * 8)
+				return false;
+
+			for (unsigned int i = 0; i < FieldCount; i++)
+			{
+				const Field& field = Fields[i];
+
+				const unsigned int usages = field.IsUsageRange
+					? field.Usages[1] - field.Usages[0] + 1u
+					: field.UsageCount;
+
+				// Every element needs a usage, a single one gets repeated
+				if (usages != field.Count && usages != 1)
+					return false;
+
+				if (field.NeutralBytes != nullptr)
+				{
+					if (field.Size != 8 || BitOffsetOf(i) % 8 != 0)
+						return false;
+
+					continue;
+				}
+
+				if (field.Bits() < 64 && (field.NeutralValue >> field.Bits()) != 0)
+					return false;
+
+				// Resting elements are in range, or the null state where allowed
+				for (unsigned int e = 0; e < field.Count && e * field.Size < 64; e++)
+				{
+					const long value = static_cast<long>((field.NeutralValue >> (e * field.Size)) & Mask(field.Size));
+
+					if ((value < field.LogicalMin || value > field.LogicalMax) && !(field.Flags & 0x40))
+						return false;
+				}
+			}
+
+			return true;
+		}
+	}
+
+	static_assert(Detail::IsConsistent(), "DS4 report schema does not add up");
+
+	//
+	// Report descriptor from the start of the application collection through
+	// the last input field; output and feature reports follow verbatim
+	// 
+	constexpr UsbDescriptors::Blob<Detail::InputDescriptorSize()> InputDescriptor()
+	{
+		Detail::Writer<Detail::InputDescriptorSize()> writer{};
+		Detail::EmitInput(writer);
+		return writer.Out;
+	}
+}
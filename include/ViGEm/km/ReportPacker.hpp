@@ -0,0 +1,348 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VIGEM_REPORT_PACKER_SSE2
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VIGEM_REPORT_PACKER_NEON
+#endif
+
+#include "Ds4ReportSchema.hpp"
+
+namespace ViGEm::Bus::Core::ReportPacker
+{
+	//
+	// Logical state of many pads, one array per member (structure of arrays).
+	// Sticks range from -1 to 1 with positive Y pointing up, triggers from 0 to 1.
+	// Out of range values get clamped, NaN maps to the lower bound.
+	// 
+	struct PadStates
+	{
+		const float* ThumbLX;
+		const float* ThumbLY;
+		const float* ThumbRX;
+		const float* ThumbRY;
+
+		const float* LeftTrigger;
+		const float* RightTrigger;
+
+		//
+		// Button bits in the layout of the target (XUSB_BUTTON or DS4_BUTTONS incl. D-Pad hat)
+		// 
+		const unsigned short* Buttons;
+
+		//
+		// DS4_SPECIAL_BUTTONS, may be nullptr for XUSB or if none are pressed
+		// 
+		const unsigned char* Special;
+	};
+
+	//
+	// Wire size of XUSB_REPORT as cached in EmulationTargetXUSB::_Packet.Report
+	// 
+	constexpr unsigned int XusbReportSize = 12;
+
+	//
+	// Wire size of the DS4 input report as cached in EmulationTargetDS4::_Report
+	// 
+	constexpr unsigned int Ds4ReportSize = Ds4ReportSchema::ReportSize;
+
+	constexpr unsigned char Ds4ReportId = Ds4ReportSchema::ReportId;
+
+	namespace Detail
+	{
+		enum Channel
+		{
+			ThumbLX,
+			ThumbLY,
+			ThumbRX,
+			ThumbRY,
+			LeftTrigger,
+			RightTrigger,
+			ChannelCount
+		};
+
+		constexpr float StickScale = 32767.0f;
+		constexpr float TriggerScale = 255.0f;
+
+		//
+		// Same operand order and NaN handling as MAXPS/MINPS
+		// 
+		inline float Clamp(float Value, float Low, float High)
+		{
+			Value = (Value > Low) ? Value : Low;
+			return (Value < High) ? Value : High;
+		}
+
+		//
+		// Scales and truncates toward zero, a single rounding step so every path agrees
+		// 
+		inline int Quantize(float Value, float Low, float High, float Scale)
+		{
+			return static_cast<int>(Clamp(Value, Low, High) * Scale);
+		}
+
+#if defined(__AVX2__)
+		constexpr unsigned int Lanes = 8;
+
+		inline void QuantizeLanes(const float* In, float Low, float High, float Scale, int* Out)
+		{
+			__m256 v = _mm256_loadu_ps(In);
+			v = _mm256_max_ps(v, _mm256_set1_ps(Low));
+			v = _mm256_min_ps(v, _mm256_set1_ps(High));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(Out),
+				_mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(Scale))));
+		}
+#elif defined(VIGEM_REPORT_PACKER_SSE2)
+		constexpr unsigned int Lanes = 4;
+
+		inline void QuantizeLanes(const float* In, float Low, float High, float Scale, int* Out)
+		{
+			__m128 v = _mm_loadu_ps(In);
+			v = _mm_max_ps(v, _mm_set1_ps(Low));
+			v = _mm_min_ps(v, _mm_set1_ps(High));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Out),
+				_mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(Scale))));
+		}
+#elif defined(VIGEM_REPORT_PACKER_NEON)
+		constexpr unsigned int Lanes = 4;
+
+		inline void QuantizeLanes(const float* In, float Low, float High, float Scale, int* Out)
+		{
+			const float32x4_t low = vdupq_n_f32(Low);
+			const float32x4_t high = vdupq_n_f32(High);
+
+			float32x4_t v = vld1q_f32(In);
+			// vmaxq/vminq propagate NaN, select explicitly to match the scalar path
+			v = vbslq_f32(vcgtq_f32(v, low), v, low);
+			v = vbslq_f32(vcltq_f32(v, high), v, high);
+			vst1q_s32(Out, vcvtq_s32_f32(vmulq_f32(v, vdupq_n_f32(Scale))));
+		}
+#else
+		constexpr unsigned int Lanes = 1;
+
+		inline void QuantizeLanes(const float* In, float Low, float High, float Scale, int* Out)
+		{
+			Out[0] = Quantize(In[0], Low, High, Scale);
+		}
+#endif
+
+		inline void PutShort(unsigned char* Out, int Value)
+		{
+			Out[0] = static_cast<unsigned char>(Value & 0xFF);
+			Out[1] = static_cast<unsigned char>((Value >> 8) & 0xFF);
+		}
+
+		//
+		// Same mapping as ReportConversion::AxisToDs4
+		// 
+		inline unsigned char StickToDs4(int Value)
+		{
+			return static_cast<unsigned char>((Value + 32768) >> 8);
+		}
+
+		//
+		// Same mapping as ReportConversion::AxisToDs4Inverted, quantized sticks
+		// never reach -32768 so plain negation can't overflow
+		// 
+		inline unsigned char StickToDs4Inverted(int Value)
+		{
+			return StickToDs4(-Value);
+		}
+
+		//
+		// Quantized values of the pads [First, First + Count) per channel
+		// 
+		template <unsigned int Count>
+		struct Block
+		{
+			int Values[ChannelCount][Count];
+		};
+
+		template <bool Vectorized, unsigned int Count>
+		inline void QuantizeBlock(const PadStates& States, unsigned int First, Block<Count>& Out)
+		{
+			const float* channels[ChannelCount] =
+			{
+				States.ThumbLX, States.ThumbLY, States.ThumbRX, States.ThumbRY,
+				States.LeftTrigger, States.RightTrigger
+			};
+
+			for (unsigned int c = 0; c < ChannelCount; c++)
+			{
+				const bool isStick = c < LeftTrigger;
+				const float low = isStick ? -1.0f : 0.0f;
+				const float scale = isStick ? StickScale : TriggerScale;
+
+				if constexpr (Vectorized)
+				{
+					static_assert(Count == Lanes, "vectorized blocks span all lanes");
+					QuantizeLanes(channels[c] + First, low, 1.0f, scale, Out.Values[c]);
+				}
+				else
+				{
+					for (unsigned int i = 0; i < Count; i++)
+						Out.Values[c][i] = Quantize(channels[c][First + i], low, 1.0f, scale);
+				}
+			}
+		}
+
+		template <unsigned int Count>
+		inline void ScatterXusb(const PadStates& States, unsigned int First, const Block<Count>& In,
+			unsigned char* Reports, unsigned int Stride)
+		{
+			for (unsigned int i = 0; i < Count; i++)
+			{
+				unsigned char* report = Reports + static_cast<unsigned long long>(First + i) * Stride;
+
+				PutShort(report + 0, States.Buttons[First + i]);
+				report[2] = static_cast<unsigned char>(In.Values[LeftTrigger][i]);
+				report[3] = static_cast<unsigned char>(In.Values[RightTrigger][i]);
+				PutShort(report + 4, In.Values[ThumbLX][i]);
+				PutShort(report + 6, In.Values[ThumbLY][i]);
+				PutShort(report + 8, In.Values[ThumbRX][i]);
+				PutShort(report + 10, In.Values[ThumbRY][i]);
+			}
+		}
+
+		template <unsigned int Count>
+		inline void ScatterDs4(const PadStates& States, unsigned int First, const Block<Count>& In,
+			unsigned char* Reports, unsigned int Stride)
+		{
+			for (unsigned int i = 0; i < Count; i++)
+			{
+				unsigned char* report = Reports + static_cast<unsigned long long>(First + i) * Stride;
+
+				report[0] = Ds4ReportId;
+				report[Ds4ReportSchema::LeftThumbX.ByteOffset()] = StickToDs4(In.Values[ThumbLX][i]);
+				report[Ds4ReportSchema::LeftThumbY.ByteOffset()] = StickToDs4Inverted(In.Values[ThumbLY][i]);
+				report[Ds4ReportSchema::RightThumbX.ByteOffset()] = StickToDs4(In.Values[ThumbRX][i]);
+				report[Ds4ReportSchema::RightThumbY.ByteOffset()] = StickToDs4Inverted(In.Values[ThumbRY][i]);
+				PutShort(report + Ds4ReportSchema::ButtonState.ByteOffset(), States.Buttons[First + i]);
+				Ds4ReportSchema::Set(report, Ds4ReportSchema::SpecialButtons, States.Special ? States.Special[First + i] : 0);
+				report[Ds4ReportSchema::LeftTrigger.ByteOffset()] = static_cast<unsigned char>(In.Values[LeftTrigger][i]);
+				report[Ds4ReportSchema::RightTrigger.ByteOffset()] = static_cast<unsigned char>(In.Values[RightTrigger][i]);
+			}
+		}
+
+		template <bool Vectorized>
+		inline void PackXusb(const PadStates& States, unsigned int Count, unsigned char* Reports, unsigned int Stride)
+		{
+			unsigned int i = 0;
+
+			for (; Vectorized && i + Lanes <= Count; i += Lanes)
+			{
+				Block<Lanes> block;
+				QuantizeBlock<true>(States, i, block);
+				ScatterXusb(States, i, block, Reports, Stride);
+			}
+
+			for (; i < Count; i++)
+			{
+				Block<1> block;
+				QuantizeBlock<false>(States, i, block);
+				ScatterXusb(States, i, block, Reports, Stride);
+			}
+		}
+
+		template <bool Vectorized>
+		inline void PackDs4(const PadStates& States, unsigned int Count, unsigned char* Reports, unsigned int Stride)
+		{
+			unsigned int i = 0;
+
+			for (; Vectorized && i + Lanes <= Count; i += Lanes)
+			{
+				Block<Lanes> block;
+				QuantizeBlock<true>(States, i, block);
+				ScatterDs4(States, i, block, Reports, Stride);
+			}
+
+			for (; i < Count; i++)
+			{
+				Block<1> block;
+				QuantizeBlock<false>(States, i, block);
+				ScatterDs4(States, i, block, Reports, Stride);
+			}
+		}
+	}
+
+	//
+	// Packs Count pads into XUSB_REPORTs placed Stride bytes apart, so they can
+	// be written straight into an array of XUSB_SUBMIT_REPORT.Report as well.
+	// Sticks map to -32767..32767, triggers to 0..255, both truncating toward zero.
+	// 
+	inline void PackXusb(const PadStates& States, unsigned int Count, void* Reports,
+		unsigned int Stride = XusbReportSize)
+	{
+		Detail::PackXusb<true>(States, Count, static_cast<unsigned char*>(Reports), Stride);
+	}
+
+	//
+	// Packs Count pads into DS4 input reports placed Stride bytes apart.
+	// Only the report ID, sticks, buttons and triggers are written; the frame
+	// counter next to the special buttons and the touch and motion data the
+	// caller keeps in the remaining bytes survive.
+	// 
+	inline void PackDs4(const PadStates& States, unsigned int Count, void* Reports,
+		unsigned int Stride = Ds4ReportSize)
+	{
+		Detail::PackDs4<true>(States, Count, static_cast<unsigned char*>(Reports), Stride);
+	}
+
+	//
+	// Scalar reference implementations, produce the same bytes as the above
+	// 
+	inline void PackXusbScalar(const PadStates& States, unsigned int Count, void* Reports,
+		unsigned int Stride = XusbReportSize)
+	{
+		Detail::PackXusb<false>(States, Count, static_cast<unsigned char*>(Reports), Stride);
+	}
+
+	inline void PackDs4Scalar(const PadStates& States, unsigned int Count, void* Reports,
+		unsigned int Stride = Ds4ReportSize)
+	{
+		Detail::PackDs4<false>(States, Count, static_cast<unsigned char*>(Reports), Stride);
+	}
+}
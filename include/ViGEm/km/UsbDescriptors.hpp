@@ -0,0 +1,224 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core::UsbDescriptors
+{
+	//
+	// Fixed-size run of descriptor bytes, composed at compile time
+	// 
+	template <unsigned int N>
+	struct Blob
+	{
+		unsigned char Bytes[N];
+
+		static constexpr unsigned int Size = N;
+	};
+
+	template <unsigned int A, unsigned int B>
+	constexpr Blob<A + B> operator+(const Blob<A>& Lhs, const Blob<B>& Rhs)
+	{
+		Blob<A + B> result{};
+
+		for (unsigned int i = 0; i < A; i++)
+			result.Bytes[i] = Lhs.Bytes[i];
+
+		for (unsigned int i = 0; i < B; i++)
+			result.Bytes[A + i] = Rhs.Bytes[i];
+
+		return result;
+	}
+
+	constexpr unsigned char Lo(unsigned int Value)
+	{
+		return static_cast<unsigned char>(Value & 0xFF);
+	}
+
+	constexpr unsigned char Hi(unsigned int Value)
+	{
+		return static_cast<unsigned char>((Value >> 8) & 0xFF);
+	}
+
+	//
+	// Bytes taken over verbatim, for vendor-specific descriptors
+	// 
+	template <typename... T>
+	constexpr Blob<sizeof...(T)> Raw(T... Bytes)
+	{
+		return { { static_cast<unsigned char>(Bytes)... } };
+	}
+
+	//
+	// Bytes taken over from an existing array
+	// 
+	template <unsigned int N>
+	constexpr Blob<N> Array(const unsigned char (&Bytes)[N])
+	{
+		Blob<N> result{};
+
+		for (unsigned int i = 0; i < N; i++)
+			result.Bytes[i] = Bytes[i];
+
+		return result;
+	}
+
+	constexpr unsigned char DeviceType = 0x01;
+	constexpr unsigned char ConfigurationType = 0x02;
+	constexpr unsigned char StringType = 0x03;
+	constexpr unsigned char InterfaceType = 0x04;
+	constexpr unsigned char EndpointType = 0x05;
+	constexpr unsigned char HidType = 0x21;
+
+	//
+	// Offsets of the fields patched per target
+	// 
+	constexpr unsigned int VendorIdOffset = 8;
+	constexpr unsigned int ProductIdOffset = 10;
+
+	constexpr Blob<18> Device(
+		unsigned short UsbVersion,
+		unsigned char Class,
+		unsigned char SubClass,
+		unsigned char Protocol,
+		unsigned char MaxPacketSize0,
+		unsigned short VendorId,
+		unsigned short ProductId,
+		unsigned short DeviceVersion,
+		unsigned char ManufacturerIndex,
+		unsigned char ProductIndex,
+		unsigned char SerialNumberIndex,
+		unsigned char NumConfigurations
+	)
+	{
+		return Raw(
+			18, DeviceType,
+			Lo(UsbVersion), Hi(UsbVersion),
+			Class, SubClass, Protocol, MaxPacketSize0,
+			Lo(VendorId), Hi(VendorId),
+			Lo(ProductId), Hi(ProductId),
+			Lo(DeviceVersion), Hi(DeviceVersion),
+			ManufacturerIndex, ProductIndex, SerialNumberIndex,
+			NumConfigurations
+		);
+	}
+
+	//
+	// Configuration header followed by Body, wTotalLength is derived from it
+	// 
+	template <unsigned int N>
+	constexpr Blob<9 + N> Configuration(
+		unsigned char NumInterfaces,
+		unsigned char ConfigurationValue,
+		unsigned char Attributes,
+		unsigned char MaxPower,
+		const Blob<N>& Body
+	)
+	{
+		return Raw(
+			9, ConfigurationType,
+			Lo(9 + N), Hi(9 + N),
+			NumInterfaces, ConfigurationValue, 0x00, Attributes, MaxPower
+		) + Body;
+	}
+
+	constexpr Blob<9> Interface(
+		unsigned char Number,
+		unsigned char AlternateSetting,
+		unsigned char NumEndpoints,
+		unsigned char Class,
+		unsigned char SubClass,
+		unsigned char Protocol,
+		unsigned char StringIndex
+	)
+	{
+		return Raw(9, InterfaceType, Number, AlternateSetting, NumEndpoints, Class, SubClass, Protocol, StringIndex);
+	}
+
+	constexpr Blob<7> Endpoint(
+		unsigned char Address,
+		unsigned char Attributes,
+		unsigned short MaxPacketSize,
+		unsigned char Interval
+	)
+	{
+		return Raw(7, EndpointType, Address, Attributes, Lo(MaxPacketSize), Hi(MaxPacketSize), Interval);
+	}
+
+	//
+	// HID class descriptor referencing a single report descriptor
+	// 
+	constexpr Blob<9> Hid(
+		unsigned short HidVersion,
+		unsigned char CountryCode,
+		unsigned char ReportType,
+		unsigned short ReportLength
+	)
+	{
+		return Raw(9, HidType, Lo(HidVersion), Hi(HidVersion), CountryCode, 0x01, ReportType, Lo(ReportLength), Hi(ReportLength));
+	}
+
+	//
+	// String descriptor zero listing a single language
+	// 
+	constexpr Blob<4> Languages(unsigned short LanguageId)
+	{
+		return Raw(4, StringType, Lo(LanguageId), Hi(LanguageId));
+	}
+
+	//
+	// UTF-16LE string descriptor from a literal, without its terminator
+	// 
+	template <unsigned int N>
+	constexpr Blob<2 + 2 * (N - 1)> String(const char16_t (&Text)[N])
+	{
+		Blob<2 + 2 * (N - 1)> result{};
+
+		result.Bytes[0] = static_cast<unsigned char>(result.Size);
+		result.Bytes[1] = StringType;
+
+		for (unsigned int i = 0; i < N - 1; i++)
+		{
+			result.Bytes[2 + 2 * i] = Lo(Text[i]);
+			result.Bytes[3 + 2 * i] = Hi(Text[i]);
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,209 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core::AxisInterpolation
+{
+	//
+	// How analog values get rendered between two submitted samples
+	// 
+	enum class Mode : unsigned int
+	{
+		//
+		// Repeat the latest sample
+		// 
+		None = 0,
+
+		//
+		// Glide from the previously rendered value to the latest sample over one
+		// sample interval (adds up to one interval of latency)
+		// 
+		Linear = 1,
+
+		//
+		// Continue the slope of the last two samples for one interval, then ease
+		// back onto the latest sample over the next one; no added latency
+		// 
+		Extrapolate = 2
+	};
+
+	//
+	// Fixed-point one (Q16)
+	// 
+	constexpr unsigned int FractionOne = 1u << 16;
+
+	//
+	// Progress through the current interval in Q16, saturating at one
+	// 
+	constexpr unsigned int Fraction(unsigned long long Elapsed, unsigned long long Interval)
+	{
+		if (Interval == 0 || Elapsed >= Interval)
+			return FractionOne;
+
+		return static_cast<unsigned int>((Elapsed << 16) / Interval);
+	}
+
+	//
+	// Renders Count unsigned 8-bit channels. Base is the value at the start of the
+	// interval, Delta gets scaled by Fraction and added; results clamp to 0..255.
+	// Written as a flat loop over independent lanes so compilers can vectorize it.
+	// 
+	inline void Render(
+		const unsigned char* Base,
+		const unsigned char* From,
+		const unsigned char* To,
+		unsigned int Fraction,
+		unsigned char* Out,
+		unsigned int Count
+	)
+	{
+		for (unsigned int i = 0; i < Count; i++)
+		{
+			const int delta = static_cast<int>(To[i]) - static_cast<int>(From[i]);
+			int value = static_cast<int>(Base[i]) + ((delta * static_cast<int>(Fraction)) >> 16);
+
+			value = value < 0 ? 0 : value;
+			value = value > 0xFF ? 0xFF : value;
+
+			Out[i] = static_cast<unsigned char>(value);
+		}
+	}
+
+	//
+	// Per-target interpolation state for Channels 8-bit analog values
+	// 
+	template <unsigned int Channels>
+	class Interpolator
+	{
+	public:
+		void SetMode(Mode NewMode)
+		{
+			_Mode = NewMode;
+		}
+
+		Mode GetMode() const
+		{
+			return _Mode;
+		}
+
+		//
+		// Holds Values steady until the next sample arrives
+		// 
+		void Reset(unsigned long long Now, const unsigned char* Values)
+		{
+			for (unsigned int i = 0; i < Channels; i++)
+				_From[i] = _To[i] = Values[i];
+
+			_LastTime = Now;
+			_Interval = 0;
+		}
+
+		//
+		// Records a newly submitted sample taken at Now
+		// 
+		void Push(unsigned long long Now, const unsigned char* Values, unsigned long long MinInterval, unsigned long long MaxInterval)
+		{
+			unsigned char rendered[Channels];
+
+			//
+			// Start the next glide where the host currently is to avoid jumps
+			// 
+			Sample(Now, rendered);
+
+			for (unsigned int i = 0; i < Channels; i++)
+			{
+				_From[i] = (_Mode == Mode::Extrapolate) ? _To[i] : rendered[i];
+				_To[i] = Values[i];
+			}
+
+			unsigned long long interval = Now - _LastTime;
+
+			interval = interval < MinInterval ? MinInterval : interval;
+			interval = interval > MaxInterval ? MaxInterval : interval;
+
+			_Interval = interval;
+			_LastTime = Now;
+		}
+
+		//
+		// Values to present to the host at Now
+		// 
+		void Sample(unsigned long long Now, unsigned char* Out) const
+		{
+			const unsigned long long elapsed = Now - _LastTime;
+
+			switch (_Mode)
+			{
+			case Mode::Linear:
+				Render(_From, _From, _To, Fraction(elapsed, _Interval), Out, Channels);
+				break;
+			case Mode::Extrapolate:
+				//
+				// A stalled feeder must not leave the overshoot applied forever
+				// 
+				if (elapsed < _Interval)
+					Render(_To, _From, _To, Fraction(elapsed, _Interval), Out, Channels);
+				else if (elapsed < 2 * _Interval)
+					Render(_To, _From, _To, FractionOne - Fraction(elapsed - _Interval, _Interval), Out, Channels);
+				else
+				{
+					for (unsigned int i = 0; i < Channels; i++)
+						Out[i] = _To[i];
+				}
+				break;
+			default:
+				for (unsigned int i = 0; i < Channels; i++)
+					Out[i] = _To[i];
+				break;
+			}
+		}
+
+	private:
+		Mode _Mode;
+
+		unsigned char _From[Channels];
+
+		unsigned char _To[Channels];
+
+		unsigned long long _LastTime;
+
+		unsigned long long _Interval;
+	};
+}
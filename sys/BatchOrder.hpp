@@ -0,0 +1,84 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core::BatchOrder
+{
+	//
+	// Sorts targets (and their reports along with them) by ascending serial
+	// number. Every batch acquires the per-target locks in this order, so two
+	// batches sharing targets can't deadlock. Insertion sort, batches are small.
+	// 
+	template <typename TTarget, typename TReport, typename TGetSerial>
+	void SortBySerial(TTarget* Targets, TReport* Reports, unsigned long Count, TGetSerial GetSerial)
+	{
+		for (unsigned long i = 1; i < Count; i++)
+		{
+			TTarget target = Targets[i];
+			TReport report = Reports[i];
+			unsigned long j = i;
+
+			for (; j > 0 && GetSerial(Targets[j - 1]) > GetSerial(target); j--)
+			{
+				Targets[j] = Targets[j - 1];
+				Reports[j] = Reports[j - 1];
+			}
+
+			Targets[j] = target;
+			Reports[j] = report;
+		}
+	}
+
+	//
+	// Expects sorted input. Returns the index of the second occurrence of a
+	// repeated serial number, Count if every serial number is unique.
+	// 
+	template <typename TTarget, typename TGetSerial>
+	unsigned long FindDuplicateSerial(const TTarget* Targets, unsigned long Count, TGetSerial GetSerial)
+	{
+		for (unsigned long i = 1; i < Count; i++)
+		{
+			if (GetSerial(Targets[i - 1]) == GetSerial(Targets[i]))
+				return i;
+		}
+
+		return Count;
+	}
+}
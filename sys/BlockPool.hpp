@@ -0,0 +1,299 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ViGEm::Bus::Core
+{
+	namespace BlockPoolDetail
+	{
+		inline long Increment(volatile long* Value)
+		{
+#if defined(_MSC_VER)
+			return _InterlockedIncrement(Value);
+#else
+			return __atomic_add_fetch(Value, 1, __ATOMIC_SEQ_CST);
+#endif
+		}
+
+		inline long Decrement(volatile long* Value)
+		{
+#if defined(_MSC_VER)
+			return _InterlockedDecrement(Value);
+#else
+			return __atomic_sub_fetch(Value, 1, __ATOMIC_SEQ_CST);
+#endif
+		}
+
+		//
+		// Returns the value found at Destination
+		// 
+		inline long long CompareExchange(volatile long long* Destination, long long Exchange, long long Comparand)
+		{
+#if defined(_MSC_VER)
+			return _InterlockedCompareExchange64(Destination, Exchange, Comparand);
+#else
+			__atomic_compare_exchange_n(Destination, &Comparand, Exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+			return Comparand;
+#endif
+		}
+
+		//
+		// Atomic read, also on 32-bit targets
+		// 
+		inline long long Load(volatile long long* Value)
+		{
+			return CompareExchange(Value, 0, 0);
+		}
+	}
+
+	//
+	// Blocks a single consumer may hold. Above Soft, blocks are only handed
+	// out while the pool has more than its reserve left; Hard is never exceeded.
+	// 
+	struct PoolQuota
+	{
+		unsigned int Soft;
+
+		unsigned int Hard;
+	};
+
+	//
+	// Share of one consumer in a BlockPool. Zero-initialized storage is a valid account.
+	// 
+	struct PoolAccount
+	{
+		//
+		// Blocks currently held
+		// 
+		volatile long InUse;
+
+		//
+		// Refused above the soft quota as the pool ran low
+		// 
+		volatile long Throttled;
+
+		//
+		// Refused at the hard quota or with the pool exhausted
+		// 
+		volatile long Overruns;
+	};
+
+	//
+	// Fixed-size blocks carved from caller-provided storage, shared by many
+	// consumers with per-consumer quotas. Free blocks form a lock-free LIFO of
+	// indices; the head carries a generation count in its upper half so a
+	// block freed and reallocated while another CPU pops can't corrupt it.
+	// Allocate and Free are safe to call concurrently at any IRQL.
+	// 
+	template <unsigned int BlockSize>
+	class BlockPool
+	{
+		static_assert(BlockSize % sizeof(void*) == 0, "BlockSize must keep blocks pointer-aligned");
+
+	public:
+		static constexpr unsigned int NoBlock = ~0u;
+
+		//
+		// Bytes of storage Initialize expects for Capacity blocks
+		// 
+		static constexpr unsigned long long StorageSize(unsigned int Capacity)
+		{
+			return static_cast<unsigned long long>(Capacity) * (BlockSize + sizeof(unsigned int));
+		}
+
+		//
+		// Takes over Storage of StorageSize(Capacity) bytes. Reserve blocks are
+		// kept for consumers below their soft quota. Not thread-safe.
+		// 
+		void Initialize(void* Storage, unsigned int Capacity, unsigned int Reserve)
+		{
+			_Blocks = static_cast<unsigned char*>(Storage);
+			_Links = reinterpret_cast<volatile unsigned int*>(_Blocks + static_cast<unsigned long long>(Capacity) * BlockSize);
+			_Capacity = Capacity;
+			_Reserve = Reserve;
+
+			for (unsigned int i = 0; i < Capacity; i++)
+				_Links[i] = (i + 1 < Capacity) ? i + 1 : NoBlock;
+
+			_Head = Capacity ? 0 : NoBlock;
+			_Free = static_cast<long>(Capacity);
+		}
+
+		//
+		// Index of a block charged to Account, NoBlock if refused
+		// 
+		unsigned int Allocate(PoolAccount& Account, const PoolQuota& Quota)
+		{
+			const long inUse = BlockPoolDetail::Increment(&Account.InUse);
+
+			if (static_cast<unsigned long>(inUse) > Quota.Hard)
+			{
+				BlockPoolDetail::Decrement(&Account.InUse);
+				BlockPoolDetail::Increment(&Account.Overruns);
+				return NoBlock;
+			}
+
+			if (static_cast<unsigned long>(inUse) > Quota.Soft && FreeCount() <= _Reserve)
+			{
+				BlockPoolDetail::Decrement(&Account.InUse);
+				BlockPoolDetail::Increment(&Account.Throttled);
+				return NoBlock;
+			}
+
+			const unsigned int index = Pop();
+
+			if (index == NoBlock)
+			{
+				BlockPoolDetail::Decrement(&Account.InUse);
+				BlockPoolDetail::Increment(&Account.Overruns);
+				return NoBlock;
+			}
+
+			BlockPoolDetail::Decrement(&_Free);
+
+			return index;
+		}
+
+		//
+		// Returns a block obtained through Allocate with the same Account
+		// 
+		void Free(PoolAccount& Account, unsigned int Index)
+		{
+			BlockPoolDetail::Increment(&_Free);
+
+			Push(Index);
+
+			BlockPoolDetail::Decrement(&Account.InUse);
+		}
+
+		unsigned char* Block(unsigned int Index)
+		{
+			return _Blocks + static_cast<unsigned long long>(Index) * BlockSize;
+		}
+
+		//
+		// Approximate while other CPUs allocate or free
+		// 
+		unsigned int FreeCount() const
+		{
+			const long free = _Free;
+
+			return free > 0 ? static_cast<unsigned int>(free) : 0;
+		}
+
+		unsigned int Capacity() const
+		{
+			return _Capacity;
+		}
+
+	private:
+		static unsigned int IndexOf(long long Head)
+		{
+			return static_cast<unsigned int>(Head & 0xFFFFFFFF);
+		}
+
+		static long long NextHead(long long Head, unsigned int Index)
+		{
+			const unsigned long long generation = (static_cast<unsigned long long>(Head) >> 32) + 1;
+
+			return static_cast<long long>((generation << 32) | Index);
+		}
+
+		unsigned int Pop()
+		{
+			long long head = BlockPoolDetail::Load(&_Head);
+
+			for (;;)
+			{
+				const unsigned int index = IndexOf(head);
+
+				if (index == NoBlock)
+					return NoBlock;
+
+				//
+				// May be stale if the block got popped meanwhile, the
+				// generation then makes the exchange fail
+				// 
+				const long long seen = BlockPoolDetail::CompareExchange(&_Head, NextHead(head, _Links[index]), head);
+
+				if (seen == head)
+					return index;
+
+				head = seen;
+			}
+		}
+
+		void Push(unsigned int Index)
+		{
+			long long head = BlockPoolDetail::Load(&_Head);
+
+			for (;;)
+			{
+				_Links[Index] = IndexOf(head);
+
+				const long long seen = BlockPoolDetail::CompareExchange(&_Head, NextHead(head, Index), head);
+
+				if (seen == head)
+					return;
+
+				head = seen;
+			}
+		}
+
+		//
+		// Generation in the upper, index of the first free block in the lower half
+		// 
+		volatile long long _Head;
+
+		volatile long _Free;
+
+		unsigned char* _Blocks;
+
+		volatile unsigned int* _Links;
+
+		unsigned int _Capacity;
+
+		unsigned int _Reserve;
+	};
+}
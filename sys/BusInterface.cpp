@@ -0,0 +1,422 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Driver.h"
+#include "trace.h"
+#include "BusInterface.tmh"
+
+//
+// Instantiates GUID_VIGEM_INTERFACE_BUS_DIRECT
+// 
+#include <initguid.h>
+#include <ViGEm/km/BusSharedEx.h>
+
+#include "EmulationTargetPDO.hpp"
+#include "XusbPdo.hpp"
+#include "Ds4Pdo.hpp"
+#include "DirectClient.hpp"
+
+using ViGEm::Bus::Core::EmulationTargetPDO;
+using ViGEm::Bus::Targets::EmulationTargetXUSB;
+using ViGEm::Bus::Targets::EmulationTargetDS4;
+
+typedef ViGEm::Bus::Core::DirectClient<WDFDEVICE> BUS_DIRECT_CLIENT, * PBUS_DIRECT_CLIENT;
+
+
+EXTERN_C_START
+
+//
+// Interface references keep the client and the bus device object (and its context) alive
+// 
+static
+VOID
+Bus_DirectInterfaceReference(
+	_In_ PVOID Context
+)
+{
+	const auto pClient = static_cast<PBUS_DIRECT_CLIENT>(Context);
+
+	pClient->Reference();
+	WdfObjectReferenceWithTag(pClient->Device, reinterpret_cast<PVOID>(Bus_DirectInterfaceReference));
+	InterlockedIncrement(&FdoGetData(pClient->Device)->InterfaceReferenceCounter);
+}
+
+static
+VOID
+Bus_DirectInterfaceDereference(
+	_In_ PVOID Context
+)
+{
+	const auto pClient = static_cast<PBUS_DIRECT_CLIENT>(Context);
+	const WDFDEVICE device = pClient->Device;
+
+	InterlockedDecrement(&FdoGetData(device)->InterfaceReferenceCounter);
+
+	if (pClient->Dereference())
+	{
+		TraceVerbose(TRACE_BUSENUM, "Direct-call client %d released", pClient->SessionId);
+		ExFreePoolWithTag(pClient, BUS_DIRECT_CLIENT_POOL_TAG);
+	}
+
+	WdfObjectDereferenceWithTag(device, reinterpret_cast<PVOID>(Bus_DirectInterfaceReference));
+}
+
+//
+// Hands every querying driver its own client as interface context, the
+// framework takes the client's first reference once this returns
+// 
+static
+NTSTATUS
+Bus_DirectInterfaceProcessQuery(
+	_In_ WDFDEVICE Device,
+	_In_ LPGUID InterfaceType,
+	_Inout_ PINTERFACE ExposedInterface,
+	_Inout_opt_ PVOID ExposedInterfaceSpecificData
+)
+{
+	UNREFERENCED_PARAMETER(InterfaceType);
+	UNREFERENCED_PARAMETER(ExposedInterfaceSpecificData);
+
+	if (ExposedInterface->Size < sizeof(VIGEM_BUS_INTERFACE_V1))
+		return STATUS_INVALID_PARAMETER;
+
+	const auto pClient = static_cast<PBUS_DIRECT_CLIENT>(ExAllocatePoolZero(
+		NonPagedPoolNx,
+		sizeof(BUS_DIRECT_CLIENT),
+		BUS_DIRECT_CLIENT_POOL_TAG
+	));
+
+	if (pClient == nullptr)
+		return STATUS_INSUFFICIENT_RESOURCES;
+
+	pClient->Device = Device;
+	pClient->SessionId = InterlockedIncrement(&FdoGetData(Device)->NextSessionId);
+
+	ExposedInterface->Context = pClient;
+
+	TraceVerbose(TRACE_BUSENUM, "Direct-call client %d created", pClient->SessionId);
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Fails once the bus device got removed
+// 
+static
+BOOLEAN
+Bus_DirectAcquire(
+	_In_ PBUS_DIRECT_CLIENT Client
+)
+{
+	return ExAcquireRundownProtection(&FdoGetData(Client->Device)->DirectInterfaceRundown);
+}
+
+static
+VOID
+Bus_DirectRelease(
+	_In_ PBUS_DIRECT_CLIENT Client
+)
+{
+	ExReleaseRundownProtection(&FdoGetData(Client->Device)->DirectInterfaceRundown);
+}
+
+//
+// Looks up a target plugged in by Client, others' targets don't exist to it
+// 
+static
+NTSTATUS
+Bus_DirectGetOwnedTarget(
+	_In_ PBUS_DIRECT_CLIENT Client,
+	_In_ ULONG SerialNo,
+	_Out_ EmulationTargetPDO** Target
+)
+{
+	if (!EmulationTargetPDO::GetPdoBySerial(Client->Device, SerialNo, Target))
+		return STATUS_DEVICE_DOES_NOT_EXIST;
+
+	if (!Client->Owns((*Target)->GetSessionId(), (*Target)->IsOwner(TRUE)))
+	{
+		TraceEvents(TRACE_LEVEL_WARNING,
+			TRACE_BUSENUM,
+			"Direct-call client %d denied access to serial %d",
+			Client->SessionId,
+			SerialNo
+		);
+		return STATUS_ACCESS_DENIED;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+static
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_DirectPlugInTarget(
+	_In_ PVOID Context,
+	_In_ ULONG SerialNo,
+	_In_ VIGEM_TARGET_TYPE TargetType,
+	_In_ USHORT VendorId,
+	_In_ USHORT ProductId
+)
+{
+	FuncEntry(TRACE_BUSENUM);
+
+	const auto pClient = static_cast<PBUS_DIRECT_CLIENT>(Context);
+
+	if (!Bus_DirectAcquire(pClient))
+	{
+		FuncExit(TRACE_BUSENUM, "status=%!STATUS!", STATUS_DEVICE_REMOVED);
+		return STATUS_DEVICE_REMOVED;
+	}
+
+	NTSTATUS status = Bus_PlugInTarget(
+		pClient->Device,
+		SerialNo,
+		pClient->SessionId,
+		TargetType,
+		VendorId,
+		ProductId,
+		TRUE
+	);
+
+	Bus_DirectRelease(pClient);
+
+	FuncExit(TRACE_BUSENUM, "status=%!STATUS!", status);
+
+	return status;
+}
+
+static
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_DirectUnPlugTarget(
+	_In_ PVOID Context,
+	_In_ ULONG SerialNo
+)
+{
+	FuncEntry(TRACE_BUSENUM);
+
+	const auto pClient = static_cast<PBUS_DIRECT_CLIENT>(Context);
+
+	if (!Bus_DirectAcquire(pClient))
+	{
+		FuncExit(TRACE_BUSENUM, "status=%!STATUS!", STATUS_DEVICE_REMOVED);
+		return STATUS_DEVICE_REMOVED;
+	}
+
+	//
+	// Only ever matches targets of this client, serial 0 removes all of them
+	// 
+	NTSTATUS status = Bus_UnPlugTarget(
+		pClient->Device,
+		SerialNo,
+		pClient->SessionId,
+		FALSE
+	);
+
+	Bus_DirectRelease(pClient);
+
+	FuncExit(TRACE_BUSENUM, "status=%!STATUS!", status);
+
+	return status;
+}
+
+static
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+Bus_DirectSubmitReport(
+	_In_ PVOID Context,
+	_In_ PVOID Report
+)
+{
+	NTSTATUS status;
+	EmulationTargetPDO* pdo;
+
+	FuncEntry(TRACE_BUSENUM);
+
+	//
+	// All submit report structures share the Size and SerialNo header
+	// 
+	const auto pSubmit = static_cast<PXUSB_SUBMIT_REPORT>(Report);
+	const auto pClient = static_cast<PBUS_DIRECT_CLIENT>(Context);
+
+	if (pSubmit == nullptr || pSubmit->SerialNo == 0)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (!Bus_DirectAcquire(pClient))
+	{
+		status = STATUS_DEVICE_REMOVED;
+		goto exit;
+	}
+
+	if (!NT_SUCCESS(status = Bus_DirectGetOwnedTarget(pClient, pSubmit->SerialNo, &pdo)))
+		goto release;
+
+	if (!pdo->IsReportSizeValid(pSubmit->Size))
+	{
+		status = STATUS_INVALID_BUFFER_SIZE;
+		goto release;
+	}
+
+	switch (pdo->GetType())
+	{
+	case Xbox360Wired:
+		status = static_cast<EmulationTargetXUSB*>(pdo)->SubmitReport(Report, TRUE);
+		break;
+	case DualShock4Wired:
+		status = static_cast<EmulationTargetDS4*>(pdo)->SubmitReport(Report, TRUE);
+		break;
+	default:
+		status = pdo->SubmitReport(Report, TRUE);
+		break;
+	}
+
+release:
+	Bus_DirectRelease(pClient);
+
+exit:
+	FuncExit(TRACE_BUSENUM, "status=%!STATUS!", status);
+
+	return status;
+}
+
+static
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_DirectRegisterOutputCallback(
+	_In_ PVOID Context,
+	_In_ ULONG SerialNo,
+	_In_opt_ PFN_VIGEM_BUS_OUTPUT_CALLBACK Callback,
+	_In_opt_ PVOID CallbackContext
+)
+{
+	NTSTATUS status;
+	EmulationTargetPDO* pdo;
+
+	const auto pClient = static_cast<PBUS_DIRECT_CLIENT>(Context);
+
+	FuncEntry(TRACE_BUSENUM);
+
+	if (!Bus_DirectAcquire(pClient))
+	{
+		status = STATUS_DEVICE_REMOVED;
+		goto exit;
+	}
+
+	if (!NT_SUCCESS(status = Bus_DirectGetOwnedTarget(pClient, SerialNo, &pdo)))
+		goto release;
+
+	status = pdo->RegisterOutputCallback(Callback, CallbackContext);
+
+release:
+	Bus_DirectRelease(pClient);
+
+exit:
+	FuncExit(TRACE_BUSENUM, "status=%!STATUS!", status);
+
+	return status;
+}
+
+//
+// Exposes the direct-call interface to kernel-mode clients (IRP_MN_QUERY_INTERFACE)
+// 
+_Use_decl_annotations_
+NTSTATUS
+Bus_DirectInterfaceCreate(
+	WDFDEVICE Device
+)
+{
+	VIGEM_BUS_INTERFACE_V1 busInterface;
+	WDF_QUERY_INTERFACE_CONFIG ifaceCfg;
+
+	PAGED_CODE();
+
+	RtlZeroMemory(&busInterface, sizeof(VIGEM_BUS_INTERFACE_V1));
+
+	busInterface.InterfaceHeader.Size = sizeof(VIGEM_BUS_INTERFACE_V1);
+	busInterface.InterfaceHeader.Version = VIGEM_BUS_INTERFACE_VERSION_1;
+	busInterface.InterfaceHeader.Context = nullptr;
+
+	//
+	// Context gets replaced per client on query, the framework then references
+	// the interface once on behalf of every querying client
+	// 
+	busInterface.InterfaceHeader.InterfaceReference = Bus_DirectInterfaceReference;
+	busInterface.InterfaceHeader.InterfaceDereference = Bus_DirectInterfaceDereference;
+
+	busInterface.PlugInTarget = Bus_DirectPlugInTarget;
+	busInterface.UnPlugTarget = Bus_DirectUnPlugTarget;
+	busInterface.SubmitReport = Bus_DirectSubmitReport;
+	busInterface.RegisterOutputCallback = Bus_DirectRegisterOutputCallback;
+
+	WDF_QUERY_INTERFACE_CONFIG_INIT(&ifaceCfg,
+		reinterpret_cast<PINTERFACE>(&busInterface),
+		&GUID_VIGEM_INTERFACE_BUS_DIRECT,
+		Bus_DirectInterfaceProcessQuery
+	);
+
+	return WdfDeviceAddQueryInterface(Device, &ifaceCfg);
+}
+
+//
+// Fails new direct calls and waits for the ones in flight; clients still
+// holding interface references keep the device context valid until they let go
+// 
+_Use_decl_annotations_
+VOID
+Bus_DirectInterfaceRundown(
+	WDFDEVICE Device
+)
+{
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	PAGED_CODE();
+
+	ExWaitForRundownProtectionRelease(&pFdoData->DirectInterfaceRundown);
+
+	if (pFdoData->InterfaceReferenceCounter > 0)
+	{
+		TraceEvents(TRACE_LEVEL_WARNING,
+			TRACE_BUSENUM,
+			"%d direct-call interface reference(s) outstanding at removal",
+			pFdoData->InterfaceReferenceCounter
+		);
+	}
+}
+
+EXTERN_C_END
@@ -35,6 +35,8 @@
 
 #pragma once
 
+#include "HotPath.hpp"
+
 constexpr auto cpp_pool_tag = 'EGiV';
 
 #ifdef _AMD64_
@@ -44,6 +46,8 @@ void* operator new
     size_t size
     )
 {
+    ViGEm::Bus::Core::HotPathScope::NoteAllocation(cpp_pool_tag);
+
     return ExAllocatePoolZero(NonPagedPoolNx, size, cpp_pool_tag);
 }
 
@@ -52,6 +56,8 @@ void* operator new[]
     size_t size
     )
 {
+    ViGEm::Bus::Core::HotPathScope::NoteAllocation(cpp_pool_tag);
+
     return ExAllocatePoolZero(NonPagedPoolNx, size, cpp_pool_tag);
 }
 
@@ -107,6 +113,8 @@ void* __CRTDECL operator new
     size_t size
     )
 {
+    ViGEm::Bus::Core::HotPathScope::NoteAllocation(cpp_pool_tag);
+
     return ExAllocatePoolZero(NonPagedPoolNx, size, cpp_pool_tag);
 }
 
@@ -115,6 +123,8 @@ void* __CRTDECL operator new[]
     size_t size
     )
 {
+    ViGEm::Bus::Core::HotPathScope::NoteAllocation(cpp_pool_tag);
+
     return ExAllocatePoolZero(NonPagedPoolNx, size, cpp_pool_tag);
 }
 
@@ -0,0 +1,270 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Driver.h"
+#include "HotPath.hpp"
+#include "trace.h"
+#include "Deadline.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, Bus_DeadlineInitialize)
+#endif
+
+
+EXTERN_C_START
+
+//
+// Current deadline wheel tick derived from interrupt time (100ns units)
+// 
+static ULONG64 Bus_DeadlineCurrentTick()
+{
+	return KeQueryInterruptTime() / (BUS_DEADLINE_TICK_MS * 10000ULL);
+}
+
+//
+// Creates the timer backing request deadlines.
+// 
+_Use_decl_annotations_
+NTSTATUS
+Bus_DeadlineInitialize(
+	WDFDEVICE Device
+)
+{
+	NTSTATUS status;
+	WDF_TIMER_CONFIG timerConfig;
+	WDF_OBJECT_ATTRIBUTES timerAttribs;
+	PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	PAGED_CODE();
+
+	KeInitializeSpinLock(&pFdoData->DeadlineLock);
+
+	WDF_TIMER_CONFIG_INIT(&timerConfig, Bus_EvtDeadlineTimer);
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&timerAttribs);
+	timerAttribs.ParentObject = Device;
+
+	if (!NT_SUCCESS(status = WdfTimerCreate(
+		&timerConfig,
+		&timerAttribs,
+		&pFdoData->DeadlineTimer
+	)))
+	{
+		TraceError(
+			TRACE_UTIL,
+			"WdfTimerCreate failed with status %!STATUS!",
+			status);
+	}
+
+	return status;
+}
+
+//
+// Forwards a request to a manual queue. With a non-zero timeout the request gets
+// completed with STATUS_TIMEOUT (and no data) if still queued once it expired.
+// 
+_Use_decl_annotations_
+NTSTATUS
+Bus_ForwardToIoQueueWithDeadline(
+	WDFDEVICE Device,
+	WDFREQUEST Request,
+	WDFQUEUE Queue,
+	ULONG TimeoutMs
+)
+{
+	NTSTATUS status;
+	KIRQL irql;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	PBUS_REQUEST_DEADLINE pDeadline;
+	BOOLEAN startTimer = FALSE;
+	PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	if (TimeoutMs == 0)
+		return WdfRequestForwardToIoQueue(Request, Queue);
+
+	//
+	// Requests sent to the bus device come with the context, others need one now
+	// 
+	if ((pDeadline = RequestGetDeadline(Request)) == nullptr)
+	{
+		ViGEm::Bus::Core::HotPathScope::NoteAllocation(BUS_FRAMEWORK_POOL_TAG);
+
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, BUS_REQUEST_DEADLINE);
+		attributes.EvtCleanupCallback = Bus_EvtRequestDeadlineCleanup;
+
+		if (!NT_SUCCESS(status = WdfObjectAllocateContext(
+			Request,
+			&attributes,
+			reinterpret_cast<PVOID*>(&pDeadline)
+		)))
+		{
+			TraceError(
+				TRACE_UTIL,
+				"WdfObjectAllocateContext failed with status %!STATUS!",
+				status);
+			return status;
+		}
+	}
+
+	pDeadline->Device = Device;
+	pDeadline->Queue = Queue;
+	pDeadline->Request = Request;
+	pDeadline->State = BusRequestDeadlineIdle;
+
+	const ULONG64 deadline = Bus_DeadlineCurrentTick() + (TimeoutMs + BUS_DEADLINE_TICK_MS - 1) / BUS_DEADLINE_TICK_MS;
+
+	//
+	// The request may get completed the moment it's queued, keep the context alive until armed
+	// 
+	WdfObjectReference(Request);
+
+	if (NT_SUCCESS(status = WdfRequestForwardToIoQueue(Request, Queue)))
+	{
+		KeAcquireSpinLock(&pFdoData->DeadlineLock, &irql);
+
+		//
+		// Skip if cleanup already ran
+		// 
+		if (pDeadline->State == BusRequestDeadlineIdle)
+		{
+			startTimer = pFdoData->DeadlineWheel.IsEmpty();
+
+			pFdoData->DeadlineWheel.Insert(&pDeadline->Entry, deadline);
+			pDeadline->State = BusRequestDeadlineArmed;
+		}
+
+		KeReleaseSpinLock(&pFdoData->DeadlineLock, irql);
+
+		if (startTimer)
+			WdfTimerStart(pFdoData->DeadlineTimer, WDF_REL_TIMEOUT_IN_MS(BUS_DEADLINE_TICK_MS));
+	}
+
+	WdfObjectDereference(Request);
+
+	return status;
+}
+
+//
+// Request completed or canceled, drop pending deadline.
+// 
+_Use_decl_annotations_
+VOID
+Bus_EvtRequestDeadlineCleanup(
+	WDFOBJECT Object
+)
+{
+	KIRQL irql;
+	const PBUS_REQUEST_DEADLINE pDeadline = RequestGetDeadline(Object);
+
+	//
+	// Every request to the bus device carries the context, most never got a deadline
+	// 
+	if (pDeadline->Device == nullptr)
+		return;
+
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(pDeadline->Device);
+
+	KeAcquireSpinLock(&pFdoData->DeadlineLock, &irql);
+
+	if (pDeadline->State == BusRequestDeadlineArmed)
+		pFdoData->DeadlineWheel.Remove(&pDeadline->Entry);
+
+	pDeadline->State = BusRequestDeadlineDone;
+
+	KeReleaseSpinLock(&pFdoData->DeadlineLock, irql);
+}
+
+//
+// Completes expired requests still sitting in their queue.
+// 
+_Use_decl_annotations_
+VOID
+Bus_EvtDeadlineTimer(
+	WDFTIMER Timer
+)
+{
+	KIRQL irql;
+	BOOLEAN restartTimer;
+	ViGEm::Bus::Core::TimerWheelEntry* expired;
+	const PFDO_DEVICE_DATA pFdoData = FdoGetData(static_cast<WDFDEVICE>(WdfTimerGetParentObject(Timer)));
+
+	KeAcquireSpinLock(&pFdoData->DeadlineLock, &irql);
+
+	expired = pFdoData->DeadlineWheel.Advance(Bus_DeadlineCurrentTick());
+
+	//
+	// Hold a reference so the context stays valid while racing regular completion
+	// 
+	for (auto entry = expired; entry != nullptr; entry = entry->Next)
+	{
+		const auto pDeadline = CONTAINING_RECORD(entry, BUS_REQUEST_DEADLINE, Entry);
+
+		pDeadline->State = BusRequestDeadlineDone;
+		WdfObjectReference(pDeadline->Request);
+	}
+
+	restartTimer = !pFdoData->DeadlineWheel.IsEmpty();
+
+	KeReleaseSpinLock(&pFdoData->DeadlineLock, irql);
+
+	while (expired != nullptr)
+	{
+		WDFREQUEST request;
+		const auto pDeadline = CONTAINING_RECORD(expired, BUS_REQUEST_DEADLINE, Entry);
+		const WDFREQUEST expiredRequest = pDeadline->Request;
+
+		expired = expired->Next;
+
+		//
+		// Fails if the request got completed or canceled in the meantime
+		// 
+		if (NT_SUCCESS(WdfIoQueueRetrieveFoundRequest(pDeadline->Queue, expiredRequest, &request)))
+		{
+			TraceVerbose(
+				TRACE_UTIL,
+				"Request 0x%p expired, completing with STATUS_TIMEOUT",
+				request);
+
+			WdfRequestComplete(request, STATUS_TIMEOUT);
+		}
+
+		WdfObjectDereference(expiredRequest);
+	}
+
+	if (restartTimer)
+		WdfTimerStart(Timer, WDF_REL_TIMEOUT_IN_MS(BUS_DEADLINE_TICK_MS));
+}
+
+EXTERN_C_END
@@ -0,0 +1,93 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// One reference to the direct-call interface. Every querying driver gets
+	// its own instance as interface context; SessionId is the owner token
+	// recorded on the targets plugged in through it, drawn from the same
+	// sequence as user-mode sessions so no two owners ever share one.
+	// 
+	template <typename TDevice>
+	struct DirectClient
+	{
+		TDevice Device;
+
+		long SessionId;
+
+		volatile long References;
+
+		void Reference()
+		{
+#if defined(_MSC_VER)
+			_InterlockedIncrement(&References);
+#else
+			__atomic_add_fetch(&References, 1, __ATOMIC_SEQ_CST);
+#endif
+		}
+
+		//
+		// Returns true once the last reference is gone and the client may be freed
+		// 
+		bool Dereference()
+		{
+#if defined(_MSC_VER)
+			return _InterlockedDecrement(&References) == 0;
+#else
+			return __atomic_sub_fetch(&References, 1, __ATOMIC_SEQ_CST) == 0;
+#endif
+		}
+
+		//
+		// Submissions, output callback registrations and unplugs only reach
+		// targets this client plugged in
+		// 
+		bool Owns(long TargetSessionId, bool OwnerIsDriver) const
+		{
+			return OwnerIsDriver && TargetSessionId == SessionId;
+		}
+	};
+}
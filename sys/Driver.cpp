@@ -44,6 +44,7 @@
 #pragma alloc_text (PAGE, Bus_DeviceFileCreate)
 #pragma alloc_text (PAGE, Bus_FileClose)
 #pragma alloc_text (PAGE, Bus_EvtDriverContextCleanup)
+#pragma alloc_text (PAGE, Bus_EvtDeviceContextCleanup)
 #endif
 
 #include "Queue.hpp"
@@ -71,6 +72,17 @@ IoctlHandler_IoctlRecord ViGEmBus_IoctlSpecification[] =
 	{IOCTL_DS4_REQUEST_NOTIFICATION, sizeof(DS4_REQUEST_NOTIFICATION), sizeof(DS4_REQUEST_NOTIFICATION), Bus_Ds4RequestNotificationHandler},
 	{IOCTL_XUSB_GET_USER_INDEX, sizeof(XUSB_GET_USER_INDEX), sizeof(XUSB_GET_USER_INDEX), Bus_XusbGetUserIndexHandler},
 	{IOCTL_DS4_AWAIT_OUTPUT_AVAILABLE, sizeof(DS4_AWAIT_OUTPUT), sizeof(DS4_AWAIT_OUTPUT), Bus_Ds4AwaitOutputHandler},
+	{IOCTL_VIGEM_GET_TARGET_SNAPSHOT, sizeof(VIGEM_TARGET_SNAPSHOT), sizeof(VIGEM_TARGET_SNAPSHOT), Bus_GetTargetSnapshotHandler},
+	{IOCTL_VIGEM_SUBMIT_REPORT_BATCH, sizeof(VIGEM_SUBMIT_REPORT_BATCH), 0, Bus_SubmitReportBatchHandler},
+	{IOCTL_VIGEM_SET_MIRROR_GROUP, sizeof(VIGEM_MIRROR_GROUP), 0, Bus_SetMirrorGroupHandler},
+	{IOCTL_VIGEM_SET_MERGE_POLICY, sizeof(VIGEM_MERGE_POLICY), 0, Bus_SetMergePolicyHandler},
+	{IOCTL_VIGEM_SUBMIT_LAYER, sizeof(VIGEM_SUBMIT_LAYER), 0, Bus_SubmitLayerHandler},
+	{IOCTL_VIGEM_SCHEDULE_REPORTS, sizeof(VIGEM_SCHEDULE_REPORTS), sizeof(VIGEM_SCHEDULE_REPORTS), Bus_ScheduleReportsHandler},
+	{IOCTL_VIGEM_SET_INTERPOLATION, sizeof(VIGEM_SET_INTERPOLATION), 0, Bus_SetInterpolationHandler},
+	{IOCTL_VIGEM_SUBMIT_IMU_SAMPLES, sizeof(VIGEM_SUBMIT_IMU_SAMPLES), 0, Bus_SubmitImuSamplesHandler},
+	{IOCTL_VIGEM_SET_ORDERED_DELIVERY, sizeof(VIGEM_SET_ORDERED_DELIVERY), 0, Bus_SetOrderedDeliveryHandler},
+	{IOCTL_VIGEM_GET_DELIVERY_COUNTERS, sizeof(VIGEM_DELIVERY_COUNTERS), sizeof(VIGEM_DELIVERY_COUNTERS), Bus_GetDeliveryCountersHandler},
+	{IOCTL_VIGEM_GET_MEMORY_FOOTPRINT, sizeof(VIGEM_MEMORY_FOOTPRINT), sizeof(VIGEM_MEMORY_FOOTPRINT), Bus_GetMemoryFootprintHandler},
 };
 
 //
@@ -97,6 +109,24 @@ NTSTATUS DriverEntry(IN PDRIVER_OBJECT DriverObject, IN PUNICODE_STRING Registry
 
 	ExInitializeDriverRuntime(DrvRtPoolNxOptIn);
 
+	//
+	// Caches recycling target objects across plug-ins
+	// 
+	if (!NT_SUCCESS(status = EmulationTargetXUSB::InitializeObjectCache()))
+	{
+		WPP_CLEANUP(DriverObject);
+		KdPrint((DRIVERNAME "ExInitializeLookasideListEx failed with status 0x%x\n", status));
+		return status;
+	}
+
+	if (!NT_SUCCESS(status = EmulationTargetDS4::InitializeObjectCache()))
+	{
+		EmulationTargetXUSB::DeleteObjectCache();
+		WPP_CLEANUP(DriverObject);
+		KdPrint((DRIVERNAME "ExInitializeLookasideListEx failed with status 0x%x\n", status));
+		return status;
+	}
+
 	//
 	// Register cleanup callback
 	// 
@@ -109,6 +139,8 @@ NTSTATUS DriverEntry(IN PDRIVER_OBJECT DriverObject, IN PUNICODE_STRING Registry
 
 	if (!NT_SUCCESS(status))
 	{
+		EmulationTargetDS4::DeleteObjectCache();
+		EmulationTargetXUSB::DeleteObjectCache();
 		WPP_CLEANUP(DriverObject);
 		KdPrint((DRIVERNAME "WdfDriverCreate failed with status 0x%x\n", status));
 	}
@@ -128,6 +160,7 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
 	WDF_FILEOBJECT_CONFIG foConfig;
 	WDF_OBJECT_ATTRIBUTES fdoAttributes;
 	WDF_OBJECT_ATTRIBUTES fileHandleAttributes;
+	WDF_OBJECT_ATTRIBUTES requestAttributes;
 	PFDO_DEVICE_DATA pFDOData;
 	PWSTR pSymbolicNameList;
 	PDMFDEVICE_INIT dmfDeviceInit = NULL;
@@ -219,9 +252,22 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
 
 #pragma endregion
 
+#pragma region Assign Request Attributes
+
+		//
+		// Pending a request with a deadline must not allocate, so every request brings the context
+		// 
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&requestAttributes, BUS_REQUEST_DEADLINE);
+		requestAttributes.EvtCleanupCallback = Bus_EvtRequestDeadlineCleanup;
+
+		WdfDeviceInitSetRequestAttributes(DeviceInit, &requestAttributes);
+
+#pragma endregion
+
 #pragma region Create FDO
 
 		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&fdoAttributes, FDO_DEVICE_DATA);
+		fdoAttributes.EvtCleanupCallback = Bus_EvtDeviceContextCleanup;
 
 		if (!NT_SUCCESS(status = WdfDeviceCreate(
 			&DeviceInit,
@@ -239,7 +285,38 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
 		pFDOData = FdoGetData(device);
 
 		pFDOData->InterfaceReferenceCounter = 0;
+		ExInitializeRundownProtection(&pFDOData->DirectInterfaceRundown);
 		pFDOData->NextSessionId = FDO_FIRST_SESSION_ID;
+		pFDOData->TargetGeneration = 0;
+		KeInitializeSpinLock(&pFDOData->GenerationLock);
+		pFDOData->RemovalGeneration = 0;
+
+		if (!NT_SUCCESS(status = Bus_DeadlineInitialize(device)))
+		{
+			TraceError(
+				TRACE_DRIVER,
+				"Bus_DeadlineInitialize failed with status %!STATUS!",
+				status);
+			break;
+		}
+
+		if (!NT_SUCCESS(status = Bus_TargetIndexInitialize(device)))
+		{
+			TraceError(
+				TRACE_DRIVER,
+				"Bus_TargetIndexInitialize failed with status %!STATUS!",
+				status);
+			break;
+		}
+
+		if (!NT_SUCCESS(status = Bus_OutputPoolInitialize(device)))
+		{
+			TraceError(
+				TRACE_DRIVER,
+				"Bus_OutputPoolInitialize failed with status %!STATUS!",
+				status);
+			break;
+		}
 
 #pragma endregion
 
@@ -258,6 +335,15 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
 			break;
 		}
 
+		if (!NT_SUCCESS(status = Bus_DirectInterfaceCreate(device)))
+		{
+			TraceError(
+				TRACE_DRIVER,
+				"Bus_DirectInterfaceCreate failed with status %!STATUS!",
+				status);
+			break;
+		}
+
 #pragma endregion
 
 #pragma region Set bus information
@@ -514,6 +600,9 @@ Bus_FileClose(
 				"Unplugging device with serial %d",
 				description.SerialNo);
 
+			// Stop routing submissions before PnP gets to the removal
+			description.Target->RemoveFromIndex();
+
 			// "Unplug" child
 			status = WdfChildListUpdateChildDescriptionAsMissing(list, &description.Header);
 			if (!NT_SUCCESS(status))
@@ -524,6 +613,11 @@ Bus_FileClose(
 					status);
 			}
 		}
+		// Drop input contributed to targets of other sessions
+		else if (childInfo.Status == WdfChildListRetrieveDeviceSuccess)
+		{
+			(void)description.Target->ReleaseLayer(pFileData->SessionId);
+		}
 	}
 
 	WdfChildListEndIteration(list, &iterator);
@@ -531,6 +625,23 @@ Bus_FileClose(
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Exit with status %!STATUS!", status);
 }
 
+//
+// Bus device removal, in-kernel clients may still hold interface references
+// 
+VOID
+Bus_EvtDeviceContextCleanup(
+	_In_ WDFOBJECT Device
+)
+{
+	PAGED_CODE();
+
+	FuncEntry(TRACE_DRIVER);
+
+	Bus_DirectInterfaceRundown(static_cast<WDFDEVICE>(Device));
+
+	FuncExitNoReturn(TRACE_DRIVER);
+}
+
 VOID
 Bus_EvtDriverContextCleanup(
 	_In_ WDFOBJECT DriverObject
@@ -556,6 +667,12 @@ Return Value:
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+	//
+	// All targets are gone along with the bus devices
+	// 
+	EmulationTargetDS4::DeleteObjectCache();
+	EmulationTargetXUSB::DeleteObjectCache();
+
 	//
 	// Stop WPP Tracing
 	//
@@ -600,30 +717,33 @@ void Util_DumpAsHex(PCSTR Prefix, PVOID Buffer, ULONG BufferLength)
 {
 #ifdef DBG
 
-	size_t dumpBufferLength = ((BufferLength * sizeof(CHAR)) * 2) + 1;
-	PSTR dumpBuffer = static_cast<PSTR>(ExAllocatePoolZero(
-		NonPagedPoolNx,
-		dumpBufferLength,
-		'1234'
-	));
-	if (dumpBuffer)
-	{
+	//
+	// Encoded on the stack in chunks, callers sit on request paths
+	// 
+	constexpr ULONG chunkSize = 32;
+	static const CHAR digits[] = "0123456789ABCDEF";
+	CHAR dumpBuffer[(chunkSize * 2) + 1];
+	const auto bytes = static_cast<PUCHAR>(Buffer);
 
-		RtlZeroMemory(dumpBuffer, dumpBufferLength);
+	for (ULONG offset = 0; offset < BufferLength; offset += chunkSize)
+	{
+		const ULONG count = min(BufferLength - offset, chunkSize);
 
-		for (ULONG i = 0; i < BufferLength; i++)
+		for (ULONG i = 0; i < count; i++)
 		{
-			sprintf(&dumpBuffer[i * 2], "%02X", static_cast<PUCHAR>(Buffer)[i]);
+			dumpBuffer[i * 2] = digits[bytes[offset + i] >> 4];
+			dumpBuffer[(i * 2) + 1] = digits[bytes[offset + i] & 0x0F];
 		}
 
+		dumpBuffer[count * 2] = '\0';
+
 		TraceVerbose(TRACE_BUSPDO,
-			"%s - Buffer length: %04d, buffer content: %s\n",
+			"%s - Buffer length: %04d, offset: %04d, buffer content: %s\n",
 			Prefix,
 			BufferLength,
+			offset,
 			dumpBuffer
 		);
-
-		ExFreePoolWithTag(dumpBuffer, '1234');
 	}
 #else
 	UNREFERENCED_PARAMETER(Prefix);
@@ -43,13 +43,80 @@
 #define NTSTRSAFE_LIB
 #include <ntstrsafe.h>
 
+#include <ViGEm/Common.h>
+
+#include "TimerWheel.hpp"
+#include "BlockPool.hpp"
+#include "TargetIndexStripe.hpp"
+
 
 #pragma region Macros
 
 #define DRIVERNAME                      "ViGEm: "
 
+//
+// Resolution and size of the request deadline timer wheel
+// 
+#define BUS_DEADLINE_TICK_MS            10
+#define BUS_DEADLINE_WHEEL_SLOTS        256
+
+//
+// Tag of framework allocations, derived from the service name
+// 
+#define BUS_FRAMEWORK_POOL_TAG          'EGiV'
+
+//
+// Layout of the serial number to target lookup table
+// 
+#define BUS_TARGET_INDEX_STRIPES        32
+#define BUS_TARGET_INDEX_STRIPE_SLOTS   8
+#define BUS_TARGET_INDEX_POOL_TAG       'ITiV'
+
+//
+// Interrupt OUT buffers shared by all targets, sized for traffic rather than target count
+// 
+#define BUS_OUTPUT_BLOCK_SIZE           128
+#define BUS_OUTPUT_POOL_BLOCKS          1024
+#define BUS_OUTPUT_POOL_RESERVE         256
+#define BUS_OUTPUT_POOL_TAG             'OBiV'
+
+//
+// Per-reference state of direct-call interface clients
+// 
+#define BUS_DIRECT_CLIENT_POOL_TAG      'CDiV'
+
 #pragma endregion
 
+namespace ViGEm::Bus::Core
+{
+    class EmulationTargetPDO;
+}
+
+//
+// One stripe of the serial number to target lookup table. Each stripe starts
+// on its own cache line, so submissions to targets hashing to different
+// stripes never touch the same line.
+// 
+#pragma warning(push)
+#pragma warning(disable:4324) // structure was padded due to alignment specifier
+typedef struct DECLSPEC_CACHEALIGN _BUS_TARGET_INDEX_STRIPE
+{
+    //
+    // Protects this stripe only
+    // 
+    KSPIN_LOCK Lock;
+
+    //
+    // Lookups in a stripe with overflow fall back to the child list
+    // 
+    ViGEm::Bus::Core::TargetIndexStripe<
+        ViGEm::Bus::Core::EmulationTargetPDO,
+        BUS_TARGET_INDEX_STRIPE_SLOTS
+    > Slots;
+
+} BUS_TARGET_INDEX_STRIPE, * PBUS_TARGET_INDEX_STRIPE;
+#pragma warning(pop)
+
 //
 // FDO (bus device) context data
 // 
@@ -61,7 +128,12 @@ typedef struct _FDO_DEVICE_DATA
     LONG InterfaceReferenceCounter;
 
     //
-    // Next SessionId to assign to a file handle
+    // Held by every direct-call interface invocation, run down on removal
+    // 
+    EX_RUNDOWN_REF DirectInterfaceRundown;
+
+    //
+    // Next SessionId to assign to a file handle or direct-call interface client
     // 
     LONG NextSessionId;
 
@@ -70,10 +142,53 @@ typedef struct _FDO_DEVICE_DATA
     // 
     DMFMODULE UserNotification;
 
+    //
+    // Bus-wide counter stamped on every target state change
+    // 
+    LONG64 TargetGeneration;
+
+    //
+    // Held while bumping TargetGeneration and storing the result on the target,
+    // so a snapshot never observes the counter ahead of the target
+    // 
+    KSPIN_LOCK GenerationLock;
+
+    //
+    // Generation of the last target removal
+    // 
+    LONG64 RemovalGeneration;
+
+    //
+    // Completes pended requests once their deadline passed
+    // 
+    WDFTIMER DeadlineTimer;
+
+    //
+    // Protects DeadlineWheel
+    // 
+    KSPIN_LOCK DeadlineLock;
+
+    //
+    // Pending request deadlines
+    // 
+    ViGEm::Bus::Core::TimerWheel<BUS_DEADLINE_WHEEL_SLOTS> DeadlineWheel;
+
+    //
+    // Serial number to target lookup used on the report submission path,
+    // BUS_TARGET_INDEX_STRIPES entries in cache-aligned pool
+    // 
+    PBUS_TARGET_INDEX_STRIPE TargetIndex;
+
+    //
+    // Interrupt OUT transfers awaiting pick-up by any target
+    // 
+    ViGEm::Bus::Core::BlockPool<BUS_OUTPUT_BLOCK_SIZE> OutputPool;
+
 } FDO_DEVICE_DATA, * PFDO_DEVICE_DATA;
 
 #define FDO_FIRST_SESSION_ID 100
 
+
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FDO_DEVICE_DATA, FdoGetData)
 
 // 
@@ -91,6 +206,49 @@ typedef struct _FDO_FILE_DATA
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FDO_FILE_DATA, FileObjectGetData)
 
+typedef enum _BUS_REQUEST_DEADLINE_STATE
+{
+    BusRequestDeadlineIdle = 0,
+    BusRequestDeadlineArmed,
+    BusRequestDeadlineDone
+
+} BUS_REQUEST_DEADLINE_STATE;
+
+//
+// Context data of requests pended with a timeout, preallocated on every
+// request sent to the bus device
+// 
+typedef struct _BUS_REQUEST_DEADLINE
+{
+    //
+    // Link in the bus deadline wheel
+    // 
+    ViGEm::Bus::Core::TimerWheelEntry Entry;
+
+    //
+    // Bus device owning the deadline wheel
+    // 
+    WDFDEVICE Device;
+
+    //
+    // Queue the request is pended on
+    // 
+    WDFQUEUE Queue;
+
+    //
+    // The request this context belongs to
+    // 
+    WDFREQUEST Request;
+
+    //
+    // Guarded by DeadlineLock
+    // 
+    BUS_REQUEST_DEADLINE_STATE State;
+
+} BUS_REQUEST_DEADLINE, * PBUS_REQUEST_DEADLINE;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(BUS_REQUEST_DEADLINE, RequestGetDeadline)
+
 
 EXTERN_C_START
 
@@ -108,6 +266,12 @@ EVT_WDF_CHILD_LIST_CREATE_DEVICE Bus_EvtDeviceListCreatePdo;
 
 EVT_WDF_OBJECT_CONTEXT_CLEANUP Bus_EvtDriverContextCleanup;
 
+EVT_WDF_OBJECT_CONTEXT_CLEANUP Bus_EvtDeviceContextCleanup;
+
+EVT_WDF_TIMER Bus_EvtDeadlineTimer;
+
+EVT_WDF_OBJECT_CONTEXT_CLEANUP Bus_EvtRequestDeadlineCleanup;
+
 #pragma endregion
 
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -144,6 +308,115 @@ Bus_UnPlugDevice(
     _Out_ size_t* Transferred
 );
 
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_PlugInTarget(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG SerialNo,
+    _In_ LONG SessionId,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ USHORT VendorId,
+    _In_ USHORT ProductId,
+    _In_ BOOLEAN OwnerIsDriver
+);
+
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_UnPlugTarget(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG SerialNo,
+    _In_ LONG SessionId,
+    _In_ BOOLEAN IsInternal
+);
+
+NTSTATUS
+Bus_GetTargetSnapshot(
+    _In_ WDFDEVICE Device,
+    _In_ WDFREQUEST Request,
+    _In_ BOOLEAN IsInternal,
+    _Out_ size_t* Transferred
+);
+
+#pragma endregion
+
+#pragma region Request deadline functions
+
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_DeadlineInitialize(
+    _In_ WDFDEVICE Device
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+Bus_ForwardToIoQueueWithDeadline(
+    _In_ WDFDEVICE Device,
+    _In_ WDFREQUEST Request,
+    _In_ WDFQUEUE Queue,
+    _In_ ULONG TimeoutMs
+);
+
+#pragma endregion
+
+#pragma region Target index functions
+
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_TargetIndexInitialize(
+    _In_ WDFDEVICE Device
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+Bus_TargetIndexInsert(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG SerialNo,
+    _In_ ViGEm::Bus::Core::EmulationTargetPDO* Target
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+Bus_TargetIndexRemove(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG SerialNo,
+    _In_ ViGEm::Bus::Core::EmulationTargetPDO* Target,
+    _In_ BOOLEAN Indexed
+);
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+Bus_TargetIndexLookup(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG SerialNo,
+    _Out_ ViGEm::Bus::Core::EmulationTargetPDO** Target
+);
+
+#pragma endregion
+
+#pragma region Output buffer pool functions
+
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_OutputPoolInitialize(
+    _In_ WDFDEVICE Device
+);
+
+#pragma endregion
+
+#pragma region Direct-call interface functions
+
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+Bus_DirectInterfaceCreate(
+    _In_ WDFDEVICE Device
+);
+
+_IRQL_requires_(PASSIVE_LEVEL)
+VOID
+Bus_DirectInterfaceRundown(
+    _In_ WDFDEVICE Device
+);
+
 #pragma endregion
 
 EXTERN_C_END
@@ -34,6 +34,7 @@
 
 
 #include <ntifs.h>
+#include "Driver.h"
 #include "Ds4Pdo.hpp"
 #include "trace.h"
 #include "Ds4Pdo.tmh"
@@ -43,12 +44,26 @@
 
 PCWSTR ViGEm::Bus::Targets::EmulationTargetDS4::_deviceDescription = L"Virtual DualShock 4 Controller";
 
+static_assert(static_cast<int>(ViGEm::Bus::Core::AxisInterpolation::Mode::Linear) == VigemInterpolationLinear,
+	"Interpolation mode mismatch");
+static_assert(static_cast<int>(ViGEm::Bus::Core::AxisInterpolation::Mode::Extrapolate) == VigemInterpolationExtrapolate,
+	"Interpolation mode mismatch");
+
 ViGEm::Bus::Targets::EmulationTargetDS4::EmulationTargetDS4(ULONG Serial, LONG SessionId, USHORT VendorId,
-	USHORT ProductId) : EmulationTargetPDO(
+	USHORT ProductId) : EmulationTarget(
 		Serial, SessionId, VendorId, ProductId)
 {
-	this->_TargetType = DualShock4Wired;
-	this->_UsbConfigurationDescriptionSize = DS4_DESCRIPTOR_SIZE;
+	//
+	// Submission and output path state live on separate cache lines
+	// 
+	static_assert(FIELD_OFFSET(EmulationTargetDS4, _Report) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"per-report state must start on its own cache line");
+	static_assert(FIELD_OFFSET(EmulationTargetDS4, _PublishedReport) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"published report must start on its own cache line");
+	static_assert(FIELD_OFFSET(EmulationTargetDS4, _OutputReport) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"output path state must start on its own cache line");
+
+	static_assert(Traits::Configuration.Size == DS4_DESCRIPTOR_SIZE, "Unexpected configuration descriptor size");
 
 	//
 	// Set PNP Capabilities
@@ -150,25 +165,20 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoPrepareDevice(PWDFDEVICE_IN
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoPrepareHardware()
 {
-	// Set default HID input report (everything zero`d)
-	UCHAR DefaultHidReport[DS4_REPORT_SIZE] =
-	{
-		0x01, 0x82, 0x7F, 0x7E, 0x80, 0x08, 0x00, 0x58,
-		0x00, 0x00, 0xFD, 0x63, 0x06, 0x03, 0x00, 0xFE,
-		0xFF, 0xFC, 0xFF, 0x79, 0xFD, 0x1B, 0x14, 0xD1,
-		0xE9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1B, 0x00,
-		0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x80,
-		0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00,
-		0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00,
-		0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00
-	};
+	//
+	// Default HID input report (sticks centered, nothing pressed)
+	// 
+	static constexpr auto neutralReport = Core::Ds4ReportSchema::NeutralReport();
+
+	static_assert(neutralReport.Size == DS4_REPORT_SIZE, "Unexpected input report size");
 
 	// Initialize HID reports to defaults
-	RtlCopyBytes(this->_Report, DefaultHidReport, DS4_REPORT_SIZE);
+	RtlCopyBytes(this->_Report, neutralReport.Bytes, DS4_REPORT_SIZE);
 	RtlZeroMemory(&this->_OutputReport, sizeof(DS4_OUTPUT_REPORT));
+	this->PublishReport();
 
 	// Start pending IRP queue flush timer
-	WdfTimerStart(this->_PendingUsbInRequestsTimer, DS4_QUEUE_FLUSH_PERIOD);
+	WdfTimerStart(this->_PendingUsbInRequestsTimer, Traits::FlushPeriod);
 
 	return STATUS_SUCCESS;
 }
@@ -182,7 +192,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoInitContext()
 	WDF_TIMER_CONFIG_INIT_PERIODIC(
 		&timerConfig,
 		PendingUsbRequestsTimerFunc,
-		DS4_QUEUE_FLUSH_PERIOD
+		Traits::FlushPeriod
 	);
 
 	// Timer object attributes
@@ -348,79 +358,6 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoInitContext()
 	return status;
 }
 
-VOID ViGEm::Bus::Targets::EmulationTargetDS4::GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length)
-{
-	UCHAR Ds4DescriptorData[DS4_DESCRIPTOR_SIZE] =
-	{
-		0x09,        // bLength
-		0x02,        // bDescriptorType (Configuration)
-		0x29, 0x00,  // wTotalLength 41
-		0x01,        // bNumInterfaces 1
-		0x01,        // bConfigurationValue
-		0x00,        // iConfiguration (String Index)
-		0xC0,        // bmAttributes Self Powered
-		0xFA,        // bMaxPower 500mA
-
-		0x09,        // bLength
-		0x04,        // bDescriptorType (Interface)
-		0x00,        // bInterfaceNumber 0
-		0x00,        // bAlternateSetting
-		0x02,        // bNumEndpoints 2
-		0x03,        // bInterfaceClass
-		0x00,        // bInterfaceSubClass
-		0x00,        // bInterfaceProtocol
-		0x00,        // iInterface (String Index)
-
-		0x09,        // bLength
-		0x21,        // bDescriptorType (HID)
-		0x11, 0x01,  // bcdHID 1.11
-		0x00,        // bCountryCode
-		0x01,        // bNumDescriptors
-		0x22,        // bDescriptorType[0] (HID)
-		0xD3, 0x01,  // wDescriptorLength[0] 467
-
-		0x07,        // bLength
-		0x05,        // bDescriptorType (Endpoint)
-		0x84,        // bEndpointAddress (IN/D2H)
-		0x03,        // bmAttributes (Interrupt)
-		0x40, 0x00,  // wMaxPacketSize 64
-		0x05,        // bInterval 5 (unit depends on device speed)
-
-		0x07,        // bLength
-		0x05,        // bDescriptorType (Endpoint)
-		0x03,        // bEndpointAddress (OUT/H2D)
-		0x03,        // bmAttributes (Interrupt)
-		0x40, 0x00,  // wMaxPacketSize 64
-		0x05,        // bInterval 5 (unit depends on device speed)
-
-					 // 41 bytes
-
-					 // best guess: USB Standard Descriptor
-	};
-
-	RtlCopyBytes(Buffer, Ds4DescriptorData, Length);
-}
-
-NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetDeviceDescriptorType(PUSB_DEVICE_DESCRIPTOR pDescriptor)
-{
-	pDescriptor->bLength = 0x12;
-	pDescriptor->bDescriptorType = USB_DEVICE_DESCRIPTOR_TYPE;
-	pDescriptor->bcdUSB = 0x0200; // USB v2.0
-	pDescriptor->bDeviceClass = 0x00; // per Interface
-	pDescriptor->bDeviceSubClass = 0x00;
-	pDescriptor->bDeviceProtocol = 0x00;
-	pDescriptor->bMaxPacketSize0 = 0x40;
-	pDescriptor->idVendor = this->_VendorId;
-	pDescriptor->idProduct = this->_ProductId;
-	pDescriptor->bcdDevice = 0x0100;
-	pDescriptor->iManufacturer = 0x01;
-	pDescriptor->iProduct = 0x02;
-	pDescriptor->iSerialNumber = 0x00;
-	pDescriptor->bNumConfigurations = 0x01;
-
-	return STATUS_SUCCESS;
-}
-
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SelectConfiguration(PURB Urb)
 {
 	if (Urb->UrbHeader.Length < DS4_CONFIGURATION_SIZE)
@@ -447,21 +384,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SelectConfiguration(PURB Urb)
 
 	pInfo->InterfaceHandle = reinterpret_cast<USBD_INTERFACE_HANDLE>(0xFFFF0000);
 
-	pInfo->Pipes[0].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[0].MaximumPacketSize = 0x40;
-	pInfo->Pipes[0].EndpointAddress = 0x84;
-	pInfo->Pipes[0].Interval = 0x05;
-	pInfo->Pipes[0].PipeType = static_cast<USBD_PIPE_TYPE>(0x03);
-	pInfo->Pipes[0].PipeHandle = reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0084);
-	pInfo->Pipes[0].PipeFlags = 0x00;
-
-	pInfo->Pipes[1].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[1].MaximumPacketSize = 0x40;
-	pInfo->Pipes[1].EndpointAddress = 0x03;
-	pInfo->Pipes[1].Interval = 0x05;
-	pInfo->Pipes[1].PipeType = static_cast<USBD_PIPE_TYPE>(0x03);
-	pInfo->Pipes[1].PipeHandle = reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0003);
-	pInfo->Pipes[1].PipeFlags = 0x00;
+	SetInterfacePipes(pInfo, 0);
 
 	return STATUS_SUCCESS;
 }
@@ -644,239 +567,6 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbClassInterface(PURB Urb)
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetDescriptorFromInterface(PURB Urb)
 {
 	NTSTATUS status = STATUS_INVALID_PARAMETER;
-	UCHAR Ds4HidReportDescriptor[] =
-	{
-		0x05, 0x01,        // Usage Page (Generic Desktop Ctrls)
-		0x09, 0x05,        // Usage (Game Pad)
-		0xA1, 0x01,        // Collection (Application)
-		0x85, 0x01,        //   Report ID (1)
-		0x09, 0x30,        //   Usage (X)
-		0x09, 0x31,        //   Usage (Y)
-		0x09, 0x32,        //   Usage (Z)
-		0x09, 0x35,        //   Usage (Rz)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x26, 0xFF, 0x00,  //   Logical Maximum (255)
-		0x75, 0x08,        //   Report Size (8)
-		0x95, 0x04,        //   Report Count (4)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x09, 0x39,        //   Usage (Hat switch)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x25, 0x07,        //   Logical Maximum (7)
-		0x35, 0x00,        //   Physical Minimum (0)
-		0x46, 0x3B, 0x01,  //   Physical Maximum (315)
-		0x65, 0x14,        //   Unit (System: English Rotation, Length: Centimeter)
-		0x75, 0x04,        //   Report Size (4)
-		0x95, 0x01,        //   Report Count (1)
-		0x81, 0x42,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,Null State)
-		0x65, 0x00,        //   Unit (None)
-		0x05, 0x09,        //   Usage Page (Button)
-		0x19, 0x01,        //   Usage Minimum (0x01)
-		0x29, 0x0E,        //   Usage Maximum (0x0E)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x25, 0x01,        //   Logical Maximum (1)
-		0x75, 0x01,        //   Report Size (1)
-		0x95, 0x0E,        //   Report Count (14)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x06, 0x00, 0xFF,  //   Usage Page (Vendor Defined 0xFF00)
-		0x09, 0x20,        //   Usage (0x20)
-		0x75, 0x06,        //   Report Size (6)
-		0x95, 0x01,        //   Report Count (1)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x25, 0x7F,        //   Logical Maximum (127)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x05, 0x01,        //   Usage Page (Generic Desktop Ctrls)
-		0x09, 0x33,        //   Usage (Rx)
-		0x09, 0x34,        //   Usage (Ry)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x26, 0xFF, 0x00,  //   Logical Maximum (255)
-		0x75, 0x08,        //   Report Size (8)
-		0x95, 0x02,        //   Report Count (2)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x06, 0x00, 0xFF,  //   Usage Page (Vendor Defined 0xFF00)
-		0x09, 0x21,        //   Usage (0x21)
-		0x95, 0x36,        //   Report Count (54)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x85, 0x05,        //   Report ID (5)
-		0x09, 0x22,        //   Usage (0x22)
-		0x95, 0x1F,        //   Report Count (31)
-		0x91, 0x02,        //   Output (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x04,        //   Report ID (4)
-		0x09, 0x23,        //   Usage (0x23)
-		0x95, 0x24,        //   Report Count (36)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x02,        //   Report ID (2)
-		0x09, 0x24,        //   Usage (0x24)
-		0x95, 0x24,        //   Report Count (36)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x08,        //   Report ID (8)
-		0x09, 0x25,        //   Usage (0x25)
-		0x95, 0x03,        //   Report Count (3)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x10,        //   Report ID (16)
-		0x09, 0x26,        //   Usage (0x26)
-		0x95, 0x04,        //   Report Count (4)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x11,        //   Report ID (17)
-		0x09, 0x27,        //   Usage (0x27)
-		0x95, 0x02,        //   Report Count (2)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x12,        //   Report ID (18)
-		0x06, 0x02, 0xFF,  //   Usage Page (Vendor Defined 0xFF02)
-		0x09, 0x21,        //   Usage (0x21)
-		0x95, 0x0F,        //   Report Count (15)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x13,        //   Report ID (19)
-		0x09, 0x22,        //   Usage (0x22)
-		0x95, 0x16,        //   Report Count (22)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x14,        //   Report ID (20)
-		0x06, 0x05, 0xFF,  //   Usage Page (Vendor Defined 0xFF05)
-		0x09, 0x20,        //   Usage (0x20)
-		0x95, 0x10,        //   Report Count (16)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x15,        //   Report ID (21)
-		0x09, 0x21,        //   Usage (0x21)
-		0x95, 0x2C,        //   Report Count (44)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x06, 0x80, 0xFF,  //   Usage Page (Vendor Defined 0xFF80)
-		0x85, 0x80,        //   Report ID (128)
-		0x09, 0x20,        //   Usage (0x20)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x81,        //   Report ID (129)
-		0x09, 0x21,        //   Usage (0x21)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x82,        //   Report ID (130)
-		0x09, 0x22,        //   Usage (0x22)
-		0x95, 0x05,        //   Report Count (5)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x83,        //   Report ID (131)
-		0x09, 0x23,        //   Usage (0x23)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x84,        //   Report ID (132)
-		0x09, 0x24,        //   Usage (0x24)
-		0x95, 0x04,        //   Report Count (4)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x85,        //   Report ID (133)
-		0x09, 0x25,        //   Usage (0x25)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x86,        //   Report ID (134)
-		0x09, 0x26,        //   Usage (0x26)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x87,        //   Report ID (135)
-		0x09, 0x27,        //   Usage (0x27)
-		0x95, 0x23,        //   Report Count (35)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x88,        //   Report ID (136)
-		0x09, 0x28,        //   Usage (0x28)
-		0x95, 0x22,        //   Report Count (34)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x89,        //   Report ID (137)
-		0x09, 0x29,        //   Usage (0x29)
-		0x95, 0x02,        //   Report Count (2)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x90,        //   Report ID (144)
-		0x09, 0x30,        //   Usage (0x30)
-		0x95, 0x05,        //   Report Count (5)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x91,        //   Report ID (145)
-		0x09, 0x31,        //   Usage (0x31)
-		0x95, 0x03,        //   Report Count (3)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x92,        //   Report ID (146)
-		0x09, 0x32,        //   Usage (0x32)
-		0x95, 0x03,        //   Report Count (3)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x93,        //   Report ID (147)
-		0x09, 0x33,        //   Usage (0x33)
-		0x95, 0x0C,        //   Report Count (12)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA0,        //   Report ID (160)
-		0x09, 0x40,        //   Usage (0x40)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA1,        //   Report ID (161)
-		0x09, 0x41,        //   Usage (0x41)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA2,        //   Report ID (162)
-		0x09, 0x42,        //   Usage (0x42)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA3,        //   Report ID (163)
-		0x09, 0x43,        //   Usage (0x43)
-		0x95, 0x30,        //   Report Count (48)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA4,        //   Report ID (164)
-		0x09, 0x44,        //   Usage (0x44)
-		0x95, 0x0D,        //   Report Count (13)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA5,        //   Report ID (165)
-		0x09, 0x45,        //   Usage (0x45)
-		0x95, 0x15,        //   Report Count (21)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA6,        //   Report ID (166)
-		0x09, 0x46,        //   Usage (0x46)
-		0x95, 0x15,        //   Report Count (21)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xF0,        //   Report ID (240)
-		0x09, 0x47,        //   Usage (0x47)
-		0x95, 0x3F,        //   Report Count (63)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xF1,        //   Report ID (241)
-		0x09, 0x48,        //   Usage (0x48)
-		0x95, 0x3F,        //   Report Count (63)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xF2,        //   Report ID (242)
-		0x09, 0x49,        //   Usage (0x49)
-		0x95, 0x0F,        //   Report Count (15)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA7,        //   Report ID (167)
-		0x09, 0x4A,        //   Usage (0x4A)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA8,        //   Report ID (168)
-		0x09, 0x4B,        //   Usage (0x4B)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA9,        //   Report ID (169)
-		0x09, 0x4C,        //   Usage (0x4C)
-		0x95, 0x08,        //   Report Count (8)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAA,        //   Report ID (170)
-		0x09, 0x4E,        //   Usage (0x4E)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAB,        //   Report ID (171)
-		0x09, 0x4F,        //   Usage (0x4F)
-		0x95, 0x39,        //   Report Count (57)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAC,        //   Report ID (172)
-		0x09, 0x50,        //   Usage (0x50)
-		0x95, 0x39,        //   Report Count (57)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAD,        //   Report ID (173)
-		0x09, 0x51,        //   Usage (0x51)
-		0x95, 0x0B,        //   Report Count (11)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAE,        //   Report ID (174)
-		0x09, 0x52,        //   Usage (0x52)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAF,        //   Report ID (175)
-		0x09, 0x53,        //   Usage (0x53)
-		0x95, 0x02,        //   Report Count (2)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xB0,        //   Report ID (176)
-		0x09, 0x54,        //   Usage (0x54)
-		0x95, 0x3F,        //   Report Count (63)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0xC0,              // End Collection
-	};
 
 	struct _URB_CONTROL_DESCRIPTOR_REQUEST* pRequest = &Urb->UrbControlDescriptorRequest;
 
@@ -885,15 +575,15 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetDescriptorFromInterface(
 		">> >> >> _URB_CONTROL_DESCRIPTOR_REQUEST: Buffer Length %d",
 		pRequest->TransferBufferLength);
 
-	if (pRequest->TransferBufferLength >= ARRAYSIZE(Ds4HidReportDescriptor))
+	if (pRequest->TransferBufferLength >= Ds4Descriptors::HidReport.Size)
 	{
-		RtlCopyMemory(pRequest->TransferBuffer, Ds4HidReportDescriptor, ARRAYSIZE(Ds4HidReportDescriptor));
+		RtlCopyMemory(pRequest->TransferBuffer, Ds4Descriptors::HidReport.Bytes, Ds4Descriptors::HidReport.Size);
 		status = STATUS_SUCCESS;
 
 		//
 		// Notify client library that PDO is ready
 		// 
-		KeSetEvent(&this->_PdoBootNotificationEvent, 0, FALSE);
+		this->SignalDeviceReady();
 	}
 
 	return status;
@@ -908,6 +598,9 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbSelectInterface(PURB Urb)
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetStringDescriptorType(PURB Urb)
 {
+	static_assert(Ds4Descriptors::Manufacturer.Size == DS4_MANUFACTURER_NAME_LENGTH, "Unexpected manufacturer string size");
+	static_assert(Ds4Descriptors::Product.Size == DS4_PRODUCT_NAME_LENGTH, "Unexpected product string size");
+
 	TraceVerbose(
 		TRACE_USBPDO,
 		"Index = %d",
@@ -917,14 +610,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetStringDescriptorType(PUR
 	{
 	case 0:
 	{
-		// "American English"
-		UCHAR LangId[] =
-		{
-			0x04, 0x03, 0x09, 0x04
-		};
-
-		Urb->UrbControlDescriptorRequest.TransferBufferLength = ARRAYSIZE(LangId);
-		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, LangId, ARRAYSIZE(LangId));
+		Urb->UrbControlDescriptorRequest.TransferBufferLength = Ds4Descriptors::Languages.Size;
+		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, Ds4Descriptors::Languages.Bytes, Ds4Descriptors::Languages.Size);
 
 		break;
 	}
@@ -942,20 +629,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetStringDescriptorType(PUR
 			break;
 		}
 
-		// "Sony Computer Entertainment"
-		UCHAR ManufacturerString[DS4_MANUFACTURER_NAME_LENGTH] =
-		{
-			0x38, 0x03, 0x53, 0x00, 0x6F, 0x00, 0x6E, 0x00,
-			0x79, 0x00, 0x20, 0x00, 0x43, 0x00, 0x6F, 0x00,
-			0x6D, 0x00, 0x70, 0x00, 0x75, 0x00, 0x74, 0x00,
-			0x65, 0x00, 0x72, 0x00, 0x20, 0x00, 0x45, 0x00,
-			0x6E, 0x00, 0x74, 0x00, 0x65, 0x00, 0x72, 0x00,
-			0x74, 0x00, 0x61, 0x00, 0x69, 0x00, 0x6E, 0x00,
-			0x6D, 0x00, 0x65, 0x00, 0x6E, 0x00, 0x74, 0x00
-		};
-
 		Urb->UrbControlDescriptorRequest.TransferBufferLength = DS4_MANUFACTURER_NAME_LENGTH;
-		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, ManufacturerString, DS4_MANUFACTURER_NAME_LENGTH);
+		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, Ds4Descriptors::Manufacturer.Bytes, DS4_MANUFACTURER_NAME_LENGTH);
 
 		break;
 	}
@@ -973,18 +648,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetStringDescriptorType(PUR
 			break;
 		}
 
-		// "Wireless Controller"
-		UCHAR ProductString[DS4_PRODUCT_NAME_LENGTH] =
-		{
-			0x28, 0x03, 0x57, 0x00, 0x69, 0x00, 0x72, 0x00,
-			0x65, 0x00, 0x6C, 0x00, 0x65, 0x00, 0x73, 0x00,
-			0x73, 0x00, 0x20, 0x00, 0x43, 0x00, 0x6F, 0x00,
-			0x6E, 0x00, 0x74, 0x00, 0x72, 0x00, 0x6F, 0x00,
-			0x6C, 0x00, 0x6C, 0x00, 0x65, 0x00, 0x72, 0x00
-		};
-
 		Urb->UrbControlDescriptorRequest.TransferBufferLength = DS4_PRODUCT_NAME_LENGTH;
-		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, ProductString, DS4_PRODUCT_NAME_LENGTH);
+		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, Ds4Descriptors::Product.Bytes, DS4_PRODUCT_NAME_LENGTH);
 
 		break;
 	}
@@ -1000,9 +665,11 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 	NTSTATUS status = STATUS_SUCCESS;
 	WDFREQUEST notifyRequest;
 
+	const auto endpoint = ResolvePipe(pTransfer->PipeHandle);
+
 	// Data coming FROM us TO higher driver
 	if (pTransfer->TransferFlags & USBD_TRANSFER_DIRECTION_IN
-		&& pTransfer->PipeHandle == reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0084))
+		&& endpoint && endpoint->Policy == Core::EndpointPolicy::Report)
 	{
 		TraceVerbose(
 			TRACE_USBPDO,
@@ -1017,9 +684,16 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 	}
 
 	// Store relevant bytes of buffer in PDO context
-	RtlCopyBytes(&this->_OutputReport,
+	if (RtlCompareMemory(&this->_OutputReport,
 		static_cast<PUCHAR>(pTransfer->TransferBuffer) + DS4_OUTPUT_BUFFER_OFFSET,
-		DS4_OUTPUT_BUFFER_LENGTH);
+		DS4_OUTPUT_BUFFER_LENGTH) != DS4_OUTPUT_BUFFER_LENGTH)
+	{
+		RtlCopyBytes(&this->_OutputReport,
+			static_cast<PUCHAR>(pTransfer->TransferBuffer) + DS4_OUTPUT_BUFFER_OFFSET,
+			DS4_OUTPUT_BUFFER_LENGTH);
+
+		this->UpdateGeneration();
+	}
 
 
 	this->_AwaitOutputCache.Size = sizeof(DS4_AWAIT_OUTPUT);
@@ -1037,6 +711,16 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 		sizeof(DS4_AWAIT_OUTPUT)
 	);
 
+	//
+	// Kernel-mode owners get output data delivered via callback
+	// 
+	if (this->_OwnerIsDriver)
+	{
+		this->InvokeOutputCallback(pTransfer->TransferBuffer, pTransfer->TransferBufferLength);
+
+		return status;
+	}
+
 	if (!NT_SUCCESS(status = DMF_NotifyUserWithRequestMultiple_DataBroadcast(
 		this->_OutputReportNotify,
 		&this->_AwaitOutputCache,
@@ -1051,10 +735,49 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 		);
 	}
 
+	//
+	// Serve this target's await-output requests which carry a deadline
+	// 
+	if (const auto awaitQueue = PeekOnDemandQueue(&this->_PendingAwaitOutputRequests))
+	{
+		WDFREQUEST awaitRequest;
+
+		while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(awaitQueue, &awaitRequest)))
+		{
+			PDS4_AWAIT_OUTPUT awaitOutput = nullptr;
+
+			const NTSTATUS awaitStatus = WdfRequestRetrieveOutputBuffer(
+				awaitRequest,
+				sizeof(DS4_AWAIT_OUTPUT),
+				reinterpret_cast<PVOID*>(&awaitOutput),
+				nullptr
+			);
+
+			if (NT_SUCCESS(awaitStatus))
+			{
+				RtlCopyMemory(awaitOutput, &this->_AwaitOutputCache, sizeof(DS4_AWAIT_OUTPUT));
+
+				WdfRequestCompleteWithInformation(awaitRequest, awaitStatus, sizeof(DS4_AWAIT_OUTPUT));
+			}
+			else
+			{
+				TraceError(
+					TRACE_USBPDO,
+					"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+					awaitStatus
+				);
 
-	if (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(
-		this->_PendingNotificationRequests,
-		&notifyRequest)))
+				WdfRequestComplete(awaitRequest, awaitStatus);
+			}
+		}
+	}
+
+	const auto notificationQueue = PeekOnDemandQueue(&this->_PendingNotificationRequests);
+
+	if (notificationQueue && NT_SUCCESS(WdfIoQueueRetrieveNextRequest(
+		notificationQueue,
+		&notifyRequest
+	)))
 	{
 		PDS4_REQUEST_NOTIFICATION notify = nullptr;
 
@@ -1087,28 +810,9 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 				status);
 		}
 	}
-	else
+	else if (this->QueueOutputBuffer(&this->_OutputReport, DS4_OUTPUT_BUFFER_LENGTH))
 	{
-		PVOID clientBuffer, contextBuffer;
-
-		if (NT_SUCCESS(DMF_BufferQueue_Fetch(
-			this->_UsbInterruptOutBufferQueue,
-			&clientBuffer,
-			&contextBuffer
-		)))
-		{
-			RtlCopyMemory(
-				clientBuffer,
-				&this->_OutputReport,
-				DS4_OUTPUT_BUFFER_LENGTH
-			);
-
-			*static_cast<size_t*>(contextBuffer) = DS4_OUTPUT_BUFFER_LENGTH;
-
-			TraceVerbose(TRACE_USBPDO, "Queued %Iu bytes", DS4_OUTPUT_BUFFER_LENGTH);
-
-			DMF_BufferQueue_Enqueue(this->_UsbInterruptOutBufferQueue, clientBuffer);
-		}
+		TraceVerbose(TRACE_USBPDO, "Queued %Iu bytes", DS4_OUTPUT_BUFFER_LENGTH);
 	}
 
 	return status;
@@ -1142,41 +846,18 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbControlTransfer(PURB Urb)
 	return status;
 }
 
-NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewReport)
+BOOLEAN ViGEm::Bus::Targets::EmulationTargetDS4::UpdateReportCache(PVOID NewReport)
 {
-	NTSTATUS				status;
-	WDFREQUEST				usbRequest;
+	ULONG length = 0;
+	PVOID pReport = nullptr;
 
 	/*
 	 * The logic here is unusual to keep backwards compatibility with the
 	 * original API that didn't allow submitting the full report.
 	 */
 
-	status = WdfIoQueueRetrieveNextRequest(this->_PendingUsbInRequests, &usbRequest);
-
-	if (!NT_SUCCESS(status))
-		return status;
-
-	// Get pending IRP
-	PIRP pendingIrp = WdfRequestWdmGetIrp(usbRequest);
-
-	// Get USB request block
-	const auto urb = static_cast<PURB>(URB_FROM_IRP(pendingIrp));
-
-	// Get transfer buffer
-	const auto buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
-
-	// Set correct buffer size
-	urb->UrbBulkOrInterruptTransfer.TransferBufferLength = DS4_REPORT_SIZE;
-
-	// Cast to expected struct
 	const auto pSubmit = static_cast<PDS4_SUBMIT_REPORT>(NewReport);
 
-	/*
-	 * Copy report to cache and transfer buffer
-	 * Skip first byte as it contains the never changing report ID
-	 */
-
 	 //
 	 // "Old" API which only allows to update partial report
 	 // 
@@ -1184,11 +865,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 	{
 		TraceVerbose(TRACE_DS4, "Received DS4_SUBMIT_REPORT update");
 
-		RtlCopyBytes(
-			&this->_Report[1],
-			&(static_cast<PDS4_SUBMIT_REPORT>(NewReport))->Report,
-			sizeof((static_cast<PDS4_SUBMIT_REPORT>(NewReport))->Report)
-		);
+		pReport = &pSubmit->Report;
+		length = sizeof(pSubmit->Report);
 	}
 
 	//
@@ -1198,15 +876,88 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 	{
 		TraceVerbose(TRACE_DS4, "Received DS4_SUBMIT_REPORT_EX update");
 
-		RtlCopyBytes(
-			&this->_Report[1],
-			&(static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report,
-			sizeof((static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report)
+		pReport = &(static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report;
+		length = sizeof((static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report);
+	}
+
+	/*
+	 * Copy report to cache
+	 * Skip first byte as it contains the never changing report ID
+	 */
+	if (pReport == nullptr || RtlCompareMemory(&this->_Report[1], pReport, length) == length)
+		return FALSE;
+
+	RtlCopyBytes(&this->_Report[1], pReport, length);
+
+	if (this->_Interpolator.GetMode() != Core::AxisInterpolation::Mode::None)
+	{
+		UCHAR values[DS4_ANALOG_COUNT];
+
+		for (int i = 0; i < DS4_ANALOG_COUNT; i++)
+			values[i] = this->_Report[DS4_ANALOG_OFFSETS[i]];
+
+		this->_Interpolator.Push(
+			KeQueryInterruptTime(),
+			values,
+			DS4_INTERPOLATION_MIN_INTERVAL,
+			DS4_INTERPOLATION_MAX_INTERVAL
 		);
 	}
 
+	this->EnqueueOrderedReport(this->_Report, DS4_REPORT_SIZE);
+
+	this->PublishReport();
+
+	return TRUE;
+}
+
+NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::FlushReportCache()
+{
+	WDFREQUEST usbRequest;
+	KIRQL irql;
+
+	// Get pending USB request
+	const auto status = WdfIoQueueRetrieveNextRequest(this->_PendingUsbInRequests, &usbRequest);
+
+	// The timer delivers the cached report with the next request
+	if (status == STATUS_NO_MORE_ENTRIES)
+		return STATUS_SUCCESS;
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	// Get pending IRP
+	const auto pendingIrp = WdfRequestWdmGetIrp(usbRequest);
+
+	const auto irpStack = IoGetCurrentIrpStackLocation(pendingIrp);
+
+	// Get USB request block
+	const auto urb = static_cast<PURB>(irpStack->Parameters.Others.Argument1);
+
+	// Get transfer buffer
+	const auto buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
+
+	// Set buffer length to report size
+	urb->UrbBulkOrInterruptTransfer.TransferBufferLength = DS4_REPORT_SIZE;
+
+	// Copy cached report to transfer buffer 
 	if (buffer)
-		RtlCopyBytes(buffer, this->_Report, DS4_REPORT_SIZE);
+	{
+		//
+		// Queued reports, motion samples and interpolation consume state per
+		// delivered report, otherwise the published copy is all we need.
+		// 
+		// Decide and read under _ReportLock: a batch publishes its targets one
+		// after another while holding all their locks, the lock is what keeps
+		// a half-applied batch invisible, and the flags may be changing.
+		// 
+		KeAcquireSpinLock(&this->_ReportLock, &irql);
+		if (this->_ExclusiveRender || this->_OrderedDelivery)
+			this->RenderInputReport(buffer, KeQueryInterruptTime());
+		else
+			this->RenderPublishedReport(buffer, KeQueryInterruptTime());
+		KeReleaseSpinLock(&this->_ReportLock, irql);
+	}
 
 	// Complete pending request
 	WdfRequestComplete(usbRequest, status);
@@ -1214,25 +965,110 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 	return status;
 }
 
-VOID ViGEm::Bus::Targets::EmulationTargetDS4::ReverseByteArray(PUCHAR Array, INT Length)
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::RenderInputReport(PUCHAR Buffer, ULONG64 Now)
 {
-	const auto s = static_cast<PUCHAR>(ExAllocatePoolZero(
-		NonPagedPoolNx,
-		sizeof(UCHAR) * Length,
-		'U4SD'
-	));
-	INT c, d;
+	VIGEM_DS4_IMU_SAMPLE sample;
+
+	static_assert(Core::Ds4ReportSchema::Imu.BitSize / 8 == sizeof(VIGEM_DS4_IMU_SAMPLE), "Unexpected motion block size");
+
+	//
+	// Pending button edges go out one per report before the latest state
+	// 
+	const BOOLEAN ordered = this->DequeueOrderedReport(Buffer, DS4_REPORT_SIZE);
 
-	if (s == nullptr)
-		return;
+	if (!ordered)
+		RtlCopyBytes(Buffer, this->_Report, DS4_REPORT_SIZE);
 
-	for (c = Length - 1, d = 0; c >= 0; c--, d++)
-		*(s + d) = *(Array + c);
+	//
+	// Every delivered report carries the next queued motion sample
+	// 
+	if (this->_ImuSamples.Pop(sample))
+	{
+		RtlCopyMemory(&this->_Report[DS4_IMU_OFFSET], &sample, sizeof(VIGEM_DS4_IMU_SAMPLE));
+		RtlCopyMemory(&Buffer[DS4_IMU_OFFSET], &sample, sizeof(VIGEM_DS4_IMU_SAMPLE));
 
-	for (c = 0; c < Length; c++)
-		*(Array + c) = *(s + c);
+		this->PublishReport();
+		this->UpdateExclusiveRender();
+	}
 
-	ExFreePoolWithTag(s, 'U4SD');
+	//
+	// Keep frame counter and sensor clock running like real hardware does,
+	// only the delivered copy is touched so resubmissions still compare equal
+	// 
+	Core::Ds4ReportClock::Stamp(Buffer, InterlockedIncrement(&this->_FrameCounter), Now);
+
+	// Replace analog values with their in-between state, queued reports are delivered as submitted
+	if (!ordered && this->_Interpolator.GetMode() != Core::AxisInterpolation::Mode::None)
+	{
+		UCHAR values[DS4_ANALOG_COUNT];
+
+		this->_Interpolator.Sample(Now, values);
+
+		for (int i = 0; i < DS4_ANALOG_COUNT; i++)
+			Buffer[DS4_ANALOG_OFFSETS[i]] = values[i];
+	}
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::RenderPublishedReport(PUCHAR Buffer, ULONG64 Now)
+{
+	this->_PublishedReport.Read(*reinterpret_cast<INPUT_REPORT*>(Buffer));
+
+	Core::Ds4ReportClock::Stamp(Buffer, InterlockedIncrement(&this->_FrameCounter), Now);
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::PublishReport()
+{
+	this->_PublishedReport.Write(*reinterpret_cast<const INPUT_REPORT*>(this->_Report));
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::UpdateExclusiveRender()
+{
+	this->_ExclusiveRender = (this->_Interpolator.GetMode() != Core::AxisInterpolation::Mode::None
+		|| !this->_ImuSamples.IsEmpty()) ? 1 : 0;
+}
+
+ULONG64 ViGEm::Bus::Targets::EmulationTargetDS4::GetReportButtons(const UCHAR* Report) const
+{
+	//
+	// D-Pad and face buttons, shoulders and sticks, PS and touchpad click;
+	// the upper bits of the last byte hold the frame counter
+	// 
+	return Core::Ds4ReportSchema::Get(Report, Core::Ds4ReportSchema::ButtonState);
+}
+
+ULONG64 ViGEm::Bus::Targets::EmulationTargetDS4::GetCachedReportButtons() const
+{
+	return this->GetReportButtons(this->_Report);
+}
+
+ULONG ViGEm::Bus::Targets::EmulationTargetDS4::QueueImuSamples(const VIGEM_DS4_IMU_SAMPLE* Samples, ULONG Count)
+{
+	KIRQL irql;
+	ULONG accepted = 0;
+
+	KeAcquireSpinLock(&this->_ReportLock, &irql);
+
+	while (accepted < Count && this->_ImuSamples.Push(Samples[accepted]))
+		accepted++;
+
+	this->UpdateExclusiveRender();
+
+	KeReleaseSpinLock(&this->_ReportLock, irql);
+
+	return accepted;
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::ReverseByteArray(PUCHAR Array, INT Length)
+{
+	//
+	// Swap in place, this runs on the control transfer path
+	// 
+	for (INT c = 0, d = Length - 1; c < d; c++, d--)
+	{
+		const UCHAR s = Array[c];
+		Array[c] = Array[d];
+		Array[d] = s;
+	}
 }
 
 VOID ViGEm::Bus::Targets::EmulationTargetDS4::GenerateRandomMacAddress(PMAC_ADDRESS Address)
@@ -1249,11 +1085,19 @@ VOID ViGEm::Bus::Targets::EmulationTargetDS4::GenerateRandomMacAddress(PMAC_ADDR
 	Address->Nic2 = RtlRandomEx(&seed) % 0xFF;
 }
 
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::GetSnapshotImpl(PVIGEM_TARGET_SNAPSHOT_ENTRY Entry)
+{
+	Entry->LargeMotor = this->_OutputReport.LargeMotor;
+	Entry->SmallMotor = this->_OutputReport.SmallMotor;
+	Entry->LightbarColor = this->_OutputReport.LightbarColor;
+}
+
 void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEUE Queue)
 {
 	NTSTATUS status;
 	WDFREQUEST request;
-	PVOID clientBuffer, contextBuffer;
+	DS4_OUTPUT_REPORT report = {};
+	ULONG reportLength;
 	PDS4_REQUEST_NOTIFICATION notify = nullptr;
 
 	FuncEntry(TRACE_DS4);
@@ -1263,25 +1107,19 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 	// 
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
-		status = DMF_BufferQueue_Dequeue(
-			this->_UsbInterruptOutBufferQueue,
-			&clientBuffer,
-			&contextBuffer
-		);
-
 		//
 		// Shouldn't happen, but if so, error out
 		// 
-		if (!NT_SUCCESS(status))
+		if (!this->DequeueOutputBuffer(&report, sizeof(report), &reportLength))
 		{
 			//
 			// Don't requeue request as we maya be out of order now
 			// 
-			WdfRequestComplete(request, status);
+			WdfRequestComplete(request, STATUS_NO_MORE_ENTRIES);
 			continue;
 		}
 
-		if (NT_SUCCESS(WdfRequestRetrieveOutputBuffer(
+		if (NT_SUCCESS(status = WdfRequestRetrieveOutputBuffer(
 			request,
 			sizeof(DS4_REQUEST_NOTIFICATION),
 			reinterpret_cast<PVOID*>(&notify),
@@ -1293,7 +1131,7 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 			// 
 			notify->Size = sizeof(DS4_REQUEST_NOTIFICATION);
 			notify->SerialNo = this->_SerialNo;
-			notify->Report = *static_cast<PDS4_OUTPUT_REPORT>(clientBuffer);
+			notify->Report = report;
 
 			DumpAsHex("!! XUSB_REQUEST_NOTIFICATION",
 				notify,
@@ -1303,12 +1141,10 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 			WdfRequestCompleteWithInformation(request, status, notify->Size);
 		}
 
-		DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
-
 		//
 		// If no more buffer to process, exit loop and await next callback
 		// 
-		if (DMF_BufferQueue_Count(this->_UsbInterruptOutBufferQueue) == 0)
+		if (!this->HasOutputBuffers())
 		{
 			break;
 		}
@@ -1324,36 +1160,9 @@ VOID ViGEm::Bus::Targets::EmulationTargetDS4::PendingUsbRequestsTimerFunc(
 	const auto ctx = reinterpret_cast<EmulationTargetDS4*>(Core::EmulationTargetPdoGetContext(
 		WdfTimerGetParentObject(Timer))->Target);
 
-	WDFREQUEST usbRequest;
-
 	FuncEntry(TRACE_DS4);
 
-	// Get pending USB request
-	const auto status = WdfIoQueueRetrieveNextRequest(ctx->_PendingUsbInRequests, &usbRequest);
-
-	if (NT_SUCCESS(status))
-	{
-		// Get pending IRP
-		const auto pendingIrp = WdfRequestWdmGetIrp(usbRequest);
-
-		const auto irpStack = IoGetCurrentIrpStackLocation(pendingIrp);
-
-		// Get USB request block
-		const auto urb = static_cast<PURB>(irpStack->Parameters.Others.Argument1);
-
-		// Get transfer buffer
-		const auto buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
-
-		// Set buffer length to report size
-		urb->UrbBulkOrInterruptTransfer.TransferBufferLength = DS4_REPORT_SIZE;
-
-		// Copy cached report to transfer buffer 
-		if (buffer)
-			RtlCopyBytes(buffer, ctx->_Report, DS4_REPORT_SIZE);
-
-		// Complete pending request
-		WdfRequestComplete(usbRequest, status);
-	}
+	const auto status = ctx->FlushReportCache();
 
 	TraceVerbose(TRACE_DS4, "%!FUNC! Exit with status %!STATUS!", status);
 }
@@ -1367,3 +1176,24 @@ VOID ViGEm::Bus::Targets::EmulationTargetDS4::SetOutputReportNotifyModule(DMFMOD
 {
 	this->_OutputReportNotify = Module;
 }
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::SetInterpolationMode(Core::AxisInterpolation::Mode Mode)
+{
+	KIRQL irql;
+	UCHAR values[DS4_ANALOG_COUNT];
+
+	KeAcquireSpinLock(&this->_ReportLock, &irql);
+
+	//
+	// Start from what the host currently sees
+	// 
+	for (int i = 0; i < DS4_ANALOG_COUNT; i++)
+		values[i] = this->_Report[DS4_ANALOG_OFFSETS[i]];
+
+	this->_Interpolator.Reset(KeQueryInterruptTime(), values);
+	this->_Interpolator.SetMode(Mode);
+
+	this->UpdateExclusiveRender();
+
+	KeReleaseSpinLock(&this->_ReportLock, irql);
+}
@@ -35,12 +35,20 @@
 
 #pragma once
 
-#include "EmulationTargetPDO.hpp"
+#include "EmulationTarget.hpp"
+#include "TargetDescriptors.hpp"
+#include "AxisInterpolation.hpp"
+#include "SampleRing.hpp"
+#include "Ds4ReportClock.hpp"
+#include "ReportChannel.hpp"
 #include <ViGEm/km/BusShared.h>
+#include <ViGEm/km/Ds4ReportSchema.hpp>
 
 
 namespace ViGEm::Bus::Targets
 {
+	constexpr auto DS4_POOL_TAG = 'D4iV';
+
 	//
 	// Represents a MAC address.
 	//
@@ -64,8 +72,43 @@ namespace ViGEm::Bus::Targets
 		return (pReq->Value >> 8) & 0xFF;
 	}
 
-	class EmulationTargetDS4 : public Core::EmulationTargetPDO
+	//
+	// Compile-time parameters of the DualShock 4 wired controller
+	// 
+	struct Ds4Traits
 	{
+		static constexpr VIGEM_TARGET_TYPE Type = DualShock4Wired;
+
+		static constexpr const auto& Device = Ds4Descriptors::Device;
+
+		static constexpr const auto& Configuration = Ds4Descriptors::Configuration;
+
+		static constexpr ULONG PoolTag = DS4_POOL_TAG;
+
+		static constexpr ULONG QueueCount = 0;
+
+		//
+		// Timer completing pending interrupt IN requests
+		// 
+		static constexpr ULONG TimerCount = 1;
+
+		static constexpr Core::EndpointTable<2> Endpoints{{
+			{ 0x00, 0x84, 0x40, 0x05, Core::EndpointPolicy::Report },
+			{ 0x00, 0x03, 0x40, 0x05, Core::EndpointPolicy::Consume },
+		}};
+
+		//
+		// Period (ms) of the timer completing pending interrupt IN requests
+		// 
+		static constexpr LONG FlushPeriod = 0x05;
+	};
+
+#pragma warning(push)
+#pragma warning(disable:4324) // structure was padded due to alignment specifier
+	class EmulationTargetDS4 final : public Core::EmulationTarget<EmulationTargetDS4, Ds4Traits>
+	{
+		friend class Core::EmulationTarget<EmulationTargetDS4, Ds4Traits>;
+
 	public:
 		EmulationTargetDS4(ULONG Serial, LONG SessionId, USHORT VendorId = 0x054C, USHORT ProductId = 0x05C4);
 
@@ -77,10 +120,6 @@ namespace ViGEm::Bus::Targets
 
 		NTSTATUS PdoInitContext() override;
 
-		VOID GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length) override;
-
-		NTSTATUS UsbGetDeviceDescriptorType(PUSB_DEVICE_DESCRIPTOR pDescriptor) override;
-
 		NTSTATUS SelectConfiguration(PURB Urb) override;
 
 		void AbortPipe() override;
@@ -97,10 +136,12 @@ namespace ViGEm::Bus::Targets
 
 		NTSTATUS UsbControlTransfer(PURB Urb) override;
 
-		NTSTATUS SubmitReportImpl(PVOID NewReport) override;
-
 		VOID SetOutputReportNotifyModule(DMFMODULE Module);
 
+		VOID SetInterpolationMode(Core::AxisInterpolation::Mode Mode);
+
+		ULONG QueueImuSamples(_In_reads_(Count) const VIGEM_DS4_IMU_SAMPLE* Samples, ULONG Count);
+
 	private:
 		static EVT_WDF_TIMER PendingUsbRequestsTimerFunc;
 
@@ -108,9 +149,27 @@ namespace ViGEm::Bus::Targets
 
 		static VOID GenerateRandomMacAddress(PMAC_ADDRESS Address);
 
+		VOID RenderInputReport(PUCHAR Buffer, ULONG64 Now);
+
+		VOID RenderPublishedReport(PUCHAR Buffer, ULONG64 Now);
+
+		VOID PublishReport();
+
+		VOID UpdateExclusiveRender();
+
 	protected:
 		void ProcessPendingNotification(WDFQUEUE Queue) override;
 
+		VOID GetSnapshotImpl(PVIGEM_TARGET_SNAPSHOT_ENTRY Entry) override;
+
+		BOOLEAN UpdateReportCache(PVOID NewReport) override;
+
+		NTSTATUS FlushReportCache() override;
+
+		ULONG64 GetReportButtons(const UCHAR* Report) const override;
+
+		ULONG64 GetCachedReportButtons() const override;
+
 		void DmfDeviceModulesAdd(_In_ PDMFMODULE_INIT DmfModuleInit) override;
 	private:
 		static PCWSTR _deviceDescription;
@@ -137,18 +196,98 @@ namespace ViGEm::Bus::Targets
 		static const int DS4_OUTPUT_BUFFER_OFFSET = 0x04;
 		static const int DS4_OUTPUT_BUFFER_LENGTH = 0x05;
 
-		static const int DS4_REPORT_SIZE = 0x40;
-		static const int DS4_QUEUE_FLUSH_PERIOD = 0x05;
+		static const int DS4_REPORT_SIZE = Core::Ds4ReportSchema::ReportSize;
+
+		//
+		// Input report offsets of sticks and analog triggers
+		// 
+		static constexpr UCHAR DS4_ANALOG_OFFSETS[] = {
+			Core::Ds4ReportSchema::LeftThumbX.ByteOffset(),
+			Core::Ds4ReportSchema::LeftThumbY.ByteOffset(),
+			Core::Ds4ReportSchema::RightThumbX.ByteOffset(),
+			Core::Ds4ReportSchema::RightThumbY.ByteOffset(),
+			Core::Ds4ReportSchema::LeftTrigger.ByteOffset(),
+			Core::Ds4ReportSchema::RightTrigger.ByteOffset()
+		};
+		static const int DS4_ANALOG_COUNT = RTL_NUMBER_OF_V1(DS4_ANALOG_OFFSETS);
+
+		//
+		// Bounds of the assumed feeder interval (100ns units)
+		// 
+		static const ULONG64 DS4_INTERPOLATION_MIN_INTERVAL = 10 * 1000;
+		static const ULONG64 DS4_INTERPOLATION_MAX_INTERVAL = 100 * 10 * 1000;
+
+		//
+		// Input report offset of the gyro/accelerometer block
+		// 
+		static const int DS4_IMU_OFFSET = Core::Ds4ReportSchema::Imu.ByteOffset();
+
+		static const int DS4_IMU_QUEUE_SIZE = 128;
+
+#pragma region Submission path, written per report
 
 		//
-		// HID Input Report buffer
+		// HID Input Report buffer, protected by _ReportLock
 		//
-		UCHAR _Report[DS4_REPORT_SIZE];
+		DECLSPEC_CACHEALIGN UCHAR _Report[DS4_REPORT_SIZE];
+
+		//
+		// Smooths analog values between submitted reports, protected by _ReportLock
+		// 
+		Core::AxisInterpolation::Interpolator<DS4_ANALOG_COUNT> _Interpolator{};
+
+		//
+		// Motion samples waiting for delivery, protected by _ReportLock
+		// 
+		Core::SampleRing<VIGEM_DS4_IMU_SAMPLE, DS4_IMU_QUEUE_SIZE> _ImuSamples{};
+
+		//
+		// Set while motion samples or interpolation require rendering under _ReportLock
+		// 
+		volatile LONG _ExclusiveRender{};
+
+		//
+		// Count of delivered input reports, the lower 6 bits go into the report
+		// 
+		volatile LONG _FrameCounter{};
+
+#pragma endregion
+
+#pragma region Published report
+
+		typedef struct _INPUT_REPORT
+		{
+			UCHAR Data[DS4_REPORT_SIZE];
+		} INPUT_REPORT;
+
+		//
+		// Copy of _Report, always consistent on its own; readers needing batch
+		// atomicity (the timer DPC) hold _ReportLock
+		// 
+		DECLSPEC_CACHEALIGN Core::ReportChannel<INPUT_REPORT> _PublishedReport{};
+
+#pragma endregion
+
+#pragma region Output path
 
 		//
 		// Output report cache
 		//
-		DS4_OUTPUT_REPORT _OutputReport;
+		DECLSPEC_CACHEALIGN DS4_OUTPUT_REPORT _OutputReport;
+
+		//
+		// Memory for full output report request
+		// 
+		DS4_AWAIT_OUTPUT _AwaitOutputCache;
+
+		//
+		// User-mode notification on new output report
+		// 
+		DMFMODULE _OutputReportNotify;
+
+#pragma endregion
+
+#pragma region Setup and teardown
 
 		//
 		// Timer for dispatching interrupt transfer
@@ -165,14 +304,7 @@ namespace ViGEm::Bus::Targets
 		//
 		MAC_ADDRESS _HostMacAddress;
 
-		//
-		// User-mode notification on new output report
-		// 
-		DMFMODULE _OutputReportNotify;
-
-		//
-		// Memory for full output report request
-		// 
-		DS4_AWAIT_OUTPUT _AwaitOutputCache;
+#pragma endregion
 	};
+#pragma warning(pop)
 }
@@ -0,0 +1,84 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#include <ViGEm/km/Ds4ReportSchema.hpp>
+
+namespace ViGEm::Bus::Core::Ds4ReportClock
+{
+	//
+	// Input report (including report ID) offset of the byte holding the special
+	// buttons in bits 0-1 and the 6-bit frame counter in bits 2-7
+	// 
+	constexpr unsigned int CounterOffset = Ds4ReportSchema::FrameCounter.ByteOffset();
+
+	//
+	// Input report offset of the little-endian 16-bit sensor timestamp
+	// 
+	constexpr unsigned int TimestampOffset = Ds4ReportSchema::Timestamp.ByteOffset();
+
+	constexpr unsigned char CounterMask = 0x3F;
+
+	static_assert(Ds4ReportSchema::FrameCounter.BitOffset == CounterOffset * 8 + 2
+		&& Ds4ReportSchema::FrameCounter.BitSize == 6, "Frame counter moved within its byte");
+
+	//
+	// Converts a 100ns tick count to sensor timestamp units of 16/3 microseconds
+	// 
+	constexpr unsigned short TimestampFromTicks(unsigned long long Ticks)
+	{
+		return static_cast<unsigned short>(Ticks * 3 / 160);
+	}
+
+	//
+	// Stamps frame counter and sensor timestamp into a report about to be
+	// delivered, leaving the special button bits untouched. Only the lower
+	// six bits of Counter are used, so callers can pass a free-running count.
+	// 
+	inline void Stamp(unsigned char* Report, unsigned int Counter, unsigned long long Now)
+	{
+		Report[CounterOffset] = static_cast<unsigned char>((Report[CounterOffset] & 0x03) | ((Counter & CounterMask) << 2));
+
+		const unsigned short timestamp = TimestampFromTicks(Now);
+
+		Report[TimestampOffset] = static_cast<unsigned char>(timestamp & 0xFF);
+		Report[TimestampOffset + 1] = static_cast<unsigned char>(timestamp >> 8);
+	}
+}
@@ -0,0 +1,230 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "EmulationTargetPDO.hpp"
+#include "Endpoints.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Binds a concrete target and its compile-time traits to the common PDO.
+	// TTarget must be final, the URB entry points are then dispatched
+	// statically from an internal I/O control handler instantiated for it.
+	// 
+	// TTraits provides:
+	//  Type          - VIGEM_TARGET_TYPE reported for the target
+	//  Device        - device descriptor blob, vendor and product ID get patched
+	//  Configuration - full configuration descriptor blob
+	//  Endpoints     - EndpointTable of the interrupt pipes handed out on configuration
+	//  PoolTag       - tag of the pool allocation holding the target object
+	//  QueueCount    - framework queues the target creates beyond the common PDO
+	//  TimerCount    - framework timers the target creates beyond the common PDO
+	// 
+	template <typename TTarget, typename TTraits>
+	class EmulationTarget : public EmulationTargetPDO
+	{
+	public:
+		using Traits = TTraits;
+
+		//
+		// Target objects of one type are recycled through a lookaside list,
+		// so plug/unplug churn rarely reaches the pool. Cache-aligned pool keeps
+		// the member groups on separate lines, the per-type tag tells targets
+		// apart in pool usage tools.
+		// 
+		static NTSTATUS InitializeObjectCache()
+		{
+			return ExInitializeLookasideListEx(
+				&_ObjectCache,
+				nullptr,
+				nullptr,
+				NonPagedPoolNxCacheAligned,
+				0,
+				sizeof(TTarget),
+				Traits::PoolTag,
+				0
+			);
+		}
+
+		static VOID DeleteObjectCache()
+		{
+			ExDeleteLookasideListEx(&_ObjectCache);
+		}
+
+		static void* operator new(size_t Size)
+		{
+			NT_ASSERT(Size == sizeof(TTarget));
+
+			HotPathScope::NoteAllocation(Traits::PoolTag);
+
+			//
+			// Recycled entries carry the previous target, start from zero like fresh pool
+			// 
+			const auto memory = ExAllocateFromLookasideListEx(&_ObjectCache);
+
+			if (memory != nullptr)
+			{
+				RtlZeroMemory(memory, Size);
+			}
+
+			return memory;
+		}
+
+		static void operator delete(void* Memory)
+		{
+			if (Memory == nullptr)
+			{
+				return;
+			}
+
+			ExFreeToLookasideListEx(&_ObjectCache, Memory);
+		}
+
+		NTSTATUS UsbGetDeviceDescriptorType(PUSB_DEVICE_DESCRIPTOR pDescriptor) final
+		{
+			static_assert(Traits::Device.Size == sizeof(USB_DEVICE_DESCRIPTOR), "Unexpected device descriptor size");
+
+			RtlCopyMemory(pDescriptor, Traits::Device.Bytes, sizeof(USB_DEVICE_DESCRIPTOR));
+
+			pDescriptor->idVendor = this->_VendorId;
+			pDescriptor->idProduct = this->_ProductId;
+
+			return STATUS_SUCCESS;
+		}
+
+		//
+		// Submission entry point for callers that know the concrete type, the
+		// report cache is updated and flushed without going through the vtable
+		// 
+		NTSTATUS SubmitReport(PVOID NewReport, BOOLEAN IsInternal = FALSE)
+		{
+			NTSTATUS status;
+			KIRQL irql;
+
+			if (this->RouteReport(NewReport, IsInternal, &status))
+				return status;
+
+			const auto target = static_cast<TTarget*>(this);
+
+			KeAcquireSpinLock(&this->_ReportLock, &irql);
+			const BOOLEAN changed = target->UpdateReportCache(NewReport);
+			KeReleaseSpinLock(&this->_ReportLock, irql);
+
+			// Don't waste pending IRP if input hasn't changed
+			return changed ? target->FlushReportCache() : STATUS_SUCCESS;
+		}
+
+	private:
+		static inline LOOKASIDE_LIST_EX _ObjectCache{};
+
+		//
+		// Pending notification queue became ready, answered by the final type
+		// 
+		static VOID EvtPendingNotificationQueueState(WDFQUEUE Queue, WDFCONTEXT Context)
+		{
+			const auto pThis = static_cast<TTarget*>(static_cast<EmulationTargetPDO*>(Context));
+
+			//
+			// No buffer available to answer the request with, leave queued
+			// 
+			if (!pThis->HasOutputBuffers())
+			{
+				return;
+			}
+
+			pThis->ProcessPendingNotification(Queue);
+		}
+
+	protected:
+		EmulationTarget(ULONG Serial, LONG SessionId, USHORT VendorId, USHORT ProductId)
+			: EmulationTargetPDO(Serial, SessionId, VendorId, ProductId)
+		{
+			static_assert(__is_final(TTarget), "target must be final to be dispatched statically");
+
+			this->_TargetType = Traits::Type;
+			this->_UsbConfigurationDescriptionSize = Traits::Configuration.Size;
+			this->_EvtIoInternalDeviceControl = EvtIoInternalDeviceControl<TTarget>;
+			this->_EvtPendingNotificationQueueState = EvtPendingNotificationQueueState;
+		}
+
+		VOID GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length) final
+		{
+			RtlCopyBytes(Buffer, Traits::Configuration.Bytes, Length);
+		}
+
+		VOID AddTargetFootprint(PVIGEM_MEMORY_FOOTPRINT Footprint) const final
+		{
+			Footprint->TargetBytes += sizeof(TTarget) - sizeof(EmulationTargetPDO);
+			Footprint->QueueCount += Traits::QueueCount;
+			Footprint->TimerCount += Traits::TimerCount;
+		}
+
+		//
+		// Describes the pipes of an interface from the endpoint table
+		// 
+		static VOID SetInterfacePipes(PUSBD_INTERFACE_INFORMATION Interface, UCHAR InterfaceNumber)
+		{
+			ULONG pipe = 0;
+
+			for (const auto& endpoint : Traits::Endpoints)
+			{
+				if (endpoint.Interface != InterfaceNumber)
+					continue;
+
+				auto& info = Interface->Pipes[pipe++];
+
+				info.MaximumTransferSize = 0x00400000;
+				info.MaximumPacketSize = endpoint.MaxPacketSize;
+				info.EndpointAddress = endpoint.Address;
+				info.Interval = endpoint.Interval;
+				info.PipeType = UsbdPipeTypeInterrupt;
+				info.PipeHandle = reinterpret_cast<USBD_PIPE_HANDLE>(static_cast<ULONG_PTR>(PipeHandleOf(endpoint)));
+				info.PipeFlags = 0x00;
+			}
+		}
+
+		//
+		// Endpoint a transfer was submitted to, nullptr if the pipe is unknown
+		// 
+		static const Endpoint* ResolvePipe(USBD_PIPE_HANDLE PipeHandle)
+		{
+			static_assert(Traits::Endpoints.IsValid(), "Endpoint policy doesn't match the endpoint direction");
+
+			return Traits::Endpoints.Resolve(reinterpret_cast<ULONG_PTR>(PipeHandle));
+		}
+	};
+}
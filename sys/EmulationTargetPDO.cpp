@@ -33,8 +33,13 @@
 */
 
 
+#include "Driver.h"
 #include "EmulationTargetPDO.hpp"
+#include "XusbPdo.hpp"
+#include "Ds4Pdo.hpp"
 #include "CRTCPP.hpp"
+#include "ReportConversion.hpp"
+#include "BatchOrder.hpp"
 #include "trace.h"
 #include "EmulationTargetPDO.tmh"
 #define NTSTRSAFE_LIB
@@ -45,6 +50,15 @@
 
 PCWSTR ViGEm::Bus::Core::EmulationTargetPDO::_deviceLocation = L"Virtual Gamepad Emulation Bus";
 
+//
+// Portable conversion constants must match the shared definitions
+// 
+static_assert(ViGEm::Bus::Core::ReportConversion::XusbGuide == XUSB_GAMEPAD_GUIDE, "XUSB button layout mismatch");
+static_assert(ViGEm::Bus::Core::ReportConversion::XusbY == XUSB_GAMEPAD_Y, "XUSB button layout mismatch");
+static_assert(ViGEm::Bus::Core::ReportConversion::Ds4ThumbRight == DS4_BUTTON_THUMB_RIGHT, "DS4 button layout mismatch");
+static_assert(ViGEm::Bus::Core::ReportConversion::Ds4SpecialPs == DS4_SPECIAL_BUTTON_PS, "DS4 button layout mismatch");
+static_assert(ViGEm::Bus::Core::ReportConversion::Ds4DpadNone == DS4_BUTTON_DPAD_NONE, "DS4 D-Pad layout mismatch");
+
 NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentDevice, PWDFDEVICE_INIT DeviceInit)
 {
 	NTSTATUS status = STATUS_UNSUCCESSFUL;
@@ -55,7 +69,8 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 	UNICODE_STRING deviceDescription;
 	WDF_OBJECT_ATTRIBUTES attributes;
 	WDF_IO_QUEUE_CONFIG usbInQueueConfig;
-	WDF_IO_QUEUE_CONFIG notificationsQueueConfig;
+	WDF_IO_QUEUE_CONFIG playbackQueueConfig;
+	WDF_TIMER_CONFIG playbackTimerConfig;
 	PEMULATION_TARGET_PDO_CONTEXT pPdoContext;
 	PDMFDEVICE_INIT dmfDeviceInit = NULL;
 	DMF_EVENT_CALLBACKS dmfEventCallbacks;
@@ -151,6 +166,7 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 		WDF_PNPPOWER_EVENT_CALLBACKS_INIT(&pnpPowerCallbacks);
 
 		pnpPowerCallbacks.EvtDevicePrepareHardware = EvtDevicePrepareHardware;
+		pnpPowerCallbacks.EvtDeviceSurpriseRemoval = EvtDeviceSurpriseRemoval;
 
 		WdfDeviceInitSetPnpPowerEventCallbacks(DeviceInit, &pnpPowerCallbacks);
 
@@ -244,37 +260,47 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 			break;
 		}
 
-		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-		attributes.ParentObject = this->_PdoDevice;
+		// Create queue holding the scheduled playback request
+		WDF_IO_QUEUE_CONFIG_INIT(&playbackQueueConfig, WdfIoQueueDispatchManual);
+		playbackQueueConfig.EvtIoCanceledOnQueue = EvtPlaybackCanceledOnQueue;
 
-		// Create and assign queue for user-land notification requests
-		WDF_IO_QUEUE_CONFIG_INIT(&notificationsQueueConfig, WdfIoQueueDispatchManual);
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, EMULATION_TARGET_PDO_CONTEXT);
 
 		status = WdfIoQueueCreate(
 			ParentDevice,
-			&notificationsQueueConfig,
-			WDF_NO_OBJECT_ATTRIBUTES,
-			&this->_PendingNotificationRequests
+			&playbackQueueConfig,
+			&attributes,
+			&this->_PendingPlaybackRequests
 		);
 		if (!NT_SUCCESS(status))
 		{
 			TraceError(
 				TRACE_BUSPDO,
-				"WdfIoQueueCreate (PendingNotificationRequests) failed with status %!STATUS!",
+				"WdfIoQueueCreate (PendingPlaybackRequests) failed with status %!STATUS!",
 				status);
 			break;
 		}
 
-		status = WdfIoQueueReadyNotify(
-			this->_PendingNotificationRequests,
-			EvtWdfIoPendingNotificationQueueState,
-			this
+		EmulationTargetPdoGetContext(this->_PendingPlaybackRequests)->Target = this;
+
+		// Create one-shot timer releasing scheduled reports
+		WDF_TIMER_CONFIG_INIT(&playbackTimerConfig, EvtPlaybackTimer);
+		playbackTimerConfig.UseHighResolutionTimer = WdfTrue;
+		playbackTimerConfig.TolerableDelay = 0;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = this->_PdoDevice;
+
+		status = WdfTimerCreate(
+			&playbackTimerConfig,
+			&attributes,
+			&this->_PlaybackTimer
 		);
 		if (!NT_SUCCESS(status))
 		{
 			TraceError(
 				TRACE_BUSPDO,
-				"WdfIoQueueReadyNotify (PendingNotificationRequests) failed with status %!STATUS!",
+				"WdfTimerCreate (PlaybackTimer) failed with status %!STATUS!",
 				status);
 			break;
 		}
@@ -288,7 +314,7 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 
 		WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(&defaultPdoQueueConfig, WdfIoQueueDispatchParallel);
 
-		defaultPdoQueueConfig.EvtIoInternalDeviceControl = EvtIoInternalDeviceControl;
+		defaultPdoQueueConfig.EvtIoInternalDeviceControl = this->_EvtIoInternalDeviceControl;
 
 		DMF_DmfDeviceInitHookQueueConfig(dmfDeviceInit, &defaultPdoQueueConfig);
 
@@ -366,6 +392,15 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 		WdfObjectDelete(this->_PdoDevice);
 	}
 
+	//
+	// Fully set up, make it reachable for the submission path
+	// 
+	if (NT_SUCCESS(status))
+	{
+		this->_IsIndexed = Bus_TargetIndexInsert(ParentDevice, this->_SerialNo, this);
+		InterlockedExchange(&this->_IsIndexRegistered, TRUE);
+	}
+
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
 
 	return status;
@@ -380,10 +415,28 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceContextCleanup(
 	const auto ctx = EmulationTargetPdoGetContext(Device);
 
 	//
-	// This queues parent is the FDO so explicitly free memory
+	// Normally gone since unplug or surprise removal, this covers children
+	// torn down along with the bus
+	// 
+	ctx->Target->RemoveFromIndex();
+
+	//
+	// Wait for creators still setting up a queue, later ones fail
+	// 
+	ExWaitForRundownProtectionRelease(&ctx->Target->_OnDemandQueueRundown);
+
+	//
+	// These queues parent is the FDO so explicitly free memory
 	//
-	WdfIoQueuePurgeSynchronously(ctx->Target->_WaitDeviceReadyRequests);
-	WdfObjectDelete(ctx->Target->_WaitDeviceReadyRequests);
+	RetireOnDemandQueue(&ctx->Target->_WaitDeviceReadyRequests);
+	RetireOnDemandQueue(&ctx->Target->_PendingNotificationRequests);
+	RetireOnDemandQueue(&ctx->Target->_PendingAwaitOutputRequests);
+
+	if (ctx->Target->_PendingPlaybackRequests)
+	{
+		WdfIoQueuePurgeSynchronously(ctx->Target->_PendingPlaybackRequests);
+		WdfObjectDelete(ctx->Target->_PendingPlaybackRequests);
+	}
 
 	//
 	// Wait for thread to finish, if active
@@ -413,6 +466,30 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceContextCleanup(
 		}
 	}
 
+	//
+	// Wait for in-flight output callback invocations and registrations to return;
+	// the rundown is never re-initialized, later calls fail
+	// 
+	ExWaitForRundownProtectionRelease(&ctx->Target->_OutputCallbackRundown);
+
+	//
+	// Let snapshot consumers know a target disappeared
+	// 
+	const auto pFdoData = FdoGetData(ctx->Target->_ParentDevice);
+	KIRQL irql;
+
+	KeAcquireSpinLock(&pFdoData->GenerationLock, &irql);
+	InterlockedExchange64(
+		&pFdoData->RemovalGeneration,
+		InterlockedIncrement64(&pFdoData->TargetGeneration)
+	);
+	KeReleaseSpinLock(&pFdoData->GenerationLock, irql);
+
+	//
+	// Hand buffered interrupt OUT transfers back to the bus
+	// 
+	ctx->Target->ReleaseOutputBuffers();
+
 	//
 	// PDO device object getting disposed, free context object 
 	// 
@@ -421,163 +498,1118 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceContextCleanup(
 	TraceVerbose(TRACE_BUSPDO, "%!FUNC! Exit");
 }
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitReport(PVOID NewReport)
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitReport(PVOID NewReport, BOOLEAN IsInternal)
 {
-	return (this->IsOwnerProcess())
-		? this->SubmitReportImpl(NewReport)
-		: STATUS_ACCESS_DENIED;
-}
+	NTSTATUS status;
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueNotification(WDFREQUEST Request) const
-{
-	return (this->IsOwnerProcess())
-		? WdfRequestForwardToIoQueue(Request, this->_PendingNotificationRequests)
-		: STATUS_ACCESS_DENIED;
-}
+	if (this->RouteReport(NewReport, IsInternal, &status))
+		return status;
 
-bool ViGEm::Bus::Core::EmulationTargetPDO::IsOwnerProcess() const
-{
-	return this->_OwnerProcessId == current_process_id();
+	return this->SubmitReportImpl(NewReport);
 }
 
-VIGEM_TARGET_TYPE ViGEm::Bus::Core::EmulationTargetPDO::GetType() const
+BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::RouteReport(PVOID NewReport, BOOLEAN IsInternal, NTSTATUS* Status)
 {
-	return this->_TargetType;
+	if (!this->IsOwner(IsInternal))
+	{
+		*Status = STATUS_ACCESS_DENIED;
+		return TRUE;
+	}
+
+	//
+	// Owner submissions become the owner's layer while merging is enabled;
+	// ApplyLayers decides under the merge lock, the read here is only a hint
+	// 
+	if (this->_MergeEnabled)
+	{
+		// All submit report structures share the Size and SerialNo header
+		const NTSTATUS status = this->ApplyLayers(
+			this->_SessionId,
+			OWNER_LAYER_PRIORITY,
+			&static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Report
+		);
+
+		// Merging got disabled in the meantime
+		if (status != STATUS_ACCESS_DENIED)
+		{
+			*Status = status;
+			return TRUE;
+		}
+	}
+
+	if (this->_MirrorCount > 0)
+	{
+		*Status = this->SubmitMirroredReport(NewReport);
+		return TRUE;
+	}
+
+	return FALSE;
 }
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFREQUEST Request)
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitMirroredReport(PVOID NewReport)
 {
-	NTSTATUS status;
+	FuncEntry(TRACE_BUSENUM);
 
-	if (!this->IsOwnerProcess())
-		return STATUS_ACCESS_DENIED;
+	KIRQL irql;
+	ULONG serials[VIGEM_MIRROR_GROUP_MAX_MEMBERS];
+	ULONG count;
+	EmulationTargetPDO* targets[VIGEM_MIRROR_GROUP_MAX_MEMBERS + 1];
+	PVOID reports[VIGEM_MIRROR_GROUP_MAX_MEMBERS + 1];
+	ULONG targetCount = 0;
 
-	if (!this->_WaitDeviceReadyRequests)
-		return STATUS_INVALID_DEVICE_STATE;
+	//
+	// Converted copies of the submitted report, one per member
+	// 
+	union
+	{
+		XUSB_SUBMIT_REPORT Xusb;
+		DS4_SUBMIT_REPORT Ds4;
+		DS4_SUBMIT_REPORT_EX Ds4Ex;
+	} mirrored[VIGEM_MIRROR_GROUP_MAX_MEMBERS];
 
-	if (this->_WaitDeviceReadyCompletionWorkerThreadHandle)
+	KeAcquireSpinLock(&this->_MirrorLock, &irql);
+	count = this->_MirrorCount;
+	RtlCopyMemory(serials, this->_MirrorSerialNo, count * sizeof(ULONG));
+	KeReleaseSpinLock(&this->_MirrorLock, irql);
+
+	targets[targetCount] = this;
+	reports[targetCount++] = NewReport;
+
+	for (ULONG i = 0; i < count; i++)
 	{
-		status = KeWaitForSingleObject(
-			&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
-			Executive,
-			KernelMode,
-			FALSE,
-			nullptr
-		);
+		EmulationTargetPDO* member;
 
-		if (NT_SUCCESS(status))
+		//
+		// Members may have been unplugged or their serial reused since the group got set
+		// 
+		if (!GetPdoBySerial(this->_ParentDevice, serials[i], &member)
+			|| member->_SessionId != this->_SessionId)
 		{
-			ZwClose(this->_WaitDeviceReadyCompletionWorkerThreadHandle);
-			this->_WaitDeviceReadyCompletionWorkerThreadHandle = nullptr;
+			TraceVerbose(
+				TRACE_BUSENUM,
+				"Skipping stale mirror target %d",
+				serials[i]);
+			continue;
+		}
+
+		auto* const out = &mirrored[i];
+
+		if (member->_TargetType == this->_TargetType)
+		{
+			RtlCopyMemory(out, NewReport, static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Size);
+		}
+		else if (member->_TargetType == DualShock4Wired)
+		{
+			DS4_SUBMIT_REPORT_INIT(&out->Ds4, 0);
+			ReportConversion::XusbToDs4(static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Report, out->Ds4.Report);
 		}
 		else
 		{
-			TraceEvents(TRACE_LEVEL_WARNING,
-				TRACE_BUSPDO,
-				"KeWaitForSingleObject failed with status %!STATUS!",
-				status
-			);
+			XUSB_SUBMIT_REPORT_INIT(&out->Xusb, 0);
+			ReportConversion::Ds4ToXusb(static_cast<PDS4_SUBMIT_REPORT>(NewReport)->Report, out->Xusb.Report);
 		}
+
+		// All submit report structures share the Size and SerialNo header
+		out->Xusb.SerialNo = member->_SerialNo;
+
+		targets[targetCount] = member;
+		reports[targetCount++] = out;
 	}
 
-	status = WdfRequestForwardToIoQueue(Request, this->_WaitDeviceReadyRequests);
+	const NTSTATUS status = SubmitReportBatch(targets, reports, targetCount);
 
-	if (!NT_SUCCESS(status))
+	FuncExit(TRACE_BUSENUM, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitReportImpl(PVOID NewReport)
+{
+	FuncEntry(TRACE_BUSENUM);
+
+	KIRQL irql;
+
+	KeAcquireSpinLock(&this->_ReportLock, &irql);
+	const BOOLEAN changed = this->UpdateReportCache(NewReport);
+	KeReleaseSpinLock(&this->_ReportLock, irql);
+
+	// Don't waste pending IRP if input hasn't changed
+	if (!changed)
+	{
+		TraceVerbose(
+			TRACE_BUSENUM,
+			"Input report hasn't changed since last update");
+		return STATUS_SUCCESS;
+	}
+
+	const NTSTATUS status = this->FlushReportCache();
+
+	FuncExit(TRACE_BUSENUM, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitReportBatch(
+	EmulationTargetPDO** Targets,
+	PVOID* Reports,
+	ULONG Count
+)
+{
+	KIRQL irql;
+	BOOLEAN changed[VIGEM_SUBMIT_REPORT_BATCH_MAX];
+	MERGED_SUBMIT_REPORT merged[VIGEM_SUBMIT_REPORT_BATCH_MAX];
+
+	FuncEntry(TRACE_BUSENUM);
+
+	if (Count == 0 || Count > VIGEM_SUBMIT_REPORT_BATCH_MAX)
+		return STATUS_INVALID_PARAMETER;
+
+	//
+	// Sort by serial so concurrent batches always acquire locks in the same order
+	// 
+	const auto getSerial = [](const EmulationTargetPDO* Target) { return Target->_SerialNo; };
+
+	BatchOrder::SortBySerial(Targets, Reports, Count, getSerial);
+
+	const ULONG duplicate = BatchOrder::FindDuplicateSerial(Targets, Count, getSerial);
+
+	if (duplicate < Count)
 	{
 		TraceError(
-			TRACE_BUSPDO,
-			"WdfRequestForwardToIoQueue failed with status %!STATUS!",
-			status
+			TRACE_BUSENUM,
+			"Serial %d occurs more than once in batch",
+			Targets[duplicate]->_SerialNo);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	KeRaiseIrql(DISPATCH_LEVEL, &irql);
+
+	//
+	// Merge locks rank above report locks (see ApplyLayers). On targets merging
+	// input the submission replaces the owner's layer instead of the report.
+	// 
+	for (ULONG i = 0; i < Count; i++)
+		KeAcquireSpinLockAtDpcLevel(&Targets[i]->_MergeLock);
+
+	for (ULONG i = 0; i < Count; i++)
+	{
+		if (!Targets[i]->_MergeEnabled)
+			continue;
+
+		// All submit report structures share the Size and SerialNo header
+		const NTSTATUS status = Targets[i]->UpdateLayer(
+			Targets[i]->_SessionId,
+			OWNER_LAYER_PRIORITY,
+			&static_cast<PXUSB_SUBMIT_REPORT>(Reports[i])->Report,
+			&merged[i]
 		);
 
+		Reports[i] = NT_SUCCESS(status) ? &merged[i] : nullptr;
+	}
+
+	//
+	// Hold all report locks while updating the caches so no interrupt IN
+	// request can observe a partially applied batch
+	// 
+	for (ULONG i = 0; i < Count; i++)
+		KeAcquireSpinLockAtDpcLevel(&Targets[i]->_ReportLock);
+
+	for (ULONG i = 0; i < Count; i++)
+		changed[i] = Reports[i] && Targets[i]->UpdateReportCache(Reports[i]);
+
+	for (ULONG i = Count; i > 0; i--)
+		KeReleaseSpinLockFromDpcLevel(&Targets[i - 1]->_ReportLock);
+
+	for (ULONG i = Count; i > 0; i--)
+		KeReleaseSpinLockFromDpcLevel(&Targets[i - 1]->_MergeLock);
+
+	KeLowerIrql(irql);
+
+	//
+	// Hand out to pending requests; if none is pending the next one picks up the cache
+	// 
+	for (ULONG i = 0; i < Count; i++)
+	{
+		if (changed[i])
+			(void)Targets[i]->FlushReportCache();
+	}
+
+	FuncExit(TRACE_BUSENUM, "status=%!STATUS!", STATUS_SUCCESS);
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueNotification(WDFREQUEST Request, ULONG TimeoutMs)
+{
+	NTSTATUS status;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	//
+	// Input-only feeders never ask, so they never pay for the queue
+	// 
+	if (!NT_SUCCESS(status = this->AcquireOnDemandQueue(
+		this->_ParentDevice,
+		&this->_PendingNotificationRequests,
+		this->_EvtPendingNotificationQueueState
+	)))
+		return status;
+
+	return Bus_ForwardToIoQueueWithDeadline(this->_ParentDevice, Request, this->_PendingNotificationRequests, TimeoutMs);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueAwaitOutput(WDFREQUEST Request, ULONG TimeoutMs)
+{
+	NTSTATUS status;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (!NT_SUCCESS(status = this->AcquireOnDemandQueue(
+		this->_ParentDevice,
+		&this->_PendingAwaitOutputRequests
+	)))
 		return status;
+
+	return Bus_ForwardToIoQueueWithDeadline(this->_ParentDevice, Request, this->_PendingAwaitOutputRequests, TimeoutMs);
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::IsOwnerProcess() const
+{
+	return !this->_OwnerIsDriver && this->_OwnerProcessId == current_process_id();
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::IsOwner(BOOLEAN IsInternal) const
+{
+	return (IsInternal) ? this->_OwnerIsDriver : this->IsOwnerProcess();
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::IsReportSizeValid(ULONG Size) const
+{
+	switch (this->_TargetType)
+	{
+	case Xbox360Wired:
+		return Size == sizeof(XUSB_SUBMIT_REPORT);
+	case DualShock4Wired:
+		return Size == sizeof(DS4_SUBMIT_REPORT) || Size == sizeof(DS4_SUBMIT_REPORT_EX);
+	default:
+		return false;
 	}
+}
 
-	OBJECT_ATTRIBUTES threadOb;
+void ViGEm::Bus::Core::EmulationTargetPDO::SetOwnerIsDriver(BOOLEAN OwnerIsDriver)
+{
+	this->_OwnerIsDriver = OwnerIsDriver;
+}
 
-	InitializeObjectAttributes(&threadOb, NULL,
-		OBJ_KERNEL_HANDLE, NULL, NULL);
+VOID ViGEm::Bus::Core::EmulationTargetPDO::SetMergePolicy(
+	BOOLEAN Enable,
+	VIGEM_MERGE_AXIS_RULE AxisRule,
+	LONG OwnerPriority
+)
+{
+	KIRQL irql;
+
+	KeAcquireSpinLock(&this->_MergeLock, &irql);
+	this->_MergeAxisRule = (AxisRule == VigemMergeAxisPriority)
+		? InputMerge::AxisRule::Priority
+		: InputMerge::AxisRule::MaxMagnitude;
+	this->_MergeOwnerPriority = OwnerPriority;
+	this->_MergeEnabled = Enable;
+	if (!Enable)
+		this->_Layers.Clear();
+	KeReleaseSpinLock(&this->_MergeLock, irql);
+}
 
-	status = PsCreateSystemThread(&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
-		static_cast<ACCESS_MASK>(0L),
-		&threadOb,
-		nullptr,
-		nullptr,
-		WaitDeviceReadyCompletionWorkerRoutine,
-		this
-	);
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitLayer(LONG SessionId, LONG Priority, PVOID Report)
+{
+	return this->ApplyLayers(SessionId, Priority, Report);
+}
 
-	if (!NT_SUCCESS(status))
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::ReleaseLayer(LONG SessionId)
+{
+	return this->ApplyLayers(SessionId, 0, nullptr);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::ApplyLayers(LONG SessionId, LONG Priority, PVOID Report)
+{
+	FuncEntry(TRACE_BUSENUM);
+
+	KIRQL irql;
+	BOOLEAN changed = FALSE;
+	NTSTATUS status;
+	MERGED_SUBMIT_REPORT merged;
+
+	KeAcquireSpinLock(&this->_MergeLock, &irql);
+
+	status = this->UpdateLayer(SessionId, Priority, Report, &merged);
+
+	//
+	// Update the cache while still holding the merge lock so concurrent
+	// contributors can't apply their merge results out of order
+	// 
+	if (NT_SUCCESS(status))
 	{
-		TraceError(
-			TRACE_BUSPDO,
-			"PsCreateSystemThread failed with status %!STATUS!",
-			status
-		);
+		KeAcquireSpinLockAtDpcLevel(&this->_ReportLock);
+		changed = this->UpdateReportCache(&merged);
+		KeReleaseSpinLockFromDpcLevel(&this->_ReportLock);
 	}
 
+	KeReleaseSpinLock(&this->_MergeLock, irql);
+
+	// Nothing to do if the session never contributed
+	if (status == STATUS_NOT_FOUND)
+		status = STATUS_SUCCESS;
+
+	if (changed)
+		status = this->FlushReportCache();
+
+	FuncExit(TRACE_BUSENUM, "status=%!STATUS!", status);
+
 	return status;
 }
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice)
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::UpdateLayer(
+	LONG SessionId,
+	LONG Priority,
+	PVOID Report,
+	MERGED_SUBMIT_REPORT* Merged
+)
 {
-	NTSTATUS status;
-	WDF_OBJECT_ATTRIBUTES attributes;
-	WDF_IO_QUEUE_CONFIG plugInQueueConfig;
-	DMF_MODULE_ATTRIBUTES moduleAttributes;
-	DMF_CONFIG_BufferQueue dmfBufferCfg;
+	InputMerge::Frame frame = {};
+
+	if (Report == nullptr)
+	{
+		if (!this->_Layers.Release(SessionId))
+			return STATUS_NOT_FOUND;
+	}
+	else
+	{
+		//
+		// Checked under the merge lock, SetMergePolicy may be clearing the layers
+		// 
+		if (!this->_MergeEnabled)
+			return STATUS_ACCESS_DENIED;
 
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = ParentDevice;
+		if (SessionId == this->_SessionId && Priority == OWNER_LAYER_PRIORITY)
+			Priority = this->_MergeOwnerPriority;
 
-	// Create and assign queue for incoming interrupt transfer
-	WDF_IO_QUEUE_CONFIG_INIT(&plugInQueueConfig, WdfIoQueueDispatchManual);
+		if (this->_TargetType == DualShock4Wired)
+			InputMerge::FromDs4(*static_cast<PDS4_REPORT>(Report), frame);
+		else
+			InputMerge::FromXusb(*static_cast<PXUSB_REPORT>(Report), frame);
 
-	status = WdfIoQueueCreate(
-		ParentDevice,
-		&plugInQueueConfig,
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&this->_WaitDeviceReadyRequests
-	);
-	if (!NT_SUCCESS(status))
+		if (!this->_Layers.Update(SessionId, Priority, frame))
+		{
+			TraceError(
+				TRACE_BUSENUM,
+				"No free input layer on target %d",
+				this->_SerialNo);
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+	}
+
+	this->_Layers.Merge(this->_MergeAxisRule, frame);
+
+	if (this->_TargetType == DualShock4Wired)
 	{
-		TraceError(
-			TRACE_BUSPDO,
-			"WdfIoQueueCreate (PendingPlugInRequests) failed with status %!STATUS!",
-			status);
+		DS4_SUBMIT_REPORT_INIT(&Merged->Ds4, this->_SerialNo);
+		InputMerge::ToDs4(frame, Merged->Ds4.Report);
+	}
+	else
+	{
+		XUSB_SUBMIT_REPORT_INIT(&Merged->Xusb, this->_SerialNo);
+		InputMerge::ToXusb(frame, Merged->Xusb.Report);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::StartPlayback(
+	WDFREQUEST Request,
+	PVIGEM_SCHEDULE_REPORTS Schedule,
+	size_t OutputBufferSize
+)
+{
+	FuncEntry(TRACE_BUSPDO);
+
+	KIRQL irql;
+	NTSTATUS status;
+	const PVIGEM_SCHEDULED_REPORT entries = VIGEM_SCHEDULE_REPORTS_ENTRIES(Schedule);
+
+	//
+	// Claim the playback slot first, forwarding may invoke the cancel callback
+	// 
+	KeAcquireSpinLock(&this->_PlaybackLock, &irql);
+
+	if (this->_PlaybackRequest != nullptr)
+	{
+		KeReleaseSpinLock(&this->_PlaybackLock, irql);
+		return STATUS_DEVICE_BUSY;
+	}
+
+	const ULONG64 now = KeQueryInterruptTime();
+
+	this->_PlaybackRequest = Request;
+	this->_Playback = Schedule;
+	this->_PlaybackOutputBufferSize = OutputBufferSize;
+	this->_PlaybackScheduler.Begin(now + Schedule->StartDelayUs * 10, Schedule->Count);
+
+	// Interrupt time is in 100ns units
+	const ULONG64 delay = this->_PlaybackScheduler.Delay(now, entries[0].OffsetUs * 10);
+
+	KeReleaseSpinLock(&this->_PlaybackLock, irql);
+
+	if (!NT_SUCCESS(status = WdfRequestForwardToIoQueue(Request, this->_PendingPlaybackRequests)))
+	{
+		TraceError(
+			TRACE_BUSPDO,
+			"WdfRequestForwardToIoQueue failed with status %!STATUS!",
+			status);
+
+		KeAcquireSpinLock(&this->_PlaybackLock, &irql);
+		if (this->_PlaybackRequest == Request)
+			this->_PlaybackRequest = nullptr;
+		KeReleaseSpinLock(&this->_PlaybackLock, irql);
+
+		return status;
+	}
+
+	// Negative due time is relative, fire at least one interval from now
+	WdfTimerStart(this->_PlaybackTimer, -static_cast<LONGLONG>(delay > 0 ? delay : 1));
+
+	FuncExit(TRACE_BUSPDO, "status=%!STATUS!", STATUS_PENDING);
+
+	return STATUS_PENDING;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::FinishPlayback()
+{
+	KIRQL irql;
+	WDFREQUEST request;
+	WDFREQUEST found;
+	size_t information = sizeof(VIGEM_SCHEDULE_REPORTS);
+
+	KeAcquireSpinLock(&this->_PlaybackLock, &irql);
+
+	if ((request = this->_PlaybackRequest) == nullptr)
+	{
+		KeReleaseSpinLock(&this->_PlaybackLock, irql);
+		return;
+	}
+
+	const auto pSchedule = this->_Playback;
+
+	pSchedule->Released = this->_PlaybackScheduler.Released();
+	pSchedule->MaxSkewUs = this->_PlaybackScheduler.MaxSkew() / 10;
+	pSchedule->TotalSkewUs = this->_PlaybackScheduler.TotalSkew() / 10;
+
+	if (this->_PlaybackOutputBufferSize >= sizeof(VIGEM_SCHEDULE_REPORTS)
+		+ static_cast<size_t>(pSchedule->Count) * sizeof(VIGEM_SCHEDULED_REPORT))
+	{
+		information += static_cast<size_t>(pSchedule->Count) * sizeof(VIGEM_SCHEDULED_REPORT);
+	}
+
+	KeReleaseSpinLock(&this->_PlaybackLock, irql);
+
+	//
+	// Request might have been canceled meanwhile, only complete it if it's still ours
+	// 
+	if (NT_SUCCESS(WdfIoQueueFindRequest(this->_PendingPlaybackRequests, nullptr, nullptr, nullptr, &found)))
+	{
+		const bool isOurs = (found == request)
+			&& NT_SUCCESS(WdfIoQueueRetrieveFoundRequest(this->_PendingPlaybackRequests, found, &request));
+
+		WdfObjectDereference(found);
+
+		if (isOurs)
+		{
+			KeAcquireSpinLock(&this->_PlaybackLock, &irql);
+			this->_PlaybackRequest = nullptr;
+			KeReleaseSpinLock(&this->_PlaybackLock, irql);
+
+			WdfRequestCompleteWithInformation(request, STATUS_SUCCESS, information);
+		}
+	}
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::EvtPlaybackTimer(
+	WDFTIMER Timer
+)
+{
+	const auto ctx = EmulationTargetPdoGetContext(WdfTimerGetParentObject(Timer))->Target;
+
+	for (;;)
+	{
+		KIRQL irql;
+
+		union
+		{
+			XUSB_SUBMIT_REPORT Xusb;
+			DS4_SUBMIT_REPORT Ds4;
+		} report;
+
+		KeAcquireSpinLock(&ctx->_PlaybackLock, &irql);
+
+		if (ctx->_PlaybackRequest == nullptr)
+		{
+			KeReleaseSpinLock(&ctx->_PlaybackLock, irql);
+			return;
+		}
+
+		if (ctx->_PlaybackScheduler.IsDone())
+		{
+			KeReleaseSpinLock(&ctx->_PlaybackLock, irql);
+			ctx->FinishPlayback();
+			return;
+		}
+
+		const auto entry = &VIGEM_SCHEDULE_REPORTS_ENTRIES(ctx->_Playback)[ctx->_PlaybackScheduler.Current()];
+		const ULONG64 now = KeQueryInterruptTime();
+		const ULONG64 delay = ctx->_PlaybackScheduler.Delay(now, entry->OffsetUs * 10);
+
+		//
+		// Not due yet, sleep until it is
+		// 
+		if (delay > 0)
+		{
+			KeReleaseSpinLock(&ctx->_PlaybackLock, irql);
+			WdfTimerStart(Timer, -static_cast<LONGLONG>(delay));
+			return;
+		}
+
+		const ULONG64 skewUs = ctx->_PlaybackScheduler.Release(now, entry->OffsetUs * 10) / 10;
+		entry->SkewUs = (skewUs > MAXULONG) ? MAXULONG : static_cast<ULONG>(skewUs);
+
+		if (ctx->_TargetType == DualShock4Wired)
+		{
+			DS4_SUBMIT_REPORT_INIT(&report.Ds4, ctx->_SerialNo);
+			report.Ds4.Report = entry->Report.Ds4;
+		}
+		else
+		{
+			XUSB_SUBMIT_REPORT_INIT(&report.Xusb, ctx->_SerialNo);
+			report.Xusb.Report = entry->Report.Xusb;
+		}
+
+		KeReleaseSpinLock(&ctx->_PlaybackLock, irql);
+
+		(void)ctx->SubmitReportImpl(&report);
+	}
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::EvtPlaybackCanceledOnQueue(
+	WDFQUEUE Queue,
+	WDFREQUEST Request
+)
+{
+	KIRQL irql;
+	const auto ctx = EmulationTargetPdoGetContext(Queue)->Target;
+
+	KeAcquireSpinLock(&ctx->_PlaybackLock, &irql);
+	if (ctx->_PlaybackRequest == Request)
+		ctx->_PlaybackRequest = nullptr;
+	KeReleaseSpinLock(&ctx->_PlaybackLock, irql);
+
+	WdfRequestComplete(Request, STATUS_CANCELLED);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::SetOrderedDelivery(
+	BOOLEAN Enable,
+	ULONG Depth,
+	VIGEM_OVERFLOW_POLICY Overflow
+)
+{
+	KIRQL irql;
+
+	KeAcquireSpinLock(&this->_ReportLock, &irql);
+	this->_OrderedReports.Configure(Depth, static_cast<OverflowPolicy>(Overflow));
+	//
+	// Edges are detected against the cache from here on, it kept changing while disabled
+	// 
+	if (!Enable || !this->_OrderedDelivery)
+		this->_OrderedReports.Clear(this->GetCachedReportButtons());
+	this->_OrderedDelivery = Enable;
+	KeReleaseSpinLock(&this->_ReportLock, irql);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::GetDeliveryCounters(PVIGEM_DELIVERY_COUNTERS Counters)
+{
+	KIRQL irql;
+
+	KeAcquireSpinLock(&this->_ReportLock, &irql);
+	const OrderedDeliveryCounters& counters = this->_OrderedReports.Counters();
+	Counters->Enqueued = counters.Enqueued;
+	Counters->Collapsed = counters.Collapsed;
+	Counters->Dropped = counters.Dropped;
+	Counters->Delivered = counters.Delivered;
+	KeReleaseSpinLock(&this->_ReportLock, irql);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::AddFootprint(PVIGEM_MEMORY_FOOTPRINT Footprint) const
+{
+	//
+	// Member groups start on their own cache line, so the
+	// distance between their first members is what they occupy
+	// 
+	Footprint->TargetCount++;
+	Footprint->SubmissionBytes += FIELD_OFFSET(EmulationTargetPDO, _ReportLock);
+	Footprint->OrderedDeliveryBytes += FIELD_OFFSET(EmulationTargetPDO, _MergeLock)
+		- FIELD_OFFSET(EmulationTargetPDO, _ReportLock);
+	Footprint->MergeBytes += FIELD_OFFSET(EmulationTargetPDO, _OutputCallbackLock)
+		- FIELD_OFFSET(EmulationTargetPDO, _MergeLock);
+	Footprint->OutputBytes += FIELD_OFFSET(EmulationTargetPDO, _PlaybackLock)
+		- FIELD_OFFSET(EmulationTargetPDO, _OutputCallbackLock);
+	Footprint->PlaybackBytes += FIELD_OFFSET(EmulationTargetPDO, _PnpCapabilities)
+		- FIELD_OFFSET(EmulationTargetPDO, _PlaybackLock);
+	Footprint->SetupBytes += sizeof(EmulationTargetPDO) - FIELD_OFFSET(EmulationTargetPDO, _PnpCapabilities);
+
+	//
+	// Blocks currently held in the bus output pool
+	// 
+	Footprint->OutputBufferBytes += static_cast<ULONG64>(this->_OutputAccount.InUse) * BUS_OUTPUT_BLOCK_SIZE;
+	Footprint->OutputBufferThrottled += this->_OutputAccount.Throttled;
+	Footprint->OutputBufferOverruns += this->_OutputAccount.Overruns;
+
+	Footprint->QueueCount += PDO_QUEUE_COUNT + this->_OnDemandQueueCount;
+	Footprint->TimerCount += PDO_TIMER_COUNT;
+
+	this->AddTargetFootprint(Footprint);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::EnqueueOrderedReport(const VOID* Report, ULONG Length)
+{
+	QUEUED_REPORT entry = {};
+
+	if (!this->_OrderedDelivery)
+		return;
+
+	RtlCopyMemory(entry.Data, Report, min(Length, sizeof(entry.Data)));
+
+	this->_OrderedReports.Push(entry, [this](const QUEUED_REPORT& Queued)
+	{
+		return this->GetReportButtons(Queued.Data);
+	});
+}
+
+BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::DequeueOrderedReport(PVOID Report, ULONG Length)
+{
+	QUEUED_REPORT entry;
+
+	if (!this->_OrderedReports.Pop(entry))
+		return FALSE;
+
+	RtlCopyMemory(Report, entry.Data, min(Length, sizeof(entry.Data)));
+
+	return TRUE;
+}
+
+BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::HasOrderedReports() const
+{
+	return !this->_OrderedReports.IsEmpty();
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::SetMirrorGroup(const ULONG* SerialNos, ULONG Count)
+{
+	KIRQL irql;
+
+	if (Count > VIGEM_MIRROR_GROUP_MAX_MEMBERS)
+		Count = VIGEM_MIRROR_GROUP_MAX_MEMBERS;
+
+	KeAcquireSpinLock(&this->_MirrorLock, &irql);
+	RtlCopyMemory(this->_MirrorSerialNo, SerialNos, Count * sizeof(ULONG));
+	this->_MirrorCount = Count;
+	KeReleaseSpinLock(&this->_MirrorLock, irql);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::RegisterOutputCallback(
+	PFN_VIGEM_BUS_OUTPUT_CALLBACK Callback,
+	PVOID CallbackContext
+)
+{
+	KIRQL irql;
+	ULONG previousSlot;
+	LONG pending;
+
+	PAGED_CODE();
+
+	if (!this->_OwnerIsDriver)
+		return STATUS_ACCESS_DENIED;
+
+	//
+	// Keeps the PDO context alive for the duration of the registration
+	// 
+	if (!ExAcquireRundownProtection(&this->_OutputCallbackRundown))
+		return STATUS_DEVICE_REMOVED;
+
+	ExAcquireFastMutex(&this->_OutputCallbackRegistrationLock);
+
+	KeAcquireSpinLock(&this->_OutputCallbackLock, &irql);
+	this->_OutputCallback = Callback;
+	this->_OutputCallbackContext = CallbackContext;
+	previousSlot = this->_OutputCallbackSlot;
+	this->_OutputCallbackSlot = previousSlot ^ 1;
+	pending = this->_OutputCallbackInvocations[previousSlot];
+	KeClearEvent(&this->_OutputCallbackDrained);
+	KeReleaseSpinLock(&this->_OutputCallbackLock, irql);
+
+	//
+	// Drain invocations of the previous callback before returning to the caller;
+	// invocations of the new one are counted in the other slot and don't hold us up
+	// 
+	if (pending > 0)
+	{
+		KeWaitForSingleObject(&this->_OutputCallbackDrained, Executive, KernelMode, FALSE, nullptr);
+	}
+
+	ExReleaseFastMutex(&this->_OutputCallbackRegistrationLock);
+
+	ExReleaseRundownProtection(&this->_OutputCallbackRundown);
+
+	return STATUS_SUCCESS;
+}
+
+LONG ViGEm::Bus::Core::EmulationTargetPDO::GetSessionId() const
+{
+	return this->_SessionId;
+}
+
+ULONG64 ViGEm::Bus::Core::EmulationTargetPDO::GetGeneration() const
+{
+	return static_cast<ULONG64>(InterlockedCompareExchange64(
+		const_cast<volatile LONG64*>(&this->_Generation), 0, 0));
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::GetSnapshot(PVIGEM_TARGET_SNAPSHOT_ENTRY Entry)
+{
+	RtlZeroMemory(Entry, sizeof(VIGEM_TARGET_SNAPSHOT_ENTRY));
+
+	Entry->SerialNo = this->_SerialNo;
+	Entry->TargetType = this->_TargetType;
+	Entry->SessionId = this->_SessionId;
+	Entry->VendorId = this->_VendorId;
+	Entry->ProductId = this->_ProductId;
+	Entry->UserIndex = VIGEM_USER_INDEX_UNKNOWN;
+	Entry->IsReady = (this->_IsReady != 0);
+	Entry->Generation = this->GetGeneration();
+
+	this->GetSnapshotImpl(Entry);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::UpdateGeneration()
+{
+	KIRQL irql;
+	const auto pFdoData = FdoGetData(this->_ParentDevice);
+
+	//
+	// Snapshots read the counter under the same lock, so they see either
+	// neither or both of the bump and the new target generation
+	// 
+	KeAcquireSpinLock(&pFdoData->GenerationLock, &irql);
+	InterlockedExchange64(&this->_Generation, InterlockedIncrement64(&pFdoData->TargetGeneration));
+	KeReleaseSpinLock(&pFdoData->GenerationLock, irql);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::GetBusGenerations(
+	WDFDEVICE Device,
+	PULONG64 Generation,
+	PULONG64 RemovalGeneration
+)
+{
+	KIRQL irql;
+	const auto pFdoData = FdoGetData(Device);
+
+	KeAcquireSpinLock(&pFdoData->GenerationLock, &irql);
+	*Generation = static_cast<ULONG64>(InterlockedCompareExchange64(&pFdoData->TargetGeneration, 0, 0));
+	*RemovalGeneration = static_cast<ULONG64>(InterlockedCompareExchange64(&pFdoData->RemovalGeneration, 0, 0));
+	KeReleaseSpinLock(&pFdoData->GenerationLock, irql);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::SignalDeviceReady()
+{
+	if (InterlockedExchange(&this->_IsReady, TRUE) == FALSE)
+	{
+		this->UpdateGeneration();
+	}
+
+	KeSetEvent(&this->_PdoBootNotificationEvent, 0, FALSE);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::InvokeOutputCallback(PVOID Buffer, ULONG BufferLength)
+{
+	KIRQL irql;
+	PFN_VIGEM_BUS_OUTPUT_CALLBACK callback;
+	PVOID callbackContext;
+	ULONG slot;
+
+	if (!ExAcquireRundownProtection(&this->_OutputCallbackRundown))
+		return;
+
+	KeAcquireSpinLock(&this->_OutputCallbackLock, &irql);
+	callback = this->_OutputCallback;
+	callbackContext = this->_OutputCallbackContext;
+	slot = this->_OutputCallbackSlot;
+	this->_OutputCallbackInvocations[slot]++;
+	KeReleaseSpinLock(&this->_OutputCallbackLock, irql);
+
+	if (callback)
+		callback(callbackContext, this->_SerialNo, Buffer, BufferLength);
+
+	//
+	// Last invocation of a replaced registration wakes the registering thread
+	// 
+	KeAcquireSpinLock(&this->_OutputCallbackLock, &irql);
+	if (--this->_OutputCallbackInvocations[slot] == 0 && slot != this->_OutputCallbackSlot)
+		KeSetEvent(&this->_OutputCallbackDrained, IO_NO_INCREMENT, FALSE);
+	KeReleaseSpinLock(&this->_OutputCallbackLock, irql);
+
+	ExReleaseRundownProtection(&this->_OutputCallbackRundown);
+}
+
+BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::QueueOutputBuffer(const VOID* Buffer, ULONG Length)
+{
+	static constexpr PoolQuota quota = { OUTPUT_BUFFER_SOFT_QUOTA, OUTPUT_BUFFER_HARD_QUOTA };
+	auto& pool = FdoGetData(this->_ParentDevice)->OutputPool;
+	KIRQL irql;
+
+	if (Length > BUS_OUTPUT_BLOCK_SIZE)
+		return FALSE;
+
+	OUTPUT_BUFFER entry = { pool.Allocate(this->_OutputAccount, quota), Length };
+
+	if (entry.Block == pool.NoBlock)
+	{
+		TraceVerbose(
+			TRACE_BUSPDO,
+			"Output pool refused block for serial %d (held %d)",
+			this->_SerialNo,
+			this->_OutputAccount.InUse);
+		return FALSE;
+	}
+
+	RtlCopyMemory(pool.Block(entry.Block), Buffer, Length);
+
+	KeAcquireSpinLock(&this->_OutputBufferLock, &irql);
+	//
+	// Can't be full, the hard quota matches the ring capacity
+	// 
+	this->_OutputBuffers.Push(entry);
+	KeReleaseSpinLock(&this->_OutputBufferLock, irql);
+
+	return TRUE;
+}
+
+BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::DequeueOutputBuffer(PVOID Buffer, ULONG BufferLength, PULONG Length)
+{
+	auto& pool = FdoGetData(this->_ParentDevice)->OutputPool;
+	OUTPUT_BUFFER entry;
+	KIRQL irql;
+
+	KeAcquireSpinLock(&this->_OutputBufferLock, &irql);
+	const bool found = this->_OutputBuffers.Pop(entry);
+	KeReleaseSpinLock(&this->_OutputBufferLock, irql);
+
+	if (!found)
+		return FALSE;
+
+	*Length = min(entry.Length, BufferLength);
+	RtlCopyMemory(Buffer, pool.Block(entry.Block), *Length);
+
+	pool.Free(this->_OutputAccount, entry.Block);
+
+	return TRUE;
+}
+
+BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::HasOutputBuffers()
+{
+	KIRQL irql;
+
+	KeAcquireSpinLock(&this->_OutputBufferLock, &irql);
+	const bool isEmpty = this->_OutputBuffers.IsEmpty();
+	KeReleaseSpinLock(&this->_OutputBufferLock, irql);
+
+	return !isEmpty;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::ReleaseOutputBuffers()
+{
+	auto& pool = FdoGetData(this->_ParentDevice)->OutputPool;
+	OUTPUT_BUFFER entry;
+	KIRQL irql;
+
+	KeAcquireSpinLock(&this->_OutputBufferLock, &irql);
+	while (this->_OutputBuffers.Pop(entry))
+		pool.Free(this->_OutputAccount, entry.Block);
+	KeReleaseSpinLock(&this->_OutputBufferLock, irql);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::AcquireOnDemandQueue(
+	WDFDEVICE Device,
+	WDFQUEUE* Queue,
+	PFN_WDF_IO_QUEUE_STATE ReadyNotify
+)
+{
+	NTSTATUS status;
+	WDF_IO_QUEUE_CONFIG queueConfig;
+	WDFQUEUE queue;
+
+	if (PeekOnDemandQueue(Queue))
+		return STATUS_SUCCESS;
+
+	//
+	// Cleanup has begun, a queue published now would outlive this object
+	// 
+	if (!ExAcquireRundownProtection(&this->_OnDemandQueueRundown))
+		return STATUS_DELETE_PENDING;
+
+	do
+	{
+		//
+		// Reached from notification, await-output and wait-ready IOCTLs inside
+		// their hot path scope, once per target and queue
+		// 
+		HotPathScope::NoteFirstUseAllocation(BUS_FRAMEWORK_POOL_TAG);
+
+		WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
+
+		if (!NT_SUCCESS(status = WdfIoQueueCreate(
+			Device,
+			&queueConfig,
+			WDF_NO_OBJECT_ATTRIBUTES,
+			&queue
+		)))
+		{
+			TraceError(
+				TRACE_BUSPDO,
+				"WdfIoQueueCreate failed with status %!STATUS!",
+				status);
+			break;
+		}
+
+		if (ReadyNotify && !NT_SUCCESS(status = WdfIoQueueReadyNotify(queue, ReadyNotify, this)))
+		{
+			TraceError(
+				TRACE_BUSPDO,
+				"WdfIoQueueReadyNotify failed with status %!STATUS!",
+				status);
+			WdfObjectDelete(queue);
+			break;
+		}
+
+		//
+		// Publish only fully set up, someone else may have been faster
+		// 
+		if (InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(Queue), queue, nullptr) != nullptr)
+		{
+			WdfObjectDelete(queue);
+			break;
+		}
+
+		InterlockedIncrement(&this->_OnDemandQueueCount);
+
+		TraceVerbose(TRACE_BUSPDO, "Created on-demand queue for serial %d", this->_SerialNo);
+	} while (FALSE);
+
+	ExReleaseRundownProtection(&this->_OnDemandQueueRundown);
+
+	return status;
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::RetireOnDemandQueue(WDFQUEUE* Queue)
+{
+	const auto queue = static_cast<WDFQUEUE>(InterlockedExchangePointer(
+		reinterpret_cast<PVOID volatile*>(Queue),
+		nullptr
+	));
+
+	if (!queue)
+		return;
+
+	WdfIoQueuePurgeSynchronously(queue);
+	WdfObjectDelete(queue);
+}
+
+WDFQUEUE ViGEm::Bus::Core::EmulationTargetPDO::PeekOnDemandQueue(WDFQUEUE* Queue)
+{
+	return static_cast<WDFQUEUE>(ReadPointerAcquire(reinterpret_cast<PVOID volatile*>(Queue)));
+}
+
+VIGEM_TARGET_TYPE ViGEm::Bus::Core::EmulationTargetPDO::GetType() const
+{
+	return this->_TargetType;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFREQUEST Request)
+{
+	NTSTATUS status;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (!this->_ParentDevice)
+		return STATUS_INVALID_DEVICE_STATE;
+
+	if (!NT_SUCCESS(status = this->AcquireOnDemandQueue(this->_ParentDevice, &this->_WaitDeviceReadyRequests)))
+		return status;
+
+	if (this->_WaitDeviceReadyCompletionWorkerThreadHandle)
+	{
+		status = KeWaitForSingleObject(
+			&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
+			Executive,
+			KernelMode,
+			FALSE,
+			nullptr
+		);
+
+		if (NT_SUCCESS(status))
+		{
+			ZwClose(this->_WaitDeviceReadyCompletionWorkerThreadHandle);
+			this->_WaitDeviceReadyCompletionWorkerThreadHandle = nullptr;
+		}
+		else
+		{
+			TraceEvents(TRACE_LEVEL_WARNING,
+				TRACE_BUSPDO,
+				"KeWaitForSingleObject failed with status %!STATUS!",
+				status
+			);
+		}
+	}
+
+	status = WdfRequestForwardToIoQueue(Request, this->_WaitDeviceReadyRequests);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceError(
+			TRACE_BUSPDO,
+			"WdfRequestForwardToIoQueue failed with status %!STATUS!",
+			status
+		);
+
+		return status;
 	}
 
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = ParentDevice;
+	OBJECT_ATTRIBUTES threadOb;
 
-	DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(
-		&dmfBufferCfg,
-		&moduleAttributes
-	);
+	InitializeObjectAttributes(&threadOb, NULL,
+		OBJ_KERNEL_HANDLE, NULL, NULL);
 
-	// Don't auto-grow; start dropping packets on overrun
-	dmfBufferCfg.SourceSettings.EnableLookAside = FALSE;
-	// Maximum number of buffers to be filled and kept queued
-	dmfBufferCfg.SourceSettings.BufferCount = MAX_OUT_BUFFER_QUEUE_COUNT;
-	// Maximum byte count per buffer
-	dmfBufferCfg.SourceSettings.BufferSize = MAX_OUT_BUFFER_QUEUE_SIZE;
-	// Field to store real buffer content length
-	dmfBufferCfg.SourceSettings.BufferContextSize = sizeof(size_t);
-	// "Expensive" memory ;)
-	dmfBufferCfg.SourceSettings.PoolType = NonPagedPoolNx;
-
-	status = DMF_BufferQueue_Create(
-		ParentDevice,
-		&moduleAttributes,
-		&attributes,
-		&this->_UsbInterruptOutBufferQueue
+	status = PsCreateSystemThread(&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
+		static_cast<ACCESS_MASK>(0L),
+		&threadOb,
+		nullptr,
+		nullptr,
+		WaitDeviceReadyCompletionWorkerRoutine,
+		this
 	);
 
 	if (!NT_SUCCESS(status))
 	{
 		TraceError(
 			TRACE_BUSPDO,
-			"DMF_BufferQueue_Create failed with status %!STATUS!",
+			"PsCreateSystemThread failed with status %!STATUS!",
 			status
 		);
 	}
@@ -585,6 +1617,18 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice
 	return status;
 }
 
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice)
+{
+	//
+	// Queues living on the FDO get created on first use
+	// 
+	this->_ParentDevice = ParentDevice;
+
+	this->UpdateGeneration();
+
+	return STATUS_SUCCESS;
+}
+
 unsigned long ViGEm::Bus::Core::EmulationTargetPDO::current_process_id()
 {
 	return static_cast<DWORD>(reinterpret_cast<DWORD_PTR>(PsGetCurrentProcessId()) & 0xFFFFFFFF);
@@ -725,38 +1769,7 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::WaitDeviceReadyCompletionWorkerRoutin
 
 VOID ViGEm::Bus::Core::EmulationTargetPDO::DumpAsHex(PCSTR Prefix, PVOID Buffer, ULONG BufferLength)
 {
-#ifdef DBG
-
-	size_t dumpBufferLength = ((BufferLength * sizeof(CHAR)) * 2) + 1;
-	PSTR dumpBuffer = static_cast<PSTR>(ExAllocatePoolZero(
-		NonPagedPoolNx,
-		dumpBufferLength,
-		'1234'
-	));
-	if (dumpBuffer)
-	{
-
-		RtlZeroMemory(dumpBuffer, dumpBufferLength);
-
-		for (ULONG i = 0; i < BufferLength; i++)
-		{
-			sprintf(&dumpBuffer[i * 2], "%02X", static_cast<PUCHAR>(Buffer)[i]);
-		}
-
-		TraceVerbose(TRACE_BUSPDO,
-			"%s - Buffer length: %04d, buffer content: %s\n",
-			Prefix,
-			BufferLength,
-			dumpBuffer
-		);
-
-		ExFreePoolWithTag(dumpBuffer, '1234');
-	}
-#else
-	UNREFERENCED_PARAMETER(Prefix);
-	UNREFERENCED_PARAMETER(Buffer);
-	UNREFERENCED_PARAMETER(BufferLength);
-#endif
+	Util_DumpAsHex(Prefix, Buffer, BufferLength);
 }
 
 void ViGEm::Bus::Core::EmulationTargetPDO::UsbAbortPipe()
@@ -765,7 +1778,9 @@ void ViGEm::Bus::Core::EmulationTargetPDO::UsbAbortPipe()
 
 	// Higher driver shutting down, emptying PDOs queues
 	WdfIoQueuePurge(this->_PendingUsbInRequests, nullptr, nullptr);
-	WdfIoQueuePurge(this->_PendingNotificationRequests, nullptr, nullptr);
+
+	if (const auto notificationQueue = PeekOnDemandQueue(&this->_PendingNotificationRequests))
+		WdfIoQueuePurge(notificationQueue, nullptr, nullptr);
 }
 
 NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::UsbGetConfigurationDescriptorType(PURB Urb)
@@ -817,8 +1832,34 @@ _SessionId(SessionId),
 _VendorId(VendorId),
 _ProductId(ProductId)
 {
+	//
+	// Keep the submission path off the lines other contexts write to
+	// 
+	static_assert(alignof(EmulationTargetPDO) == SYSTEM_CACHE_ALIGNMENT_SIZE,
+		"target objects must be cache-aligned");
+	static_assert(FIELD_OFFSET(EmulationTargetPDO, _ParentDevice) + sizeof(WDFDEVICE) <= SYSTEM_CACHE_ALIGNMENT_SIZE,
+		"read-mostly submission fields must share the first cache line");
+	static_assert(FIELD_OFFSET(EmulationTargetPDO, _ReportLock) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"per-report state must start on its own cache line");
+	static_assert(FIELD_OFFSET(EmulationTargetPDO, _MergeLock) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"input combination state must start on its own cache line");
+	static_assert(FIELD_OFFSET(EmulationTargetPDO, _OutputCallbackLock) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"output path state must start on its own cache line");
+	static_assert(FIELD_OFFSET(EmulationTargetPDO, _PlaybackLock) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"playback state must start on its own cache line");
+
 	this->_OwnerProcessId = current_process_id();
 	KeInitializeEvent(&this->_PdoBootNotificationEvent, NotificationEvent, FALSE);
+	KeInitializeEvent(&this->_OutputCallbackDrained, NotificationEvent, FALSE);
+	ExInitializeFastMutex(&this->_OutputCallbackRegistrationLock);
+	KeInitializeSpinLock(&this->_OutputCallbackLock);
+	KeInitializeSpinLock(&this->_ReportLock);
+	KeInitializeSpinLock(&this->_MirrorLock);
+	KeInitializeSpinLock(&this->_MergeLock);
+	KeInitializeSpinLock(&this->_PlaybackLock);
+	KeInitializeSpinLock(&this->_OutputBufferLock);
+	ExInitializeRundownProtection(&this->_OutputCallbackRundown);
+	ExInitializeRundownProtection(&this->_OnDemandQueueRundown);
 
 	WDF_DEVICE_PNP_CAPABILITIES_INIT(&this->_PnpCapabilities);
 	WDF_DEVICE_POWER_CAPABILITIES_INIT(&this->_PowerCapabilities);
@@ -829,6 +1870,12 @@ bool ViGEm::Bus::Core::EmulationTargetPDO::GetPdoBySerial(
 {
 	WDF_CHILD_RETRIEVE_INFO info;
 
+	//
+	// Striped index first, avoids the child list lock shared by all targets
+	// 
+	if (Bus_TargetIndexLookup(ParentDevice, SerialNo, Object))
+		return (*Object != nullptr);
+
 	const WDFCHILDLIST list = WdfFdoGetDefaultChildList(ParentDevice);
 
 	PDO_IDENTIFICATION_DESCRIPTION description;
@@ -858,6 +1905,37 @@ bool ViGEm::Bus::Core::EmulationTargetPDO::GetPdoByTypeAndSerial(IN WDFDEVICE Pa
 	return (GetPdoBySerial(ParentDevice, SerialNo, Object) && (*Object)->GetType() == Type);
 }
 
+VOID ViGEm::Bus::Core::EmulationTargetPDO::AddBusFootprint(IN WDFDEVICE ParentDevice,
+	PVIGEM_MEMORY_FOOTPRINT Footprint)
+{
+	WDF_CHILD_LIST_ITERATOR iterator;
+	WDF_CHILD_RETRIEVE_INFO childInfo;
+	PDO_IDENTIFICATION_DESCRIPTION description;
+	WDFDEVICE childDevice;
+
+	const WDFCHILDLIST list = WdfFdoGetDefaultChildList(ParentDevice);
+
+	WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
+
+	WdfChildListBeginIteration(list, &iterator);
+
+	for (;;)
+	{
+		WDF_CHILD_RETRIEVE_INFO_INIT(&childInfo, &description.Header);
+		WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+
+		const NTSTATUS status = WdfChildListRetrieveNextDevice(list, &iterator, &childDevice, &childInfo);
+
+		if (!NT_SUCCESS(status) || status == STATUS_NO_MORE_ENTRIES)
+			break;
+
+		if (childInfo.Status == WdfChildListRetrieveDeviceSuccess && description.Target->IsOwnerProcess())
+			description.Target->AddFootprint(Footprint);
+	}
+
+	WdfChildListEndIteration(list, &iterator);
+}
+
 BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::EvtChildListIdentificationDescriptionCompare(
 	WDFCHILDLIST DeviceList,
 	PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER FirstIdentificationDescription,
@@ -961,196 +2039,320 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EvtDevicePrepareHardware(
 	return status;
 }
 
-VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl(
-	_In_ WDFQUEUE Queue,
-	_In_ WDFREQUEST Request,
-	_In_ size_t OutputBufferLength,
-	_In_ size_t InputBufferLength,
-	_In_ ULONG IoControlCode
+VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceSurpriseRemoval(
+	_In_ WDFDEVICE Device
 )
 {
-	const auto ctx = EmulationTargetPdoGetContext(WdfIoQueueGetDevice(Queue));
-
-	UNREFERENCED_PARAMETER(OutputBufferLength);
-	UNREFERENCED_PARAMETER(InputBufferLength);
-
-	NTSTATUS status = STATUS_INVALID_PARAMETER;
-	PIRP irp;
-	PURB urb;
-	PIO_STACK_LOCATION irpStack;
-
 	FuncEntry(TRACE_BUSPDO);
 
-	// No help from the framework available from here on
-	irp = WdfRequestWdmGetIrp(Request);
-	irpStack = IoGetCurrentIrpStackLocation(irp);
+	EmulationTargetPdoGetContext(Device)->Target->RemoveFromIndex();
 
-	switch (IoControlCode)
+	FuncExitNoReturn(TRACE_BUSPDO);
+}
+
+VOID ViGEm::Bus::Core::EmulationTargetPDO::RemoveFromIndex()
+{
+	//
+	// Whoever clears the flag first removes the entry
+	// 
+	if (InterlockedExchange(&this->_IsIndexRegistered, FALSE))
 	{
-	case IOCTL_INTERNAL_USB_SUBMIT_URB:
+		Bus_TargetIndexRemove(
+			this->_ParentDevice,
+			this->_SerialNo,
+			this,
+			this->_IsIndexed
+		);
+	}
+}
 
-		TraceVerbose(
-			TRACE_BUSPDO,
-			">> IOCTL_INTERNAL_USB_SUBMIT_URB");
+#pragma region URB dispatch
 
-		urb = static_cast<PURB>(URB_FROM_IRP(irp));
+template <typename TTarget>
+static NTSTATUS UrbUnknownFunction(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Target);
+	UNREFERENCED_PARAMETER(Request);
 
-		switch (urb->UrbHeader.Function)
-		{
-		case URB_FUNCTION_CONTROL_TRANSFER:
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >>  Unknown function: 0x%X",
+		Urb->UrbHeader.Function);
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_CONTROL_TRANSFER");
+	return STATUS_INVALID_PARAMETER;
+}
 
-			status = ctx->Target->UsbControlTransfer(urb);
+template <typename TTarget>
+static NTSTATUS UrbControlTransfer(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Request);
 
-			break;
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_CONTROL_TRANSFER");
 
-		case URB_FUNCTION_CONTROL_TRANSFER_EX:
+	return Target->UsbControlTransfer(Urb);
+}
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_CONTROL_TRANSFER_EX");
+template <typename TTarget>
+static NTSTATUS UrbControlTransferEx(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Target);
+	UNREFERENCED_PARAMETER(Urb);
+	UNREFERENCED_PARAMETER(Request);
 
-			status = STATUS_UNSUCCESSFUL;
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_CONTROL_TRANSFER_EX");
 
-			break;
+	return STATUS_UNSUCCESSFUL;
+}
 
-		case URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER:
+template <typename TTarget>
+static NTSTATUS UrbBulkOrInterruptTransfer(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER");
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER");
+	return Target->UsbBulkOrInterruptTransfer(&Urb->UrbBulkOrInterruptTransfer, Request);
+}
 
-			status = ctx->Target->UsbBulkOrInterruptTransfer(&urb->UrbBulkOrInterruptTransfer, Request);
+template <typename TTarget>
+static NTSTATUS UrbSelectConfiguration(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Request);
 
-			break;
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_SELECT_CONFIGURATION");
 
-		case URB_FUNCTION_SELECT_CONFIGURATION:
+	return Target->UsbSelectConfiguration(Urb);
+}
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_SELECT_CONFIGURATION");
+template <typename TTarget>
+static NTSTATUS UrbSelectInterface(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Request);
 
-			status = ctx->Target->UsbSelectConfiguration(urb);
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_SELECT_INTERFACE");
 
-			break;
+	return Target->UsbSelectInterface(Urb);
+}
 
-		case URB_FUNCTION_SELECT_INTERFACE:
+template <typename TTarget>
+static NTSTATUS UrbGetDescriptorFromDevice(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	NTSTATUS status = STATUS_INVALID_PARAMETER;
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_SELECT_INTERFACE");
+	UNREFERENCED_PARAMETER(Request);
 
-			status = ctx->Target->UsbSelectInterface(urb);
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE");
 
-			break;
+	switch (Urb->UrbControlDescriptorRequest.DescriptorType)
+	{
+	case USB_DEVICE_DESCRIPTOR_TYPE:
 
-		case URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE:
+		TraceVerbose(
+			TRACE_BUSPDO,
+			">> >> >> USB_DEVICE_DESCRIPTOR_TYPE");
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE");
+		status = Target->UsbGetDeviceDescriptorType(
+			static_cast<PUSB_DEVICE_DESCRIPTOR>(Urb->UrbControlDescriptorRequest.TransferBuffer));
 
-			switch (urb->UrbControlDescriptorRequest.DescriptorType)
-			{
-			case USB_DEVICE_DESCRIPTOR_TYPE:
+		break;
 
-				TraceVerbose(
-					TRACE_BUSPDO,
-					">> >> >> USB_DEVICE_DESCRIPTOR_TYPE");
+	case USB_CONFIGURATION_DESCRIPTOR_TYPE:
 
-				status = ctx->Target->UsbGetDeviceDescriptorType(
-					static_cast<PUSB_DEVICE_DESCRIPTOR>(urb->UrbControlDescriptorRequest.TransferBuffer));
+		TraceVerbose(
+			TRACE_BUSPDO,
+			">> >> >> USB_CONFIGURATION_DESCRIPTOR_TYPE");
 
-				break;
+		status = Target->UsbGetConfigurationDescriptorType(Urb);
 
-			case USB_CONFIGURATION_DESCRIPTOR_TYPE:
+		break;
 
-				TraceVerbose(
-					TRACE_BUSPDO,
-					">> >> >> USB_CONFIGURATION_DESCRIPTOR_TYPE");
+	case USB_STRING_DESCRIPTOR_TYPE:
 
-				status = ctx->Target->UsbGetConfigurationDescriptorType(urb);
+		TraceVerbose(
+			TRACE_BUSPDO,
+			">> >> >> USB_STRING_DESCRIPTOR_TYPE");
 
-				break;
+		status = Target->UsbGetStringDescriptorType(Urb);
 
-			case USB_STRING_DESCRIPTOR_TYPE:
+		break;
 
-				TraceVerbose(
-					TRACE_BUSPDO,
-					">> >> >> USB_STRING_DESCRIPTOR_TYPE");
+	default:
 
-				status = ctx->Target->UsbGetStringDescriptorType(urb);
+		TraceVerbose(
+			TRACE_BUSPDO,
+			">> >> >> Unknown descriptor type");
 
-				break;
+		break;
+	}
 
-			default:
+	TraceVerbose(
+		TRACE_BUSPDO,
+		"<< <<");
 
-				TraceVerbose(
-					TRACE_BUSPDO,
-					">> >> >> Unknown descriptor type");
+	return status;
+}
 
-				break;
-			}
+template <typename TTarget>
+static NTSTATUS UrbGetStatusFromDevice(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Target);
+	UNREFERENCED_PARAMETER(Urb);
+	UNREFERENCED_PARAMETER(Request);
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				"<< <<");
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_GET_STATUS_FROM_DEVICE");
 
-			break;
+	// Defaults always succeed
+	return STATUS_SUCCESS;
+}
 
-		case URB_FUNCTION_GET_STATUS_FROM_DEVICE:
+template <typename TTarget>
+static NTSTATUS UrbAbortPipe(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Urb);
+	UNREFERENCED_PARAMETER(Request);
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_GET_STATUS_FROM_DEVICE");
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_ABORT_PIPE");
 
-			// Defaults always succeed
-			status = STATUS_SUCCESS;
+	Target->UsbAbortPipe();
 
-			break;
+	return STATUS_INVALID_PARAMETER;
+}
 
-		case URB_FUNCTION_ABORT_PIPE:
+template <typename TTarget>
+static NTSTATUS UrbClassInterface(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Request);
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_ABORT_PIPE");
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_CLASS_INTERFACE");
 
-			ctx->Target->UsbAbortPipe();
+	return Target->UsbClassInterface(Urb);
+}
 
-			break;
+template <typename TTarget>
+static NTSTATUS UrbGetDescriptorFromInterface(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	UNREFERENCED_PARAMETER(Request);
 
-		case URB_FUNCTION_CLASS_INTERFACE:
+	TraceVerbose(
+		TRACE_BUSPDO,
+		">> >> URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE");
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_CLASS_INTERFACE");
+	return Target->UsbGetDescriptorFromInterface(Urb);
+}
 
-			status = ctx->Target->UsbClassInterface(urb);
+//
+// URB function code to handler of the concrete target. TTarget is final, so
+// the handlers and the target methods they call are direct calls the
+// compiler can inline; a table of handler pointers measured slower.
+// 
+template <typename TTarget>
+static NTSTATUS UrbDispatch(TTarget* Target, PURB Urb, WDFREQUEST Request)
+{
+	switch (Urb->UrbHeader.Function)
+	{
+	case URB_FUNCTION_CONTROL_TRANSFER:
+		return UrbControlTransfer(Target, Urb, Request);
+	case URB_FUNCTION_CONTROL_TRANSFER_EX:
+		return UrbControlTransferEx(Target, Urb, Request);
+	case URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER:
+		return UrbBulkOrInterruptTransfer(Target, Urb, Request);
+	case URB_FUNCTION_SELECT_CONFIGURATION:
+		return UrbSelectConfiguration(Target, Urb, Request);
+	case URB_FUNCTION_SELECT_INTERFACE:
+		return UrbSelectInterface(Target, Urb, Request);
+	case URB_FUNCTION_GET_DESCRIPTOR_FROM_DEVICE:
+		return UrbGetDescriptorFromDevice(Target, Urb, Request);
+	case URB_FUNCTION_GET_STATUS_FROM_DEVICE:
+		return UrbGetStatusFromDevice(Target, Urb, Request);
+	case URB_FUNCTION_ABORT_PIPE:
+		return UrbAbortPipe(Target, Urb, Request);
+	case URB_FUNCTION_CLASS_INTERFACE:
+		return UrbClassInterface(Target, Urb, Request);
+	case URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE:
+		return UrbGetDescriptorFromInterface(Target, Urb, Request);
+	default:
+		return UrbUnknownFunction(Target, Urb, Request);
+	}
+}
 
-			break;
+#pragma endregion
 
-		case URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE:
+template <typename TTarget>
+VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl(
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ size_t OutputBufferLength,
+	_In_ size_t InputBufferLength,
+	_In_ ULONG IoControlCode
+)
+{
+	const auto target = static_cast<TTarget*>(EmulationTargetPdoGetContext(WdfIoQueueGetDevice(Queue))->Target);
+	const HotPathScope hotPath;
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >> URB_FUNCTION_GET_DESCRIPTOR_FROM_INTERFACE");
+	UNREFERENCED_PARAMETER(OutputBufferLength);
+	UNREFERENCED_PARAMETER(InputBufferLength);
 
-			status = ctx->Target->UsbGetDescriptorFromInterface(urb);
+	NTSTATUS status = STATUS_INVALID_PARAMETER;
+	PIRP irp;
+	PURB urb;
+	PIO_STACK_LOCATION irpStack;
 
-			break;
+	// No help from the framework available from here on
+	irp = WdfRequestWdmGetIrp(Request);
 
-		default:
+	if (IoControlCode == IOCTL_INTERNAL_USB_SUBMIT_URB)
+	{
+		urb = static_cast<PURB>(URB_FROM_IRP(irp));
 
-			TraceVerbose(
-				TRACE_BUSPDO,
-				">> >>  Unknown function: 0x%X",
-				urb->UrbHeader.Function);
+		//
+		// Interrupt IN transfers arrive once per polling interval,
+		// hand them straight to the target without tracing
+		// 
+		if (urb->UrbHeader.Function == URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER
+			&& (urb->UrbBulkOrInterruptTransfer.TransferFlags & USBD_TRANSFER_DIRECTION_IN))
+		{
+			status = target->UsbBulkOrInterruptTransfer(&urb->UrbBulkOrInterruptTransfer, Request);
 
-			break;
+			if (status != STATUS_PENDING)
+			{
+				WdfRequestComplete(Request, status);
+			}
+
+			return;
 		}
+	}
+
+	FuncEntry(TRACE_BUSPDO);
+
+	irpStack = IoGetCurrentIrpStackLocation(irp);
+
+	switch (IoControlCode)
+	{
+	case IOCTL_INTERNAL_USB_SUBMIT_URB:
+
+		TraceVerbose(
+			TRACE_BUSPDO,
+			">> IOCTL_INTERNAL_USB_SUBMIT_URB");
+
+		urb = static_cast<PURB>(URB_FROM_IRP(irp));
+
+		status = UrbDispatch(target, urb, Request);
 
 		TraceVerbose(
 			TRACE_BUSPDO,
@@ -1212,23 +2414,13 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl(
 	TraceVerbose(TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
 }
 
-void ViGEm::Bus::Core::EmulationTargetPDO::EvtWdfIoPendingNotificationQueueState(
-	WDFQUEUE Queue,
-	WDFCONTEXT Context
-)
-{
-	const auto pThis = static_cast<EmulationTargetPDO*>(Context);
-
-	//
-	// No buffer available to answer the request with, leave queued
-	// 
-	if (DMF_BufferQueue_Count(pThis->_UsbInterruptOutBufferQueue) == 0)
-	{
-		return;
-	}
-
-	pThis->ProcessPendingNotification(Queue);
-}
+//
+// Concrete targets the internal I/O control handler is dispatched for
+// 
+template VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl<ViGEm::Bus::Targets::EmulationTargetXUSB>(
+	WDFQUEUE, WDFREQUEST, size_t, size_t, ULONG);
+template VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl<ViGEm::Bus::Targets::EmulationTargetDS4>(
+	WDFQUEUE, WDFREQUEST, size_t, size_t, ULONG);
 
 VOID ViGEm::Bus::Core::EmulationTargetPDO::DmfDeviceModulesAdd(_In_ WDFDEVICE Device, _In_ PDMFMODULE_INIT DmfModuleInit)
 {
@@ -46,6 +46,14 @@
 #include <usbbusif.h>
 
 #include <ViGEm/Common.h>
+#include <ViGEm/km/BusSharedEx.h>
+
+#include "InputMerge.hpp"
+#include "PlaybackScheduler.hpp"
+#include "OrderedDelivery.hpp"
+#include "BlockPool.hpp"
+#include "SampleRing.hpp"
+#include "HotPath.hpp"
 
 //
 // Some insane macro-magic =3
@@ -58,6 +66,12 @@ namespace ViGEm::Bus::Core
 {
 	typedef struct _PDO_IDENTIFICATION_DESCRIPTION* PPDO_IDENTIFICATION_DESCRIPTION;
 
+	//
+	// Members are grouped by the code path touching them, each group written
+	// from a different context starts on its own cache line
+	// 
+#pragma warning(push)
+#pragma warning(disable:4324) // structure was padded due to alignment specifier
 	class EmulationTargetPDO
 	{
 	public:
@@ -72,6 +86,20 @@ namespace ViGEm::Bus::Core
 			OUT EmulationTargetPDO** Object
 		);
 
+		static bool GetPdoBySerial(
+			IN WDFDEVICE ParentDevice,
+			IN ULONG SerialNo,
+			OUT EmulationTargetPDO** Object
+		);
+
+		//
+		// Adds the memory held by every target the calling process owns to Footprint
+		// 
+		static VOID AddBusFootprint(
+			IN WDFDEVICE ParentDevice,
+			PVIGEM_MEMORY_FOOTPRINT Footprint
+		);
+
 		static NTSTATUS EnqueueWaitDeviceReady(
 			WDFDEVICE ParentDevice,
 			ULONG SerialNo,
@@ -116,39 +144,130 @@ namespace ViGEm::Bus::Core
 
 		virtual NTSTATUS UsbControlTransfer(PURB Urb) = 0;
 
-		NTSTATUS SubmitReport(PVOID NewReport);
+		NTSTATUS SubmitReport(PVOID NewReport, BOOLEAN IsInternal = FALSE);
+
+		static NTSTATUS SubmitReportBatch(
+			_Inout_updates_(Count) EmulationTargetPDO** Targets,
+			_Inout_updates_(Count) PVOID* Reports,
+			_In_ ULONG Count
+		);
 
-		NTSTATUS EnqueueNotification(WDFREQUEST Request) const;
+		NTSTATUS EnqueueNotification(WDFREQUEST Request, ULONG TimeoutMs = 0);
+
+		//
+		// Parks a DS4_AWAIT_OUTPUT_EX request until this target receives output data
+		// 
+		NTSTATUS EnqueueAwaitOutput(WDFREQUEST Request, ULONG TimeoutMs);
 
 		bool IsOwnerProcess() const;
 
+		bool IsOwner(BOOLEAN IsInternal) const;
+
+		bool IsReportSizeValid(ULONG Size) const;
+
+		void SetOwnerIsDriver(BOOLEAN OwnerIsDriver);
+
+		VOID SetMirrorGroup(_In_reads_(Count) const ULONG* SerialNos, _In_ ULONG Count);
+
+		VOID SetMergePolicy(BOOLEAN Enable, VIGEM_MERGE_AXIS_RULE AxisRule, LONG OwnerPriority);
+
+		NTSTATUS SubmitLayer(LONG SessionId, LONG Priority, PVOID Report);
+
+		NTSTATUS ReleaseLayer(LONG SessionId);
+
+		NTSTATUS StartPlayback(WDFREQUEST Request, PVIGEM_SCHEDULE_REPORTS Schedule, size_t OutputBufferSize);
+
+		VOID SetOrderedDelivery(BOOLEAN Enable, ULONG Depth, VIGEM_OVERFLOW_POLICY Overflow);
+
+		VOID GetDeliveryCounters(PVIGEM_DELIVERY_COUNTERS Counters);
+
+		//
+		// Adds the memory held by this target to Footprint
+		// 
+		VOID AddFootprint(PVIGEM_MEMORY_FOOTPRINT Footprint) const;
+
+		LONG GetSessionId() const;
+
+		ULONG64 GetGeneration() const;
+
+		VOID GetSnapshot(PVIGEM_TARGET_SNAPSHOT_ENTRY Entry);
+
+		//
+		// Reads the bus target and removal generations consistently with
+		// concurrent target stamps
+		// 
+		static VOID GetBusGenerations(WDFDEVICE Device, PULONG64 Generation, PULONG64 RemovalGeneration);
+
+		_IRQL_requires_(PASSIVE_LEVEL)
+		NTSTATUS RegisterOutputCallback(PFN_VIGEM_BUS_OUTPUT_CALLBACK Callback, PVOID CallbackContext);
+
 		VIGEM_TARGET_TYPE GetType() const;
 
 		NTSTATUS PdoPrepare(WDFDEVICE ParentDevice);
 
+		//
+		// Makes the target unreachable through the bus target index, safe to
+		// call more than once
+		// 
+		VOID RemoveFromIndex();
+
 	private:
 		static unsigned long current_process_id();
 
 		static EVT_WDF_DEVICE_CONTEXT_CLEANUP EvtDeviceContextCleanup;
 
-		static bool GetPdoBySerial(
-			IN WDFDEVICE ParentDevice,
-			IN ULONG SerialNo,
-			OUT EmulationTargetPDO** Object
-		);
+		static EVT_WDF_TIMER EvtPlaybackTimer;
+
+		static EVT_WDF_IO_QUEUE_IO_CANCELED_ON_QUEUE EvtPlaybackCanceledOnQueue;
 
 		NTSTATUS EnqueueWaitDeviceReady(WDFREQUEST Request);
 
-		HANDLE _WaitDeviceReadyCompletionWorkerThreadHandle{};
+		NTSTATUS SubmitMirroredReport(PVOID NewReport);
+
+		NTSTATUS ApplyLayers(LONG SessionId, LONG Priority, PVOID Report);
+
+		//
+		// Merged report of either target type
+		// 
+		union MERGED_SUBMIT_REPORT
+		{
+			XUSB_SUBMIT_REPORT Xusb;
+			DS4_SUBMIT_REPORT Ds4;
+		};
+
+		//
+		// Stores (or with Report set to nullptr drops) the layer of a session and
+		// renders the merged report, called with _MergeLock held. Fails with
+		// STATUS_ACCESS_DENIED while merging is disabled, STATUS_NOT_FOUND if
+		// the dropped layer didn't exist.
+		// 
+		NTSTATUS UpdateLayer(LONG SessionId, LONG Priority, PVOID Report, MERGED_SUBMIT_REPORT* Merged);
+
+		VOID FinishPlayback();
 
 	protected:
 		static const ULONG _maxHardwareIdLength = 0xFF;
 
 		static const int MAX_INSTANCE_ID_LEN = 80;
 
-		static const size_t MAX_OUT_BUFFER_QUEUE_COUNT = 64;
+		//
+		// Interrupt OUT transfers a target may hold in the bus output pool
+		// 
+		static const ULONG OUTPUT_BUFFER_SOFT_QUOTA = 4;
+
+		static const ULONG OUTPUT_BUFFER_HARD_QUOTA = 64;
 
-		static const size_t MAX_OUT_BUFFER_QUEUE_SIZE = 128;
+		//
+		// Framework queues and timers every target creates on plug-in
+		// 
+		static const ULONG PDO_QUEUE_COUNT = 3;
+
+		static const ULONG PDO_TIMER_COUNT = 1;
+
+		//
+		// Layer priority standing in for _MergeOwnerPriority on owner submissions
+		// 
+		static const LONG OWNER_LAYER_PRIORITY = MINLONG;
 
 		static PCWSTR _deviceLocation;
 
@@ -174,9 +293,19 @@ namespace ViGEm::Bus::Core
 
 		static EVT_WDF_DEVICE_PREPARE_HARDWARE EvtDevicePrepareHardware;
 
-		static EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL EvtIoInternalDeviceControl;
+		static EVT_WDF_DEVICE_SURPRISE_REMOVAL EvtDeviceSurpriseRemoval;
 
-		static EVT_WDF_IO_QUEUE_STATE EvtWdfIoPendingNotificationQueueState;
+		//
+		// Instantiated per concrete target so the URB hops are dispatched statically
+		// 
+		template <typename TTarget>
+		static VOID EvtIoInternalDeviceControl(
+			_In_ WDFQUEUE Queue,
+			_In_ WDFREQUEST Request,
+			_In_ size_t OutputBufferLength,
+			_In_ size_t InputBufferLength,
+			_In_ ULONG IoControlCode
+		);
 
 		static VOID WaitDeviceReadyCompletionWorkerRoutine(IN PVOID StartContext);
 
@@ -190,21 +319,105 @@ namespace ViGEm::Bus::Core
 
 		virtual void AbortPipe() = 0;
 
-		virtual NTSTATUS SubmitReportImpl(PVOID NewReport) = 0;
+		NTSTATUS SubmitReportImpl(PVOID NewReport);
+
+		//
+		// Owner check, merging and mirroring ahead of the report cache. Returns
+		// TRUE with Status set if the report got handled (or refused) here,
+		// FALSE if it goes into this target's cache alone.
+		// 
+		BOOLEAN RouteReport(PVOID NewReport, BOOLEAN IsInternal, NTSTATUS* Status);
+
+		//
+		// Copies a submitted report into the report cache, called with _ReportLock held.
+		// Returns TRUE if the cached report changed.
+		// 
+		virtual BOOLEAN UpdateReportCache(PVOID NewReport) = 0;
+
+		//
+		// Completes a pending interrupt IN request with the cached report. Succeeds
+		// without one as well, the next interrupt IN request picks up the cache.
+		// 
+		virtual NTSTATUS FlushReportCache() = 0;
 
 		virtual VOID ProcessPendingNotification(WDFQUEUE Queue) = 0;
 
 		virtual void DmfDeviceModulesAdd(_In_ PDMFMODULE_INIT DmfModuleInit) = 0;
 
+		virtual VOID GetSnapshotImpl(PVIGEM_TARGET_SNAPSHOT_ENTRY Entry) = 0;
+
 		//
-		// PNP Capabilities may differ from device to device
+		// Adds what the concrete target holds beyond the common PDO
 		// 
-		WDF_DEVICE_PNP_CAPABILITIES _PnpCapabilities;
+		virtual VOID AddTargetFootprint(PVIGEM_MEMORY_FOOTPRINT Footprint) const = 0;
 
 		//
-		// Power Capabilities may differ from device to device
+		// Button state of a cached input report, used to detect edges for ordered delivery
 		// 
-		WDF_DEVICE_POWER_CAPABILITIES _PowerCapabilities;
+		virtual ULONG64 GetReportButtons(const UCHAR* Report) const = 0;
+
+		//
+		// Button state of the report cache, called with _ReportLock held
+		// 
+		virtual ULONG64 GetCachedReportButtons() const = 0;
+
+		//
+		// Queues a copy of the cached report if ordered delivery is enabled,
+		// called with _ReportLock held.
+		// 
+		VOID EnqueueOrderedReport(const VOID* Report, ULONG Length);
+
+		//
+		// Pops the oldest queued report, called with _ReportLock held.
+		// Returns FALSE if the cached report should be delivered instead.
+		// 
+		BOOLEAN DequeueOrderedReport(PVOID Report, ULONG Length);
+
+		BOOLEAN HasOrderedReports() const;
+
+		VOID InvokeOutputCallback(PVOID Buffer, ULONG BufferLength);
+
+		//
+		// Buffers an interrupt OUT transfer for user-mode pick-up, dropped
+		// if the target is over its quota or the bus pool is exhausted
+		// 
+		BOOLEAN QueueOutputBuffer(const VOID* Buffer, ULONG Length);
+
+		//
+		// Copies out and releases the oldest buffered interrupt OUT transfer
+		// 
+		BOOLEAN DequeueOutputBuffer(PVOID Buffer, ULONG BufferLength, PULONG Length);
+
+		BOOLEAN HasOutputBuffers();
+
+		//
+		// Hands all buffered interrupt OUT transfers back to the bus pool
+		// 
+		VOID ReleaseOutputBuffers();
+
+		//
+		// Creates the manual queue in Queue on Device unless it already exists.
+		// Concurrent first users race to publish theirs, the losers delete their own.
+		// Fails with STATUS_DELETE_PENDING once PDO cleanup has started.
+		// 
+		NTSTATUS AcquireOnDemandQueue(WDFDEVICE Device, WDFQUEUE* Queue,
+			PFN_WDF_IO_QUEUE_STATE ReadyNotify = nullptr);
+
+		//
+		// Queue published by AcquireOnDemandQueue, nullptr until first use
+		// 
+		static WDFQUEUE PeekOnDemandQueue(WDFQUEUE* Queue);
+
+		//
+		// Unpublishes the queue in Queue, then purges and deletes it
+		// 
+		static VOID RetireOnDemandQueue(WDFQUEUE* Queue);
+
+		VOID UpdateGeneration();
+
+		VOID SignalDeviceReady();
+
+#pragma region Submission path, read-mostly
 
 		//
 		// Unique serial number of the device on the bus
@@ -226,6 +439,224 @@ namespace ViGEm::Bus::Core
 		// 
 		VIGEM_TARGET_TYPE _TargetType;
 
+		//
+		// Set if this PDO got created by a kernel-mode client
+		// 
+		BOOLEAN _OwnerIsDriver{};
+
+		//
+		// Set if other sessions may contribute input layers
+		// 
+		BOOLEAN _MergeEnabled{};
+
+		//
+		// Set if every button edge gets its own interrupt IN transfer
+		// 
+		BOOLEAN _OrderedDelivery{};
+
+		//
+		// Number of valid entries in _MirrorSerialNo
+		// 
+		ULONG _MirrorCount{};
+
+		//
+		// Queue for incoming data interrupt transfer
+		//
+		WDFQUEUE _PendingUsbInRequests{};
+
+		//
+		// This child objects' device object
+		// 
+		WDFDEVICE _PdoDevice{};
+
+		//
+		// Bus device this PDO got created on
+		// 
+		WDFDEVICE _ParentDevice{};
+
+#pragma endregion
+
+#pragma region Submission path, written per report
+
+		//
+		// Protects the cached input report against concurrent updates and reads
+		// 
+		DECLSPEC_CACHEALIGN KSPIN_LOCK _ReportLock{};
+
+		//
+		// Copy of a complete input report awaiting ordered delivery
+		// 
+		typedef struct _QUEUED_REPORT
+		{
+			UCHAR Data[64];
+		} QUEUED_REPORT;
+
+		//
+		// Reports awaiting delivery, protected by _ReportLock
+		// 
+		OrderedDeliveryQueue<QUEUED_REPORT, VIGEM_ORDERED_DELIVERY_MAX_DEPTH> _OrderedReports{};
+
+#pragma endregion
+
+#pragma region Submission path, input combination
+
+		//
+		// Protects the layers and merge policy, acquired before _ReportLock
+		// 
+		DECLSPEC_CACHEALIGN KSPIN_LOCK _MergeLock{};
+
+		//
+		// How layer axes and triggers get combined
+		// 
+		InputMerge::AxisRule _MergeAxisRule{};
+
+		//
+		// Priority of the owner's own layer
+		// 
+		LONG _MergeOwnerPriority{};
+
+		//
+		// Input contributed per session
+		// 
+		InputMerge::LayerSet<VIGEM_MERGE_MAX_LAYERS> _Layers{};
+
+		//
+		// Protects the mirror group members
+		// 
+		KSPIN_LOCK _MirrorLock{};
+
+		//
+		// Serials of targets submitted reports get mirrored to
+		// 
+		ULONG _MirrorSerialNo[VIGEM_MIRROR_GROUP_MAX_MEMBERS]{};
+
+#pragma endregion
+
+#pragma region Output path
+
+		//
+		// Protects callback, context and the per-registration invocation counts
+		// 
+		DECLSPEC_CACHEALIGN KSPIN_LOCK _OutputCallbackLock{};
+
+		//
+		// Output data callback of kernel-mode owner
+		// 
+		PFN_VIGEM_BUS_OUTPUT_CALLBACK _OutputCallback{};
+
+		//
+		// Opaque context passed to output callback
+		// 
+		PVOID _OutputCallbackContext{};
+
+		//
+		// Invocations in flight per registration slot; a new registration flips
+		// the slot and waits for the previous one to drain
+		// 
+		LONG _OutputCallbackInvocations[2]{};
+
+		//
+		// Registration slot new invocations are accounted to
+		// 
+		ULONG _OutputCallbackSlot{};
+
+		//
+		// Signaled once the previous registration slot has drained
+		// 
+		KEVENT _OutputCallbackDrained;
+
+		//
+		// Serializes registrations against each other
+		// 
+		FAST_MUTEX _OutputCallbackRegistrationLock;
+
+		//
+		// Run down once at PDO cleanup, fails registrations and invocations after
+		// 
+		EX_RUNDOWN_REF _OutputCallbackRundown{};
+
+		//
+		// Interrupt OUT transfer held in a block of the bus output pool
+		// 
+		typedef struct _OUTPUT_BUFFER
+		{
+			ULONG Block;
+			ULONG Length;
+		} OUTPUT_BUFFER;
+
+		//
+		// Protects _OutputBuffers
+		// 
+		KSPIN_LOCK _OutputBufferLock{};
+
+		//
+		// Interrupt OUT transfers awaiting delivery to user-land
+		// 
+		SampleRing<OUTPUT_BUFFER, OUTPUT_BUFFER_HARD_QUOTA> _OutputBuffers{};
+
+		//
+		// Blocks held in the bus output pool and transfers dropped
+		// 
+		PoolAccount _OutputAccount{};
+
+		//
+		// Bus generation of the last state change
+		// 
+		volatile LONG64 _Generation{};
+
+#pragma endregion
+
+#pragma region Scheduled playback
+
+		//
+		// Protects the playback state
+		// 
+		DECLSPEC_CACHEALIGN KSPIN_LOCK _PlaybackLock{};
+
+		//
+		// Releases scheduled reports at their due time
+		// 
+		WDFTIMER _PlaybackTimer{};
+
+		//
+		// Holds the pending playback request (parent is the FDO)
+		// 
+		WDFQUEUE _PendingPlaybackRequests{};
+
+		//
+		// Playback request in progress, NULL if idle
+		// 
+		WDFREQUEST _PlaybackRequest{};
+
+		//
+		// Buffer of the playback request in progress
+		// 
+		PVIGEM_SCHEDULE_REPORTS _Playback{};
+
+		//
+		// Output buffer size of the playback request in progress
+		// 
+		size_t _PlaybackOutputBufferSize{};
+
+		//
+		// Release times and skew of the playback in progress
+		// 
+		PlaybackScheduler _PlaybackScheduler{};
+
+#pragma endregion
+
+#pragma region Setup and teardown
+
+		//
+		// PNP Capabilities may differ from device to device
+		// 
+		WDF_DEVICE_PNP_CAPABILITIES _PnpCapabilities;
+
+		//
+		// Power Capabilities may differ from device to device
+		// 
+		WDF_DEVICE_POWER_CAPABILITIES _PowerCapabilities;
+
 		//
 		// If set, the vendor ID the emulated device is reporting
 		// 
@@ -237,40 +668,72 @@ namespace ViGEm::Bus::Core
 		USHORT _ProductId{};
 
 		//
-		// Queue for blocking plugin requests
+		// Queue for blocking plugin requests, created on first use
 		// 
 		WDFQUEUE _WaitDeviceReadyRequests{};
 
 		//
-		// Queue for incoming data interrupt transfer
+		// Queue for inverted calls, created on first use
 		//
-		WDFQUEUE _PendingUsbInRequests{};
+		WDFQUEUE _PendingNotificationRequests{};
 
 		//
-		// Queue for inverted calls
+		// Queue for await-output requests carrying a deadline, created on first use
+		// 
+		WDFQUEUE _PendingAwaitOutputRequests{};
+
 		//
-		WDFQUEUE _PendingNotificationRequests{};
+		// Queues created on first use so far
+		// 
+		volatile LONG _OnDemandQueueCount{};
 
 		//
-		// This child objects' device object
+		// Held while creating an on-demand queue, run down once at PDO cleanup
 		// 
-		WDFDEVICE _PdoDevice{};
+		EX_RUNDOWN_REF _OnDemandQueueRundown{};
 
 		//
 		// Configuration descriptor size (populated by derived class)
 		// 
 		ULONG _UsbConfigurationDescriptionSize{};
 
+		//
+		// Internal I/O control handler of the concrete target (populated by derived class)
+		// 
+		PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL _EvtIoInternalDeviceControl{};
+
+		//
+		// Ready notification of the pending notification queue (populated by derived class)
+		// 
+		PFN_WDF_IO_QUEUE_STATE _EvtPendingNotificationQueueState{};
+
 		//
 		// Signals the bus that PDO is ready to receive data
 		// 
 		KEVENT _PdoBootNotificationEvent;
 
 		//
-		// Queue for interrupt out requests delivered to user-land
+		// Set if reachable through the bus target index
 		// 
-		DMFMODULE _UsbInterruptOutBufferQueue{};
+		BOOLEAN _IsIndexed{};
+
+		//
+		// Set while the bus target index accounts for this target, either in
+		// a slot or as stripe overflow
+		// 
+		volatile LONG _IsIndexRegistered{};
+
+		//
+		// Set once the host stack has finished booting the device
+		// 
+		volatile LONG _IsReady{};
+
+	private:
+		HANDLE _WaitDeviceReadyCompletionWorkerThreadHandle{};
+
+#pragma endregion
 	};
+#pragma warning(pop)
 
 	typedef struct _PDO_IDENTIFICATION_DESCRIPTION
 	{
@@ -0,0 +1,175 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// How transfers on an endpoint are served
+	// 
+	enum class EndpointPolicy : unsigned char
+	{
+		//
+		// IN, completed with the next input report
+		// 
+		Report,
+		//
+		// IN, parked until the device has something to say
+		// 
+		Hold,
+		//
+		// IN, nothing behind it ever sends; parked for good like on a device
+		// with no accessory attached
+		// 
+		Idle,
+		//
+		// OUT, consumed as output data
+		// 
+		Consume,
+	};
+
+	struct Endpoint
+	{
+		unsigned char Interface;
+
+		//
+		// bEndpointAddress, bit 7 set for IN
+		// 
+		unsigned char Address;
+
+		unsigned short MaxPacketSize;
+
+		unsigned char Interval;
+
+		EndpointPolicy Policy;
+
+		constexpr bool IsIn() const
+		{
+			return (Address & 0x80) != 0;
+		}
+
+		//
+		// Consume is the OUT policy, all others serve IN endpoints
+		// 
+		constexpr bool IsPolicyValid() const
+		{
+			return IsIn() == (Policy != EndpointPolicy::Consume);
+		}
+	};
+
+	//
+	// Pipe handles handed out for an endpoint carry its address in the low byte
+	// 
+	constexpr unsigned long long PipeHandlePrefix = 0xFFFF0000;
+
+	constexpr unsigned long long PipeHandleOf(const Endpoint& Entry)
+	{
+		return PipeHandlePrefix | Entry.Address;
+	}
+
+	//
+	// Endpoints of a device, resolved from a pipe handle in O(1)
+	// 
+	template <unsigned int Count>
+	class EndpointTable
+	{
+		static_assert(Count != 0 && Count <= 32, "USB devices have at most 32 endpoints");
+
+		//
+		// Endpoint number plus direction
+		// 
+		static constexpr unsigned int IndexOf(unsigned char Address)
+		{
+			return (Address & 0x0F) | ((Address & 0x80) >> 3);
+		}
+
+	public:
+		constexpr explicit EndpointTable(const Endpoint (&Endpoints)[Count]) : _Endpoints{}, _Slots{}
+		{
+			for (unsigned int i = 0; i < Count; i++)
+			{
+				_Endpoints[i] = Endpoints[i];
+				_Slots[IndexOf(Endpoints[i].Address)] = static_cast<unsigned char>(i + 1);
+			}
+		}
+
+		//
+		// Endpoint a pipe handle was handed out for, nullptr if unknown
+		// 
+		constexpr const Endpoint* Resolve(unsigned long long PipeHandle) const
+		{
+			if ((PipeHandle & ~0xFFull) != PipeHandlePrefix)
+				return nullptr;
+
+			const unsigned int slot = _Slots[IndexOf(static_cast<unsigned char>(PipeHandle))];
+
+			return (slot != 0 && _Endpoints[slot - 1].Address == static_cast<unsigned char>(PipeHandle))
+				? &_Endpoints[slot - 1]
+				: nullptr;
+		}
+
+		constexpr bool IsValid() const
+		{
+			for (unsigned int i = 0; i < Count; i++)
+				if (!_Endpoints[i].IsPolicyValid())
+					return false;
+
+			return true;
+		}
+
+		constexpr const Endpoint* begin() const
+		{
+			return _Endpoints;
+		}
+
+		constexpr const Endpoint* end() const
+		{
+			return _Endpoints + Count;
+		}
+
+	private:
+		Endpoint _Endpoints[Count];
+
+		//
+		// One past the table index, zero if no endpoint uses the address
+		// 
+		unsigned char _Slots[32];
+	};
+}
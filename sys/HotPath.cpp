@@ -0,0 +1,149 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Driver.h"
+#include "HotPath.hpp"
+#include "trace.h"
+#include "HotPath.tmh"
+
+#if DBG
+
+//
+// Thread of each active scope. DPCs run on whatever thread they interrupted,
+// so a scope entered at DISPATCH_LEVEL borrows that thread for its duration.
+// 
+static PKTHREAD volatile g_HotPathThreads[64];
+
+static volatile LONG g_HotPathViolations;
+
+static volatile LONG g_HotPathUntracked;
+
+static volatile LONG g_HotPathFirstUse;
+
+ViGEm::Bus::Core::HotPathScope::HotPathScope() : _Slot(UNTRACKED_SCOPE)
+{
+	static_assert(ARRAYSIZE(g_HotPathThreads) == MAX_TRACKED_SCOPES, "Scope table size mismatch");
+
+	const auto thread = KeGetCurrentThread();
+
+	for (ULONG i = 0; i < MAX_TRACKED_SCOPES; i++)
+	{
+		if (InterlockedCompareExchangePointer(
+			reinterpret_cast<PVOID volatile*>(&g_HotPathThreads[i]),
+			thread,
+			nullptr
+		) == nullptr)
+		{
+			this->_Slot = i;
+			return;
+		}
+	}
+
+	//
+	// Allocations on this thread go unnoticed until the scope ends
+	// 
+	InterlockedIncrement(&g_HotPathUntracked);
+
+	TraceEvents(TRACE_LEVEL_WARNING,
+		TRACE_UTIL,
+		"Hot path scope table full, thread 0x%p untracked",
+		thread);
+
+	NT_ASSERTMSG("Hot path scope table full", FALSE);
+}
+
+ViGEm::Bus::Core::HotPathScope::~HotPathScope()
+{
+	if (this->_Slot != UNTRACKED_SCOPE)
+		InterlockedExchangePointer(reinterpret_cast<PVOID volatile*>(&g_HotPathThreads[this->_Slot]), nullptr);
+}
+
+bool ViGEm::Bus::Core::HotPathScope::IsCurrentThreadInside()
+{
+	const auto thread = KeGetCurrentThread();
+
+	for (ULONG i = 0; i < MAX_TRACKED_SCOPES; i++)
+	{
+		if (g_HotPathThreads[i] == thread)
+			return true;
+	}
+
+	return false;
+}
+
+VOID ViGEm::Bus::Core::HotPathScope::NoteAllocation(ULONG Tag)
+{
+	if (!IsCurrentThreadInside())
+		return;
+
+	InterlockedIncrement(&g_HotPathViolations);
+
+	TraceError(
+		TRACE_UTIL,
+		"Pool allocation with tag %08X on a hot path",
+		Tag);
+
+	NT_ASSERTMSG("Pool allocation on a hot path", FALSE);
+}
+
+VOID ViGEm::Bus::Core::HotPathScope::NoteFirstUseAllocation(ULONG Tag)
+{
+	if (!IsCurrentThreadInside())
+		return;
+
+	InterlockedIncrement(&g_HotPathFirstUse);
+
+	TraceVerbose(
+		TRACE_UTIL,
+		"First-use pool allocation with tag %08X on a hot path",
+		Tag);
+}
+
+LONG ViGEm::Bus::Core::HotPathScope::Violations()
+{
+	return g_HotPathViolations;
+}
+
+LONG ViGEm::Bus::Core::HotPathScope::FirstUseAllocations()
+{
+	return g_HotPathFirstUse;
+}
+
+LONG ViGEm::Bus::Core::HotPathScope::Untracked()
+{
+	return g_HotPathUntracked;
+}
+
+#endif
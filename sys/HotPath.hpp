@@ -0,0 +1,118 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Marks a URB or I/O control hot path for the lifetime of the object. Debug
+	// builds track the threads inside one and assert that the driver makes no
+	// pool allocation on them; free builds compile it away.
+	// 
+	class HotPathScope
+	{
+	public:
+#if DBG
+		HotPathScope();
+
+		~HotPathScope();
+
+		//
+		// Called by the driver's allocation sites, counts and asserts if the
+		// calling thread is inside a hot path
+		// 
+		static VOID NoteAllocation(ULONG Tag);
+
+		//
+		// Called by allocation sites exempt from the rule: one-time setup a
+		// target does on the first request of a kind (on-demand queues). Counted
+		// separately, never asserts.
+		// 
+		static VOID NoteFirstUseAllocation(ULONG Tag);
+
+		//
+		// Allocations made on hot paths so far
+		// 
+		static LONG Violations();
+
+		//
+		// Exempt first-use allocations made on hot paths so far
+		// 
+		static LONG FirstUseAllocations();
+
+		//
+		// Scopes entered while all table slots were taken, counts and asserts
+		// 
+		static LONG Untracked();
+#else
+		//
+		// User-provided so unreferenced scopes don't trip unused variable warnings
+		// 
+		HotPathScope() {}
+
+		static VOID NoteAllocation(ULONG Tag)
+		{
+			UNREFERENCED_PARAMETER(Tag);
+		}
+
+		static VOID NoteFirstUseAllocation(ULONG Tag)
+		{
+			UNREFERENCED_PARAMETER(Tag);
+		}
+#endif
+
+		HotPathScope(const HotPathScope&) = delete;
+
+		HotPathScope& operator=(const HotPathScope&) = delete;
+
+#if DBG
+	private:
+		static bool IsCurrentThreadInside();
+
+		//
+		// Threads currently inside a hot path, one slot per scope
+		// 
+		static const ULONG MAX_TRACKED_SCOPES = 64;
+
+		static const ULONG UNTRACKED_SCOPE = MAXULONG;
+
+		//
+		// Slot claimed by this scope or UNTRACKED_SCOPE if the table was full
+		// 
+		ULONG _Slot;
+#endif
+	};
+}
@@ -0,0 +1,284 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#include "ReportConversion.hpp"
+
+namespace ViGEm::Bus::Core::InputMerge
+{
+	//
+	// How contributions to the same axis or trigger get combined
+	// 
+	enum class AxisRule : unsigned int
+	{
+		//
+		// Value furthest from neutral wins
+		// 
+		MaxMagnitude = 0,
+
+		//
+		// Highest priority layer deflecting the axis wins
+		// 
+		Priority = 1
+	};
+
+	constexpr unsigned int AxisCount = 4;
+
+	constexpr unsigned int TriggerCount = 2;
+
+	//
+	// Target-independent input state. Axes are signed and centered at zero,
+	// buttons are a plain bit mask so layers can be OR-ed together.
+	// 
+	struct Frame
+	{
+		unsigned int Buttons;
+
+		unsigned char Triggers[TriggerCount];
+
+		short Axes[AxisCount];
+	};
+
+	//
+	// Picks between two contributions, returns true if Candidate replaces Current
+	// 
+	constexpr bool Supersedes(AxisRule Rule, int Candidate, int CandidatePriority, int Current, int CurrentPriority)
+	{
+		const int candidateMagnitude = Candidate < 0 ? -Candidate : Candidate;
+		const int currentMagnitude = Current < 0 ? -Current : Current;
+
+		if (candidateMagnitude == 0)
+			return false;
+
+		if (Rule == AxisRule::Priority && currentMagnitude != 0 && CandidatePriority != CurrentPriority)
+			return CandidatePriority > CurrentPriority;
+
+		return candidateMagnitude > currentMagnitude;
+	}
+
+	//
+	// Fixed set of per-session input layers. Zero-initialized storage is a
+	// valid, empty set. Callers serialize access.
+	// 
+	template <unsigned int MaxLayers>
+	class LayerSet
+	{
+	public:
+		//
+		// Stores the input of a session, returns false if all slots are taken
+		// 
+		bool Update(long SessionId, int Priority, const Frame& Input)
+		{
+			int freeSlot = -1;
+
+			for (unsigned int i = 0; i < MaxLayers; i++)
+			{
+				if (_InUse[i] && _Layers[i].SessionId == SessionId)
+				{
+					_Layers[i].Priority = Priority;
+					_Layers[i].Input = Input;
+					return true;
+				}
+
+				if (!_InUse[i] && freeSlot < 0)
+					freeSlot = static_cast<int>(i);
+			}
+
+			if (freeSlot < 0)
+				return false;
+
+			_Layers[freeSlot].SessionId = SessionId;
+			_Layers[freeSlot].Priority = Priority;
+			_Layers[freeSlot].Input = Input;
+			_InUse[freeSlot] = true;
+
+			return true;
+		}
+
+		//
+		// Drops the layer of a session, returns false if it had none
+		// 
+		bool Release(long SessionId)
+		{
+			for (unsigned int i = 0; i < MaxLayers; i++)
+			{
+				if (_InUse[i] && _Layers[i].SessionId == SessionId)
+				{
+					_InUse[i] = false;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void Clear()
+		{
+			for (unsigned int i = 0; i < MaxLayers; i++)
+				_InUse[i] = false;
+		}
+
+		unsigned int Count() const
+		{
+			unsigned int count = 0;
+
+			for (unsigned int i = 0; i < MaxLayers; i++)
+				count += _InUse[i] ? 1 : 0;
+
+			return count;
+		}
+
+		//
+		// Combines all layers into Out; buttons are OR-ed, axes and triggers follow Rule
+		// 
+		void Merge(AxisRule Rule, Frame& Out) const
+		{
+			int axisPriority[AxisCount] = {};
+			int triggerPriority[TriggerCount] = {};
+
+			Out = Frame{};
+
+			for (unsigned int i = 0; i < MaxLayers; i++)
+			{
+				if (!_InUse[i])
+					continue;
+
+				const Layer& layer = _Layers[i];
+
+				Out.Buttons |= layer.Input.Buttons;
+
+				for (unsigned int a = 0; a < AxisCount; a++)
+				{
+					if (Supersedes(Rule, layer.Input.Axes[a], layer.Priority, Out.Axes[a], axisPriority[a]))
+					{
+						Out.Axes[a] = layer.Input.Axes[a];
+						axisPriority[a] = layer.Priority;
+					}
+				}
+
+				for (unsigned int t = 0; t < TriggerCount; t++)
+				{
+					if (Supersedes(Rule, layer.Input.Triggers[t], layer.Priority, Out.Triggers[t], triggerPriority[t]))
+					{
+						Out.Triggers[t] = layer.Input.Triggers[t];
+						triggerPriority[t] = layer.Priority;
+					}
+				}
+			}
+		}
+
+	private:
+		struct Layer
+		{
+			long SessionId;
+
+			int Priority;
+
+			Frame Input;
+		};
+
+		Layer _Layers[MaxLayers];
+
+		bool _InUse[MaxLayers];
+	};
+
+	//
+	// XUSB_REPORT <-> Frame
+	// 
+	template <typename TXusbReport>
+	constexpr void FromXusb(const TXusbReport& In, Frame& Out)
+	{
+		Out.Buttons = In.wButtons;
+		Out.Triggers[0] = In.bLeftTrigger;
+		Out.Triggers[1] = In.bRightTrigger;
+		Out.Axes[0] = In.sThumbLX;
+		Out.Axes[1] = In.sThumbLY;
+		Out.Axes[2] = In.sThumbRX;
+		Out.Axes[3] = In.sThumbRY;
+	}
+
+	template <typename TXusbReport>
+	constexpr void ToXusb(const Frame& In, TXusbReport& Out)
+	{
+		Out.wButtons = static_cast<unsigned short>(In.Buttons);
+		Out.bLeftTrigger = In.Triggers[0];
+		Out.bRightTrigger = In.Triggers[1];
+		Out.sThumbLX = In.Axes[0];
+		Out.sThumbLY = In.Axes[1];
+		Out.sThumbRX = In.Axes[2];
+		Out.sThumbRY = In.Axes[3];
+	}
+
+	//
+	// DS4_REPORT <-> Frame. The D-Pad hat is expanded into direction bits and
+	// the special buttons occupy bits 16 and up so everything can be OR-ed.
+	// 
+	template <typename TDs4Report>
+	constexpr void FromDs4(const TDs4Report& In, Frame& Out)
+	{
+		using namespace ReportConversion;
+
+		Out.Buttons = HatToXusbDpad(static_cast<unsigned char>(In.wButtons & Ds4DpadMask))
+			| (In.wButtons & ~Ds4DpadMask & 0xFFFF)
+			| (static_cast<unsigned int>(In.bSpecial) << 16);
+		Out.Triggers[0] = In.bTriggerL;
+		Out.Triggers[1] = In.bTriggerR;
+		Out.Axes[0] = AxisToXusb(In.bThumbLX);
+		Out.Axes[1] = AxisToXusb(In.bThumbLY);
+		Out.Axes[2] = AxisToXusb(In.bThumbRX);
+		Out.Axes[3] = AxisToXusb(In.bThumbRY);
+	}
+
+	template <typename TDs4Report>
+	constexpr void ToDs4(const Frame& In, TDs4Report& Out)
+	{
+		using namespace ReportConversion;
+
+		Out.wButtons = static_cast<unsigned short>(XusbDpadToHat(static_cast<unsigned short>(In.Buttons))
+			| (In.Buttons & ~Ds4DpadMask & 0xFFFF));
+		Out.bSpecial = static_cast<unsigned char>(In.Buttons >> 16);
+		Out.bTriggerL = In.Triggers[0];
+		Out.bTriggerR = In.Triggers[1];
+		Out.bThumbLX = AxisToDs4(In.Axes[0]);
+		Out.bThumbLY = AxisToDs4(In.Axes[1]);
+		Out.bThumbRX = AxisToDs4(In.Axes[2]);
+		Out.bThumbRY = AxisToDs4(In.Axes[3]);
+	}
+}
@@ -0,0 +1,212 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#include "SampleRing.hpp"
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// What happens to a report with a button edge if the queue is at its depth
+	// 
+	enum class OverflowPolicy : unsigned int
+	{
+		//
+		// Discard the oldest queued report to make room
+		// 
+		DropOldest = 0,
+
+		//
+		// Discard the new report
+		// 
+		DropNewest = 1,
+
+		//
+		// Overwrite the newest queued report with the new one
+		// 
+		OverwriteNewest = 2
+	};
+
+	struct OrderedDeliveryCounters
+	{
+		//
+		// Reports appended to the queue
+		// 
+		unsigned long long Enqueued;
+
+		//
+		// Reports merged into the newest pending state as they had no button edge
+		// 
+		unsigned long long Collapsed;
+
+		//
+		// Reports (or button edges) lost due to overflow
+		// 
+		unsigned long long Dropped;
+
+		//
+		// Reports handed to the host from the queue
+		// 
+		unsigned long long Delivered;
+	};
+
+	//
+	// Bounded FIFO of complete input reports which only collapses consecutive
+	// reports if they don't differ in button state, so short taps survive even
+	// when several reports get submitted within one host poll interval.
+	// 
+	// An empty queue means the host should get the latest cached report; reports
+	// without a button edge against the latest state don't get queued then.
+	// Zero-initialized storage is a valid, empty queue. Callers serialize access.
+	// 
+	template <typename T, unsigned int Capacity>
+	class OrderedDeliveryQueue
+	{
+	public:
+		//
+		// Depth is clamped to 1..Capacity
+		// 
+		void Configure(unsigned int Depth, OverflowPolicy Policy)
+		{
+			Depth = Depth == 0 ? 1 : Depth;
+
+			_Depth = Depth > Capacity ? Capacity : Depth;
+			_Policy = Policy;
+		}
+
+		//
+		// Queues a report, ButtonsOf maps a report to its button state
+		// 
+		template <typename TButtonsOf>
+		void Push(const T& Report, TButtonsOf ButtonsOf)
+		{
+			const unsigned long long buttons = ButtonsOf(Report);
+
+			//
+			// No edge: refresh the newest queued report, or leave it to the cache if none is queued
+			// 
+			if (buttons == _LatestButtons)
+			{
+				T* back = _Reports.Back();
+
+				if (back != nullptr)
+				{
+					*back = Report;
+					_Counters.Collapsed++;
+				}
+
+				return;
+			}
+
+			if (_Reports.Count() >= Depth())
+			{
+				switch (_Policy)
+				{
+				case OverflowPolicy::DropNewest:
+					_Counters.Dropped++;
+					return;
+				case OverflowPolicy::OverwriteNewest:
+					*_Reports.Back() = Report;
+					_LatestButtons = buttons;
+					_Counters.Dropped++;
+					return;
+				default:
+					_Reports.DropFront();
+					_Counters.Dropped++;
+					break;
+				}
+			}
+
+			_Reports.Push(Report);
+			_LatestButtons = buttons;
+			_Counters.Enqueued++;
+		}
+
+		bool Pop(T& Report)
+		{
+			if (!_Reports.Pop(Report))
+				return false;
+
+			_Counters.Delivered++;
+
+			return true;
+		}
+
+		//
+		// Drops all queued reports, later edges get detected against LatestButtons,
+		// the button state of the report the host gets without a queue
+		// 
+		void Clear(unsigned long long LatestButtons)
+		{
+			_Reports.Clear();
+			_LatestButtons = LatestButtons;
+		}
+
+		bool IsEmpty() const
+		{
+			return _Reports.IsEmpty();
+		}
+
+		unsigned int Depth() const
+		{
+			return _Depth == 0 ? Capacity : _Depth;
+		}
+
+		const OrderedDeliveryCounters& Counters() const
+		{
+			return _Counters;
+		}
+
+	private:
+		SampleRing<T, Capacity> _Reports;
+
+		unsigned int _Depth;
+
+		OverflowPolicy _Policy;
+
+		//
+		// Button state of the newest report that entered the queue, or of the
+		// cached report as of the last Clear
+		// 
+		unsigned long long _LatestButtons;
+
+		OrderedDeliveryCounters _Counters;
+	};
+}
@@ -0,0 +1,97 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Driver.h"
+#include "trace.h"
+#include "OutputPool.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, Bus_OutputPoolInitialize)
+#endif
+
+
+EXTERN_C_START
+
+//
+// Allocates the blocks shared by all targets for buffering interrupt OUT
+// transfers, freed along with the bus device.
+// 
+_Use_decl_annotations_
+NTSTATUS
+Bus_OutputPoolInitialize(
+	WDFDEVICE Device
+)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDFMEMORY memory;
+	PVOID buffer;
+	PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+	const size_t size = static_cast<size_t>(
+		ViGEm::Bus::Core::BlockPool<BUS_OUTPUT_BLOCK_SIZE>::StorageSize(BUS_OUTPUT_POOL_BLOCKS));
+
+	PAGED_CODE();
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Device;
+
+	if (!NT_SUCCESS(status = WdfMemoryCreate(
+		&attributes,
+		NonPagedPoolNx,
+		BUS_OUTPUT_POOL_TAG,
+		size,
+		&memory,
+		&buffer
+	)))
+	{
+		TraceError(
+			TRACE_UTIL,
+			"WdfMemoryCreate failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	pFdoData->OutputPool.Initialize(buffer, BUS_OUTPUT_POOL_BLOCKS, BUS_OUTPUT_POOL_RESERVE);
+
+	TraceVerbose(
+		TRACE_UTIL,
+		"Output pool of %d blocks (%Iu bytes) ready",
+		BUS_OUTPUT_POOL_BLOCKS,
+		size);
+
+	return status;
+}
+
+EXTERN_C_END
@@ -0,0 +1,127 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Releases a sequence of entries at start-relative offsets and keeps track
+	// of how far each release missed its scheduled instant. Time is an opaque,
+	// monotonic tick count supplied by the caller. Callers serialize access.
+	// 
+	class PlaybackScheduler
+	{
+	public:
+		void Begin(unsigned long long Start, unsigned int Count)
+		{
+			_Start = Start;
+			_Count = Count;
+			_Index = 0;
+			_MaxSkew = 0;
+			_TotalSkew = 0;
+		}
+
+		bool IsDone() const
+		{
+			return _Index >= _Count;
+		}
+
+		//
+		// Index of the next entry to release
+		// 
+		unsigned int Current() const
+		{
+			return _Index;
+		}
+
+		//
+		// Ticks until the next entry (at Offset) is due, 0 if it is due already
+		// 
+		unsigned long long Delay(unsigned long long Now, unsigned long long Offset) const
+		{
+			const unsigned long long due = _Start + Offset;
+
+			return (Now >= due) ? 0 : due - Now;
+		}
+
+		//
+		// Marks the next entry (at Offset) as released at Now, returns its skew
+		// 
+		unsigned long long Release(unsigned long long Now, unsigned long long Offset)
+		{
+			const unsigned long long due = _Start + Offset;
+			const unsigned long long skew = (Now > due) ? Now - due : 0;
+
+			if (skew > _MaxSkew)
+				_MaxSkew = skew;
+
+			_TotalSkew += skew;
+			_Index++;
+
+			return skew;
+		}
+
+		unsigned int Released() const
+		{
+			return _Index;
+		}
+
+		unsigned long long MaxSkew() const
+		{
+			return _MaxSkew;
+		}
+
+		unsigned long long TotalSkew() const
+		{
+			return _TotalSkew;
+		}
+
+	private:
+		unsigned long long _Start;
+
+		unsigned int _Count;
+
+		unsigned int _Index;
+
+		unsigned long long _MaxSkew;
+
+		unsigned long long _TotalSkew;
+	};
+}
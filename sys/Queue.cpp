@@ -43,6 +43,7 @@
 
 using ViGEm::Bus::Core::PDO_IDENTIFICATION_DESCRIPTION;
 using ViGEm::Bus::Core::EmulationTargetPDO;
+using ViGEm::Bus::Core::HotPathScope;
 using ViGEm::Bus::Targets::EmulationTargetXUSB;
 using ViGEm::Bus::Targets::EmulationTargetDS4;
 
@@ -225,6 +226,7 @@ Bus_XusbSubmitReportHandler(
 
 	FuncEntry(TRACE_QUEUE);
 
+	const HotPathScope hotPath;
 	NTSTATUS status;
 	EmulationTargetPDO* pdo;
 	PXUSB_SUBMIT_REPORT xusbSubmit = (PXUSB_SUBMIT_REPORT)InputBuffer;
@@ -243,7 +245,7 @@ Bus_XusbSubmitReportHandler(
 	if (!EmulationTargetPDO::GetPdoByTypeAndSerial(WdfIoQueueGetDevice(Queue), Xbox360Wired, xusbSubmit->SerialNo, &pdo))
 		status = STATUS_DEVICE_DOES_NOT_EXIST;
 	else
-		status = pdo->SubmitReport(xusbSubmit);
+		status = static_cast<EmulationTargetXUSB*>(pdo)->SubmitReport(xusbSubmit);
 
 exit:
 	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
@@ -275,9 +277,11 @@ Bus_XusbRequestNotificationHandler(
 
 	FuncEntry(TRACE_QUEUE);
 
+	const HotPathScope hotPath;
 	NTSTATUS status;
 	EmulationTargetPDO* pdo;
 	PXUSB_REQUEST_NOTIFICATION xusbNotify = (PXUSB_REQUEST_NOTIFICATION)InputBuffer;
+	ULONG timeoutMs = 0;
 
 	// This request only supports a single PDO at a time
 	if (xusbNotify->SerialNo == 0)
@@ -290,11 +294,17 @@ Bus_XusbRequestNotificationHandler(
 		goto exit;
 	}
 
+	// Extended request carries a deadline
+	if (InputBufferSize >= sizeof(XUSB_REQUEST_NOTIFICATION_EX) && xusbNotify->Size == sizeof(XUSB_REQUEST_NOTIFICATION_EX))
+	{
+		timeoutMs = ((PXUSB_REQUEST_NOTIFICATION_EX)InputBuffer)->TimeoutMs;
+	}
+
 	if (!EmulationTargetPDO::GetPdoByTypeAndSerial(WdfIoQueueGetDevice(Queue), Xbox360Wired, xusbNotify->SerialNo, &pdo))
 		status = STATUS_DEVICE_DOES_NOT_EXIST;
 	else
 	{
-		status = pdo->EnqueueNotification(Request);
+		status = pdo->EnqueueNotification(Request, timeoutMs);
 
 		status = (NT_SUCCESS(status)) ? STATUS_PENDING : status;
 	}
@@ -327,6 +337,7 @@ Bus_Ds4SubmitReportHandler(
 
 	FuncEntry(TRACE_QUEUE);
 
+	const HotPathScope hotPath;
 	NTSTATUS status;
 	EmulationTargetPDO* pdo;
 	PDS4_SUBMIT_REPORT ds4Submit = (PDS4_SUBMIT_REPORT)InputBuffer;
@@ -377,7 +388,7 @@ Bus_Ds4SubmitReportHandler(
 	if (!EmulationTargetPDO::GetPdoByTypeAndSerial(WdfIoQueueGetDevice(Queue), DualShock4Wired, ds4Submit->SerialNo, &pdo))
 		status = STATUS_DEVICE_DOES_NOT_EXIST;
 	else
-		status = pdo->SubmitReport(ds4Submit);
+		status = static_cast<EmulationTargetDS4*>(pdo)->SubmitReport(ds4Submit);
 
 exit:
 	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
@@ -408,9 +419,11 @@ Bus_Ds4RequestNotificationHandler(
 
 	FuncEntry(TRACE_QUEUE);
 
+	const HotPathScope hotPath;
 	NTSTATUS status;
 	EmulationTargetPDO* pdo;
 	PDS4_REQUEST_NOTIFICATION ds4Notify = (PDS4_REQUEST_NOTIFICATION)InputBuffer;
+	ULONG timeoutMs = 0;
 
 	// This request only supports a single PDO at a time
 	if (ds4Notify->SerialNo == 0)
@@ -423,11 +436,17 @@ Bus_Ds4RequestNotificationHandler(
 		goto exit;
 	}
 
+	// Extended request carries a deadline
+	if (InputBufferSize >= sizeof(DS4_REQUEST_NOTIFICATION_EX) && ds4Notify->Size == sizeof(DS4_REQUEST_NOTIFICATION_EX))
+	{
+		timeoutMs = ((PDS4_REQUEST_NOTIFICATION_EX)InputBuffer)->TimeoutMs;
+	}
+
 	if (!EmulationTargetPDO::GetPdoByTypeAndSerial(WdfIoQueueGetDevice(Queue), DualShock4Wired, ds4Notify->SerialNo, &pdo))
 		status = STATUS_DEVICE_DOES_NOT_EXIST;
 	else
 	{
-		status = pdo->EnqueueNotification(Request);
+		status = pdo->EnqueueNotification(Request, timeoutMs);
 
 		status = (NT_SUCCESS(status)) ? STATUS_PENDING : status;
 	}
@@ -502,15 +521,45 @@ Bus_Ds4AwaitOutputHandler(
 	UNREFERENCED_PARAMETER(Queue);
 	UNREFERENCED_PARAMETER(IoctlCode);
 	UNREFERENCED_PARAMETER(OutputBufferSize);
-	UNREFERENCED_PARAMETER(InputBufferSize);
-	UNREFERENCED_PARAMETER(InputBuffer);
 	UNREFERENCED_PARAMETER(OutputBuffer);
 	UNREFERENCED_PARAMETER(BytesReturned);
 
 	FuncEntry(TRACE_QUEUE);
 
+	const HotPathScope hotPath;
 	NTSTATUS status;
-	PFDO_DEVICE_DATA pDevCtx = FdoGetData(DMF_ParentDeviceGet(DmfModule));
+	WDFDEVICE device = DMF_ParentDeviceGet(DmfModule);
+	PFDO_DEVICE_DATA pDevCtx = FdoGetData(device);
+	PDS4_AWAIT_OUTPUT awaitOutput = (PDS4_AWAIT_OUTPUT)InputBuffer;
+
+	//
+	// Extended request carries a deadline, park it with the (owned) target it names
+	// 
+	if (InputBufferSize >= sizeof(DS4_AWAIT_OUTPUT_EX) && awaitOutput->Size == sizeof(DS4_AWAIT_OUTPUT_EX))
+	{
+		EmulationTargetPDO* pdo;
+
+		if (awaitOutput->SerialNo == 0)
+		{
+			TraceError(
+				TRACE_QUEUE,
+				"Invalid serial 0 submitted");
+
+			status = STATUS_INVALID_PARAMETER;
+			goto exit;
+		}
+
+		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(device, DualShock4Wired, awaitOutput->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			goto exit;
+		}
+
+		status = pdo->EnqueueAwaitOutput(Request, ((PDS4_AWAIT_OUTPUT_EX)InputBuffer)->TimeoutMs);
+
+		status = NT_SUCCESS(status) ? STATUS_PENDING : status;
+		goto exit;
+	}
 	
 	if (!NT_SUCCESS(status = DMF_NotifyUserWithRequestMultiple_RequestProcess(
 		pDevCtx->UserNotification,
@@ -528,4 +577,759 @@ exit:
 	return status;
 }
 
+NTSTATUS
+Bus_GetTargetSnapshotHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(InputBuffer);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+
+	FuncEntry(TRACE_QUEUE);
+
+	NTSTATUS status = Bus_GetTargetSnapshot(WdfIoQueueGetDevice(Queue), Request, FALSE, BytesReturned);
+
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_SubmitReportBatchHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+	UNREFERENCED_PARAMETER(BytesReturned);
+
+	FuncEntry(TRACE_QUEUE);
+
+	const HotPathScope hotPath;
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* targets[VIGEM_SUBMIT_REPORT_BATCH_MAX];
+	PVOID reports[VIGEM_SUBMIT_REPORT_BATCH_MAX];
+	PVIGEM_SUBMIT_REPORT_BATCH pBatch = (PVIGEM_SUBMIT_REPORT_BATCH)InputBuffer;
+	size_t offset = sizeof(VIGEM_SUBMIT_REPORT_BATCH);
+
+	if (pBatch->Size != sizeof(VIGEM_SUBMIT_REPORT_BATCH)
+		|| pBatch->Count == 0
+		|| pBatch->Count > VIGEM_SUBMIT_REPORT_BATCH_MAX)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	//
+	// Resolve and validate every report before touching any target
+	// 
+	for (ULONG i = 0; i < pBatch->Count; i++)
+	{
+		EmulationTargetPDO* pdo;
+
+		// All submit report structures share the Size and SerialNo header
+		const auto pSubmit = (PXUSB_SUBMIT_REPORT)((PUCHAR)InputBuffer + offset);
+
+		if (InputBufferSize - offset < FIELD_OFFSET(XUSB_SUBMIT_REPORT, Report)
+			|| pSubmit->Size < FIELD_OFFSET(XUSB_SUBMIT_REPORT, Report)
+			|| pSubmit->Size > InputBufferSize - offset)
+		{
+			status = STATUS_INVALID_BUFFER_SIZE;
+			goto exit;
+		}
+
+		if (pSubmit->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			goto exit;
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), pSubmit->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			goto exit;
+		}
+
+		if (!pdo->IsOwnerProcess())
+		{
+			status = STATUS_ACCESS_DENIED;
+			goto exit;
+		}
+
+		if (!pdo->IsReportSizeValid(pSubmit->Size))
+		{
+			status = STATUS_INVALID_BUFFER_SIZE;
+			goto exit;
+		}
+
+		targets[i] = pdo;
+		reports[i] = pSubmit;
+		offset += pSubmit->Size;
+	}
+
+	status = EmulationTargetPDO::SubmitReportBatch(targets, reports, pBatch->Count);
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_SetMirrorGroupHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+	UNREFERENCED_PARAMETER(BytesReturned);
+
+	FuncEntry(TRACE_QUEUE);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* primary;
+	PVIGEM_MIRROR_GROUP pGroup = (PVIGEM_MIRROR_GROUP)InputBuffer;
+
+	if (pGroup->Size != sizeof(VIGEM_MIRROR_GROUP)
+		|| pGroup->PrimarySerialNo == 0
+		|| pGroup->MemberCount > VIGEM_MIRROR_GROUP_MAX_MEMBERS)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), pGroup->PrimarySerialNo, &primary))
+	{
+		status = STATUS_DEVICE_DOES_NOT_EXIST;
+		goto exit;
+	}
+
+	if (!primary->IsOwnerProcess())
+	{
+		status = STATUS_ACCESS_DENIED;
+		goto exit;
+	}
+
+	for (ULONG i = 0; i < pGroup->MemberCount; i++)
+	{
+		EmulationTargetPDO* member;
+		const ULONG serial = pGroup->MemberSerialNo[i];
+
+		if (serial == 0 || serial == pGroup->PrimarySerialNo)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			goto exit;
+		}
+
+		for (ULONG j = 0; j < i; j++)
+		{
+			if (pGroup->MemberSerialNo[j] == serial)
+			{
+				status = STATUS_INVALID_PARAMETER;
+				goto exit;
+			}
+		}
+
+		if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), serial, &member))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			goto exit;
+		}
+
+		if (!member->IsOwnerProcess() || member->GetSessionId() != primary->GetSessionId())
+		{
+			status = STATUS_ACCESS_DENIED;
+			goto exit;
+		}
+	}
+
+	primary->SetMirrorGroup(pGroup->MemberSerialNo, pGroup->MemberCount);
+
+	TraceVerbose(
+		TRACE_QUEUE,
+		"Target %d now mirrors to %d targets",
+		pGroup->PrimarySerialNo,
+		pGroup->MemberCount);
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_SetMergePolicyHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+	UNREFERENCED_PARAMETER(BytesReturned);
+
+	FuncEntry(TRACE_QUEUE);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* pdo;
+	PVIGEM_MERGE_POLICY pPolicy = (PVIGEM_MERGE_POLICY)InputBuffer;
+
+	if (pPolicy->Size != sizeof(VIGEM_MERGE_POLICY)
+		|| pPolicy->SerialNo == 0
+		|| (pPolicy->AxisRule != VigemMergeAxisMaxMagnitude && pPolicy->AxisRule != VigemMergeAxisPriority))
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), pPolicy->SerialNo, &pdo))
+	{
+		status = STATUS_DEVICE_DOES_NOT_EXIST;
+		goto exit;
+	}
+
+	if (!pdo->IsOwnerProcess())
+	{
+		status = STATUS_ACCESS_DENIED;
+		goto exit;
+	}
+
+	pdo->SetMergePolicy(pPolicy->Enable, pPolicy->AxisRule, pPolicy->OwnerPriority);
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_SubmitLayerHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+	UNREFERENCED_PARAMETER(BytesReturned);
+
+	FuncEntry(TRACE_QUEUE);
+
+	const HotPathScope hotPath;
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* pdo;
+	WDFFILEOBJECT fileObject;
+	PFDO_FILE_DATA pFileData;
+	PVIGEM_SUBMIT_LAYER pLayer = (PVIGEM_SUBMIT_LAYER)InputBuffer;
+
+	if (pLayer->Size != sizeof(VIGEM_SUBMIT_LAYER) || pLayer->SerialNo == 0)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	fileObject = WdfRequestGetFileObject(Request);
+	if (fileObject == NULL)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	pFileData = FileObjectGetData(fileObject);
+	if (pFileData == NULL)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), pLayer->SerialNo, &pdo))
+	{
+		status = STATUS_DEVICE_DOES_NOT_EXIST;
+		goto exit;
+	}
+
+	status = (pLayer->Flags & VIGEM_LAYER_FLAG_RELEASE)
+		? pdo->ReleaseLayer(pFileData->SessionId)
+		: pdo->SubmitLayer(pFileData->SessionId, pLayer->Priority, &pLayer->Report);
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_ScheduleReportsHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+	UNREFERENCED_PARAMETER(BytesReturned);
+
+	FuncEntry(TRACE_QUEUE);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* pdo;
+	PVIGEM_SCHEDULE_REPORTS pSchedule = (PVIGEM_SCHEDULE_REPORTS)InputBuffer;
+	PVIGEM_SCHEDULED_REPORT pEntries = VIGEM_SCHEDULE_REPORTS_ENTRIES(pSchedule);
+
+	if (pSchedule->Size != sizeof(VIGEM_SCHEDULE_REPORTS)
+		|| pSchedule->SerialNo == 0
+		|| pSchedule->Count == 0
+		|| pSchedule->Count > VIGEM_SCHEDULE_MAX_REPORTS
+		|| pSchedule->StartDelayUs > VIGEM_SCHEDULE_MAX_DELAY_US)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if ((InputBufferSize - sizeof(VIGEM_SCHEDULE_REPORTS)) / sizeof(VIGEM_SCHEDULED_REPORT) < pSchedule->Count)
+	{
+		status = STATUS_INVALID_BUFFER_SIZE;
+		goto exit;
+	}
+
+	for (ULONG i = 1; i < pSchedule->Count; i++)
+	{
+		if (pEntries[i].OffsetUs < pEntries[i - 1].OffsetUs)
+		{
+			TraceError(
+				TRACE_QUEUE,
+				"Report %d scheduled before its predecessor",
+				i);
+
+			status = STATUS_INVALID_PARAMETER;
+			goto exit;
+		}
+	}
+
+	//
+	// Offsets don't decrease, so checking the last one bounds them all. Keeps the
+	// start instant plus offset (in 100ns units) from wrapping and the timer due
+	// time relative.
+	// 
+	if (pEntries[pSchedule->Count - 1].OffsetUs > VIGEM_SCHEDULE_MAX_DELAY_US)
+	{
+		TraceError(
+			TRACE_QUEUE,
+			"Report offset %I64u exceeds the maximum schedule length",
+			pEntries[pSchedule->Count - 1].OffsetUs);
+
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), pSchedule->SerialNo, &pdo))
+	{
+		status = STATUS_DEVICE_DOES_NOT_EXIST;
+		goto exit;
+	}
+
+	if (!pdo->IsOwnerProcess())
+	{
+		status = STATUS_ACCESS_DENIED;
+		goto exit;
+	}
+
+	pSchedule->Released = 0;
+	pSchedule->MaxSkewUs = 0;
+	pSchedule->TotalSkewUs = 0;
+
+	status = pdo->StartPlayback(Request, pSchedule, OutputBufferSize);
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_SetInterpolationHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+	UNREFERENCED_PARAMETER(BytesReturned);
+
+	FuncEntry(TRACE_QUEUE);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* pdo;
+	PVIGEM_SET_INTERPOLATION pInterpolation = (PVIGEM_SET_INTERPOLATION)InputBuffer;
+
+	if (pInterpolation->Size != sizeof(VIGEM_SET_INTERPOLATION)
+		|| pInterpolation->SerialNo == 0
+		|| pInterpolation->Mode > VigemInterpolationExtrapolate)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	// Only the DS4 timer path can present in-between values
+	if (!EmulationTargetPDO::GetPdoByTypeAndSerial(WdfIoQueueGetDevice(Queue), DualShock4Wired, pInterpolation->SerialNo, &pdo))
+	{
+		status = STATUS_DEVICE_DOES_NOT_EXIST;
+		goto exit;
+	}
+
+	if (!pdo->IsOwnerProcess())
+	{
+		status = STATUS_ACCESS_DENIED;
+		goto exit;
+	}
+
+	static_cast<EmulationTargetDS4*>(pdo)->SetInterpolationMode(
+		static_cast<ViGEm::Bus::Core::AxisInterpolation::Mode>(pInterpolation->Mode));
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_SubmitImuSamplesHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+
+	FuncEntry(TRACE_QUEUE);
+
+	const HotPathScope hotPath;
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* pdo;
+	ULONG accepted;
+	PVIGEM_SUBMIT_IMU_SAMPLES pSubmit = (PVIGEM_SUBMIT_IMU_SAMPLES)InputBuffer;
+
+	if (pSubmit->Size != sizeof(VIGEM_SUBMIT_IMU_SAMPLES)
+		|| pSubmit->SerialNo == 0
+		|| pSubmit->Count == 0
+		|| pSubmit->Count > VIGEM_IMU_SAMPLES_MAX)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if ((InputBufferSize - sizeof(VIGEM_SUBMIT_IMU_SAMPLES)) / sizeof(VIGEM_DS4_IMU_SAMPLE) < pSubmit->Count)
+	{
+		status = STATUS_INVALID_BUFFER_SIZE;
+		goto exit;
+	}
+
+	if (!EmulationTargetPDO::GetPdoByTypeAndSerial(WdfIoQueueGetDevice(Queue), DualShock4Wired, pSubmit->SerialNo, &pdo))
+	{
+		status = STATUS_DEVICE_DOES_NOT_EXIST;
+		goto exit;
+	}
+
+	if (!pdo->IsOwnerProcess())
+	{
+		status = STATUS_ACCESS_DENIED;
+		goto exit;
+	}
+
+	accepted = static_cast<EmulationTargetDS4*>(pdo)->QueueImuSamples(
+		VIGEM_SUBMIT_IMU_SAMPLES_ENTRIES(pSubmit),
+		pSubmit->Count
+	);
+
+	if (OutputBufferSize >= sizeof(VIGEM_SUBMIT_IMU_SAMPLES))
+	{
+		PVIGEM_SUBMIT_IMU_SAMPLES pResult = (PVIGEM_SUBMIT_IMU_SAMPLES)OutputBuffer;
+
+		pResult->Accepted = accepted;
+		*BytesReturned = sizeof(VIGEM_SUBMIT_IMU_SAMPLES);
+	}
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_SetOrderedDeliveryHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBuffer);
+	UNREFERENCED_PARAMETER(BytesReturned);
+
+	FuncEntry(TRACE_QUEUE);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* pdo;
+	PVIGEM_SET_ORDERED_DELIVERY pDelivery = (PVIGEM_SET_ORDERED_DELIVERY)InputBuffer;
+
+	if (pDelivery->Size != sizeof(VIGEM_SET_ORDERED_DELIVERY)
+		|| pDelivery->SerialNo == 0
+		|| (pDelivery->Enable && (pDelivery->Depth == 0 || pDelivery->Depth > VIGEM_ORDERED_DELIVERY_MAX_DEPTH))
+		|| pDelivery->Overflow > VigemOverflowOverwriteNewest)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), pDelivery->SerialNo, &pdo))
+	{
+		status = STATUS_DEVICE_DOES_NOT_EXIST;
+		goto exit;
+	}
+
+	if (!pdo->IsOwnerProcess())
+	{
+		status = STATUS_ACCESS_DENIED;
+		goto exit;
+	}
+
+	pdo->SetOrderedDelivery(pDelivery->Enable, pDelivery->Depth, pDelivery->Overflow);
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_GetDeliveryCountersHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+
+	FuncEntry(TRACE_QUEUE);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* pdo;
+	PVIGEM_DELIVERY_COUNTERS pCounters = (PVIGEM_DELIVERY_COUNTERS)InputBuffer;
+	PVIGEM_DELIVERY_COUNTERS pResult = (PVIGEM_DELIVERY_COUNTERS)OutputBuffer;
+
+	if (pCounters->Size != sizeof(VIGEM_DELIVERY_COUNTERS) || pCounters->SerialNo == 0)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), pCounters->SerialNo, &pdo))
+	{
+		status = STATUS_DEVICE_DOES_NOT_EXIST;
+		goto exit;
+	}
+
+	if (!pdo->IsOwnerProcess())
+	{
+		status = STATUS_ACCESS_DENIED;
+		goto exit;
+	}
+
+	pResult->Size = sizeof(VIGEM_DELIVERY_COUNTERS);
+	pResult->SerialNo = pCounters->SerialNo;
+	pdo->GetDeliveryCounters(pResult);
+
+	*BytesReturned = sizeof(VIGEM_DELIVERY_COUNTERS);
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
+NTSTATUS
+Bus_GetMemoryFootprintHandler(
+	_In_ DMFMODULE DmfModule,
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_reads_(InputBufferSize) VOID* InputBuffer,
+	_In_ size_t InputBufferSize,
+	_Out_writes_(OutputBufferSize) VOID* OutputBuffer,
+	_In_ size_t OutputBufferSize,
+	_Out_ size_t* BytesReturned
+)
+{
+	UNREFERENCED_PARAMETER(DmfModule);
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(IoctlCode);
+	UNREFERENCED_PARAMETER(InputBufferSize);
+	UNREFERENCED_PARAMETER(OutputBufferSize);
+
+	FuncEntry(TRACE_QUEUE);
+
+	NTSTATUS status = STATUS_SUCCESS;
+	EmulationTargetPDO* pdo;
+	VIGEM_MEMORY_FOOTPRINT footprint;
+	PVIGEM_MEMORY_FOOTPRINT pFootprint = (PVIGEM_MEMORY_FOOTPRINT)InputBuffer;
+
+	if (pFootprint->Size != sizeof(VIGEM_MEMORY_FOOTPRINT))
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	//
+	// Input and output share the system buffer, sum up in a local copy
+	// 
+	VIGEM_MEMORY_FOOTPRINT_INIT(&footprint, pFootprint->SerialNo);
+
+	if (footprint.SerialNo == 0)
+	{
+		EmulationTargetPDO::AddBusFootprint(WdfIoQueueGetDevice(Queue), &footprint);
+	}
+	else
+	{
+		if (!EmulationTargetPDO::GetPdoBySerial(WdfIoQueueGetDevice(Queue), footprint.SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			goto exit;
+		}
+
+		if (!pdo->IsOwnerProcess())
+		{
+			status = STATUS_ACCESS_DENIED;
+			goto exit;
+		}
+
+		pdo->AddFootprint(&footprint);
+	}
+
+	footprint.TotalBytes = footprint.SubmissionBytes
+		+ footprint.OrderedDeliveryBytes
+		+ footprint.MergeBytes
+		+ footprint.OutputBytes
+		+ footprint.PlaybackBytes
+		+ footprint.SetupBytes
+		+ footprint.TargetBytes
+		+ footprint.OutputBufferBytes;
+
+	TraceVerbose(
+		TRACE_QUEUE,
+		"%d target(s) hold %I64u bytes, %d queue(s), %d timer(s)",
+		footprint.TargetCount,
+		footprint.TotalBytes,
+		footprint.QueueCount,
+		footprint.TimerCount);
+
+	RtlCopyMemory(OutputBuffer, &footprint, sizeof(VIGEM_MEMORY_FOOTPRINT));
+
+	*BytesReturned = sizeof(VIGEM_MEMORY_FOOTPRINT);
+
+exit:
+	FuncExit(TRACE_QUEUE, "status=%!STATUS!", status);
+
+	return status;
+}
+
 EXTERN_C_END
@@ -47,5 +47,16 @@ EVT_DMF_IoctlHandler_Callback Bus_Ds4SubmitReportHandler;
 EVT_DMF_IoctlHandler_Callback Bus_Ds4RequestNotificationHandler;
 EVT_DMF_IoctlHandler_Callback Bus_XusbGetUserIndexHandler;
 EVT_DMF_IoctlHandler_Callback Bus_Ds4AwaitOutputHandler;
+EVT_DMF_IoctlHandler_Callback Bus_GetTargetSnapshotHandler;
+EVT_DMF_IoctlHandler_Callback Bus_SubmitReportBatchHandler;
+EVT_DMF_IoctlHandler_Callback Bus_SetMirrorGroupHandler;
+EVT_DMF_IoctlHandler_Callback Bus_SetMergePolicyHandler;
+EVT_DMF_IoctlHandler_Callback Bus_SubmitLayerHandler;
+EVT_DMF_IoctlHandler_Callback Bus_ScheduleReportsHandler;
+EVT_DMF_IoctlHandler_Callback Bus_SetInterpolationHandler;
+EVT_DMF_IoctlHandler_Callback Bus_SubmitImuSamplesHandler;
+EVT_DMF_IoctlHandler_Callback Bus_SetOrderedDeliveryHandler;
+EVT_DMF_IoctlHandler_Callback Bus_GetDeliveryCountersHandler;
+EVT_DMF_IoctlHandler_Callback Bus_GetMemoryFootprintHandler;
 
 EXTERN_C_END
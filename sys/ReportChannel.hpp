@@ -0,0 +1,186 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <string.h>
+
+namespace ViGEm::Bus::Core
+{
+	namespace ReportChannelDetail
+	{
+		//
+		// Orders the sequence accesses against the payload copy. Writers need
+		// the odd sequence visible before the payload and readers the payload
+		// read before the sequence is checked again, acquire/release covers
+		// both: a compiler barrier on x86/x64, a barrier instruction on ARM.
+		// 
+		inline void Fence()
+		{
+#if defined(_MSC_VER)
+			_ReadWriteBarrier();
+#if defined(_M_ARM64) || defined(_M_ARM)
+			__dmb(_ARM64_BARRIER_ISH);
+#endif
+#else
+			__atomic_thread_fence(__ATOMIC_ACQ_REL);
+#endif
+		}
+	}
+
+	//
+	// Sequence lock publishing one trivially copyable report from a writer to any
+	// number of readers. Readers never block the writer and retry until they got
+	// a copy no write overlapped with, so they never see a torn report.
+	// 
+	// Writers must be serialized by the caller. Zero-initialized storage is a
+	// valid channel holding a zeroed report.
+	// 
+	template <typename T>
+	class ReportChannel
+	{
+	public:
+		void Write(const T& Report)
+		{
+			_Sequence = _Sequence + 1;
+			ReportChannelDetail::Fence();
+
+			Copy(_Report, Report);
+
+			ReportChannelDetail::Fence();
+			_Sequence = _Sequence + 1;
+		}
+
+		//
+		// Returns the sequence the copy belongs to
+		// 
+		unsigned int Read(T& Report) const
+		{
+			for (;;)
+			{
+				const unsigned int sequence = _Sequence;
+
+				if (sequence & 1)
+					continue;
+
+				ReportChannelDetail::Fence();
+
+				Copy(Report, _Report);
+
+				ReportChannelDetail::Fence();
+
+				if (_Sequence == sequence)
+					return sequence;
+			}
+		}
+
+		//
+		// Changes with every completed write
+		// 
+		unsigned int Sequence() const
+		{
+			return _Sequence & ~1u;
+		}
+
+	private:
+		typedef unsigned long long Word;
+
+		//
+		// Copy through volatile so the compiler can't fuse or elide it around the
+		// fences. Reports of whole words move a word at a time, the non-volatile
+		// side goes through memcpy as it carries no alignment guarantee.
+		// 
+		static void Copy(volatile T& Destination, const T& Source)
+		{
+			if constexpr (sizeof(T) % sizeof(Word) == 0)
+			{
+				auto dst = reinterpret_cast<volatile Word*>(&Destination);
+				auto src = reinterpret_cast<const unsigned char*>(&Source);
+
+				for (unsigned int i = 0; i < sizeof(T) / sizeof(Word); i++)
+				{
+					Word word;
+
+					memcpy(&word, src + i * sizeof(Word), sizeof(Word));
+					dst[i] = word;
+				}
+			}
+			else
+			{
+				auto dst = reinterpret_cast<volatile unsigned char*>(&Destination);
+				auto src = reinterpret_cast<const unsigned char*>(&Source);
+
+				for (unsigned int i = 0; i < sizeof(T); i++)
+					dst[i] = src[i];
+			}
+		}
+
+		static void Copy(T& Destination, const volatile T& Source)
+		{
+			if constexpr (sizeof(T) % sizeof(Word) == 0)
+			{
+				auto dst = reinterpret_cast<unsigned char*>(&Destination);
+				auto src = reinterpret_cast<const volatile Word*>(&Source);
+
+				for (unsigned int i = 0; i < sizeof(T) / sizeof(Word); i++)
+				{
+					const Word word = src[i];
+
+					memcpy(dst + i * sizeof(Word), &word, sizeof(Word));
+				}
+			}
+			else
+			{
+				auto dst = reinterpret_cast<unsigned char*>(&Destination);
+				auto src = reinterpret_cast<const volatile unsigned char*>(&Source);
+
+				for (unsigned int i = 0; i < sizeof(T); i++)
+					dst[i] = src[i];
+			}
+		}
+
+		volatile unsigned int _Sequence;
+
+		alignas(Word) volatile T _Report;
+	};
+}
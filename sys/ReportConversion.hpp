@@ -0,0 +1,249 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core::ReportConversion
+{
+	//
+	// XUSB_BUTTON values (see ViGEm/Common.h)
+	// 
+	constexpr unsigned short XusbDpadUp = 0x0001;
+	constexpr unsigned short XusbDpadDown = 0x0002;
+	constexpr unsigned short XusbDpadLeft = 0x0004;
+	constexpr unsigned short XusbDpadRight = 0x0008;
+	constexpr unsigned short XusbStart = 0x0010;
+	constexpr unsigned short XusbBack = 0x0020;
+	constexpr unsigned short XusbLeftThumb = 0x0040;
+	constexpr unsigned short XusbRightThumb = 0x0080;
+	constexpr unsigned short XusbLeftShoulder = 0x0100;
+	constexpr unsigned short XusbRightShoulder = 0x0200;
+	constexpr unsigned short XusbGuide = 0x0400;
+	constexpr unsigned short XusbA = 0x1000;
+	constexpr unsigned short XusbB = 0x2000;
+	constexpr unsigned short XusbX = 0x4000;
+	constexpr unsigned short XusbY = 0x8000;
+
+	//
+	// DS4_BUTTONS and DS4_SPECIAL_BUTTONS values (see ViGEm/Common.h)
+	// 
+	constexpr unsigned short Ds4Square = 1 << 4;
+	constexpr unsigned short Ds4Cross = 1 << 5;
+	constexpr unsigned short Ds4Circle = 1 << 6;
+	constexpr unsigned short Ds4Triangle = 1 << 7;
+	constexpr unsigned short Ds4ShoulderLeft = 1 << 8;
+	constexpr unsigned short Ds4ShoulderRight = 1 << 9;
+	constexpr unsigned short Ds4TriggerLeft = 1 << 10;
+	constexpr unsigned short Ds4TriggerRight = 1 << 11;
+	constexpr unsigned short Ds4Share = 1 << 12;
+	constexpr unsigned short Ds4Options = 1 << 13;
+	constexpr unsigned short Ds4ThumbLeft = 1 << 14;
+	constexpr unsigned short Ds4ThumbRight = 1 << 15;
+	constexpr unsigned char Ds4SpecialPs = 1 << 0;
+
+	//
+	// DS4 D-Pad lives in the low nibble of wButtons as a hat switch
+	// 
+	constexpr unsigned short Ds4DpadMask = 0x000F;
+	constexpr unsigned char Ds4DpadNone = 0x8;
+
+	//
+	// Button pairs translated one to one
+	// 
+	struct ButtonPair
+	{
+		unsigned short Xusb;
+
+		unsigned short Ds4;
+	};
+
+	constexpr ButtonPair ButtonMap[] =
+	{
+		{XusbA, Ds4Cross},
+		{XusbB, Ds4Circle},
+		{XusbX, Ds4Square},
+		{XusbY, Ds4Triangle},
+		{XusbLeftShoulder, Ds4ShoulderLeft},
+		{XusbRightShoulder, Ds4ShoulderRight},
+		{XusbBack, Ds4Share},
+		{XusbStart, Ds4Options},
+		{XusbLeftThumb, Ds4ThumbLeft},
+		{XusbRightThumb, Ds4ThumbRight},
+	};
+
+	//
+	// XUSB D-Pad bits to DS4 hat direction, opposing directions cancel out
+	// 
+	constexpr unsigned char XusbDpadToHat(unsigned short Buttons)
+	{
+		const int up = (Buttons & XusbDpadUp) ? 1 : 0;
+		const int down = (Buttons & XusbDpadDown) ? 1 : 0;
+		const int left = (Buttons & XusbDpadLeft) ? 1 : 0;
+		const int right = (Buttons & XusbDpadRight) ? 1 : 0;
+
+		const int vertical = down - up;		// -1 north, +1 south
+		const int horizontal = right - left;	// -1 west, +1 east
+
+		//
+		// Indexed by [vertical + 1][horizontal + 1]
+		// 
+		constexpr unsigned char hat[3][3] =
+		{
+			{0x7, 0x0, 0x1},
+			{0x6, Ds4DpadNone, 0x2},
+			{0x5, 0x4, 0x3},
+		};
+
+		return hat[vertical + 1][horizontal + 1];
+	}
+
+	//
+	// DS4 hat direction to XUSB D-Pad bits, out of range values map to neutral
+	// 
+	constexpr unsigned short HatToXusbDpad(unsigned char Hat)
+	{
+		constexpr unsigned short bits[8] =
+		{
+			XusbDpadUp,
+			XusbDpadUp | XusbDpadRight,
+			XusbDpadRight,
+			XusbDpadDown | XusbDpadRight,
+			XusbDpadDown,
+			XusbDpadDown | XusbDpadLeft,
+			XusbDpadLeft,
+			XusbDpadUp | XusbDpadLeft,
+		};
+
+		return (Hat < 8) ? bits[Hat] : 0;
+	}
+
+	//
+	// XUSB axes are signed 16-bit with positive Y pointing up, DS4 axes are
+	// unsigned 8-bit centered at 0x80 with Y growing downwards
+	// 
+	constexpr unsigned char AxisToDs4(short Value)
+	{
+		return static_cast<unsigned char>((static_cast<int>(Value) + 32768) >> 8);
+	}
+
+	//
+	// Negation saturating at 32767, keeps XUSB zero on the DS4 center
+	// 
+	constexpr short NegateAxis(short Value)
+	{
+		return (Value == -32768) ? static_cast<short>(32767) : static_cast<short>(-Value);
+	}
+
+	constexpr unsigned char AxisToDs4Inverted(short Value)
+	{
+		return AxisToDs4(NegateAxis(Value));
+	}
+
+	//
+	// Maps the center 0x80 to 0 and scales each half to its full range; every
+	// result stays within the input's AxisToDs4 bucket, so it round-trips exactly
+	// 
+	constexpr short AxisToXusb(unsigned char Value)
+	{
+		const int offset = static_cast<int>(Value) - 0x80;
+
+		return static_cast<short>((offset < 0) ? offset * 256 : offset * 32767 / 127);
+	}
+
+	constexpr short AxisToXusbInverted(unsigned char Value)
+	{
+		return NegateAxis(AxisToXusb(Value));
+	}
+
+	//
+	// Converts an XUSB_REPORT into a DS4_REPORT (or any layout sharing its member names)
+	// 
+	template <typename TXusbReport, typename TDs4Report>
+	constexpr void XusbToDs4(const TXusbReport& In, TDs4Report& Out)
+	{
+		unsigned short buttons = XusbDpadToHat(In.wButtons);
+
+		for (const auto& pair : ButtonMap)
+		{
+			if (In.wButtons & pair.Xusb)
+				buttons |= pair.Ds4;
+		}
+
+		if (In.bLeftTrigger)
+			buttons |= Ds4TriggerLeft;
+		if (In.bRightTrigger)
+			buttons |= Ds4TriggerRight;
+
+		Out.wButtons = buttons;
+		Out.bSpecial = (In.wButtons & XusbGuide) ? Ds4SpecialPs : 0;
+		Out.bTriggerL = In.bLeftTrigger;
+		Out.bTriggerR = In.bRightTrigger;
+		Out.bThumbLX = AxisToDs4(In.sThumbLX);
+		Out.bThumbLY = AxisToDs4Inverted(In.sThumbLY);
+		Out.bThumbRX = AxisToDs4(In.sThumbRX);
+		Out.bThumbRY = AxisToDs4Inverted(In.sThumbRY);
+	}
+
+	//
+	// Converts a DS4_REPORT into an XUSB_REPORT. Touchpad click has no XUSB
+	// equivalent and gets dropped, digital trigger bits follow the analog values.
+	// 
+	template <typename TDs4Report, typename TXusbReport>
+	constexpr void Ds4ToXusb(const TDs4Report& In, TXusbReport& Out)
+	{
+		unsigned short buttons = HatToXusbDpad(static_cast<unsigned char>(In.wButtons & Ds4DpadMask));
+
+		for (const auto& pair : ButtonMap)
+		{
+			if (In.wButtons & pair.Ds4)
+				buttons |= pair.Xusb;
+		}
+
+		if (In.bSpecial & Ds4SpecialPs)
+			buttons |= XusbGuide;
+
+		Out.wButtons = buttons;
+		Out.bLeftTrigger = In.bTriggerL;
+		Out.bRightTrigger = In.bTriggerR;
+		Out.sThumbLX = AxisToXusb(In.bThumbLX);
+		Out.sThumbLY = AxisToXusbInverted(In.bThumbLY);
+		Out.sThumbRX = AxisToXusb(In.bThumbRX);
+		Out.sThumbRY = AxisToXusbInverted(In.bThumbRY);
+	}
+}
@@ -0,0 +1,129 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Fixed-capacity FIFO of trivially copyable elements. Pushing into a full
+	// ring fails instead of overwriting, so consumers never see gaps.
+	// Zero-initialized storage is a valid, empty ring. Callers serialize access.
+	// 
+	template <typename T, unsigned int Capacity>
+	class SampleRing
+	{
+		static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+		bool Push(const T& Element)
+		{
+			if (IsFull())
+				return false;
+
+			_Elements[_Tail++ & (Capacity - 1)] = Element;
+
+			return true;
+		}
+
+		bool Pop(T& Element)
+		{
+			if (IsEmpty())
+				return false;
+
+			Element = _Elements[_Head++ & (Capacity - 1)];
+
+			return true;
+		}
+
+		//
+		// Most recently pushed element, nullptr if empty
+		// 
+		T* Back()
+		{
+			return IsEmpty() ? nullptr : &_Elements[(_Tail - 1) & (Capacity - 1)];
+		}
+
+		//
+		// Discards the oldest element
+		// 
+		bool DropFront()
+		{
+			if (IsEmpty())
+				return false;
+
+			_Head++;
+
+			return true;
+		}
+
+		void Clear()
+		{
+			_Head = _Tail;
+		}
+
+		unsigned int Count() const
+		{
+			// Unsigned wrap-around keeps this correct after the indices overflow
+			return _Tail - _Head;
+		}
+
+		unsigned int Free() const
+		{
+			return Capacity - Count();
+		}
+
+		bool IsEmpty() const
+		{
+			return _Tail == _Head;
+		}
+
+		bool IsFull() const
+		{
+			return Count() == Capacity;
+		}
+
+	private:
+		T _Elements[Capacity];
+
+		unsigned int _Head;
+
+		unsigned int _Tail;
+	};
+}
@@ -0,0 +1,348 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#include <ViGEm/km/UsbDescriptors.hpp>
+#include <ViGEm/km/Ds4ReportSchema.hpp>
+
+namespace ViGEm::Bus::Targets::XusbDescriptors
+{
+	using namespace Core::UsbDescriptors;
+
+	//
+	// Vendor and product ID get patched per target
+	// 
+	inline constexpr auto Device = Core::UsbDescriptors::Device(
+		0x0200, // USB v2.0
+		0xFF, 0xFF, 0xFF,
+		0x08,
+		0x045E, 0x028E,
+		0x0114,
+		0x01, 0x02, 0x03,
+		0x01
+	);
+
+	inline constexpr auto Configuration = Core::UsbDescriptors::Configuration(
+		0x04,        // bNumInterfaces 4
+		0x01,        // bConfigurationValue
+		0xA0,        // bmAttributes Remote Wakeup
+		0xFA,        // bMaxPower 500mA
+
+		Interface(0x00, 0x00, 0x02, 0xFF, 0x5D, 0x01, 0x00)
+		+ Raw(
+			0x11,        // bLength
+			0x21,        // bDescriptorType (HID)
+			0x00, 0x01,  // bcdHID 1.00
+			0x01,        // bCountryCode
+			0x25,        // bNumDescriptors
+			0x81,        // bDescriptorType[0] (Unknown 0x81)
+			0x14, 0x00,  // wDescriptorLength[0] 20
+			0x00,        // bDescriptorType[1] (Unknown 0x00)
+			0x00, 0x00,  // wDescriptorLength[1] 0
+			0x13,        // bDescriptorType[2] (Unknown 0x13)
+			0x01, 0x08,  // wDescriptorLength[2] 2049
+			0x00,        // bDescriptorType[3] (Unknown 0x00)
+			0x00
+		)
+		+ Endpoint(0x81, 0x03, 0x0020, 0x04)
+		+ Endpoint(0x01, 0x03, 0x0020, 0x08)
+
+		+ Interface(0x01, 0x00, 0x04, 0xFF, 0x5D, 0x03, 0x00)
+		+ Raw(
+			0x1B,        // bLength
+			0x21,        // bDescriptorType (HID)
+			0x00, 0x01,  // bcdHID 1.00
+			0x01,        // bCountryCode
+			0x01,        // bNumDescriptors
+			0x82,        // bDescriptorType[0] (Unknown 0x82)
+			0x40, 0x01,  // wDescriptorLength[0] 320
+			0x02, 0x20, 0x16, 0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+		)
+		+ Endpoint(0x82, 0x03, 0x0020, 0x02)
+		+ Endpoint(0x02, 0x03, 0x0020, 0x04)
+		+ Endpoint(0x83, 0x03, 0x0020, 0x40)
+		+ Endpoint(0x03, 0x03, 0x0020, 0x10)
+
+		+ Interface(0x02, 0x00, 0x01, 0xFF, 0x5D, 0x02, 0x00)
+		+ Raw(
+			0x09,        // bLength
+			0x21,        // bDescriptorType (HID)
+			0x00, 0x01,  // bcdHID 1.00
+			0x01,        // bCountryCode
+			0x22,        // bNumDescriptors
+			0x84,        // bDescriptorType[0] (Unknown 0x84)
+			0x07, 0x00   // wDescriptorLength[0] 7
+		)
+		+ Endpoint(0x84, 0x03, 0x0020, 0x10)
+
+		+ Interface(0x03, 0x00, 0x00, 0xFF, 0xFD, 0x13, 0x04)
+		+ Raw(
+			0x06,        // bLength
+			0x41,        // bDescriptorType (Unknown)
+			0x00, 0x01, 0x01, 0x03
+		)
+	);
+}
+
+namespace ViGEm::Bus::Targets::Ds4Descriptors
+{
+	using namespace Core::UsbDescriptors;
+
+	//
+	// Output and feature reports, following the input report generated from Ds4ReportSchema
+	// 
+	inline constexpr unsigned char HidReportFeatures[] =
+	{
+		0x85, 0x05,        //   Report ID (5)
+		0x09, 0x22,        //   Usage (0x22)
+		0x95, 0x1F,        //   Report Count (31)
+		0x91, 0x02,        //   Output (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x04,        //   Report ID (4)
+		0x09, 0x23,        //   Usage (0x23)
+		0x95, 0x24,        //   Report Count (36)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x02,        //   Report ID (2)
+		0x09, 0x24,        //   Usage (0x24)
+		0x95, 0x24,        //   Report Count (36)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x08,        //   Report ID (8)
+		0x09, 0x25,        //   Usage (0x25)
+		0x95, 0x03,        //   Report Count (3)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x10,        //   Report ID (16)
+		0x09, 0x26,        //   Usage (0x26)
+		0x95, 0x04,        //   Report Count (4)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x11,        //   Report ID (17)
+		0x09, 0x27,        //   Usage (0x27)
+		0x95, 0x02,        //   Report Count (2)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x12,        //   Report ID (18)
+		0x06, 0x02, 0xFF,  //   Usage Page (Vendor Defined 0xFF02)
+		0x09, 0x21,        //   Usage (0x21)
+		0x95, 0x0F,        //   Report Count (15)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x13,        //   Report ID (19)
+		0x09, 0x22,        //   Usage (0x22)
+		0x95, 0x16,        //   Report Count (22)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x14,        //   Report ID (20)
+		0x06, 0x05, 0xFF,  //   Usage Page (Vendor Defined 0xFF05)
+		0x09, 0x20,        //   Usage (0x20)
+		0x95, 0x10,        //   Report Count (16)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x15,        //   Report ID (21)
+		0x09, 0x21,        //   Usage (0x21)
+		0x95, 0x2C,        //   Report Count (44)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x06, 0x80, 0xFF,  //   Usage Page (Vendor Defined 0xFF80)
+		0x85, 0x80,        //   Report ID (128)
+		0x09, 0x20,        //   Usage (0x20)
+		0x95, 0x06,        //   Report Count (6)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x81,        //   Report ID (129)
+		0x09, 0x21,        //   Usage (0x21)
+		0x95, 0x06,        //   Report Count (6)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x82,        //   Report ID (130)
+		0x09, 0x22,        //   Usage (0x22)
+		0x95, 0x05,        //   Report Count (5)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x83,        //   Report ID (131)
+		0x09, 0x23,        //   Usage (0x23)
+		0x95, 0x01,        //   Report Count (1)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x84,        //   Report ID (132)
+		0x09, 0x24,        //   Usage (0x24)
+		0x95, 0x04,        //   Report Count (4)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x85,        //   Report ID (133)
+		0x09, 0x25,        //   Usage (0x25)
+		0x95, 0x06,        //   Report Count (6)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x86,        //   Report ID (134)
+		0x09, 0x26,        //   Usage (0x26)
+		0x95, 0x06,        //   Report Count (6)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x87,        //   Report ID (135)
+		0x09, 0x27,        //   Usage (0x27)
+		0x95, 0x23,        //   Report Count (35)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x88,        //   Report ID (136)
+		0x09, 0x28,        //   Usage (0x28)
+		0x95, 0x22,        //   Report Count (34)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x89,        //   Report ID (137)
+		0x09, 0x29,        //   Usage (0x29)
+		0x95, 0x02,        //   Report Count (2)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x90,        //   Report ID (144)
+		0x09, 0x30,        //   Usage (0x30)
+		0x95, 0x05,        //   Report Count (5)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x91,        //   Report ID (145)
+		0x09, 0x31,        //   Usage (0x31)
+		0x95, 0x03,        //   Report Count (3)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x92,        //   Report ID (146)
+		0x09, 0x32,        //   Usage (0x32)
+		0x95, 0x03,        //   Report Count (3)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0x93,        //   Report ID (147)
+		0x09, 0x33,        //   Usage (0x33)
+		0x95, 0x0C,        //   Report Count (12)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA0,        //   Report ID (160)
+		0x09, 0x40,        //   Usage (0x40)
+		0x95, 0x06,        //   Report Count (6)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA1,        //   Report ID (161)
+		0x09, 0x41,        //   Usage (0x41)
+		0x95, 0x01,        //   Report Count (1)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA2,        //   Report ID (162)
+		0x09, 0x42,        //   Usage (0x42)
+		0x95, 0x01,        //   Report Count (1)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA3,        //   Report ID (163)
+		0x09, 0x43,        //   Usage (0x43)
+		0x95, 0x30,        //   Report Count (48)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA4,        //   Report ID (164)
+		0x09, 0x44,        //   Usage (0x44)
+		0x95, 0x0D,        //   Report Count (13)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA5,        //   Report ID (165)
+		0x09, 0x45,        //   Usage (0x45)
+		0x95, 0x15,        //   Report Count (21)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA6,        //   Report ID (166)
+		0x09, 0x46,        //   Usage (0x46)
+		0x95, 0x15,        //   Report Count (21)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xF0,        //   Report ID (240)
+		0x09, 0x47,        //   Usage (0x47)
+		0x95, 0x3F,        //   Report Count (63)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xF1,        //   Report ID (241)
+		0x09, 0x48,        //   Usage (0x48)
+		0x95, 0x3F,        //   Report Count (63)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xF2,        //   Report ID (242)
+		0x09, 0x49,        //   Usage (0x49)
+		0x95, 0x0F,        //   Report Count (15)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA7,        //   Report ID (167)
+		0x09, 0x4A,        //   Usage (0x4A)
+		0x95, 0x01,        //   Report Count (1)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA8,        //   Report ID (168)
+		0x09, 0x4B,        //   Usage (0x4B)
+		0x95, 0x01,        //   Report Count (1)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xA9,        //   Report ID (169)
+		0x09, 0x4C,        //   Usage (0x4C)
+		0x95, 0x08,        //   Report Count (8)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xAA,        //   Report ID (170)
+		0x09, 0x4E,        //   Usage (0x4E)
+		0x95, 0x01,        //   Report Count (1)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xAB,        //   Report ID (171)
+		0x09, 0x4F,        //   Usage (0x4F)
+		0x95, 0x39,        //   Report Count (57)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xAC,        //   Report ID (172)
+		0x09, 0x50,        //   Usage (0x50)
+		0x95, 0x39,        //   Report Count (57)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xAD,        //   Report ID (173)
+		0x09, 0x51,        //   Usage (0x51)
+		0x95, 0x0B,        //   Report Count (11)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xAE,        //   Report ID (174)
+		0x09, 0x52,        //   Usage (0x52)
+		0x95, 0x01,        //   Report Count (1)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xAF,        //   Report ID (175)
+		0x09, 0x53,        //   Usage (0x53)
+		0x95, 0x02,        //   Report Count (2)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0x85, 0xB0,        //   Report ID (176)
+		0x09, 0x54,        //   Usage (0x54)
+		0x95, 0x3F,        //   Report Count (63)
+		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+		0xC0,              // End Collection
+	};
+
+	inline constexpr auto HidReport = Core::Ds4ReportSchema::InputDescriptor() + Array(HidReportFeatures);
+
+	//
+	// Vendor and product ID get patched per target
+	// 
+	inline constexpr auto Device = Core::UsbDescriptors::Device(
+		0x0200, // USB v2.0
+		0x00, 0x00, 0x00, // per Interface
+		0x40,
+		0x054C, 0x05C4,
+		0x0100,
+		0x01, 0x02, 0x00,
+		0x01
+	);
+
+	inline constexpr auto Configuration = Core::UsbDescriptors::Configuration(
+		0x01,        // bNumInterfaces 1
+		0x01,        // bConfigurationValue
+		0xC0,        // bmAttributes Self Powered
+		0xFA,        // bMaxPower 500mA
+
+		Interface(0x00, 0x00, 0x02, 0x03, 0x00, 0x00, 0x00)
+		+ Hid(0x0111, 0x00, 0x22, HidReport.Size)
+		+ Endpoint(0x84, 0x03, 0x0040, 0x05)
+		+ Endpoint(0x03, 0x03, 0x0040, 0x05)
+	);
+
+	// "American English"
+	inline constexpr auto Languages = Core::UsbDescriptors::Languages(0x0409);
+
+	inline constexpr auto Manufacturer = String(u"Sony Computer Entertainment");
+
+	inline constexpr auto Product = String(u"Wireless Controller");
+}
@@ -0,0 +1,183 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "Driver.h"
+#include "trace.h"
+#include "TargetIndex.tmh"
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text (PAGE, Bus_TargetIndexInitialize)
+#endif
+
+
+EXTERN_C_START
+
+//
+// Serials are handed out in ascending order, so consecutive targets land in
+// different stripes
+// 
+static PBUS_TARGET_INDEX_STRIPE Bus_TargetIndexStripe(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG SerialNo
+)
+{
+	return &FdoGetData(Device)->TargetIndex[SerialNo % BUS_TARGET_INDEX_STRIPES];
+}
+
+//
+// Allocates the striped lookup table, freed along with the bus device.
+// 
+_Use_decl_annotations_
+NTSTATUS
+Bus_TargetIndexInitialize(
+	WDFDEVICE Device
+)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDFMEMORY memory;
+	PVOID buffer;
+	PFDO_DEVICE_DATA pFdoData = FdoGetData(Device);
+
+	PAGED_CODE();
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = Device;
+
+	if (!NT_SUCCESS(status = WdfMemoryCreate(
+		&attributes,
+		NonPagedPoolNxCacheAligned,
+		BUS_TARGET_INDEX_POOL_TAG,
+		BUS_TARGET_INDEX_STRIPES * sizeof(BUS_TARGET_INDEX_STRIPE),
+		&memory,
+		&buffer
+	)))
+	{
+		TraceError(
+			TRACE_UTIL,
+			"WdfMemoryCreate failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	RtlZeroMemory(buffer, BUS_TARGET_INDEX_STRIPES * sizeof(BUS_TARGET_INDEX_STRIPE));
+
+	pFdoData->TargetIndex = static_cast<PBUS_TARGET_INDEX_STRIPE>(buffer);
+
+	for (ULONG i = 0; i < BUS_TARGET_INDEX_STRIPES; i++)
+	{
+		KeInitializeSpinLock(&pFdoData->TargetIndex[i].Lock);
+	}
+
+	return status;
+}
+
+//
+// Registers a created target. Returns FALSE if its stripe is full; the
+// target is then only reachable through the child list.
+// 
+_Use_decl_annotations_
+BOOLEAN
+Bus_TargetIndexInsert(
+	WDFDEVICE Device,
+	ULONG SerialNo,
+	ViGEm::Bus::Core::EmulationTargetPDO* Target
+)
+{
+	KIRQL irql;
+	const PBUS_TARGET_INDEX_STRIPE pStripe = Bus_TargetIndexStripe(Device, SerialNo);
+
+	KeAcquireSpinLock(&pStripe->Lock, &irql);
+
+	const bool indexed = pStripe->Slots.Insert(SerialNo, Target);
+
+	KeReleaseSpinLock(&pStripe->Lock, irql);
+
+	TraceVerbose(
+		TRACE_UTIL,
+		"Target with serial %d indexed: %d",
+		SerialNo,
+		indexed);
+
+	return indexed ? TRUE : FALSE;
+}
+
+//
+// Unregisters a target, Indexed is the result of its Bus_TargetIndexInsert call.
+// 
+_Use_decl_annotations_
+VOID
+Bus_TargetIndexRemove(
+	WDFDEVICE Device,
+	ULONG SerialNo,
+	ViGEm::Bus::Core::EmulationTargetPDO* Target,
+	BOOLEAN Indexed
+)
+{
+	KIRQL irql;
+	const PBUS_TARGET_INDEX_STRIPE pStripe = Bus_TargetIndexStripe(Device, SerialNo);
+
+	KeAcquireSpinLock(&pStripe->Lock, &irql);
+
+	pStripe->Slots.Remove(Target, Indexed != FALSE);
+
+	KeReleaseSpinLock(&pStripe->Lock, irql);
+}
+
+//
+// Returns TRUE if the index holds the answer, with Target set to nullptr for
+// an unknown serial. FALSE means the caller has to consult the child list.
+// 
+_Use_decl_annotations_
+BOOLEAN
+Bus_TargetIndexLookup(
+	WDFDEVICE Device,
+	ULONG SerialNo,
+	ViGEm::Bus::Core::EmulationTargetPDO** Target
+)
+{
+	KIRQL irql;
+	const PBUS_TARGET_INDEX_STRIPE pStripe = Bus_TargetIndexStripe(Device, SerialNo);
+
+	KeAcquireSpinLock(&pStripe->Lock, &irql);
+
+	const bool authoritative = pStripe->Slots.Lookup(SerialNo, *Target);
+
+	KeReleaseSpinLock(&pStripe->Lock, irql);
+
+	return authoritative ? TRUE : FALSE;
+}
+
+EXTERN_C_END
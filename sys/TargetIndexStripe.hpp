@@ -0,0 +1,137 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Slots of one stripe of the serial number to target lookup table. Not
+	// synchronized, the owner pairs every stripe with its own lock.
+	// 
+	template <typename TTarget, unsigned int Slots>
+	struct TargetIndexStripe
+	{
+		//
+		// Live targets which didn't fit into a slot, lookups in this stripe
+		// aren't authoritative while non-zero
+		// 
+		unsigned int Overflow;
+
+		unsigned int SerialNo[Slots];
+
+		TTarget* Target[Slots];
+
+		//
+		// Returns false if the stripe is full, the target then counts as overflow
+		// 
+		bool Insert(unsigned int Serial, TTarget* Entry)
+		{
+			unsigned int slot = Slots;
+
+			for (unsigned int i = 0; i < Slots; i++)
+			{
+				//
+				// A re-plugged serial replaces the instance still awaiting removal
+				// 
+				if (Target[i] != nullptr && SerialNo[i] == Serial)
+				{
+					slot = i;
+					break;
+				}
+
+				if (Target[i] == nullptr && slot == Slots)
+					slot = i;
+			}
+
+			if (slot == Slots)
+			{
+				Overflow++;
+				return false;
+			}
+
+			SerialNo[slot] = Serial;
+			Target[slot] = Entry;
+
+			return true;
+		}
+
+		//
+		// Indexed is the result of the target's Insert call
+		// 
+		void Remove(TTarget* Entry, bool Indexed)
+		{
+			if (!Indexed)
+			{
+				Overflow--;
+				return;
+			}
+
+			for (unsigned int i = 0; i < Slots; i++)
+			{
+				if (Target[i] == Entry)
+				{
+					Target[i] = nullptr;
+					SerialNo[i] = 0;
+					return;
+				}
+			}
+		}
+
+		//
+		// Returns true if the stripe holds the answer, with Entry set to nullptr
+		// for an unknown serial
+		// 
+		bool Lookup(unsigned int Serial, TTarget*& Entry) const
+		{
+			Entry = nullptr;
+
+			for (unsigned int i = 0; i < Slots; i++)
+			{
+				if (Target[i] != nullptr && SerialNo[i] == Serial)
+				{
+					Entry = Target[i];
+					return true;
+				}
+			}
+
+			return (Overflow == 0);
+		}
+	};
+}
@@ -0,0 +1,165 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Intrusive timer wheel link, embedded in the object carrying the deadline
+	// 
+	struct TimerWheelEntry
+	{
+		TimerWheelEntry* Next;
+
+		TimerWheelEntry* Prev;
+
+		//
+		// Absolute expiry tick
+		// 
+		unsigned long long Deadline;
+	};
+
+	//
+	// Hashed timing wheel with one slot per tick. Deadlines further away than
+	// one revolution stay in their slot until a later pass finds them due.
+	// 
+	// Insert and Remove are O(1), Advance visits at most SlotCount slots.
+	// Zero-initialized storage is a valid, empty wheel. Callers serialize access.
+	// 
+	template <unsigned int SlotCount>
+	class TimerWheel
+	{
+		static_assert(SlotCount != 0 && (SlotCount & (SlotCount - 1)) == 0, "SlotCount must be a power of two");
+
+		static constexpr unsigned long long SlotMask = SlotCount - 1;
+
+	public:
+		void Insert(TimerWheelEntry* Entry, unsigned long long Deadline)
+		{
+			//
+			// Already due, expire on the next advance
+			// 
+			if (Deadline <= _CurrentTick)
+				Deadline = _CurrentTick + 1;
+
+			TimerWheelEntry*& head = _Slots[Deadline & SlotMask];
+
+			Entry->Deadline = Deadline;
+			Entry->Prev = nullptr;
+			Entry->Next = head;
+
+			if (head)
+				head->Prev = Entry;
+
+			head = Entry;
+			_Count++;
+		}
+
+		void Remove(TimerWheelEntry* Entry)
+		{
+			if (Entry->Prev)
+				Entry->Prev->Next = Entry->Next;
+			else
+				_Slots[Entry->Deadline & SlotMask] = Entry->Next;
+
+			if (Entry->Next)
+				Entry->Next->Prev = Entry->Prev;
+
+			Entry->Next = nullptr;
+			Entry->Prev = nullptr;
+			_Count--;
+		}
+
+		//
+		// Moves the wheel to Now and unlinks every entry due at or before it.
+		// Returns the expired entries chained through their Next member.
+		// 
+		TimerWheelEntry* Advance(unsigned long long Now)
+		{
+			TimerWheelEntry* expired = nullptr;
+
+			if (Now <= _CurrentTick)
+				return nullptr;
+
+			const unsigned long long span = Now - _CurrentTick;
+			const unsigned long long slots = (span < SlotCount) ? span : SlotCount;
+
+			for (unsigned long long i = 1; i <= slots; i++)
+			{
+				TimerWheelEntry* entry = _Slots[(_CurrentTick + i) & SlotMask];
+
+				while (entry)
+				{
+					TimerWheelEntry* next = entry->Next;
+
+					if (entry->Deadline <= Now)
+					{
+						Remove(entry);
+						entry->Next = expired;
+						expired = entry;
+					}
+
+					entry = next;
+				}
+			}
+
+			_CurrentTick = Now;
+
+			return expired;
+		}
+
+		bool IsEmpty() const
+		{
+			return _Count == 0;
+		}
+
+		unsigned long long Count() const
+		{
+			return _Count;
+		}
+
+	private:
+		TimerWheelEntry* _Slots[SlotCount];
+
+		unsigned long long _CurrentTick;
+
+		unsigned long long _Count;
+	};
+}
@@ -0,0 +1,139 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+//
+// Self-contained (no WDK dependencies) so it can be built and exercised outside the driver
+// 
+
+#include <string.h>
+
+namespace ViGEm::Bus::Core
+{
+	//
+	// Packets an XUSB device answers on the data pipe before it reports input.
+	// The stages are the same for every controller and live in read-only data,
+	// a target only keeps its position in the sequence.
+	// 
+	class XusbBootSequence
+	{
+	public:
+		//
+		// A stage is either a 3 byte status packet or the 14 byte input packet
+		// 
+		static constexpr unsigned char StatusLength = 3;
+		static constexpr unsigned char InputLength = 14;
+
+		struct Stage
+		{
+			unsigned char Length;
+
+			unsigned char Bytes[InputLength];
+
+			//
+			// Copies Length bytes. Each branch has a length known at compile time,
+			// so the copy is inlined instead of becoming a call with a runtime size.
+			// 
+			void CopyTo(unsigned char* Buffer) const
+			{
+				if (Length == InputLength)
+					memcpy(Buffer, Bytes, InputLength);
+				else
+					memcpy(Buffer, Bytes, StatusLength);
+			}
+		};
+
+		static constexpr Stage Stages[] =
+		{
+			{ 3, { 0x01, 0x03, 0x0E } },
+			{ 3, { 0x02, 0x03, 0x00 } },
+			{ 3, { 0x03, 0x03, 0x03 } },
+			{ 3, { 0x08, 0x03, 0x00 } },
+			//
+			// Initial input packet
+			// 
+			{ 14, { 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0xE4, 0xF2, 0xB3, 0xF8, 0x49, 0xF3, 0xB0, 0xFC } },
+			{ 3, { 0x01, 0x03, 0x03 } },
+		};
+
+		static constexpr unsigned int StageCount = sizeof(Stages) / sizeof(Stages[0]);
+
+		static constexpr bool HasFixedLengths()
+		{
+			for (const auto& stage : Stages)
+			{
+				if (stage.Length != StatusLength && stage.Length != InputLength)
+					return false;
+			}
+
+			return true;
+		}
+
+		//
+		// Answered once on the control pipe, required for XInputGetCapabilities to work
+		// 
+		static constexpr unsigned char Capabilities[] = { 0x05, 0x03, 0x00 };
+
+		//
+		// Answered to the vendor control transfer asking for 4 bytes
+		// 
+		static constexpr unsigned char XenonMagic[] = { 0x31, 0x3F, 0xCF, 0xDC };
+
+		//
+		// Stage to answer the current request with, advancing the sequence.
+		// Returns nullptr once the sequence is complete. Callers serialize access.
+		// 
+		const Stage* Next()
+		{
+			return IsComplete() ? nullptr : &Stages[_Position++];
+		}
+
+		bool IsComplete() const
+		{
+			return _Position >= StageCount;
+		}
+
+		void Reset()
+		{
+			_Position = 0;
+		}
+
+	private:
+		unsigned int _Position;
+	};
+
+	static_assert(XusbBootSequence::HasFixedLengths(), "Stage::CopyTo only knows status and input packets");
+}
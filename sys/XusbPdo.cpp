@@ -47,11 +47,18 @@
 PCWSTR ViGEm::Bus::Targets::EmulationTargetXUSB::_deviceDescription = L"Virtual Xbox 360 Controller";
 
 ViGEm::Bus::Targets::EmulationTargetXUSB::EmulationTargetXUSB(ULONG Serial, LONG SessionId, USHORT VendorId,
-	USHORT ProductId) : EmulationTargetPDO(
+	USHORT ProductId) : EmulationTarget(
 		Serial, SessionId, VendorId, ProductId)
 {
-	this->_TargetType = Xbox360Wired;
-	this->_UsbConfigurationDescriptionSize = XUSB_DESCRIPTOR_SIZE;
+	//
+	// Submission and output path state live on separate cache lines
+	// 
+	static_assert(FIELD_OFFSET(EmulationTargetXUSB, _Packet) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"per-report state must start on its own cache line");
+	static_assert(FIELD_OFFSET(EmulationTargetXUSB, _Rumble) % SYSTEM_CACHE_ALIGNMENT_SIZE == 0,
+		"output path state must start on its own cache line");
+
+	static_assert(Traits::Configuration.Size == XUSB_DESCRIPTOR_SIZE, "Unexpected configuration descriptor size");
 
 	//
 	// Set PNP Capabilities
@@ -207,71 +214,14 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoPrepareHardware()
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoInitContext()
 {
-	WDF_OBJECT_ATTRIBUTES attributes;
-	PUCHAR blobBuffer;
-
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = this->_PdoDevice;
+	NTSTATUS status;
+	WDF_IO_QUEUE_CONFIG holdingInQueueConfig;
 
 	TraceVerbose(TRACE_XUSB, "Initializing XUSB context...");
 
-	RtlZeroMemory(this->_Rumble, ARRAYSIZE(this->_Rumble));
-
-	// Is later overwritten by actual XInput slot
-	this->_LedNumber = -1;
-
-	RtlZeroMemory(&this->_Packet, sizeof(XUSB_INTERRUPT_IN_PACKET));
-	// Packet size (20 bytes = 0x14)
-	this->_Packet.Size = 0x14;
-
-	this->_ReportedCapabilities = FALSE;
-
-	this->_InterruptInitStage = 0;
-
-	// Allocate blob storage
-	NTSTATUS status = WdfMemoryCreate(
-		&attributes,
-		NonPagedPoolNx,
-		XUSB_POOL_TAG,
-		XUSB_BLOB_STORAGE_SIZE,
-		&this->_InterruptBlobStorage,
-		reinterpret_cast<PVOID*>(&blobBuffer)
-	);
-	if (!NT_SUCCESS(status))
-	{
-		TraceError(
-			TRACE_XUSB,
-			"WdfMemoryCreate failed with status %!STATUS!",
-			status);
-		return status;
-	}
-
-	// Fill blob storage
-	COPY_BYTE_ARRAY(blobBuffer, P99_PROTECT({
-		// 0
-		0x01, 0x03, 0x0E,
-		// 1
-		0x02, 0x03, 0x00,
-		// 2
-		0x03, 0x03, 0x03,
-		// 3
-		0x08, 0x03, 0x00,
-		// 4
-		0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0xe4, 0xf2,
-		0xb3, 0xf8, 0x49, 0xf3, 0xb0, 0xfc, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00,
-		// 5
-		0x01, 0x03, 0x03,
-		// 6
-		0x05, 0x03, 0x00,
-		// 7
-		0x31, 0x3F, 0xCF, 0xDC
-		}));
-
-	// I/O Queue for pending IRPs
-	WDF_IO_QUEUE_CONFIG holdingInQueueConfig;
-
-	// Create and assign queue for unhandled interrupt requests
+	//
+	// Hosts poll the held and idle endpoints from the start, park those here
+	// 
 	WDF_IO_QUEUE_CONFIG_INIT(&holdingInQueueConfig, WdfIoQueueDispatchManual);
 
 	status = WdfIoQueueCreate(
@@ -289,167 +239,22 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoInitContext()
 		return status;
 	}
 
-	return STATUS_SUCCESS;
-}
+	RtlZeroMemory(this->_Rumble, ARRAYSIZE(this->_Rumble));
 
-VOID ViGEm::Bus::Targets::EmulationTargetXUSB::GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length)
-{
-	UCHAR XusbDescriptorData[XUSB_DESCRIPTOR_SIZE] =
-	{
-		0x09,        //   bLength
-		0x02,        //   bDescriptorType (Configuration)
-		0x99, 0x00,  //   wTotalLength 153
-		0x04,        //   bNumInterfaces 4
-		0x01,        //   bConfigurationValue
-		0x00,        //   iConfiguration (String Index)
-		0xA0,        //   bmAttributes Remote Wakeup
-		0xFA,        //   bMaxPower 500mA
-
-		0x09,        //   bLength
-		0x04,        //   bDescriptorType (Interface)
-		0x00,        //   bInterfaceNumber 0
-		0x00,        //   bAlternateSetting
-		0x02,        //   bNumEndpoints 2
-		0xFF,        //   bInterfaceClass
-		0x5D,        //   bInterfaceSubClass
-		0x01,        //   bInterfaceProtocol
-		0x00,        //   iInterface (String Index)
-
-		0x11,        //   bLength
-		0x21,        //   bDescriptorType (HID)
-		0x00, 0x01,  //   bcdHID 1.00
-		0x01,        //   bCountryCode
-		0x25,        //   bNumDescriptors
-		0x81,        //   bDescriptorType[0] (Unknown 0x81)
-		0x14, 0x00,  //   wDescriptorLength[0] 20
-		0x00,        //   bDescriptorType[1] (Unknown 0x00)
-		0x00, 0x00,  //   wDescriptorLength[1] 0
-		0x13,        //   bDescriptorType[2] (Unknown 0x13)
-		0x01, 0x08,  //   wDescriptorLength[2] 2049
-		0x00,        //   bDescriptorType[3] (Unknown 0x00)
-		0x00,
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x81,        //   bEndpointAddress (IN/D2H)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x04,        //   bInterval 4 (unit depends on device speed)
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x01,        //   bEndpointAddress (OUT/H2D)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x08,        //   bInterval 8 (unit depends on device speed)
-
-		0x09,        //   bLength
-		0x04,        //   bDescriptorType (Interface)
-		0x01,        //   bInterfaceNumber 1
-		0x00,        //   bAlternateSetting
-		0x04,        //   bNumEndpoints 4
-		0xFF,        //   bInterfaceClass
-		0x5D,        //   bInterfaceSubClass
-		0x03,        //   bInterfaceProtocol
-		0x00,        //   iInterface (String Index)
-
-		0x1B,        //   bLength
-		0x21,        //   bDescriptorType (HID)
-		0x00, 0x01,  //   bcdHID 1.00
-		0x01,        //   bCountryCode
-		0x01,        //   bNumDescriptors
-		0x82,        //   bDescriptorType[0] (Unknown 0x82)
-		0x40, 0x01,  //   wDescriptorLength[0] 320
-		0x02, 0x20, 0x16, 0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x82,        //   bEndpointAddress (IN/D2H)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x02,        //   bInterval 2 (unit depends on device speed)
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x02,        //   bEndpointAddress (OUT/H2D)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x04,        //   bInterval 4 (unit depends on device speed)
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x83,        //   bEndpointAddress (IN/D2H)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x40,        //   bInterval 64 (unit depends on device speed)
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x03,        //   bEndpointAddress (OUT/H2D)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x10,        //   bInterval 16 (unit depends on device speed)
-
-		0x09,        //   bLength
-		0x04,        //   bDescriptorType (Interface)
-		0x02,        //   bInterfaceNumber 2
-		0x00,        //   bAlternateSetting
-		0x01,        //   bNumEndpoints 1
-		0xFF,        //   bInterfaceClass
-		0x5D,        //   bInterfaceSubClass
-		0x02,        //   bInterfaceProtocol
-		0x00,        //   iInterface (String Index)
-
-		0x09,        //   bLength
-		0x21,        //   bDescriptorType (HID)
-		0x00, 0x01,  //   bcdHID 1.00
-		0x01,        //   bCountryCode
-		0x22,        //   bNumDescriptors
-		0x84,        //   bDescriptorType[0] (Unknown 0x84)
-		0x07, 0x00,  //   wDescriptorLength[0] 7
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x84,        //   bEndpointAddress (IN/D2H)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x10,        //   bInterval 16 (unit depends on device speed)
-
-		0x09,        //   bLength
-		0x04,        //   bDescriptorType (Interface)
-		0x03,        //   bInterfaceNumber 3
-		0x00,        //   bAlternateSetting
-		0x00,        //   bNumEndpoints 0
-		0xFF,        //   bInterfaceClass
-		0xFD,        //   bInterfaceSubClass
-		0x13,        //   bInterfaceProtocol
-		0x04,        //   iInterface (String Index)
-
-		0x06,        //   bLength
-		0x41,        //   bDescriptorType (Unknown)
-		0x00, 0x01, 0x01, 0x03,
-		// 153 bytes
-
-		// best guess: USB Standard Descriptor
-	};
-
-	RtlCopyBytes(Buffer, XusbDescriptorData, Length);
-}
+	// Is later overwritten by actual XInput slot
+	this->_LedNumber = -1;
 
-NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbGetDeviceDescriptorType(PUSB_DEVICE_DESCRIPTOR pDescriptor)
-{
-	pDescriptor->bLength = 0x12;
-	pDescriptor->bDescriptorType = USB_DEVICE_DESCRIPTOR_TYPE;
-	pDescriptor->bcdUSB = 0x0200; // USB v2.0
-	pDescriptor->bDeviceClass = 0xFF;
-	pDescriptor->bDeviceSubClass = 0xFF;
-	pDescriptor->bDeviceProtocol = 0xFF;
-	pDescriptor->bMaxPacketSize0 = 0x08;
-	pDescriptor->idVendor = this->_VendorId;
-	pDescriptor->idProduct = this->_ProductId;
-	pDescriptor->bcdDevice = 0x0114;
-	pDescriptor->iManufacturer = 0x01;
-	pDescriptor->iProduct = 0x02;
-	pDescriptor->iSerialNumber = 0x03;
-	pDescriptor->bNumConfigurations = 0x01;
+	RtlZeroMemory(&this->_Packet, sizeof(XUSB_INTERRUPT_IN_PACKET));
+	// Packet size (20 bytes = 0x14)
+	this->_Packet.Size = 0x14;
+
+	this->_ReportPending = FALSE;
+
+	this->_ReportedCapabilities = FALSE;
+
+	static_assert(Core::XusbBootSequence::Stages[4].Length == sizeof(XUSB_INTERRUPT_IN_PACKET), "Unexpected initial input packet size");
+
+	this->_BootSequence.Reset();
 
 	return STATUS_SUCCESS;
 }
@@ -480,21 +285,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SelectConfiguration(PURB Urb)
 
 	pInfo->InterfaceHandle = (USBD_INTERFACE_HANDLE)0xFFFF0000;
 
-	pInfo->Pipes[0].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[0].MaximumPacketSize = 0x20;
-	pInfo->Pipes[0].EndpointAddress = 0x81;
-	pInfo->Pipes[0].Interval = 0x04;
-	pInfo->Pipes[0].PipeType = (USBD_PIPE_TYPE)0x03;
-	pInfo->Pipes[0].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0081;
-	pInfo->Pipes[0].PipeFlags = 0x00;
-
-	pInfo->Pipes[1].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[1].MaximumPacketSize = 0x20;
-	pInfo->Pipes[1].EndpointAddress = 0x01;
-	pInfo->Pipes[1].Interval = 0x08;
-	pInfo->Pipes[1].PipeType = (USBD_PIPE_TYPE)0x03;
-	pInfo->Pipes[1].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0001;
-	pInfo->Pipes[1].PipeFlags = 0x00;
+	SetInterfacePipes(pInfo, 0);
 
 	pInfo = (PUSBD_INTERFACE_INFORMATION)((PCHAR)pInfo + pInfo->Length);
 
@@ -512,37 +303,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SelectConfiguration(PURB Urb)
 
 	pInfo->InterfaceHandle = (USBD_INTERFACE_HANDLE)0xFFFF0000;
 
-	pInfo->Pipes[0].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[0].MaximumPacketSize = 0x20;
-	pInfo->Pipes[0].EndpointAddress = 0x82;
-	pInfo->Pipes[0].Interval = 0x04;
-	pInfo->Pipes[0].PipeType = (USBD_PIPE_TYPE)0x03;
-	pInfo->Pipes[0].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0082;
-	pInfo->Pipes[0].PipeFlags = 0x00;
-
-	pInfo->Pipes[1].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[1].MaximumPacketSize = 0x20;
-	pInfo->Pipes[1].EndpointAddress = 0x02;
-	pInfo->Pipes[1].Interval = 0x08;
-	pInfo->Pipes[1].PipeType = (USBD_PIPE_TYPE)0x03;
-	pInfo->Pipes[1].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0002;
-	pInfo->Pipes[1].PipeFlags = 0x00;
-
-	pInfo->Pipes[2].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[2].MaximumPacketSize = 0x20;
-	pInfo->Pipes[2].EndpointAddress = 0x83;
-	pInfo->Pipes[2].Interval = 0x08;
-	pInfo->Pipes[2].PipeType = (USBD_PIPE_TYPE)0x03;
-	pInfo->Pipes[2].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0083;
-	pInfo->Pipes[2].PipeFlags = 0x00;
-
-	pInfo->Pipes[3].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[3].MaximumPacketSize = 0x20;
-	pInfo->Pipes[3].EndpointAddress = 0x03;
-	pInfo->Pipes[3].Interval = 0x08;
-	pInfo->Pipes[3].PipeType = (USBD_PIPE_TYPE)0x03;
-	pInfo->Pipes[3].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0003;
-	pInfo->Pipes[3].PipeFlags = 0x00;
+	SetInterfacePipes(pInfo, 1);
 
 	pInfo = (PUSBD_INTERFACE_INFORMATION)((PCHAR)pInfo + pInfo->Length);
 
@@ -560,13 +321,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SelectConfiguration(PURB Urb)
 
 	pInfo->InterfaceHandle = (USBD_INTERFACE_HANDLE)0xFFFF0000;
 
-	pInfo->Pipes[0].MaximumTransferSize = 0x00400000;
-	pInfo->Pipes[0].MaximumPacketSize = 0x20;
-	pInfo->Pipes[0].EndpointAddress = 0x84;
-	pInfo->Pipes[0].Interval = 0x04;
-	pInfo->Pipes[0].PipeType = (USBD_PIPE_TYPE)0x03;
-	pInfo->Pipes[0].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0084;
-	pInfo->Pipes[0].PipeFlags = 0x00;
+	SetInterfacePipes(pInfo, 2);
 
 	pInfo = (PUSBD_INTERFACE_INFORMATION)((PCHAR)pInfo + pInfo->Length);
 
@@ -633,37 +388,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbSelectInterface(PURB Urb)
 
 		pInfo[0].InterfaceHandle = (USBD_INTERFACE_HANDLE)0xFFFF0000;
 
-		pInfo[0].Pipes[0].MaximumTransferSize = 0x00400000;
-		pInfo[0].Pipes[0].MaximumPacketSize = 0x20;
-		pInfo[0].Pipes[0].EndpointAddress = 0x82;
-		pInfo[0].Pipes[0].Interval = 0x04;
-		pInfo[0].Pipes[0].PipeType = (USBD_PIPE_TYPE)0x03;
-		pInfo[0].Pipes[0].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0082;
-		pInfo[0].Pipes[0].PipeFlags = 0x00;
-
-		pInfo[0].Pipes[1].MaximumTransferSize = 0x00400000;
-		pInfo[0].Pipes[1].MaximumPacketSize = 0x20;
-		pInfo[0].Pipes[1].EndpointAddress = 0x02;
-		pInfo[0].Pipes[1].Interval = 0x08;
-		pInfo[0].Pipes[1].PipeType = (USBD_PIPE_TYPE)0x03;
-		pInfo[0].Pipes[1].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0002;
-		pInfo[0].Pipes[1].PipeFlags = 0x00;
-
-		pInfo[0].Pipes[2].MaximumTransferSize = 0x00400000;
-		pInfo[0].Pipes[2].MaximumPacketSize = 0x20;
-		pInfo[0].Pipes[2].EndpointAddress = 0x83;
-		pInfo[0].Pipes[2].Interval = 0x08;
-		pInfo[0].Pipes[2].PipeType = (USBD_PIPE_TYPE)0x03;
-		pInfo[0].Pipes[2].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0083;
-		pInfo[0].Pipes[2].PipeFlags = 0x00;
-
-		pInfo[0].Pipes[3].MaximumTransferSize = 0x00400000;
-		pInfo[0].Pipes[3].MaximumPacketSize = 0x20;
-		pInfo[0].Pipes[3].EndpointAddress = 0x03;
-		pInfo[0].Pipes[3].Interval = 0x08;
-		pInfo[0].Pipes[3].PipeType = (USBD_PIPE_TYPE)0x03;
-		pInfo[0].Pipes[3].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0003;
-		pInfo[0].Pipes[3].PipeFlags = 0x00;
+		SetInterfacePipes(pInfo, 1);
 
 		return STATUS_SUCCESS;
 	}
@@ -677,13 +402,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbSelectInterface(PURB Urb)
 
 		pInfo[0].InterfaceHandle = (USBD_INTERFACE_HANDLE)0xFFFF0000;
 
-		pInfo[0].Pipes[0].MaximumTransferSize = 0x00400000;
-		pInfo[0].Pipes[0].MaximumPacketSize = 0x20;
-		pInfo[0].Pipes[0].EndpointAddress = 0x84;
-		pInfo[0].Pipes[0].Interval = 0x04;
-		pInfo[0].Pipes[0].PipeType = (USBD_PIPE_TYPE)0x03;
-		pInfo[0].Pipes[0].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0084;
-		pInfo[0].Pipes[0].PipeFlags = 0x00;
+		SetInterfacePipes(pInfo, 2);
 
 		return STATUS_SUCCESS;
 	}
@@ -710,87 +429,57 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			TRACE_USBPDO,
 			">> >> >> Incoming request, queuing...");
 
-		auto blobBuffer = static_cast<PUCHAR>(WdfMemoryGetBuffer(this->_InterruptBlobStorage, nullptr));
+		const auto endpoint = ResolvePipe(pTransfer->PipeHandle);
 
-		if (xusb_is_data_pipe(pTransfer))
+		if (endpoint && endpoint->Policy == Core::EndpointPolicy::Report)
 		{
 			//
 			// Send "boot sequence" first, then the actual inputs
 			// 
-			switch (this->_InterruptInitStage)
+			if (const auto stage = this->_BootSequence.Next())
 			{
-			case 0:
-				pTransfer->TransferBufferLength = XUSB_INIT_STAGE_SIZE;
-				this->_InterruptInitStage++;
-				RtlCopyMemory(
-					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_00_OFFSET],
-					XUSB_INIT_STAGE_SIZE
-				);
-				return STATUS_SUCCESS;
-			case 1:
-				pTransfer->TransferBufferLength = XUSB_INIT_STAGE_SIZE;
-				this->_InterruptInitStage++;
-				RtlCopyMemory(
-					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_01_OFFSET],
-					XUSB_INIT_STAGE_SIZE
-				);
+				pTransfer->TransferBufferLength = stage->Length;
+				stage->CopyTo(static_cast<PUCHAR>(pTransfer->TransferBuffer));
 				return STATUS_SUCCESS;
-			case 2:
-				pTransfer->TransferBufferLength = XUSB_INIT_STAGE_SIZE;
-				this->_InterruptInitStage++;
-				RtlCopyMemory(
-					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_02_OFFSET],
-					XUSB_INIT_STAGE_SIZE
-				);
-				return STATUS_SUCCESS;
-			case 3:
-				pTransfer->TransferBufferLength = XUSB_INIT_STAGE_SIZE;
-				this->_InterruptInitStage++;
-				RtlCopyMemory(
-					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_03_OFFSET],
-					XUSB_INIT_STAGE_SIZE
-				);
-				return STATUS_SUCCESS;
-			case 4:
+			}
+
+			KIRQL irql;
+
+			KeAcquireSpinLock(&this->_ReportLock, &irql);
+
+			//
+			// A report got committed while no request was pending, hand it out right away
+			// 
+			if (this->_ReportPending)
+			{
 				pTransfer->TransferBufferLength = sizeof(XUSB_INTERRUPT_IN_PACKET);
-				this->_InterruptInitStage++;
-				RtlCopyMemory(
-					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_04_OFFSET],
-					sizeof(XUSB_INTERRUPT_IN_PACKET)
-				);
-				return STATUS_SUCCESS;
-			case 5:
-				pTransfer->TransferBufferLength = XUSB_INIT_STAGE_SIZE;
-				this->_InterruptInitStage++;
-				RtlCopyMemory(
-					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_05_OFFSET],
-					XUSB_INIT_STAGE_SIZE
-				);
-				return STATUS_SUCCESS;
-			default:
-				/* This request is sent periodically and relies on data the "feeder"
-				* has to supply, so we queue this request and return with STATUS_PENDING.
-				* The request gets completed as soon as the "feeder" sent an update. */
-				status = WdfRequestForwardToIoQueue(Request, this->_PendingUsbInRequests);
+				this->CopyNextPacket(pTransfer->TransferBuffer);
+
+				KeReleaseSpinLock(&this->_ReportLock, irql);
 
-				return (NT_SUCCESS(status)) ? STATUS_PENDING : status;
+				return STATUS_SUCCESS;
 			}
+
+			/* This request is sent periodically and relies on data the "feeder"
+			* has to supply, so we queue this request and return with STATUS_PENDING.
+			* The request gets completed as soon as the "feeder" sent an update. */
+			status = WdfRequestForwardToIoQueue(Request, this->_PendingUsbInRequests);
+
+			KeReleaseSpinLock(&this->_ReportLock, irql);
+
+			return (NT_SUCCESS(status)) ? STATUS_PENDING : status;
 		}
 
-		if (xusb_is_control_pipe(pTransfer))
+		if (endpoint && (endpoint->Policy == Core::EndpointPolicy::Hold || endpoint->Policy == Core::EndpointPolicy::Idle))
 		{
-			if (!this->_ReportedCapabilities && pTransfer->TransferBufferLength >= XUSB_INIT_STAGE_SIZE)
+			if (endpoint->Policy == Core::EndpointPolicy::Hold
+				&& !this->_ReportedCapabilities
+				&& pTransfer->TransferBufferLength >= sizeof(Core::XusbBootSequence::Capabilities))
 			{
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_06_OFFSET],
-					XUSB_INIT_STAGE_SIZE
+					Core::XusbBootSequence::Capabilities,
+					sizeof(Core::XusbBootSequence::Capabilities)
 				);
 
 				this->_ReportedCapabilities = TRUE;
@@ -817,6 +506,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 	if (pTransfer->TransferBufferLength == XUSB_LEDSET_SIZE) // Led
 	{
 		auto Buffer = static_cast<PUCHAR>(pTransfer->TransferBuffer);
+		const CHAR previousLedNumber = this->_LedNumber;
 
 		TraceVerbose(
 			TRACE_USBPDO,
@@ -840,7 +530,10 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 		//
 		// Notify client library that PDO is ready
 		// 
-		KeSetEvent(&this->_PdoBootNotificationEvent, 0, FALSE);
+		this->SignalDeviceReady();
+
+		if (this->_LedNumber != previousLedNumber)
+			this->UpdateGeneration();
 	}
 
 	// Extract rumble (vibration) information
@@ -860,13 +553,29 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			Buffer[6],
 			Buffer[7]);
 
-		RtlCopyBytes(this->_Rumble, Buffer, pTransfer->TransferBufferLength);
+		if (RtlCompareMemory(this->_Rumble, Buffer, XUSB_RUMBLE_SIZE) != XUSB_RUMBLE_SIZE)
+		{
+			RtlCopyBytes(this->_Rumble, Buffer, pTransfer->TransferBufferLength);
+			this->UpdateGeneration();
+		}
 	}
 
 #pragma endregion
 
-	if (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(
-		this->_PendingNotificationRequests,
+	//
+	// Kernel-mode owners get output data delivered via callback
+	// 
+	if (this->_OwnerIsDriver)
+	{
+		this->InvokeOutputCallback(pTransfer->TransferBuffer, pTransfer->TransferBufferLength);
+
+		return status;
+	}
+
+	const auto notificationQueue = PeekOnDemandQueue(&this->_PendingNotificationRequests);
+
+	if (notificationQueue && NT_SUCCESS(WdfIoQueueRetrieveNextRequest(
+		notificationQueue,
 		&notifyRequest
 	)))
 	{
@@ -903,28 +612,9 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				status);
 		}
 	}
-	else
+	else if (this->QueueOutputBuffer(pTransfer->TransferBuffer, pTransfer->TransferBufferLength))
 	{
-		PVOID clientBuffer, contextBuffer;
-
-		if (NT_SUCCESS(DMF_BufferQueue_Fetch(
-			this->_UsbInterruptOutBufferQueue,
-			&clientBuffer,
-			&contextBuffer
-		)) && pTransfer->TransferBufferLength <= MAX_OUT_BUFFER_QUEUE_SIZE)
-		{
-			RtlCopyMemory(
-				clientBuffer,
-				pTransfer->TransferBuffer,
-				pTransfer->TransferBufferLength
-			);
-
-			*static_cast<size_t*>(contextBuffer) = pTransfer->TransferBufferLength;
-
-			TraceVerbose(TRACE_USBPDO, "Queued %Iu bytes", pTransfer->TransferBufferLength);
-
-			DMF_BufferQueue_Enqueue(this->_UsbInterruptOutBufferQueue, clientBuffer);
-		}
+		TraceVerbose(TRACE_USBPDO, "Queued %Iu bytes", pTransfer->TransferBufferLength);
 	}
 
 	return status;
@@ -933,20 +623,18 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbControlTransfer(PURB Urb)
 {
 	NTSTATUS status;
-	PUCHAR   blobBuffer;
 
 	switch (Urb->UrbControlTransfer.SetupPacket[6])
 	{
 	case 0x04:
 
-		blobBuffer = static_cast<PUCHAR>(WdfMemoryGetBuffer(this->_InterruptBlobStorage, nullptr));
 		//
 		// Xenon magic
 		// 
 		RtlCopyMemory(
 			Urb->UrbControlTransfer.TransferBuffer,
-			&blobBuffer[XUSB_BLOB_07_OFFSET],
-			0x04
+			Core::XusbBootSequence::XenonMagic,
+			sizeof(Core::XusbBootSequence::XenonMagic)
 		);
 		status = STATUS_SUCCESS;
 
@@ -973,52 +661,65 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbControlTransfer(PURB Urb)
 	return status;
 }
 
-NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitReportImpl(PVOID NewReport)
+BOOLEAN ViGEm::Bus::Targets::EmulationTargetXUSB::UpdateReportCache(PVOID NewReport)
 {
-	FuncEntry(TRACE_BUSENUM);
+	const auto pReport = &static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Report;
 
-	NTSTATUS    status = STATUS_SUCCESS;
-	BOOLEAN     changed;
-	WDFREQUEST  usbRequest;
+	if (RtlCompareMemory(&this->_Packet.Report, pReport, sizeof(XUSB_REPORT)) == sizeof(XUSB_REPORT))
+		return FALSE;
 
-	changed = (RtlCompareMemory(&this->_Packet.Report,
-		&static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Report,
-		sizeof(XUSB_REPORT)) != sizeof(XUSB_REPORT));
+	// Copy submitted report to cache
+	RtlCopyBytes(&this->_Packet.Report, pReport, sizeof(XUSB_REPORT));
 
-	// Don't waste pending IRP if input hasn't changed
-	if (!changed)
-	{
-		TraceVerbose(
-			TRACE_BUSENUM,
-			"Input report hasn't changed since last update, aborting with %!STATUS!",
-			status);
-		return status;
-	}
+	this->EnqueueOrderedReport(&this->_Packet, sizeof(XUSB_INTERRUPT_IN_PACKET));
+
+	// Deliver to the next interrupt IN request if none is pending now
+	this->_ReportPending = TRUE;
+
+	return TRUE;
+}
+
+NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::FlushReportCache()
+{
+	NTSTATUS    status;
+	WDFREQUEST  usbRequest;
+	KIRQL       irql;
 
 	TraceVerbose(
 		TRACE_BUSENUM,
 		"Received new report, processing");
 
+	KeAcquireSpinLock(&this->_ReportLock, &irql);
+
 	status = WdfIoQueueRetrieveNextRequest(this->_PendingUsbInRequests, &usbRequest);
 
-	if (!NT_SUCCESS(status))
-		return status;
+	if (NT_SUCCESS(status))
+	{
+		// Get pending IRP
+		PIRP pendingIrp = WdfRequestWdmGetIrp(usbRequest);
 
-	// Get pending IRP
-	PIRP pendingIrp = WdfRequestWdmGetIrp(usbRequest);
+		// Get USB request block
+		PURB urb = static_cast<PURB>(URB_FROM_IRP(pendingIrp));
 
-	// Get USB request block
-	PURB urb = static_cast<PURB>(URB_FROM_IRP(pendingIrp));
+		// Get transfer buffer
+		auto Buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
 
-	// Get transfer buffer
-	auto Buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
+		urb->UrbBulkOrInterruptTransfer.TransferBufferLength = sizeof(XUSB_INTERRUPT_IN_PACKET);
 
-	urb->UrbBulkOrInterruptTransfer.TransferBufferLength = sizeof(XUSB_INTERRUPT_IN_PACKET);
+		// Copy next report to URB transfer buffer
+		this->CopyNextPacket(Buffer);
+	}
 
-	// Copy submitted report to cache
-	RtlCopyBytes(&this->_Packet.Report, &(static_cast<PXUSB_SUBMIT_REPORT>(NewReport))->Report, sizeof(XUSB_REPORT));
-	// Copy cached report to URB transfer buffer
-	RtlCopyBytes(Buffer, &this->_Packet, sizeof(XUSB_INTERRUPT_IN_PACKET));
+	KeReleaseSpinLock(&this->_ReportLock, irql);
+
+	if (status == STATUS_NO_MORE_ENTRIES)
+	{
+		TraceVerbose(TRACE_BUSENUM, "No interrupt IN request pending, report cached for later");
+		return STATUS_SUCCESS;
+	}
+
+	if (!NT_SUCCESS(status))
+		return status;
 
 	// Complete pending request
 	WdfRequestComplete(usbRequest, status);
@@ -1028,6 +729,37 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitReportImpl(PVOID NewRep
 	return status;
 }
 
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::CopyNextPacket(PVOID Buffer)
+{
+	//
+	// Queued reports go first, the cached one is still due if the last
+	// queued report doesn't reflect it (e.g. after an overflow)
+	// 
+	if (this->DequeueOrderedReport(Buffer, sizeof(XUSB_INTERRUPT_IN_PACKET)))
+	{
+		this->_ReportPending = this->HasOrderedReports()
+			|| RtlCompareMemory(Buffer, &this->_Packet, sizeof(XUSB_INTERRUPT_IN_PACKET))
+			!= sizeof(XUSB_INTERRUPT_IN_PACKET);
+		return;
+	}
+
+	RtlCopyBytes(Buffer, &this->_Packet, sizeof(XUSB_INTERRUPT_IN_PACKET));
+
+	this->_ReportPending = FALSE;
+}
+
+ULONG64 ViGEm::Bus::Targets::EmulationTargetXUSB::GetReportButtons(const UCHAR* Report) const
+{
+	const ULONG offset = FIELD_OFFSET(XUSB_INTERRUPT_IN_PACKET, Report.wButtons);
+
+	return Report[offset] | (static_cast<ULONG64>(Report[offset + 1]) << 8);
+}
+
+ULONG64 ViGEm::Bus::Targets::EmulationTargetXUSB::GetCachedReportButtons() const
+{
+	return this->GetReportButtons(reinterpret_cast<const UCHAR*>(&this->_Packet));
+}
+
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::GetUserIndex(PULONG UserIndex) const
 {
 	if (!this->IsOwnerProcess())
@@ -1047,12 +779,21 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::GetUserIndex(PULONG UserIndex
 	return STATUS_INVALID_DEVICE_OBJECT_PARAMETER;
 }
 
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::GetSnapshotImpl(PVIGEM_TARGET_SNAPSHOT_ENTRY Entry)
+{
+	if (this->_LedNumber >= 0)
+		Entry->UserIndex = static_cast<ULONG>(this->_LedNumber);
+
+	Entry->LargeMotor = this->_Rumble[3];
+	Entry->SmallMotor = this->_Rumble[4];
+}
+
 void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUEUE Queue)
 {
 	NTSTATUS status;
 	WDFREQUEST request;
-	PVOID clientBuffer, contextBuffer;
-	size_t bufferLength;
+	UCHAR clientBuffer[BUS_OUTPUT_BLOCK_SIZE];
+	ULONG bufferLength;
 	PXUSB_REQUEST_NOTIFICATION notify = nullptr;
 
 	FuncEntry(TRACE_BUSENUM);
@@ -1062,40 +803,28 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 	// 
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
-		status = DMF_BufferQueue_Dequeue(
-			this->_UsbInterruptOutBufferQueue,
-			&clientBuffer,
-			&contextBuffer
-		);
-
 		//
 		// Shouldn't happen, but if so, error out
 		// 
-		if (!NT_SUCCESS(status))
+		if (!this->DequeueOutputBuffer(clientBuffer, sizeof(clientBuffer), &bufferLength))
 		{
 			//
 			// Don't requeue request as we maya be out of order now
 			// 
-			WdfRequestComplete(request, status);
+			WdfRequestComplete(request, STATUS_NO_MORE_ENTRIES);
 			continue;
 		}
 
-		//
-		// Actual buffer length
-		// 
-		bufferLength = *static_cast<size_t*>(contextBuffer);
-
 		//
 		// Validate packet
 		// 
 		if (bufferLength != XUSB_RUMBLE_SIZE && bufferLength != XUSB_LEDSET_SIZE)
 		{
-			DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
 			WdfRequestComplete(request, STATUS_INVALID_BUFFER_SIZE);
 			break; // await callback getting fired again
 		}
 
-		if (NT_SUCCESS(WdfRequestRetrieveOutputBuffer(
+		if (NT_SUCCESS(status = WdfRequestRetrieveOutputBuffer(
 			request,
 			sizeof(XUSB_REQUEST_NOTIFICATION),
 			reinterpret_cast<PVOID*>(&notify),
@@ -1108,8 +837,8 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 
 			if (bufferLength == XUSB_RUMBLE_SIZE)
 			{
-				notify->LargeMotor = static_cast<PUCHAR>(clientBuffer)[3];
-				notify->SmallMotor = static_cast<PUCHAR>(clientBuffer)[4];
+				notify->LargeMotor = clientBuffer[3];
+				notify->SmallMotor = clientBuffer[4];
 			}
 			else
 			{
@@ -1125,12 +854,10 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 			WdfRequestCompleteWithInformation(request, status, notify->Size);
 		}
 
-		DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
-
 		//
 		// If no more buffer to process, exit loop and await next callback
 		// 
-		if (DMF_BufferQueue_Count(this->_UsbInterruptOutBufferQueue) == 0)
+		if (!this->HasOutputBuffers())
 		{
 			break;
 		}
@@ -35,7 +35,9 @@
 
 #pragma once
 
-#include "EmulationTargetPDO.hpp"
+#include "EmulationTarget.hpp"
+#include "TargetDescriptors.hpp"
+#include "XusbBootSequence.hpp"
 
 namespace ViGEm::Bus::Targets
 {
@@ -50,18 +52,49 @@ namespace ViGEm::Bus::Targets
 		XUSB_REPORT Report;
 	} XUSB_INTERRUPT_IN_PACKET, *PXUSB_INTERRUPT_IN_PACKET;
 
-	constexpr bool xusb_is_data_pipe(_URB_BULK_OR_INTERRUPT_TRANSFER* pTransfer)
+	//
+	// Compile-time parameters of the Xbox 360 wired controller
+	// 
+	struct XusbTraits
 	{
-		return (pTransfer->PipeHandle == reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0081));
-	}
+		static constexpr VIGEM_TARGET_TYPE Type = Xbox360Wired;
 
-	constexpr bool xusb_is_control_pipe(_URB_BULK_OR_INTERRUPT_TRANSFER* pTransfer)
-	{
-		return (pTransfer->PipeHandle == reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0083));
-	}
+		static constexpr const auto& Device = XusbDescriptors::Device;
+
+		static constexpr const auto& Configuration = XusbDescriptors::Configuration;
+
+		static constexpr ULONG PoolTag = XUSB_POOL_TAG;
 
-	class EmulationTargetXUSB : public Core::EmulationTargetPDO
+		//
+		// Queue parking the interrupt IN requests of the held and idle endpoints
+		// 
+		static constexpr ULONG QueueCount = 1;
+
+		static constexpr ULONG TimerCount = 0;
+
+		static constexpr Core::EndpointTable<7> Endpoints{{
+			//
+			// Input reports, preceded by the "boot sequence"
+			// 
+			{ 0x00, 0x81, 0x20, 0x04, Core::EndpointPolicy::Report },
+			{ 0x00, 0x01, 0x20, 0x08, Core::EndpointPolicy::Consume },
+			{ 0x01, 0x82, 0x20, 0x04, Core::EndpointPolicy::Idle },
+			{ 0x01, 0x02, 0x20, 0x08, Core::EndpointPolicy::Consume },
+			//
+			// Answered once with the capabilities, then parked
+			// 
+			{ 0x01, 0x83, 0x20, 0x08, Core::EndpointPolicy::Hold },
+			{ 0x01, 0x03, 0x20, 0x08, Core::EndpointPolicy::Consume },
+			{ 0x02, 0x84, 0x20, 0x04, Core::EndpointPolicy::Idle },
+		}};
+	};
+
+#pragma warning(push)
+#pragma warning(disable:4324) // structure was padded due to alignment specifier
+	class EmulationTargetXUSB final : public Core::EmulationTarget<EmulationTargetXUSB, XusbTraits>
 	{
+		friend class Core::EmulationTarget<EmulationTargetXUSB, XusbTraits>;
+
 	public:
 		EmulationTargetXUSB(ULONG Serial, LONG SessionId, USHORT VendorId = 0x045E, USHORT ProductId = 0x028E);
 
@@ -73,10 +106,6 @@ namespace ViGEm::Bus::Targets
 
 		NTSTATUS PdoInitContext() override;
 
-		VOID GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length) override;
-
-		NTSTATUS UsbGetDeviceDescriptorType(PUSB_DEVICE_DESCRIPTOR pDescriptor) override;
-
 		NTSTATUS SelectConfiguration(PURB Urb) override;
 
 		void AbortPipe() override;
@@ -93,16 +122,27 @@ namespace ViGEm::Bus::Targets
 		
 		NTSTATUS UsbControlTransfer(PURB Urb) override;
 		
-		NTSTATUS SubmitReportImpl(PVOID NewReport) override;
-
 		NTSTATUS GetUserIndex(PULONG UserIndex) const;
 
 	protected:
 		void ProcessPendingNotification(WDFQUEUE Queue) override;
+
+		VOID GetSnapshotImpl(PVIGEM_TARGET_SNAPSHOT_ENTRY Entry) override;
+
+		BOOLEAN UpdateReportCache(PVOID NewReport) override;
+
+		NTSTATUS FlushReportCache() override;
+
+		ULONG64 GetReportButtons(const UCHAR* Report) const override;
+
+		ULONG64 GetCachedReportButtons() const override;
+
 		void DmfDeviceModulesAdd(_In_ PDMFMODULE_INIT DmfModuleInit) override;
 	private:
 		static PCWSTR _deviceDescription;
 
+		VOID CopyNextPacket(PVOID Buffer);
+
 #if defined(_X86_)
 		static const int XUSB_CONFIGURATION_SIZE = 0x00E4;
 #else
@@ -112,51 +152,53 @@ namespace ViGEm::Bus::Targets
 		static const int XUSB_RUMBLE_SIZE = 0x08;
 		static const int XUSB_LEDSET_SIZE = 0x03;
 		static const int XUSB_LEDNUM_SIZE = 0x01;
-		static const int XUSB_INIT_STAGE_SIZE = 0x03;
-		static const int XUSB_BLOB_STORAGE_SIZE = 0x2A;
-
-		static const int XUSB_BLOB_00_OFFSET = 0x00;
-		static const int XUSB_BLOB_01_OFFSET = 0x03;
-		static const int XUSB_BLOB_02_OFFSET = 0x06;
-		static const int XUSB_BLOB_03_OFFSET = 0x09;
-		static const int XUSB_BLOB_04_OFFSET = 0x0C;
-		static const int XUSB_BLOB_05_OFFSET = 0x20;
-		static const int XUSB_BLOB_06_OFFSET = 0x23;
-		static const int XUSB_BLOB_07_OFFSET = 0x26;
+
+#pragma region Submission path, written per report
 
 		//
-		// Rumble buffer
+		// Report packet
 		//
-		UCHAR _Rumble[XUSB_RUMBLE_SIZE];
+		DECLSPEC_CACHEALIGN XUSB_INTERRUPT_IN_PACKET _Packet;
 
 		//
-		// LED number (represents XInput slot index)
+		// Set if the cached report hasn't been delivered to the host yet
+		// 
+		BOOLEAN _ReportPending;
+
 		//
-		CHAR _LedNumber;
+		// Position in the "boot sequence" answered before the actual inputs
+		// 
+		Core::XusbBootSequence _BootSequence;
+
+#pragma endregion
+
+#pragma region Output path
 
 		//
-		// Report packet
+		// Rumble buffer
 		//
-		XUSB_INTERRUPT_IN_PACKET _Packet;
+		DECLSPEC_CACHEALIGN UCHAR _Rumble[XUSB_RUMBLE_SIZE];
 
 		//
-		// Queue for incoming control interrupt transfer
+		// LED number (represents XInput slot index)
 		//
-		WDFQUEUE _HoldingUsbInRequests;
+		CHAR _LedNumber;
+
+#pragma endregion
+
+#pragma region Setup and teardown
 
 		//
-		// Required for XInputGetCapabilities to work
-		// 
-		BOOLEAN _ReportedCapabilities;
+		// Queue parking interrupt IN transfers of held and idle endpoints
+		//
+		WDFQUEUE _HoldingUsbInRequests{};
 
 		//
 		// Required for XInputGetCapabilities to work
 		// 
-		ULONG _InterruptInitStage;
+		BOOLEAN _ReportedCapabilities;
 
-		//
-		// Storage of binary blobs (packets) for PDO initialization
-		// 
-		WDFMEMORY _InterruptBlobStorage;
+#pragma endregion
 	};
+#pragma warning(pop)
 }
@@ -44,6 +44,9 @@
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text (PAGE, Bus_PlugInDevice)
 #pragma alloc_text (PAGE, Bus_UnPlugDevice)
+#pragma alloc_text (PAGE, Bus_PlugInTarget)
+#pragma alloc_text (PAGE, Bus_UnPlugTarget)
+#pragma alloc_text (PAGE, Bus_GetTargetSnapshot)
 #endif
 
 using ViGEm::Bus::Core::PDO_IDENTIFICATION_DESCRIPTION;
@@ -60,7 +63,6 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 	_In_ BOOLEAN IsInternal,
 	_Out_ size_t* Transferred)
 {
-	PDO_IDENTIFICATION_DESCRIPTION  description;
 	NTSTATUS                        status;
 	PVIGEM_PLUGIN_TARGET            plugIn;
 	WDFFILEOBJECT                   fileObject;
@@ -97,14 +99,6 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 		return STATUS_INVALID_PARAMETER;
 	}
 
-	if (plugIn->SerialNo == 0)
-	{
-		TraceError(
-			TRACE_BUSENUM,
-			"Serial no. 0 not allowed");
-		return STATUS_INVALID_PARAMETER;
-	}
-
 	*Transferred = length;
 
 	fileObject = WdfRequestGetFileObject(Request);
@@ -127,28 +121,71 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 		return STATUS_INVALID_PARAMETER;
 	}
 
+	status = Bus_PlugInTarget(
+		Device,
+		plugIn->SerialNo,
+		pFileData->SessionId,
+		plugIn->TargetType,
+		plugIn->VendorId,
+		plugIn->ProductId,
+		FALSE
+	);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", status);
+
+	return status;
+}
+
+//
+// Creates a new target object and reports it to the child list.
+// 
+EXTERN_C NTSTATUS Bus_PlugInTarget(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG SerialNo,
+	_In_ LONG SessionId,
+	_In_ VIGEM_TARGET_TYPE TargetType,
+	_In_ USHORT VendorId,
+	_In_ USHORT ProductId,
+	_In_ BOOLEAN OwnerIsDriver)
+{
+	PDO_IDENTIFICATION_DESCRIPTION  description;
+	NTSTATUS                        status;
+
+	PAGED_CODE();
+
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Entry");
+
+	if (SerialNo == 0)
+	{
+		TraceError(
+			TRACE_BUSENUM,
+			"Serial no. 0 not allowed");
+		return STATUS_INVALID_PARAMETER;
+	}
+
 	//
 	// Initialize the description with the information about the newly
 	// plugged in device.
 	//
 	WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
 
-	description.SerialNo = plugIn->SerialNo;
-	description.SessionId = pFileData->SessionId;
+	description.SerialNo = SerialNo;
+	description.SessionId = SessionId;
 
 	// Set default IDs if supplied values are invalid
-	if (plugIn->VendorId == 0 || plugIn->ProductId == 0)
+	if (VendorId == 0 || ProductId == 0)
 	{
-		switch (plugIn->TargetType)
+		switch (TargetType)
 		{
 		case Xbox360Wired:
 
-			description.Target = new EmulationTargetXUSB(plugIn->SerialNo, pFileData->SessionId);
+			description.Target = new EmulationTargetXUSB(SerialNo, SessionId);
 
 			break;
 		case DualShock4Wired:
 
-			description.Target = new EmulationTargetDS4(plugIn->SerialNo, pFileData->SessionId);
+			description.Target = new EmulationTargetDS4(SerialNo, SessionId);
 
 			break;
 		default:
@@ -157,25 +194,25 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 	}
 	else
 	{
-		switch (plugIn->TargetType)
+		switch (TargetType)
 		{
 		case Xbox360Wired:
 
 			description.Target = new EmulationTargetXUSB(
-				plugIn->SerialNo,
-				pFileData->SessionId,
-				plugIn->VendorId,
-				plugIn->ProductId
+				SerialNo,
+				SessionId,
+				VendorId,
+				ProductId
 			);
 
 			break;
 		case DualShock4Wired:
 
 			description.Target = new EmulationTargetDS4(
-				plugIn->SerialNo,
-				pFileData->SessionId,
-				plugIn->VendorId,
-				plugIn->ProductId
+				SerialNo,
+				SessionId,
+				VendorId,
+				ProductId
 			);
 
 			break;
@@ -184,12 +221,14 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 		}
 	}
 
-	if (!NT_SUCCESS(description.Target->PdoPrepare(Device)))
+	description.Target->SetOwnerIsDriver(OwnerIsDriver);
+
+	if (!NT_SUCCESS(status = description.Target->PdoPrepare(Device)))
 	{
 		goto pluginEnd;
 	}
 
-	if (plugIn->TargetType == DualShock4Wired)
+	if (TargetType == DualShock4Wired)
 	{
 		static_cast<EmulationTargetDS4*>(description.Target)->SetOutputReportNotifyModule(FdoGetData(Device)->UserNotification);
 	}
@@ -242,12 +281,6 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 	_Out_ size_t* Transferred)
 {
 	NTSTATUS                            status;
-	WDFDEVICE                           hChild;
-	WDFCHILDLIST                        list;
-	WDF_CHILD_LIST_ITERATOR             iterator;
-	WDF_CHILD_RETRIEVE_INFO             childInfo;
-	PDO_IDENTIFICATION_DESCRIPTION      description;
-	BOOLEAN                             unplugAll;
 	PVIGEM_UNPLUG_TARGET                unPlug;
 	WDFFILEOBJECT                       fileObject;
 	PFDO_FILE_DATA                      pFileData = NULL;
@@ -283,7 +316,6 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 	}
 
 	*Transferred = length;
-	unplugAll = (unPlug->SerialNo == 0);
 
 	fileObject = WdfRequestGetFileObject(Request);
 	if (fileObject == NULL)
@@ -305,6 +337,41 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 		return STATUS_INVALID_PARAMETER;
 	}
 
+	status = Bus_UnPlugTarget(
+		Device,
+		unPlug->SerialNo,
+		pFileData->SessionId,
+		IsInternal
+	);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", status);
+
+	return status;
+}
+
+//
+// Reports all matching children owned by the given session as missing.
+// 
+EXTERN_C NTSTATUS Bus_UnPlugTarget(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG SerialNo,
+	_In_ LONG SessionId,
+	_In_ BOOLEAN IsInternal)
+{
+	NTSTATUS                            status;
+	WDFDEVICE                           hChild;
+	WDFCHILDLIST                        list;
+	WDF_CHILD_LIST_ITERATOR             iterator;
+	WDF_CHILD_RETRIEVE_INFO             childInfo;
+	PDO_IDENTIFICATION_DESCRIPTION      description;
+	BOOLEAN                             unplugAll;
+
+	PAGED_CODE();
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Entry");
+
+	unplugAll = (SerialNo == 0);
+
 	TraceVerbose(
 		TRACE_BUSENUM,
 		"Starting child list traversal");
@@ -343,25 +410,28 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 		}
 
 		// Child isn't the one we looked for, skip
-		if (!unplugAll && description.SerialNo != unPlug->SerialNo)
+		if (!unplugAll && description.SerialNo != SerialNo)
 		{
 			TraceVerbose(
 				TRACE_BUSENUM,
 				"Seeking serial mismatch: %d != %d",
 				description.SerialNo,
-				unPlug->SerialNo);
+				SerialNo);
 			continue;
 		}
 
 		TraceVerbose(
 			TRACE_BUSENUM,
-			"description.SessionId = %d, pFileData->SessionId = %d",
+			"description.SessionId = %d, SessionId = %d",
 			description.SessionId,
-			pFileData->SessionId);
+			SessionId);
 
 		// Only unplug owned children
-		if (IsInternal || description.SessionId == pFileData->SessionId)
+		if (IsInternal || description.SessionId == SessionId)
 		{
+			// Stop routing submissions before PnP gets to the removal
+			description.Target->RemoveFromIndex();
+
 			// Unplug child
 			status = WdfChildListUpdateChildDescriptionAsMissing(list, &description.Header);
 			if (!NT_SUCCESS(status))
@@ -384,3 +454,170 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 
 	return STATUS_SUCCESS;
 }
+
+//
+// Reports the state of all targets visible to the caller in a single child list pass.
+// 
+EXTERN_C NTSTATUS Bus_GetTargetSnapshot(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request,
+	_In_ BOOLEAN IsInternal,
+	_Out_ size_t* Transferred)
+{
+	NTSTATUS                            status;
+	WDFDEVICE                           hChild;
+	WDFCHILDLIST                        list;
+	WDF_CHILD_LIST_ITERATOR             iterator;
+	WDF_CHILD_RETRIEVE_INFO             childInfo;
+	PDO_IDENTIFICATION_DESCRIPTION      description;
+	PVIGEM_TARGET_SNAPSHOT              pSnapshot;
+	PVIGEM_TARGET_SNAPSHOT_ENTRY        pEntries;
+	WDFFILEOBJECT                       fileObject;
+	PFDO_FILE_DATA                      pFileData;
+	ULONG64                             sinceGeneration;
+	ULONG                               maxEntries;
+	ULONG                               entryCount = 0;
+	ULONG                               totalCount = 0;
+	size_t                              length = 0;
+
+	PAGED_CODE();
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Entry");
+
+	status = WdfRequestRetrieveInputBuffer(
+		Request,
+		sizeof(VIGEM_TARGET_SNAPSHOT),
+		reinterpret_cast<PVOID*>(&pSnapshot),
+		&length
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceError(
+			TRACE_BUSENUM,
+			"WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	if (sizeof(VIGEM_TARGET_SNAPSHOT) != pSnapshot->Size)
+	{
+		TraceError(
+			TRACE_BUSENUM,
+			"sizeof(VIGEM_TARGET_SNAPSHOT) buffer size mismatch [%d != %d]",
+			sizeof(VIGEM_TARGET_SNAPSHOT), pSnapshot->Size);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	//
+	// Input and output share the system buffer, grab input before writing
+	// 
+	sinceGeneration = pSnapshot->SinceGeneration;
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		sizeof(VIGEM_TARGET_SNAPSHOT),
+		reinterpret_cast<PVOID*>(&pSnapshot),
+		&length
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceError(
+			TRACE_BUSENUM,
+			"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	fileObject = WdfRequestGetFileObject(Request);
+	if (fileObject == NULL)
+	{
+		TraceError(
+			TRACE_BUSENUM,
+			"WdfRequestGetFileObject failed to fetch WDFFILEOBJECT from request 0x%p",
+			Request);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	pFileData = FileObjectGetData(fileObject);
+	if (pFileData == NULL)
+	{
+		TraceError(
+			TRACE_BUSENUM,
+			"FileObjectGetData failed to get context data for 0x%p",
+			fileObject);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	pEntries = VIGEM_TARGET_SNAPSHOT_ENTRIES(pSnapshot);
+	maxEntries = static_cast<ULONG>((length - sizeof(VIGEM_TARGET_SNAPSHOT)) / sizeof(VIGEM_TARGET_SNAPSHOT_ENTRY));
+
+	//
+	// Fetch generations before the pass. Every target stamped up to the counter
+	// read already carries its stamp, anything the pass misses is above it and
+	// gets reported next time.
+	// 
+	pSnapshot->Size = sizeof(VIGEM_TARGET_SNAPSHOT);
+	pSnapshot->SinceGeneration = sinceGeneration;
+
+	EmulationTargetPDO::GetBusGenerations(Device, &pSnapshot->Generation, &pSnapshot->RemovalGeneration);
+
+	list = WdfFdoGetDefaultChildList(Device);
+
+	WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
+
+	WdfChildListBeginIteration(list, &iterator);
+
+	for (;;)
+	{
+		WDF_CHILD_RETRIEVE_INFO_INIT(&childInfo, &description.Header);
+		WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+
+		status = WdfChildListRetrieveNextDevice(list, &iterator, &hChild, &childInfo);
+
+		// Error or no more children, end loop
+		if (!NT_SUCCESS(status) || status == STATUS_NO_MORE_ENTRIES)
+		{
+			break;
+		}
+
+		// If unable to retrieve device
+		if (childInfo.Status != WdfChildListRetrieveDeviceSuccess)
+		{
+			continue;
+		}
+
+		// Only report owned children
+		if (!IsInternal && description.SessionId != pFileData->SessionId)
+		{
+			continue;
+		}
+
+		// Unchanged since last poll
+		if (description.Target->GetGeneration() <= sinceGeneration)
+		{
+			continue;
+		}
+
+		totalCount++;
+
+		if (entryCount < maxEntries)
+		{
+			description.Target->GetSnapshot(&pEntries[entryCount++]);
+		}
+	}
+
+	WdfChildListEndIteration(list, &iterator);
+
+	pSnapshot->EntryCount = entryCount;
+	pSnapshot->TotalCount = totalCount;
+
+	*Transferred = sizeof(VIGEM_TARGET_SNAPSHOT) + (entryCount * sizeof(VIGEM_TARGET_SNAPSHOT_ENTRY));
+
+	status = (entryCount < totalCount) ? STATUS_BUFFER_OVERFLOW : STATUS_SUCCESS;
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", status);
+
+	return status;
+}
@@ -0,0 +1,164 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "AxisInterpolation.hpp"
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core::AxisInterpolation;
+
+namespace
+{
+	using TwoChannels = Interpolator<2>;
+
+	constexpr unsigned long long Interval = 1000;
+
+	unsigned char SampleAt(const TwoChannels& Interpolator, unsigned long long Now, unsigned int Channel = 0)
+	{
+		unsigned char out[2];
+
+		Interpolator.Sample(Now, out);
+
+		return out[Channel];
+	}
+
+	void NoneRepeatsLatestSample()
+	{
+		static TwoChannels interpolator;
+		const unsigned char start[2] = { 10, 20 };
+		const unsigned char next[2] = { 110, 120 };
+
+		interpolator.Reset(0, start);
+		interpolator.Push(Interval, next, 1, 10 * Interval);
+
+		CHECK_EQ(SampleAt(interpolator, Interval), 110);
+		CHECK_EQ(SampleAt(interpolator, Interval + Interval / 2, 1), 120);
+	}
+
+	void LinearGlidesOverOneInterval()
+	{
+		static TwoChannels interpolator;
+		const unsigned char start[2] = { 100, 100 };
+		const unsigned char next[2] = { 200, 0 };
+
+		interpolator.SetMode(Mode::Linear);
+		interpolator.Reset(0, start);
+		interpolator.Push(Interval, next, 1, 10 * Interval);
+
+		CHECK_EQ(SampleAt(interpolator, Interval), 100);
+		CHECK_EQ(SampleAt(interpolator, Interval + Interval / 2), 150);
+		CHECK_EQ(SampleAt(interpolator, Interval + Interval / 2, 1), 50);
+		CHECK_EQ(SampleAt(interpolator, 2 * Interval), 200);
+		CHECK_EQ(SampleAt(interpolator, 50 * Interval), 200);
+	}
+
+	void ExtrapolationOvershootsOnceThenSettles()
+	{
+		static TwoChannels interpolator;
+		const unsigned char first[2] = { 100, 100 };
+		const unsigned char second[2] = { 120, 80 };
+
+		interpolator.SetMode(Mode::Extrapolate);
+		interpolator.Reset(0, first);
+		interpolator.Push(Interval, first, 1, 10 * Interval);
+		interpolator.Push(2 * Interval, second, 1, 10 * Interval);
+
+		CHECK_EQ(SampleAt(interpolator, 2 * Interval), 120);
+		CHECK_EQ(SampleAt(interpolator, 2 * Interval + Interval / 2), 130);
+		CHECK_EQ(SampleAt(interpolator, 3 * Interval), 140);
+		CHECK_EQ(SampleAt(interpolator, 3 * Interval + Interval / 2), 130);
+		CHECK_EQ(SampleAt(interpolator, 4 * Interval), 120);
+		CHECK_EQ(SampleAt(interpolator, 4 * Interval, 1), 80);
+
+		//
+		// Feeder stalled: stays on the last submitted sample
+		// 
+		CHECK_EQ(SampleAt(interpolator, 1000 * Interval), 120);
+		CHECK_EQ(SampleAt(interpolator, 1000 * Interval, 1), 80);
+	}
+
+	void ExtrapolationClampsToRange()
+	{
+		static TwoChannels interpolator;
+		const unsigned char first[2] = { 100, 100 };
+		const unsigned char second[2] = { 250, 5 };
+
+		interpolator.SetMode(Mode::Extrapolate);
+		interpolator.Reset(0, first);
+		interpolator.Push(Interval, first, 1, 10 * Interval);
+		interpolator.Push(2 * Interval, second, 1, 10 * Interval);
+
+		CHECK_EQ(SampleAt(interpolator, 3 * Interval), 0xFF);
+		CHECK_EQ(SampleAt(interpolator, 3 * Interval, 1), 0);
+	}
+
+	void IntervalIsBounded()
+	{
+		static TwoChannels interpolator;
+		const unsigned char start[2] = { 0, 0 };
+		const unsigned char next[2] = { 200, 200 };
+
+		interpolator.SetMode(Mode::Linear);
+		interpolator.Reset(0, start);
+
+		//
+		// Submitted after a long pause, the glide still only takes MaxInterval
+		// 
+		interpolator.Push(100 * Interval, next, 1, Interval);
+
+		CHECK_EQ(SampleAt(interpolator, 100 * Interval + Interval / 2), 100);
+		CHECK_EQ(SampleAt(interpolator, 101 * Interval), 200);
+	}
+
+	void FractionSaturates()
+	{
+		CHECK_EQ(Fraction(0, 100), 0u);
+		CHECK_EQ(Fraction(50, 100), FractionOne / 2);
+		CHECK_EQ(Fraction(100, 100), FractionOne);
+		CHECK_EQ(Fraction(500, 100), FractionOne);
+		CHECK_EQ(Fraction(5, 0), FractionOne);
+	}
+}
+
+int main()
+{
+	NoneRepeatsLatestSample();
+	LinearGlidesOverOneInterval();
+	ExtrapolationOvershootsOnceThenSettles();
+	ExtrapolationClampsToRange();
+	IntervalIsBounded();
+	FractionSaturates();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,245 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "BatchOrder.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Reports per second for a feeder updating N targets, once as N independent
+// submissions (one round trip, one report lock each) and once as a batch
+// (one round trip, sorted by serial, merge and report locks of all targets
+// held while the caches are updated). The round trip is a real ioctl on a
+// pipe, a lower bound for DeviceIoControl. Every thread feeds the same
+// targets in its own shuffled order, so batches overlap like concurrent
+// feeders sharing pads. Run with the thread count as the only argument.
+// 
+namespace
+{
+	constexpr unsigned int TargetCount = 32;				// VIGEM_SUBMIT_REPORT_BATCH_MAX
+	constexpr auto Duration = std::chrono::milliseconds(300);
+
+	class SpinLock
+	{
+	public:
+		void Acquire()
+		{
+			while (_Locked.exchange(true, std::memory_order_acquire))
+			{
+				while (_Locked.load(std::memory_order_relaxed))
+					std::this_thread::yield();
+			}
+		}
+
+		void Release()
+		{
+			_Locked.store(false, std::memory_order_release);
+		}
+
+	private:
+		std::atomic<bool> _Locked{ false };
+	};
+
+	struct Report
+	{
+		unsigned char Data[12];
+	};
+
+	struct Target
+	{
+		unsigned int SerialNo;
+
+		alignas(64) SpinLock ReportLock;
+		Report Cache;
+
+		alignas(64) SpinLock MergeLock;
+	};
+
+	Target Targets[TargetCount];
+
+	int PipeFds[2];
+
+	//
+	// User/kernel round trip standing in for DeviceIoControl
+	// 
+	void RoundTrip()
+	{
+		int queued = 0;
+
+		if (ioctl(PipeFds[0], FIONREAD, &queued) != 0)
+			std::abort();
+	}
+
+	bool UpdateCache(Target* Pad, const Report* NewReport)
+	{
+		const bool changed = std::memcmp(&Pad->Cache, NewReport, sizeof(Report)) != 0;
+
+		Pad->Cache = *NewReport;
+
+		return changed;
+	}
+
+	void SubmitIndependently(Target** Pads, const Report* Reports, unsigned int Count)
+	{
+		for (unsigned int i = 0; i < Count; i++)
+		{
+			RoundTrip();
+
+			Pads[i]->ReportLock.Acquire();
+			(void)UpdateCache(Pads[i], &Reports[i]);
+			Pads[i]->ReportLock.Release();
+		}
+	}
+
+	void SubmitBatch(Target** Pads, const Report* Reports, unsigned int Count)
+	{
+		const Report* reports[TargetCount];
+		bool changed[TargetCount];
+
+		RoundTrip();
+
+		for (unsigned int i = 0; i < Count; i++)
+			reports[i] = &Reports[i];
+
+		const auto getSerial = [](const Target* Pad) { return Pad->SerialNo; };
+
+		BatchOrder::SortBySerial(Pads, reports, Count, getSerial);
+
+		if (BatchOrder::FindDuplicateSerial(Pads, Count, getSerial) < Count)
+			std::abort();
+
+		for (unsigned int i = 0; i < Count; i++)
+			Pads[i]->MergeLock.Acquire();
+
+		for (unsigned int i = 0; i < Count; i++)
+			Pads[i]->ReportLock.Acquire();
+
+		for (unsigned int i = 0; i < Count; i++)
+			changed[i] = UpdateCache(Pads[i], reports[i]);
+
+		for (unsigned int i = Count; i > 0; i--)
+			Pads[i - 1]->ReportLock.Release();
+
+		for (unsigned int i = Count; i > 0; i--)
+			Pads[i - 1]->MergeLock.Release();
+
+		(void)changed;
+	}
+
+	template <typename TSubmit>
+	double ReportsPerSecond(unsigned int Threads, unsigned int Count, TSubmit Submit)
+	{
+		std::vector<std::thread> threads;
+		std::vector<unsigned long long> counts(Threads * 8);
+		const auto until = std::chrono::steady_clock::now() + Duration;
+
+		for (unsigned int t = 0; t < Threads; t++)
+		{
+			threads.emplace_back([&, t]
+			{
+				std::mt19937 random(t + 1);
+				Target* pads[TargetCount];
+				Report reports[TargetCount]{};
+				unsigned long long submitted = 0;
+
+				for (unsigned int i = 0; i < TargetCount; i++)
+					pads[i] = &Targets[i];
+
+				while (std::chrono::steady_clock::now() < until)
+				{
+					for (unsigned int round = 0; round < 64; round++)
+					{
+						std::shuffle(pads, pads + TargetCount, random);
+
+						for (unsigned int i = 0; i < Count; i++)
+							reports[i].Data[0] = static_cast<unsigned char>(submitted + i);
+
+						Submit(pads, reports, Count);
+						submitted += Count;
+					}
+				}
+
+				counts[t * 8] = submitted;
+			});
+		}
+
+		unsigned long long total = 0;
+
+		for (unsigned int t = 0; t < Threads; t++)
+		{
+			threads[t].join();
+			total += counts[t * 8];
+		}
+
+		return total / std::chrono::duration<double>(Duration).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned int threads = (argc > 1) ? static_cast<unsigned int>(std::atoi(argv[1])) : 1;
+
+	if (pipe(PipeFds) != 0)
+		return 1;
+
+	for (unsigned int i = 0; i < TargetCount; i++)
+		Targets[i].SerialNo = i + 1;
+
+	std::printf("%u thread(s), million reports/s\n", threads);
+
+	for (const unsigned int count : { 1u, 4u, 8u, 16u, 32u })
+	{
+		const double independent = ReportsPerSecond(threads, count, SubmitIndependently);
+		const double batch = ReportsPerSecond(threads, count, SubmitBatch);
+
+		std::printf("%2u targets  independent %6.2f  batch %6.2f\n", count, independent / 1e6, batch / 1e6);
+	}
+
+	close(PipeFds[0]);
+	close(PipeFds[1]);
+
+	return 0;
+}
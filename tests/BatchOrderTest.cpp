@@ -0,0 +1,183 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "BatchOrder.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	struct Target
+	{
+		unsigned long SerialNo{};
+		std::mutex ReportLock{};
+		unsigned long Report{};
+	};
+
+	const auto GetSerial = [](const Target* T) { return T->SerialNo; };
+
+	void SortKeepsReportsWithTargets()
+	{
+		Target targets[5]{ {4}, {1}, {5}, {3}, {2} };
+		Target* order[5];
+		unsigned long reports[5];
+
+		for (int i = 0; i < 5; i++)
+		{
+			order[i] = &targets[i];
+			reports[i] = targets[i].SerialNo * 100;
+		}
+
+		BatchOrder::SortBySerial(order, reports, 5, GetSerial);
+
+		for (unsigned long i = 0; i < 5; i++)
+		{
+			CHECK_EQ(order[i]->SerialNo, i + 1);
+			CHECK_EQ(reports[i], (i + 1) * 100);
+		}
+
+		CHECK_EQ(BatchOrder::FindDuplicateSerial(order, 5, GetSerial), 5ul);
+	}
+
+	void DuplicatesAreFound()
+	{
+		Target targets[4]{ {7}, {2}, {7}, {9} };
+		Target* order[4] = { &targets[0], &targets[1], &targets[2], &targets[3] };
+		int reports[4]{};
+
+		BatchOrder::SortBySerial(order, reports, 4, GetSerial);
+
+		const auto duplicate = BatchOrder::FindDuplicateSerial(order, 4, GetSerial);
+
+		CHECK(duplicate < 4);
+		CHECK_EQ(order[duplicate]->SerialNo, 7ul);
+	}
+
+	//
+	// Mirrors the driver's batch commit: lock all targets in serial order,
+	// update every cache, unlock. Batches are handed in shuffled, a reader
+	// locking the same set must never see caches from different batches.
+	// 
+	void ConcurrentBatchesApplyAtomically()
+	{
+		constexpr unsigned long targetCount = 8;
+		constexpr int writers = 4;
+		constexpr int batchesPerWriter = 20000;
+
+		std::vector<Target> targets(targetCount);
+
+		for (unsigned long i = 0; i < targetCount; i++)
+			targets[i].SerialNo = i + 1;
+
+		std::atomic<bool> done{ false };
+		std::atomic<int> torn{ 0 };
+		std::vector<std::thread> threads;
+
+		for (int w = 0; w < writers; w++)
+		{
+			threads.emplace_back([&, w]
+			{
+				std::mt19937 rng(w);
+				Target* order[targetCount];
+				unsigned long reports[targetCount];
+
+				for (int b = 0; b < batchesPerWriter; b++)
+				{
+					for (unsigned long i = 0; i < targetCount; i++)
+						order[i] = &targets[i];
+
+					std::shuffle(order, order + targetCount, rng);
+
+					const unsigned long batchId = static_cast<unsigned long>(w) * batchesPerWriter + b + 1;
+					std::fill(reports, reports + targetCount, batchId);
+
+					BatchOrder::SortBySerial(order, reports, targetCount, GetSerial);
+
+					for (unsigned long i = 0; i < targetCount; i++)
+						order[i]->ReportLock.lock();
+
+					for (unsigned long i = 0; i < targetCount; i++)
+						order[i]->Report = reports[i];
+
+					for (unsigned long i = targetCount; i > 0; i--)
+						order[i - 1]->ReportLock.unlock();
+				}
+			});
+		}
+
+		std::thread reader([&]
+		{
+			while (!done)
+			{
+				for (auto& target : targets)
+					target.ReportLock.lock();
+
+				for (auto& target : targets)
+				{
+					if (target.Report != targets[0].Report)
+						++torn;
+				}
+
+				for (auto it = targets.rbegin(); it != targets.rend(); ++it)
+					it->ReportLock.unlock();
+			}
+		});
+
+		for (auto& thread : threads)
+			thread.join();
+
+		done = true;
+		reader.join();
+
+		CHECK_EQ(torn.load(), 0);
+	}
+}
+
+int main()
+{
+	SortKeepsReportsWithTargets();
+	DuplicatesAreFound();
+	ConcurrentBatchesApplyAtomically();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,171 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "BlockPool.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Allocate/free pairs per second with 1 to N threads, each holding a few
+// blocks like a target buffering interrupt OUT transfers: the shared
+// lock-free pool against a free list behind one lock. Run with the thread
+// count as the only argument.
+// 
+namespace
+{
+	using Pool = BlockPool<128>;
+
+	constexpr unsigned int Capacity = 1024;
+	constexpr unsigned int Reserve = 256;
+	constexpr unsigned int Held = 8;
+	constexpr auto Duration = std::chrono::milliseconds(500);
+
+	template <typename TWorker>
+	double PairsPerSecond(unsigned int Threads, TWorker Worker)
+	{
+		std::vector<std::thread> threads;
+		std::vector<unsigned long long> counts(Threads * 8);
+		const auto until = std::chrono::steady_clock::now() + Duration;
+
+		for (unsigned int t = 0; t < Threads; t++)
+			threads.emplace_back([&, t] { counts[t * 8] = Worker(until); });
+
+		unsigned long long total = 0;
+
+		for (unsigned int t = 0; t < Threads; t++)
+		{
+			threads[t].join();
+			total += counts[t * 8];
+		}
+
+		return total / std::chrono::duration<double>(Duration).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned int maxThreads = (argc > 1)
+		? static_cast<unsigned int>(std::atoi(argv[1]))
+		: std::thread::hardware_concurrency();
+
+	std::vector<unsigned char> storage(Pool::StorageSize(Capacity));
+	static Pool pool{};
+
+	pool.Initialize(storage.data(), Capacity, Reserve);
+
+	std::mutex lock;
+	std::vector<unsigned int> freeList;
+
+	for (unsigned int i = 0; i < Capacity; i++)
+		freeList.push_back(i);
+
+	std::printf("threads  block pool/s  locked list/s\n");
+
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		const double lockFree = PairsPerSecond(threads, [&](auto Until)
+		{
+			PoolAccount account{};
+			unsigned int held[Held];
+			unsigned long long pairs = 0;
+
+			for (unsigned int k = 0; k < Held; k++)
+				held[k] = pool.Allocate(account, { Held, 64 });
+
+			while (std::chrono::steady_clock::now() < Until)
+			{
+				for (unsigned int i = 0; i < 1024; i++, pairs++)
+				{
+					const unsigned int k = i % Held;
+
+					pool.Free(account, held[k]);
+					held[k] = pool.Allocate(account, { Held, 64 });
+				}
+			}
+
+			for (unsigned int k = 0; k < Held; k++)
+				pool.Free(account, held[k]);
+
+			return pairs;
+		});
+
+		const double locked = PairsPerSecond(threads, [&](auto Until)
+		{
+			unsigned int held[Held];
+			unsigned long long pairs = 0;
+
+			for (unsigned int k = 0; k < Held; k++)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				held[k] = freeList.back();
+				freeList.pop_back();
+			}
+
+			while (std::chrono::steady_clock::now() < Until)
+			{
+				for (unsigned int i = 0; i < 1024; i++, pairs++)
+				{
+					const unsigned int k = i % Held;
+
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						freeList.push_back(held[k]);
+					}
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						held[k] = freeList.back();
+						freeList.pop_back();
+					}
+				}
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+
+			for (unsigned int k = 0; k < Held; k++)
+				freeList.push_back(held[k]);
+
+			return pairs;
+		});
+
+		std::printf("%7u  %12.0f  %13.0f\n", threads, lockFree, locked);
+	}
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "BlockPool.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	using Pool = BlockPool<128>;
+
+	constexpr unsigned int Capacity = 1024;
+	constexpr unsigned int Reserve = 256;
+
+	void QuotasAreEnforced()
+	{
+		std::vector<unsigned char> storage(Pool::StorageSize(Capacity));
+		Pool pool{};
+		PoolAccount account{};
+		std::vector<unsigned int> held;
+
+		pool.Initialize(storage.data(), Capacity, Reserve);
+
+		for (int i = 0; i < 10; i++)
+		{
+			const auto block = pool.Allocate(account, { 4, 8 });
+
+			if (block != Pool::NoBlock)
+				held.push_back(block);
+		}
+
+		CHECK_EQ(held.size(), 8u);
+		CHECK_EQ(account.InUse, 8);
+		CHECK_EQ(account.Overruns, 2);
+		CHECK_EQ(pool.FreeCount(), Capacity - 8);
+
+		for (const auto block : held)
+			pool.Free(account, block);
+
+		CHECK_EQ(account.InUse, 0);
+		CHECK_EQ(pool.FreeCount(), Capacity);
+	}
+
+	//
+	// Above its soft quota a consumer stops at the reserve, which stays
+	// available to consumers still within theirs
+	// 
+	void ReserveIsKeptForOthers()
+	{
+		std::vector<unsigned char> storage(Pool::StorageSize(Capacity));
+		Pool pool{};
+		PoolAccount chatty{}, quiet{};
+		std::vector<unsigned int> held;
+
+		pool.Initialize(storage.data(), Capacity, Reserve);
+
+		for (;;)
+		{
+			const auto block = pool.Allocate(chatty, { 0, Capacity });
+
+			if (block == Pool::NoBlock)
+				break;
+
+			held.push_back(block);
+		}
+
+		CHECK_EQ(held.size(), Capacity - Reserve);
+		CHECK_EQ(chatty.Throttled, 1);
+
+		const auto block = pool.Allocate(quiet, { 4, 64 });
+
+		CHECK(block != Pool::NoBlock);
+
+		pool.Free(quiet, block);
+
+		for (const auto b : held)
+			pool.Free(chatty, b);
+
+		CHECK_EQ(pool.FreeCount(), Capacity);
+	}
+
+	//
+	// Every thread stamps the blocks it holds; a block handed out twice shows
+	// up as a foreign stamp
+	// 
+	void ConcurrentUseNeverSharesBlocks()
+	{
+		constexpr int Threads = 4;
+		constexpr int Rounds = 200000;
+		constexpr int Held = 8;
+
+		std::vector<unsigned char> storage(Pool::StorageSize(Capacity));
+		static Pool pool{};
+		std::atomic<int> corrupted{ 0 };
+		std::vector<std::thread> threads;
+
+		pool.Initialize(storage.data(), Capacity, Reserve);
+
+		for (int t = 0; t < Threads; t++)
+			threads.emplace_back([&, t]
+			{
+				PoolAccount account{};
+				unsigned int held[Held];
+
+				for (int i = 0; i < Rounds; i++)
+				{
+					const int k = i % Held;
+
+					if (i >= Held)
+					{
+						const unsigned char* block = pool.Block(held[k]);
+
+						if (block[0] != t || block[127] != k)
+							corrupted++;
+
+						pool.Free(account, held[k]);
+					}
+
+					held[k] = pool.Allocate(account, { Held, 64 });
+
+					if (held[k] == Pool::NoBlock)
+					{
+						corrupted++;
+						return;
+					}
+
+					unsigned char* block = pool.Block(held[k]);
+
+					std::memset(block, t, 127);
+					block[127] = static_cast<unsigned char>(k);
+				}
+
+				for (int k = 0; k < Held; k++)
+					pool.Free(account, held[k]);
+
+				if (account.InUse != 0)
+					corrupted++;
+			});
+
+		for (auto& thread : threads)
+			thread.join();
+
+		CHECK_EQ(corrupted.load(), 0);
+		CHECK_EQ(pool.FreeCount(), Capacity);
+	}
+}
+
+int main()
+{
+	QuotasAreEnforced();
+	ReserveIsKeptForOthers();
+	ConcurrentUseNeverSharesBlocks();
+
+	return ViGEm::Tests::Result();
+}
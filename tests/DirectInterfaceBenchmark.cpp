@@ -0,0 +1,216 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "DirectClient.hpp"
+#include "TargetIndexStripe.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Nanoseconds per report submission through the direct-call interface
+// against the IOCTL path. Both run the same bus-side work: rundown, striped
+// lookup, ownership check and a locked report copy. The IOCTL path adds a
+// real user/kernel round trip (ioctl on a pipe) and the METHOD_BUFFERED copy
+// into a system buffer; a Windows DeviceIoControl costs more than this, so
+// the gap is a lower bound.
+// 
+namespace
+{
+	constexpr unsigned int Rounds = 2000000;
+	constexpr unsigned int DriverSerial = 3;
+	constexpr unsigned int UserSerial = 4;
+
+	struct Report
+	{
+		unsigned long Size;
+		unsigned long SerialNo;
+		unsigned char Data[12];
+	};
+
+	struct Target
+	{
+		long SessionId;
+		bool OwnerIsDriver;
+		long OwnerProcessId;
+		std::atomic_flag ReportLock = ATOMIC_FLAG_INIT;
+		unsigned char Data[12];
+	};
+
+	struct Bus
+	{
+		std::atomic<long> Rundown{ 0 };
+		std::atomic_flag StripeLock = ATOMIC_FLAG_INIT;
+		TargetIndexStripe<Target, 8> Stripe{};
+	};
+
+	void Acquire(std::atomic_flag& Lock)
+	{
+		while (Lock.test_and_set(std::memory_order_acquire))
+			;
+	}
+
+	void Release(std::atomic_flag& Lock)
+	{
+		Lock.clear(std::memory_order_release);
+	}
+
+	//
+	// Everything past the entry point, shared by both paths
+	// 
+	template <typename TOwns>
+	int Deliver(Bus& Device, const Report* Submit, TOwns Owns)
+	{
+		Target* target;
+		int status = 0;
+
+		Device.Rundown.fetch_add(1, std::memory_order_acquire);
+
+		Acquire(Device.StripeLock);
+		Device.Stripe.Lookup(Submit->SerialNo, target);
+		Release(Device.StripeLock);
+
+		if (target == nullptr)
+			status = 1;
+		else if (!Owns(*target))
+			status = 2;
+		else
+		{
+			Acquire(target->ReportLock);
+			std::memcpy(target->Data, Submit->Data, sizeof(target->Data));
+			Release(target->ReportLock);
+		}
+
+		Device.Rundown.fetch_sub(1, std::memory_order_release);
+
+		return status;
+	}
+
+	int DirectSubmitReport(void* Context, void* Submit)
+	{
+		const auto client = static_cast<DirectClient<Bus*>*>(Context);
+
+		return Deliver(*client->Device, static_cast<const Report*>(Submit), [client](const Target& Entry)
+		{
+			return client->Owns(Entry.SessionId, Entry.OwnerIsDriver);
+		});
+	}
+
+	//
+	// Entry point of the interface as a caller sees it, through a pointer
+	// 
+	struct Interface
+	{
+		void* Context;
+		int (*SubmitReport)(void*, void*);
+	};
+
+	template <typename TSubmit>
+	double NanosecondsPerSubmit(unsigned long Serial, TSubmit Submit)
+	{
+		Report report{ sizeof(Report), Serial, {} };
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int r = 0; r < Rounds; r++)
+		{
+			report.Data[0] = static_cast<unsigned char>(r);
+
+			if (Submit(report) != 0)
+				return -1.0;
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / Rounds;
+	}
+}
+
+int main()
+{
+	static Bus bus;
+	static Target driverTarget, userTarget;
+	int pipeFds[2];
+
+	if (pipe(pipeFds) != 0)
+		return 1;
+
+	DirectClient<Bus*> client{ &bus, 101, 1 };
+	const long ownerProcess = getpid();
+
+	driverTarget.SessionId = client.SessionId;
+	driverTarget.OwnerIsDriver = true;
+	bus.Stripe.Insert(DriverSerial, &driverTarget);
+
+	userTarget.SessionId = 102;
+	userTarget.OwnerProcessId = ownerProcess;
+	bus.Stripe.Insert(UserSerial, &userTarget);
+
+	volatile Interface busInterface{ &client, DirectSubmitReport };
+
+	const double direct = NanosecondsPerSubmit(DriverSerial, [&](Report& Submit)
+	{
+		return busInterface.SubmitReport(busInterface.Context, &Submit);
+	});
+
+	const double ioctlPath = NanosecondsPerSubmit(UserSerial, [&](Report& Submit)
+	{
+		int queued;
+		Report systemBuffer;
+
+		if (ioctl(pipeFds[0], FIONREAD, &queued) != 0)
+			return -1;
+
+		std::memcpy(&systemBuffer, &Submit, sizeof(systemBuffer));
+
+		return Deliver(bus, &systemBuffer, [&](const Target& Entry)
+		{
+			return !Entry.OwnerIsDriver && Entry.OwnerProcessId == ownerProcess;
+		});
+	});
+
+	std::printf("direct call  %6.1f ns\n", direct);
+	std::printf("ioctl path   %6.1f ns\n", ioctlPath);
+
+	close(pipeFds[0]);
+	close(pipeFds[1]);
+
+	return 0;
+}
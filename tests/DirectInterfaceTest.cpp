@@ -0,0 +1,310 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "DirectClient.hpp"
+
+#include <map>
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Simulation of the direct-call interface contract on top of the portable
+// client: the bus below stands in for the child list, the session sequence
+// and the removal rundown, the entry points mirror those in BusInterface.cpp
+// 
+namespace
+{
+	enum Status
+	{
+		Success,
+		AccessDenied,
+		DoesNotExist,
+		DeviceRemoved,
+		Collision
+	};
+
+	struct SimulatedTarget
+	{
+		long SessionId;
+		bool OwnerIsDriver;
+		int Reports;
+		bool HasCallback;
+	};
+
+	struct SimulatedBus
+	{
+		long NextSessionId = 100;
+		long References = 0;
+		bool Removed = false;
+		std::map<unsigned long, SimulatedTarget> Children;
+
+		long OpenUserSession()
+		{
+			return ++NextSessionId;
+		}
+
+		DirectClient<SimulatedBus*>* Query()
+		{
+			const auto client = new DirectClient<SimulatedBus*>{ this, ++NextSessionId, 0 };
+
+			Reference(client);
+
+			return client;
+		}
+
+		static void Reference(DirectClient<SimulatedBus*>* Client)
+		{
+			Client->Reference();
+			Client->Device->References++;
+		}
+
+		static void Dereference(DirectClient<SimulatedBus*>* Client)
+		{
+			const auto bus = Client->Device;
+
+			if (Client->Dereference())
+				delete Client;
+
+			bus->References--;
+		}
+
+		Status PlugIn(long SessionId, unsigned long Serial, bool OwnerIsDriver)
+		{
+			if (Children.count(Serial) != 0)
+				return Collision;
+
+			Children[Serial] = { SessionId, OwnerIsDriver, 0, false };
+
+			return Success;
+		}
+
+		//
+		// Same matching as Bus_UnPlugTarget without IsInternal
+		// 
+		void UnPlug(long SessionId, unsigned long Serial)
+		{
+			for (auto it = Children.begin(); it != Children.end();)
+			{
+				if ((Serial == 0 || it->first == Serial) && it->second.SessionId == SessionId)
+					it = Children.erase(it);
+				else
+					++it;
+			}
+		}
+	};
+
+	Status GetOwnedTarget(DirectClient<SimulatedBus*>* Client, unsigned long Serial, SimulatedTarget** Target)
+	{
+		const auto it = Client->Device->Children.find(Serial);
+
+		if (it == Client->Device->Children.end())
+			return DoesNotExist;
+
+		if (!Client->Owns(it->second.SessionId, it->second.OwnerIsDriver))
+			return AccessDenied;
+
+		*Target = &it->second;
+
+		return Success;
+	}
+
+	Status DirectPlugIn(DirectClient<SimulatedBus*>* Client, unsigned long Serial)
+	{
+		if (Client->Device->Removed)
+			return DeviceRemoved;
+
+		return Client->Device->PlugIn(Client->SessionId, Serial, true);
+	}
+
+	Status DirectUnPlug(DirectClient<SimulatedBus*>* Client, unsigned long Serial)
+	{
+		if (Client->Device->Removed)
+			return DeviceRemoved;
+
+		Client->Device->UnPlug(Client->SessionId, Serial);
+
+		return Success;
+	}
+
+	Status DirectSubmit(DirectClient<SimulatedBus*>* Client, unsigned long Serial)
+	{
+		SimulatedTarget* target = nullptr;
+
+		if (Client->Device->Removed)
+			return DeviceRemoved;
+
+		const auto status = GetOwnedTarget(Client, Serial, &target);
+
+		if (status == Success)
+			target->Reports++;
+
+		return status;
+	}
+
+	Status DirectRegister(DirectClient<SimulatedBus*>* Client, unsigned long Serial)
+	{
+		SimulatedTarget* target = nullptr;
+
+		if (Client->Device->Removed)
+			return DeviceRemoved;
+
+		const auto status = GetOwnedTarget(Client, Serial, &target);
+
+		if (status == Success)
+			target->HasCallback = true;
+
+		return status;
+	}
+
+	void EveryQueryGetsItsOwnToken()
+	{
+		SimulatedBus bus;
+
+		const long user = bus.OpenUserSession();
+		const auto a = bus.Query();
+		const auto b = bus.Query();
+
+		CHECK(a->SessionId != b->SessionId);
+		CHECK(a->SessionId != user);
+		CHECK(b->SessionId != user);
+
+		SimulatedBus::Dereference(a);
+		SimulatedBus::Dereference(b);
+
+		CHECK_EQ(bus.References, 0);
+	}
+
+	void ClientsOnlyReachTheirOwnTargets()
+	{
+		SimulatedBus bus;
+
+		const auto a = bus.Query();
+		const auto b = bus.Query();
+
+		CHECK_EQ(DirectPlugIn(a, 1), Success);
+		CHECK_EQ(DirectPlugIn(a, 2), Success);
+		CHECK_EQ(DirectPlugIn(b, 3), Success);
+		CHECK_EQ(DirectPlugIn(b, 1), Collision);
+
+		CHECK_EQ(DirectSubmit(a, 1), Success);
+		CHECK_EQ(DirectSubmit(b, 1), AccessDenied);
+		CHECK_EQ(DirectSubmit(b, 4), DoesNotExist);
+		CHECK_EQ(bus.Children[1].Reports, 1);
+
+		CHECK_EQ(DirectRegister(b, 2), AccessDenied);
+		CHECK_EQ(DirectRegister(a, 2), Success);
+		CHECK(bus.Children[2].HasCallback);
+
+		CHECK_EQ(DirectUnPlug(b, 1), Success);
+		CHECK_EQ(bus.Children.count(1), 1u);
+
+		SimulatedBus::Dereference(a);
+		SimulatedBus::Dereference(b);
+	}
+
+	void UnplugAllStaysWithinTheClient()
+	{
+		SimulatedBus bus;
+
+		const long user = bus.OpenUserSession();
+		const auto a = bus.Query();
+		const auto b = bus.Query();
+
+		CHECK_EQ(bus.PlugIn(user, 10, false), Success);
+		CHECK_EQ(DirectPlugIn(a, 1), Success);
+		CHECK_EQ(DirectPlugIn(a, 2), Success);
+		CHECK_EQ(DirectPlugIn(b, 3), Success);
+
+		CHECK_EQ(DirectUnPlug(a, 0), Success);
+
+		CHECK_EQ(bus.Children.size(), 2u);
+		CHECK_EQ(bus.Children.count(3), 1u);
+		CHECK_EQ(bus.Children.count(10), 1u);
+
+		//
+		// A user-mode target is never the client's, even though it isn't driver-owned
+		// 
+		CHECK_EQ(DirectSubmit(b, 10), AccessDenied);
+
+		SimulatedBus::Dereference(a);
+		SimulatedBus::Dereference(b);
+	}
+
+	void ReferencesKeepTheClientAlive()
+	{
+		SimulatedBus bus;
+
+		const auto a = bus.Query();
+
+		SimulatedBus::Reference(a);
+		CHECK_EQ(bus.References, 2);
+
+		SimulatedBus::Dereference(a);
+		CHECK_EQ(a->References, 1);
+		CHECK_EQ(DirectPlugIn(a, 1), Success);
+
+		SimulatedBus::Dereference(a);
+		CHECK_EQ(bus.References, 0);
+	}
+
+	void CallsFailOnceTheBusIsGone()
+	{
+		SimulatedBus bus;
+
+		const auto a = bus.Query();
+
+		CHECK_EQ(DirectPlugIn(a, 1), Success);
+
+		bus.Removed = true;
+
+		CHECK_EQ(DirectSubmit(a, 1), DeviceRemoved);
+		CHECK_EQ(DirectRegister(a, 1), DeviceRemoved);
+		CHECK_EQ(DirectUnPlug(a, 1), DeviceRemoved);
+		CHECK_EQ(DirectPlugIn(a, 2), DeviceRemoved);
+
+		SimulatedBus::Dereference(a);
+	}
+}
+
+int main()
+{
+	EveryQueryGetsItsOwnToken();
+	ClientsOnlyReachTheirOwnTargets();
+	UnplugAllStaysWithinTheClient();
+	ReferencesKeepTheClientAlive();
+	CallsFailOnceTheBusIsGone();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,137 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "Ds4ReportClock.hpp"
+
+#include "Check.hpp"
+
+#include <cstring>
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	constexpr unsigned int ReportSize = 64;
+
+	//
+	// 16/3 microseconds per timestamp unit, 100ns ticks
+	// 
+	void ConvertsTicksToSensorUnits()
+	{
+		static_assert(Ds4ReportClock::TimestampFromTicks(0) == 0, "Zero");
+		static_assert(Ds4ReportClock::TimestampFromTicks(53) == 0, "Just below one unit");
+		static_assert(Ds4ReportClock::TimestampFromTicks(54) == 1, "One unit is 53.3 ticks");
+		static_assert(Ds4ReportClock::TimestampFromTicks(160) == 3, "16 microseconds are 3 units");
+
+		CHECK_EQ(Ds4ReportClock::TimestampFromTicks(1600000), 30000u);
+
+		//
+		// One second is 187500 units, the 16-bit stamp keeps the low part
+		// 
+		CHECK_EQ(Ds4ReportClock::TimestampFromTicks(10000000), 187500u & 0xFFFF);
+
+		//
+		// 2^16 units are 349.5 ms, the stamp wraps to 0 there
+		// 
+		CHECK_EQ(Ds4ReportClock::TimestampFromTicks(3495254), 0u);
+		CHECK_EQ(Ds4ReportClock::TimestampFromTicks(3495253), 0xFFFFu);
+	}
+
+	void WritesTimestampLittleEndian()
+	{
+		unsigned char report[ReportSize]{};
+
+		// 0x1234 units
+		Ds4ReportClock::Stamp(report, 0, 248534);
+
+		CHECK_EQ(report[Ds4ReportClock::TimestampOffset], 0x34);
+		CHECK_EQ(report[Ds4ReportClock::TimestampOffset + 1], 0x12);
+	}
+
+	//
+	// The counter shares its byte with the two special buttons, which must
+	// survive every stamp including the wrap from 63 to 0
+	// 
+	void CounterWrapKeepsSpecialButtons()
+	{
+		for (unsigned char special = 0; special < 4; special++)
+		{
+			unsigned char report[ReportSize]{};
+
+			report[Ds4ReportClock::CounterOffset] = special;
+
+			for (unsigned int counter = 0; counter < 200; counter++)
+			{
+				Ds4ReportClock::Stamp(report, counter, 0);
+
+				const unsigned char value = report[Ds4ReportClock::CounterOffset];
+
+				CHECK_EQ(value & 0x03, special);
+				CHECK_EQ(value >> 2, counter % 64);
+			}
+		}
+	}
+
+	void LeavesOtherBytesAlone()
+	{
+		unsigned char report[ReportSize];
+		unsigned char expected[ReportSize];
+
+		std::memset(report, 0xA5, sizeof(report));
+		std::memcpy(expected, report, sizeof(report));
+
+		Ds4ReportClock::Stamp(report, 0x2A, 248534);
+
+		for (unsigned int i = 0; i < ReportSize; i++)
+		{
+			if (i == Ds4ReportClock::CounterOffset
+				|| i == Ds4ReportClock::TimestampOffset
+				|| i == Ds4ReportClock::TimestampOffset + 1)
+				continue;
+
+			CHECK_EQ(report[i], expected[i]);
+		}
+
+		CHECK_EQ(report[Ds4ReportClock::CounterOffset], (0x2A << 2) | (0xA5 & 0x03));
+	}
+}
+
+int main()
+{
+	ConvertsTicksToSensorUnits();
+	WritesTimestampLittleEndian();
+	CounterWrapKeepsSpecialButtons();
+	LeavesOtherBytesAlone();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,145 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <ViGEm/km/Ds4ReportSchema.hpp>
+
+//
+// Included twice on purpose, the header must guard itself
+// 
+#include <ViGEm/km/Ds4ReportSchema.hpp>
+
+#include <cstring>
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	//
+	// Default input report the target used before the schema existed
+	// 
+	constexpr unsigned char LegacyNeutral[Ds4ReportSchema::ReportSize] =
+	{
+		0x01, 0x82, 0x7F, 0x7E, 0x80, 0x08, 0x00, 0x58,
+		0x00, 0x00, 0xFD, 0x63, 0x06, 0x03, 0x00, 0xFE,
+		0xFF, 0xFC, 0xFF, 0x79, 0xFD, 0x1B, 0x14, 0xD1,
+		0xE9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1B, 0x00,
+		0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x80,
+		0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00,
+		0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00,
+		0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00
+	};
+
+	void NeutralReportMatchesLegacy()
+	{
+		const auto neutral = Ds4ReportSchema::NeutralReport();
+
+		CHECK(std::memcmp(neutral.Bytes, LegacyNeutral, sizeof(LegacyNeutral)) == 0);
+	}
+
+	//
+	// Offsets the DS4_REPORT based code has always used
+	// 
+	void ElementsMatchDs4Report()
+	{
+		using namespace Ds4ReportSchema;
+
+		CHECK_EQ(LeftThumbX.ByteOffset(), 1u);
+		CHECK_EQ(LeftThumbY.ByteOffset(), 2u);
+		CHECK_EQ(RightThumbX.ByteOffset(), 3u);
+		CHECK_EQ(RightThumbY.ByteOffset(), 4u);
+		CHECK_EQ(ButtonState.BitOffset, 40u);
+		CHECK_EQ(ButtonState.BitSize, 18u);
+		CHECK_EQ(SpecialButtons.BitOffset, 56u);
+		CHECK_EQ(SpecialButtons.BitSize, 2u);
+		CHECK_EQ(FrameCounter.BitOffset, 58u);
+		CHECK_EQ(FrameCounter.BitSize, 6u);
+		CHECK_EQ(LeftTrigger.ByteOffset(), 8u);
+		CHECK_EQ(RightTrigger.ByteOffset(), 9u);
+		CHECK_EQ(Timestamp.ByteOffset(), 10u);
+		CHECK_EQ(Imu.ByteOffset(), 13u);
+	}
+
+	void SetOnlyTouchesItsBits()
+	{
+		using namespace Ds4ReportSchema;
+
+		unsigned char report[ReportSize];
+
+		std::memcpy(report, LegacyNeutral, sizeof(report));
+
+		CHECK_EQ(Get(report, ButtonState), 0x08u);
+		CHECK_EQ(Get(report, FrameCounter), 0x16u);
+
+		Set(report, ButtonState, 0x3FFF5);
+		CHECK_EQ(report[5], 0xF5);
+		CHECK_EQ(report[6], 0xFF);
+		CHECK_EQ(Get(report, SpecialButtons), 3u);
+		CHECK_EQ(Get(report, FrameCounter), 0x16u);
+
+		Set(report, FrameCounter, 0x3F);
+		CHECK_EQ(report[7], 0xFF);
+
+		Set(report, SpecialButtons, 0);
+		CHECK_EQ(report[7], 0xFC);
+
+		Set(report, ElementOf(DPad), 5);
+		CHECK_EQ(report[5], 0xF5);
+		CHECK_EQ(report[4], 0x80);
+
+		Set(report, LeftTrigger, 0xAB);
+		CHECK_EQ(Get(report, LeftTrigger), 0xABu);
+		CHECK_EQ(report[9], 0x00);
+	}
+
+	void InputDescriptorStartsTheCollection()
+	{
+		constexpr auto descriptor = Ds4ReportSchema::InputDescriptor();
+
+		const unsigned char head[] = { 0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01 };
+
+		CHECK(descriptor.Size > sizeof(head));
+		CHECK(std::memcmp(descriptor.Bytes, head, sizeof(head)) == 0);
+	}
+}
+
+int main()
+{
+	NeutralReportMatchesLegacy();
+	ElementsMatchDs4Report();
+	SetOnlyTouchesItsBits();
+	InputDescriptorStartsTheCollection();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,105 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "Endpoints.hpp"
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	//
+	// Same layout as the XUSB target's table
+	// 
+	constexpr EndpointTable<7> Xusb{{
+		{ 0x00, 0x81, 0x20, 0x04, EndpointPolicy::Report },
+		{ 0x00, 0x01, 0x20, 0x08, EndpointPolicy::Consume },
+		{ 0x01, 0x82, 0x20, 0x04, EndpointPolicy::Idle },
+		{ 0x01, 0x02, 0x20, 0x08, EndpointPolicy::Consume },
+		{ 0x01, 0x83, 0x20, 0x08, EndpointPolicy::Hold },
+		{ 0x01, 0x03, 0x20, 0x08, EndpointPolicy::Consume },
+		{ 0x02, 0x84, 0x20, 0x04, EndpointPolicy::Idle },
+	}};
+
+	static_assert(Xusb.IsValid(), "IN policies on IN endpoints, Consume on OUT");
+
+	void ResolvesHandedOutPipes()
+	{
+		for (const auto& endpoint : Xusb)
+			CHECK(Xusb.Resolve(PipeHandleOf(endpoint)) == &endpoint);
+
+		CHECK(Xusb.Resolve(0xFFFF0081)->Policy == EndpointPolicy::Report);
+		CHECK(Xusb.Resolve(0xFFFF0083)->Policy == EndpointPolicy::Hold);
+		CHECK(Xusb.Resolve(0xFFFF0084)->Policy == EndpointPolicy::Idle);
+		CHECK(Xusb.Resolve(0xFFFF0003)->Policy == EndpointPolicy::Consume);
+	}
+
+	void RejectsUnknownPipes()
+	{
+		CHECK(Xusb.Resolve(0) == nullptr);
+		CHECK(Xusb.Resolve(0xFFFF0085) == nullptr);
+		CHECK(Xusb.Resolve(0xFFFF0004) == nullptr);
+		CHECK(Xusb.Resolve(0xFFFF0091) == nullptr);
+		CHECK(Xusb.Resolve(0x12340081) == nullptr);
+	}
+
+	//
+	// Tagging an IN endpoint with the OUT policy, or the other way round,
+	// makes the table invalid
+	// 
+	void PolicyMustMatchDirection()
+	{
+		constexpr Endpoint inAsOut{ 0x01, 0x82, 0x20, 0x04, EndpointPolicy::Consume };
+		constexpr Endpoint outAsIn{ 0x01, 0x02, 0x20, 0x08, EndpointPolicy::Idle };
+
+		CHECK(!inAsOut.IsPolicyValid());
+		CHECK(!outAsIn.IsPolicyValid());
+
+		constexpr EndpointTable<2> mixed{{
+			{ 0x00, 0x81, 0x20, 0x04, EndpointPolicy::Report },
+			inAsOut,
+		}};
+
+		CHECK(!mixed.IsValid());
+	}
+}
+
+int main()
+{
+	ResolvesHandedOutPipes();
+	RejectsUnknownPipes();
+	PolicyMustMatchDirection();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,63 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//
+// Every portable header must compile with the host compiler and no WDK headers
+// 
+#include "BatchOrder.hpp"
+#include "TimerWheel.hpp"
+#include "ReportConversion.hpp"
+#include "InputMerge.hpp"
+#include "PlaybackScheduler.hpp"
+#include "AxisInterpolation.hpp"
+#include "SampleRing.hpp"
+#include "Ds4ReportClock.hpp"
+#include "OrderedDelivery.hpp"
+#include "ReportChannel.hpp"
+#include "TargetDescriptors.hpp"
+#include "XusbBootSequence.hpp"
+#include "Endpoints.hpp"
+#include "BlockPool.hpp"
+#include "TargetIndexStripe.hpp"
+#include "DirectClient.hpp"
+#include <ViGEm/km/UsbDescriptors.hpp>
+#include <ViGEm/km/Ds4ReportSchema.hpp>
+#include <ViGEm/km/ReportPacker.hpp>
+
+#include "Check.hpp"
+
+int main()
+{
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,177 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "InputMerge.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <initializer_list>
+
+using namespace ViGEm::Bus::Core::InputMerge;
+
+//
+// Nanoseconds per submission on a target merging input, for 1 to 8 active
+// layers and both axis rules: conversion to a Frame, layer update, merge of
+// all layers and conversion back, as UpdateLayer does under the merge lock.
+// The plain report copy of a target that doesn't merge is the baseline.
+// 
+namespace
+{
+	constexpr unsigned int Iterations = 10000000;
+	constexpr unsigned int MaxLayers = 8;				// VIGEM_MERGE_MAX_LAYERS
+
+	struct XusbReport
+	{
+		unsigned short wButtons;
+		unsigned char bLeftTrigger;
+		unsigned char bRightTrigger;
+		short sThumbLX;
+		short sThumbLY;
+		short sThumbRX;
+		short sThumbRY;
+	};
+
+	struct Ds4Report
+	{
+		unsigned char bThumbLX;
+		unsigned char bThumbLY;
+		unsigned char bThumbRX;
+		unsigned char bThumbRY;
+		unsigned short wButtons;
+		unsigned char bSpecial;
+		unsigned char bTriggerL;
+		unsigned char bTriggerR;
+	};
+
+	template <typename TSubmit>
+	double NanosecondsPerSubmit(TSubmit Submit)
+	{
+		volatile unsigned int sink = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < Iterations; i++)
+			sink = sink + Submit(i);
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / Iterations;
+	}
+
+	//
+	// Layers - 1 idle sessions hold their input, session 1 keeps submitting
+	// 
+	LayerSet<MaxLayers> Prepare(unsigned int Layers)
+	{
+		LayerSet<MaxLayers> set{};
+
+		for (unsigned int i = 1; i < Layers; i++)
+		{
+			const Frame idle{ 1u << i, { static_cast<unsigned char>(i * 20), 0 },
+				{ static_cast<short>(i * 1000), static_cast<short>(-i * 900), 0, 0 } };
+
+			set.Update(static_cast<long>(i + 1), static_cast<int>(i), idle);
+		}
+
+		return set;
+	}
+
+	double MeasureXusb(unsigned int Layers, AxisRule Rule)
+	{
+		auto set = Prepare(Layers);
+		XusbReport merged{};
+
+		return NanosecondsPerSubmit([&](unsigned int I)
+		{
+			const XusbReport report{ static_cast<unsigned short>(I), static_cast<unsigned char>(I), 0,
+				static_cast<short>(I * 7), static_cast<short>(I * 3), 0, 0 };
+			Frame frame{};
+
+			FromXusb(report, frame);
+			set.Update(1, 0, frame);
+			set.Merge(Rule, frame);
+			ToXusb(frame, merged);
+
+			return static_cast<unsigned int>(merged.sThumbLX + merged.wButtons);
+		});
+	}
+
+	double MeasureDs4(unsigned int Layers, AxisRule Rule)
+	{
+		auto set = Prepare(Layers);
+		Ds4Report merged{};
+
+		return NanosecondsPerSubmit([&](unsigned int I)
+		{
+			const Ds4Report report{ static_cast<unsigned char>(I), 0x80, 0x80, static_cast<unsigned char>(I >> 3),
+				static_cast<unsigned short>(0x8 | (I & 0x10)), 0, static_cast<unsigned char>(I), 0 };
+			Frame frame{};
+
+			FromDs4(report, frame);
+			set.Update(1, 0, frame);
+			set.Merge(Rule, frame);
+			ToDs4(frame, merged);
+
+			return static_cast<unsigned int>(merged.bThumbLX + merged.wButtons);
+		});
+	}
+}
+
+int main()
+{
+	XusbReport cache{};
+
+	const double copy = NanosecondsPerSubmit([&](unsigned int I)
+	{
+		const XusbReport report{ static_cast<unsigned short>(I), static_cast<unsigned char>(I), 0,
+			static_cast<short>(I * 7), static_cast<short>(I * 3), 0, 0 };
+
+		cache = report;
+
+		return static_cast<unsigned int>(cache.sThumbLX + cache.wButtons);
+	});
+
+	std::printf("no merging      %6.2f ns/submit\n", copy);
+
+	for (const unsigned int layers : { 1u, 2u, 4u, 8u })
+	{
+		std::printf("%u layer(s)  XUSB magnitude %6.2f  priority %6.2f   DS4 magnitude %6.2f  priority %6.2f ns/submit\n",
+			layers,
+			MeasureXusb(layers, AxisRule::MaxMagnitude),
+			MeasureXusb(layers, AxisRule::Priority),
+			MeasureDs4(layers, AxisRule::MaxMagnitude),
+			MeasureDs4(layers, AxisRule::Priority));
+	}
+
+	return 0;
+}
@@ -0,0 +1,157 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "InputMerge.hpp"
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core::InputMerge;
+
+namespace
+{
+	struct Ds4Report
+	{
+		unsigned char bThumbLX;
+		unsigned char bThumbLY;
+		unsigned char bThumbRX;
+		unsigned char bThumbRY;
+		unsigned short wButtons;
+		unsigned char bSpecial;
+		unsigned char bTriggerL;
+		unsigned char bTriggerR;
+	};
+
+	constexpr Ds4Report Ds4Neutral = { 0x80, 0x80, 0x80, 0x80, 0x8, 0, 0, 0 };
+
+	void ButtonsOrAxesFollowRule()
+	{
+		static LayerSet<8> layers;
+		Frame merged{};
+
+		const Frame first{ 0x0001, { 10, 0 }, { 100, -200, 0, 0 } };
+		const Frame second{ 0x1000, { 5, 50 }, { -300, 0, 0, 7 } };
+
+		CHECK(layers.Update(1, 0, first));
+		CHECK(layers.Update(2, 5, second));
+
+		layers.Merge(AxisRule::MaxMagnitude, merged);
+
+		CHECK_EQ(merged.Buttons, 0x1001u);
+		CHECK_EQ(merged.Axes[0], -300);
+		CHECK_EQ(merged.Axes[1], -200);
+		CHECK_EQ(merged.Triggers[0], 10);
+		CHECK_EQ(merged.Triggers[1], 50);
+
+		CHECK(layers.Update(1, 10, first));
+		layers.Merge(AxisRule::Priority, merged);
+
+		CHECK_EQ(merged.Axes[0], 100);
+		CHECK_EQ(merged.Axes[3], 7);
+
+		CHECK(layers.Release(2));
+		CHECK(!layers.Release(2));
+		CHECK_EQ(layers.Count(), 1u);
+	}
+
+	void FullSetRejectsNewSessions()
+	{
+		static LayerSet<2> layers;
+		const Frame input{};
+
+		CHECK(layers.Update(1, 0, input));
+		CHECK(layers.Update(2, 0, input));
+		CHECK(!layers.Update(3, 0, input));
+		CHECK(layers.Update(2, 1, input));
+	}
+
+	//
+	// A DS4 layer at rest must not outweigh a deflected layer or show up as deflection
+	// 
+	void Ds4CenterIsNeutral()
+	{
+		static LayerSet<4> layers;
+		Frame frame{};
+		Ds4Report out{};
+
+		FromDs4(Ds4Neutral, frame);
+
+		for (unsigned int a = 0; a < AxisCount; a++)
+			CHECK_EQ(frame.Axes[a], 0);
+
+		Ds4Report deflected = Ds4Neutral;
+		deflected.bThumbLX = 0x81;
+
+		Frame small{};
+		FromDs4(deflected, small);
+
+		CHECK(layers.Update(1, 10, frame));
+		CHECK(layers.Update(2, 0, small));
+
+		layers.Merge(AxisRule::Priority, frame);
+		ToDs4(frame, out);
+
+		CHECK_EQ(out.bThumbLX, 0x81);
+		CHECK_EQ(out.bThumbLY, 0x80);
+		CHECK_EQ(out.wButtons, 0x8);
+	}
+
+	void Ds4RoundTrip()
+	{
+		Frame frame{};
+		Ds4Report out{};
+
+		const Ds4Report in{ 0, 255, 128, 3, static_cast<unsigned short>(0x5 | 0x20 | 0x400), 3, 9, 0 };
+
+		FromDs4(in, frame);
+		ToDs4(frame, out);
+
+		CHECK_EQ(out.wButtons, in.wButtons);
+		CHECK_EQ(out.bSpecial, 3);
+		CHECK_EQ(out.bThumbLX, 0);
+		CHECK_EQ(out.bThumbLY, 255);
+		CHECK_EQ(out.bThumbRX, 128);
+		CHECK_EQ(out.bThumbRY, 3);
+		CHECK_EQ(out.bTriggerL, 9);
+	}
+}
+
+int main()
+{
+	ButtonsOrAxesFollowRule();
+	FullSetRejectsNewSessions();
+	Ds4CenterIsNeutral();
+	Ds4RoundTrip();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,214 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+//
+// Per-request cost of the interrupt IN fast path in the internal I/O control
+// handler against the traced dispatch it bypasses: FuncEntry, the
+// ">> IOCTL_INTERNAL_USB_SUBMIT_URB" and "<<" messages, the per-URB message
+// and the exit message, plus the stack location lookup and the URB switch.
+// Trace points are modelled after WPP: a level and flag check against the
+// control block, and when a session or the in-flight recorder takes verbose
+// messages, an out-of-line call reserving a record in a shared buffer and
+// copying the arguments. Real ETW also timestamps and manages buffers, so
+// the enabled numbers are a lower bound.
+// 
+namespace
+{
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+	constexpr unsigned int Iterations = 20000000;
+
+	constexpr unsigned int TraceLevelVerbose = 5;
+	constexpr unsigned int TraceBusPdo = 1u << 3;
+
+	constexpr unsigned short FunctionControlTransfer = 0x0008;
+	constexpr unsigned short FunctionBulkOrInterruptTransfer = 0x0009;
+	constexpr unsigned int TransferDirectionIn = 0x1;
+
+	//
+	// WPP_CONTROL block of the provider, written when sessions attach
+	// 
+	struct TraceControl
+	{
+		volatile unsigned int Flags;
+		volatile unsigned char Level;
+	};
+
+	TraceControl Control{};
+
+	struct TraceRecord
+	{
+		unsigned short MessageId;
+		unsigned short Size;
+		unsigned int Argument;
+		unsigned long long Data[3];
+	};
+
+	constexpr unsigned int BufferRecords = 4096;
+
+	TraceRecord Buffer[BufferRecords];
+	std::atomic<unsigned int> BufferNext{ 0 };
+
+	BENCH_NOINLINE void TraceMessage(unsigned short MessageId, unsigned int Argument)
+	{
+		const unsigned int slot = BufferNext.fetch_add(1, std::memory_order_relaxed) % BufferRecords;
+
+		Buffer[slot].MessageId = MessageId;
+		Buffer[slot].Size = sizeof(TraceRecord);
+		Buffer[slot].Argument = Argument;
+	}
+
+	inline void TraceVerbose(unsigned int Flag, unsigned short MessageId, unsigned int Argument = 0)
+	{
+		if ((Control.Flags & Flag) && Control.Level >= TraceLevelVerbose)
+			TraceMessage(MessageId, Argument);
+	}
+
+	struct Urb
+	{
+		unsigned short Function;
+		unsigned int TransferFlags;
+		unsigned int TransferBufferLength;
+	};
+
+	struct Irp
+	{
+		Urb* Request;
+		unsigned char StackLocations[4][72];
+		unsigned int CurrentLocation;
+	};
+
+	class Target
+	{
+	public:
+		BENCH_NOINLINE long UsbBulkOrInterruptTransfer(Urb* Transfer)
+		{
+			Transfer->TransferBufferLength = 20;
+			return 0;
+		}
+
+		BENCH_NOINLINE long UsbControlTransfer(Urb* Transfer)
+		{
+			return static_cast<long>(Transfer->TransferBufferLength);
+		}
+	};
+
+	long UrbDispatch(Target* Pad, Urb* Request)
+	{
+		switch (Request->Function)
+		{
+		case FunctionBulkOrInterruptTransfer:
+			TraceVerbose(TraceBusPdo, 3);
+			return Pad->UsbBulkOrInterruptTransfer(Request);
+		case FunctionControlTransfer:
+			TraceVerbose(TraceBusPdo, 4);
+			return Pad->UsbControlTransfer(Request);
+		default:
+			return -1;
+		}
+	}
+
+	BENCH_NOINLINE long TracedDispatch(Target* Pad, Irp* Request)
+	{
+		TraceVerbose(TraceBusPdo, 1);
+
+		volatile unsigned char* stack = Request->StackLocations[Request->CurrentLocation];
+		(void)stack[0];
+
+		TraceVerbose(TraceBusPdo, 2);
+
+		const long status = UrbDispatch(Pad, Request->Request);
+
+		TraceVerbose(TraceBusPdo, 5);
+		TraceVerbose(TraceBusPdo, 6, static_cast<unsigned int>(status));
+
+		return status;
+	}
+
+	BENCH_NOINLINE long FastPathDispatch(Target* Pad, Irp* Request)
+	{
+		Urb* urb = Request->Request;
+
+		if (urb->Function == FunctionBulkOrInterruptTransfer && (urb->TransferFlags & TransferDirectionIn))
+			return Pad->UsbBulkOrInterruptTransfer(urb);
+
+		return TracedDispatch(Pad, Request);
+	}
+
+	template <typename TDispatch>
+	double NanosecondsPerRequest(TDispatch Dispatch)
+	{
+		Target pad;
+		Urb urb{ FunctionBulkOrInterruptTransfer, TransferDirectionIn, 0 };
+		Irp irp{};
+		volatile long sink = 0;
+
+		irp.Request = &urb;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < Iterations; i++)
+			sink = sink + Dispatch(&pad, &irp);
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / Iterations;
+	}
+}
+
+int main()
+{
+	const char* states[] = { "tracing off", "verbose on" };
+
+	for (unsigned int enabled = 0; enabled < 2; enabled++)
+	{
+		Control.Flags = enabled ? TraceBusPdo : 0;
+		Control.Level = enabled ? TraceLevelVerbose : 0;
+
+		const double traced = NanosecondsPerRequest(TracedDispatch);
+		const double fast = NanosecondsPerRequest(FastPathDispatch);
+
+		std::printf("%-12s traced dispatch %6.2f ns  fast path %6.2f ns per interrupt IN\n", states[enabled], traced, fast);
+	}
+
+	return 0;
+}
@@ -0,0 +1,199 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "OrderedDelivery.hpp"
+
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	struct Report
+	{
+		unsigned int Buttons;
+		int Axis;
+	};
+
+	const auto ButtonsOf = [](const Report& Queued) { return static_cast<unsigned long long>(Queued.Buttons); };
+
+	//
+	// With ample depth every button edge submitted reaches the host, in order,
+	// whenever the host polls and however many reports arrive in between
+	// 
+	void EveryEdgeIsDelivered()
+	{
+		std::mt19937 rng(36);
+
+		for (int trial = 0; trial < 500; trial++)
+		{
+			static OrderedDeliveryQueue<Report, 32> queue;
+			queue = OrderedDeliveryQueue<Report, 32>{};
+			queue.Configure(32, OverflowPolicy::DropOldest);
+
+			std::vector<unsigned int> submitted{ 0 }, delivered{ 0 };
+			Report cache{};
+
+			for (int poll = 0; poll < 200; poll++)
+			{
+				const int count = static_cast<int>(rng() % 3);
+
+				for (int i = 0; i < count; i++)
+				{
+					const Report report{ static_cast<unsigned int>(rng() % 4), static_cast<int>(rng() % 100) };
+
+					cache = report;
+					queue.Push(report, ButtonsOf);
+
+					if (report.Buttons != submitted.back())
+						submitted.push_back(report.Buttons);
+				}
+
+				Report sent;
+
+				if (!queue.Pop(sent))
+					sent = cache;
+
+				if (sent.Buttons != delivered.back())
+					delivered.push_back(sent.Buttons);
+			}
+
+			Report sent;
+
+			while (queue.Pop(sent))
+			{
+				if (sent.Buttons != delivered.back())
+					delivered.push_back(sent.Buttons);
+			}
+
+			if (cache.Buttons != delivered.back())
+				delivered.push_back(cache.Buttons);
+
+			CHECK(submitted == delivered);
+			CHECK_EQ(queue.Counters().Dropped, 0ull);
+			CHECK_EQ(queue.Counters().Enqueued, queue.Counters().Delivered);
+		}
+	}
+
+	void OverflowPolicies()
+	{
+		Report sent;
+
+		OrderedDeliveryQueue<Report, 4> dropNewest{};
+		dropNewest.Configure(2, OverflowPolicy::DropNewest);
+		dropNewest.Push({ 1, 0 }, ButtonsOf);
+		dropNewest.Push({ 2, 0 }, ButtonsOf);
+		dropNewest.Push({ 3, 0 }, ButtonsOf);
+		CHECK_EQ(dropNewest.Counters().Dropped, 1ull);
+		CHECK(dropNewest.Pop(sent) && sent.Buttons == 1);
+		CHECK(dropNewest.Pop(sent) && sent.Buttons == 2);
+		CHECK(!dropNewest.Pop(sent));
+
+		OrderedDeliveryQueue<Report, 4> dropOldest{};
+		dropOldest.Configure(2, OverflowPolicy::DropOldest);
+		dropOldest.Push({ 1, 0 }, ButtonsOf);
+		dropOldest.Push({ 2, 0 }, ButtonsOf);
+		dropOldest.Push({ 3, 0 }, ButtonsOf);
+		CHECK(dropOldest.Pop(sent) && sent.Buttons == 2);
+
+		OrderedDeliveryQueue<Report, 4> overwrite{};
+		overwrite.Configure(2, OverflowPolicy::OverwriteNewest);
+		overwrite.Push({ 1, 0 }, ButtonsOf);
+		overwrite.Push({ 2, 0 }, ButtonsOf);
+		overwrite.Push({ 3, 0 }, ButtonsOf);
+		CHECK(overwrite.Pop(sent) && sent.Buttons == 1);
+		CHECK(overwrite.Pop(sent) && sent.Buttons == 3);
+	}
+
+	//
+	// Only reports actually folded into a queued one count as collapsed
+	// 
+	void CollapsedCountsMerges()
+	{
+		OrderedDeliveryQueue<Report, 4> queue{};
+		Report sent;
+
+		queue.Configure(4, OverflowPolicy::DropOldest);
+
+		queue.Push({ 0, 1 }, ButtonsOf);
+		CHECK_EQ(queue.Counters().Collapsed, 0ull);
+		CHECK(queue.IsEmpty());
+
+		queue.Push({ 1, 1 }, ButtonsOf);
+		queue.Push({ 1, 2 }, ButtonsOf);
+		CHECK_EQ(queue.Counters().Collapsed, 1ull);
+		CHECK(queue.Pop(sent) && sent.Axis == 2);
+
+		queue.Push({ 1, 3 }, ButtonsOf);
+		CHECK_EQ(queue.Counters().Collapsed, 1ull);
+		CHECK(queue.IsEmpty());
+	}
+
+	//
+	// After a clear, edges are judged against the state the host got since
+	// 
+	void ClearResetsEdgeDetection()
+	{
+		OrderedDeliveryQueue<Report, 4> queue{};
+		Report sent;
+
+		queue.Configure(4, OverflowPolicy::DropOldest);
+
+		queue.Push({ 1, 0 }, ButtonsOf);
+		queue.Clear(0);
+
+		//
+		// Same buttons as before the clear, but an edge against the cache
+		// 
+		queue.Push({ 1, 0 }, ButtonsOf);
+		CHECK(queue.Pop(sent) && sent.Buttons == 1);
+
+		queue.Clear(2);
+		queue.Push({ 2, 5 }, ButtonsOf);
+		CHECK(queue.IsEmpty());
+	}
+}
+
+int main()
+{
+	EveryEdgeIsDelivered();
+	OverflowPolicies();
+	CollapsedCountsMerges();
+	ClearResetsEdgeDetection();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,186 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "PlaybackScheduler.hpp"
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	//
+	// Virtual clock in 100ns ticks, as the driver passes KeQueryInterruptTime
+	// 
+	constexpr unsigned long long Start = 1000000;
+
+	constexpr unsigned long long Microseconds(unsigned long long Value)
+	{
+		return Value * 10;
+	}
+
+	void DelayCountsDownToTheDueInstant()
+	{
+		PlaybackScheduler scheduler{};
+
+		scheduler.Begin(Start, 1);
+
+		CHECK_EQ(scheduler.Delay(Start - 500, Microseconds(100)), 500 + Microseconds(100));
+		CHECK_EQ(scheduler.Delay(Start, Microseconds(100)), Microseconds(100));
+		CHECK_EQ(scheduler.Delay(Start + Microseconds(99), Microseconds(100)), Microseconds(1));
+		CHECK_EQ(scheduler.Delay(Start + Microseconds(100), Microseconds(100)), 0u);
+		CHECK_EQ(scheduler.Delay(Start + Microseconds(250), Microseconds(100)), 0u);
+	}
+
+	//
+	// Releasing ahead of time (timer fired early) counts as zero skew
+	// 
+	void EarlyReleaseHasNoSkew()
+	{
+		PlaybackScheduler scheduler{};
+
+		scheduler.Begin(Start, 2);
+
+		CHECK_EQ(scheduler.Release(Start + Microseconds(90), Microseconds(100)), 0u);
+		CHECK_EQ(scheduler.Release(Start + Microseconds(200), Microseconds(200)), 0u);
+
+		CHECK_EQ(scheduler.MaxSkew(), 0u);
+		CHECK_EQ(scheduler.TotalSkew(), 0u);
+		CHECK_EQ(scheduler.Released(), 2u);
+	}
+
+	void LateReleasesAccumulateSkew()
+	{
+		PlaybackScheduler scheduler{};
+
+		scheduler.Begin(Start, 3);
+
+		CHECK_EQ(scheduler.Release(Start + Microseconds(130), Microseconds(100)), Microseconds(30));
+		CHECK_EQ(scheduler.Release(Start + Microseconds(205), Microseconds(200)), Microseconds(5));
+		CHECK_EQ(scheduler.Release(Start + Microseconds(290), Microseconds(300)), 0u);
+
+		CHECK_EQ(scheduler.MaxSkew(), Microseconds(30));
+		CHECK_EQ(scheduler.TotalSkew(), Microseconds(35));
+	}
+
+	//
+	// Walks a sequence the way the playback timer does: wait out the delay of
+	// the current entry, release it a fixed latency late, repeat until done
+	// 
+	void TimerLoopReleasesEveryEntryOnce()
+	{
+		constexpr unsigned long long Offsets[] = { 0, Microseconds(1000), Microseconds(1000), Microseconds(4000) };
+		constexpr unsigned int Count = sizeof(Offsets) / sizeof(Offsets[0]);
+		constexpr unsigned long long Latency = 7;
+
+		PlaybackScheduler scheduler{};
+		unsigned long long now = Start - Microseconds(50);
+		unsigned int releases = 0;
+
+		scheduler.Begin(Start, Count);
+
+		while (!scheduler.IsDone())
+		{
+			const auto index = scheduler.Current();
+
+			CHECK_EQ(index, releases);
+
+			const auto delay = scheduler.Delay(now, Offsets[index]);
+
+			now += delay;
+			if (delay > 0)
+				now += Latency;
+
+			scheduler.Release(now, Offsets[index]);
+			releases++;
+		}
+
+		CHECK_EQ(releases, Count);
+		CHECK_EQ(scheduler.Released(), Count);
+
+		//
+		// The third entry shares the instant of the second and is released
+		// right behind it, so it inherits its skew
+		// 
+		CHECK_EQ(scheduler.MaxSkew(), Latency);
+		CHECK_EQ(scheduler.TotalSkew(), 4 * Latency);
+	}
+
+	void BeginStartsOver()
+	{
+		PlaybackScheduler scheduler{};
+
+		scheduler.Begin(Start, 1);
+		scheduler.Release(Start + Microseconds(10), 0);
+
+		CHECK(scheduler.IsDone());
+
+		scheduler.Begin(Start + Microseconds(1000), 2);
+
+		CHECK(!scheduler.IsDone());
+		CHECK_EQ(scheduler.Current(), 0u);
+		CHECK_EQ(scheduler.Released(), 0u);
+		CHECK_EQ(scheduler.MaxSkew(), 0u);
+		CHECK_EQ(scheduler.TotalSkew(), 0u);
+		CHECK_EQ(scheduler.Delay(Start, 0), Microseconds(1000));
+	}
+
+	//
+	// The schedule ioctl bounds start delay and offsets, the largest due
+	// instant stays far from wrapping
+	// 
+	void LargestScheduleDoesNotWrap()
+	{
+		constexpr unsigned long long MaxDelay = Microseconds(3600000000ULL);
+
+		PlaybackScheduler scheduler{};
+		const unsigned long long now = ~0ULL / 2;
+
+		scheduler.Begin(now + MaxDelay, 1);
+
+		CHECK_EQ(scheduler.Delay(now, MaxDelay), 2 * MaxDelay);
+		CHECK_EQ(scheduler.Release(now + 2 * MaxDelay + 3, MaxDelay), 3u);
+	}
+}
+
+int main()
+{
+	DelayCountsDownToTheDueInstant();
+	EarlyReleaseHasNoSkew();
+	LateReleasesAccumulateSkew();
+	TimerLoopReleasesEveryEntryOnce();
+	BeginStartsOver();
+	LargestScheduleDoesNotWrap();
+
+	return ViGEm::Tests::Result();
+}
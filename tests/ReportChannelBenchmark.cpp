@@ -0,0 +1,204 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "ReportChannel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Write and read cost of the DS4 published report (64 bytes): the sequence
+// lock channel, which copies through volatile byte by byte, against a spin
+// lock around a plain memcpy. First uncontended, one operation at a time,
+// then one writer at a fixed rate against N polling readers. Run with the
+// reader count as the only argument.
+// 
+namespace
+{
+	constexpr unsigned int Iterations = 20000000;
+	constexpr auto Duration = std::chrono::milliseconds(500);
+
+	struct InputReport
+	{
+		unsigned char Data[64];
+	};
+
+	class LockedReport
+	{
+	public:
+		void Write(const InputReport& Report)
+		{
+			Acquire();
+			std::memcpy(&_Report, &Report, sizeof(InputReport));
+			Release();
+		}
+
+		unsigned int Read(InputReport& Report)
+		{
+			Acquire();
+			std::memcpy(&Report, &_Report, sizeof(InputReport));
+			Release();
+			return 0;
+		}
+
+	private:
+		void Acquire()
+		{
+			while (_Locked.exchange(true, std::memory_order_acquire))
+			{
+				while (_Locked.load(std::memory_order_relaxed))
+					std::this_thread::yield();
+			}
+		}
+
+		void Release()
+		{
+			_Locked.store(false, std::memory_order_release);
+		}
+
+		std::atomic<bool> _Locked{ false };
+		InputReport _Report{};
+	};
+
+	template <typename TChannel>
+	void Uncontended(const char* Name)
+	{
+		static TChannel channel{};
+		InputReport report{};
+		volatile unsigned int sink = 0;
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < Iterations; i++)
+		{
+			report.Data[i & 63] = static_cast<unsigned char>(i);
+			channel.Write(report);
+		}
+
+		const std::chrono::duration<double, std::nano> writes = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < Iterations; i++)
+		{
+			channel.Read(report);
+			sink = sink + report.Data[i & 63];
+		}
+
+		const std::chrono::duration<double, std::nano> reads = std::chrono::steady_clock::now() - start;
+
+		std::printf("%-14s write %6.2f ns  read %6.2f ns\n", Name,
+			writes.count() / Iterations, reads.count() / Iterations);
+	}
+
+	//
+	// One writer publishing every 10 us (a fast feeder), readers polling as fast as they can
+	// 
+	template <typename TChannel>
+	void Contended(const char* Name, unsigned int Readers)
+	{
+		static TChannel channel{};
+		std::atomic<bool> done{ false };
+		std::vector<std::thread> threads;
+		std::vector<unsigned long long> counts(Readers * 8);
+		unsigned long long written = 0;
+
+		for (unsigned int r = 0; r < Readers; r++)
+		{
+			threads.emplace_back([&, r]
+			{
+				InputReport report{};
+				unsigned long long reads = 0;
+				volatile unsigned int sink = 0;
+
+				while (!done.load(std::memory_order_relaxed))
+				{
+					channel.Read(report);
+					sink = sink + report.Data[reads & 63];
+					reads++;
+				}
+
+				counts[r * 8] = reads;
+			});
+		}
+
+		const auto until = std::chrono::steady_clock::now() + Duration;
+		auto next = std::chrono::steady_clock::now();
+		InputReport report{};
+
+		while (next < until)
+		{
+			while (std::chrono::steady_clock::now() < next)
+				std::this_thread::yield();
+
+			report.Data[written & 63] = static_cast<unsigned char>(written);
+			channel.Write(report);
+			written++;
+			next += std::chrono::microseconds(10);
+		}
+
+		done = true;
+
+		unsigned long long total = 0;
+
+		for (unsigned int r = 0; r < Readers; r++)
+		{
+			threads[r].join();
+			total += counts[r * 8];
+		}
+
+		std::printf("%-14s %u reader(s)  %8.2f M reads/s  %6.2f k writes/s\n", Name, Readers,
+			total / std::chrono::duration<double>(Duration).count() / 1e6,
+			written / std::chrono::duration<double>(Duration).count() / 1e3);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned int readers = (argc > 1) ? static_cast<unsigned int>(std::atoi(argv[1])) : 1;
+
+	Uncontended<ReportChannel<InputReport>>("report channel");
+	Uncontended<LockedReport>("spin lock");
+
+	Contended<ReportChannel<InputReport>>("report channel", readers);
+	Contended<LockedReport>("spin lock", readers);
+
+	return 0;
+}
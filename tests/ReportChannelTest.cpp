@@ -0,0 +1,152 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "ReportChannel.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	struct Report
+	{
+		unsigned char Data[64];
+	};
+
+	void Fill(Report& Target, unsigned char Value)
+	{
+		for (auto& byte : Target.Data)
+			byte = Value;
+	}
+
+	bool IsUniform(const Report& Target)
+	{
+		for (const auto byte : Target.Data)
+			if (byte != Target.Data[0])
+				return false;
+
+		return true;
+	}
+
+	void ZeroInitializedIsValid()
+	{
+		ReportChannel<Report> channel{};
+		Report read;
+
+		Fill(read, 0xFF);
+
+		CHECK_EQ(channel.Read(read), 0u);
+		CHECK(IsUniform(read) && read.Data[0] == 0);
+	}
+
+	void SequenceAdvancesPerWrite()
+	{
+		ReportChannel<Report> channel{};
+		Report report, read;
+
+		Fill(report, 7);
+		channel.Write(report);
+
+		CHECK_EQ(channel.Sequence(), 2u);
+		CHECK_EQ(channel.Read(read), 2u);
+		CHECK_EQ(read.Data[63], 7);
+
+		channel.Write(report);
+		CHECK_EQ(channel.Sequence(), 4u);
+	}
+
+	//
+	// Every report is written uniform, so any mixed copy a reader gets was torn
+	// by an overlapping write
+	// 
+	void ReadersNeverSeeTornReports()
+	{
+		constexpr unsigned int Writes = 200000;
+
+		static ReportChannel<Report> channel{};
+		std::atomic<bool> done{ false };
+		std::atomic<unsigned int> torn{ 0 };
+		std::atomic<unsigned int> reads{ 0 };
+
+		std::vector<std::thread> readers;
+
+		for (int i = 0; i < 3; i++)
+			readers.emplace_back([&]
+			{
+				Report read;
+				unsigned int last = 0;
+
+				do
+				{
+					const auto sequence = channel.Read(read);
+
+					if (!IsUniform(read) || sequence < last)
+						torn++;
+
+					last = sequence;
+					reads++;
+				} while (!done.load());
+			});
+
+		Report report;
+
+		for (unsigned int i = 1; i <= Writes; i++)
+		{
+			Fill(report, static_cast<unsigned char>(i));
+			channel.Write(report);
+		}
+
+		done = true;
+
+		for (auto& reader : readers)
+			reader.join();
+
+		CHECK(reads.load() > 0);
+		CHECK_EQ(torn.load(), 0u);
+		CHECK_EQ(channel.Sequence(), Writes * 2);
+	}
+}
+
+int main()
+{
+	ZeroInitializedIsValid();
+	SequenceAdvancesPerWrite();
+	ReadersNeverSeeTornReports();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,179 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ReportConversion.hpp"
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core::ReportConversion;
+
+namespace
+{
+	//
+	// Same member names as XUSB_REPORT and DS4_REPORT
+	// 
+	struct XusbReport
+	{
+		unsigned short wButtons;
+		unsigned char bLeftTrigger;
+		unsigned char bRightTrigger;
+		short sThumbLX;
+		short sThumbLY;
+		short sThumbRX;
+		short sThumbRY;
+	};
+
+	struct Ds4Report
+	{
+		unsigned char bThumbLX;
+		unsigned char bThumbLY;
+		unsigned char bThumbRX;
+		unsigned char bThumbRY;
+		unsigned short wButtons;
+		unsigned char bSpecial;
+		unsigned char bTriggerL;
+		unsigned char bTriggerR;
+	};
+
+	void AxesRoundTrip()
+	{
+		for (int value = 0; value <= 0xFF; value++)
+		{
+			const auto ds4 = static_cast<unsigned char>(value);
+
+			CHECK_EQ(AxisToDs4(AxisToXusb(ds4)), ds4);
+			CHECK_EQ(AxisToDs4Inverted(AxisToXusbInverted(ds4)), ds4);
+		}
+
+		CHECK_EQ(AxisToDs4(-32768), 0x00);
+		CHECK_EQ(AxisToDs4(32767), 0xFF);
+		CHECK_EQ(AxisToDs4(0), 0x80);
+		CHECK_EQ(AxisToDs4Inverted(32767), 0x00);
+		CHECK_EQ(AxisToXusb(0x00), -32768);
+		CHECK_EQ(AxisToXusb(0xFF), 32767);
+	}
+
+	void CentersMapToEachOther()
+	{
+		CHECK_EQ(AxisToXusb(0x80), 0);
+		CHECK_EQ(AxisToXusbInverted(0x80), 0);
+		CHECK_EQ(AxisToDs4Inverted(0), 0x80);
+		CHECK_EQ(AxisToXusbInverted(0x00), 32767);
+		CHECK_EQ(AxisToXusbInverted(0xFF), -32767);
+	}
+
+	void DpadHatRoundTrip()
+	{
+		for (unsigned char hat = 0; hat < 8; hat++)
+			CHECK_EQ(XusbDpadToHat(HatToXusbDpad(hat)), hat);
+
+		CHECK_EQ(XusbDpadToHat(0), Ds4DpadNone);
+		CHECK_EQ(XusbDpadToHat(XusbDpadUp | XusbDpadDown), Ds4DpadNone);
+		CHECK_EQ(XusbDpadToHat(XusbDpadUp | XusbDpadDown | XusbDpadLeft), 0x6);
+		CHECK_EQ(HatToXusbDpad(Ds4DpadNone), 0);
+		CHECK_EQ(HatToXusbDpad(0xF), 0);
+	}
+
+	void ButtonsRoundTrip()
+	{
+		for (const auto& pair : ButtonMap)
+		{
+			XusbReport xusb{};
+			Ds4Report ds4{};
+
+			xusb.wButtons = pair.Xusb;
+			XusbToDs4(xusb, ds4);
+
+			CHECK_EQ(ds4.wButtons, static_cast<unsigned short>(pair.Ds4 | Ds4DpadNone));
+
+			XusbReport back{};
+			Ds4ToXusb(ds4, back);
+
+			CHECK_EQ(back.wButtons, pair.Xusb);
+		}
+	}
+
+	void GuideAndTriggers()
+	{
+		XusbReport xusb{};
+		Ds4Report ds4{};
+
+		xusb.wButtons = XusbGuide;
+		xusb.bLeftTrigger = 1;
+		XusbToDs4(xusb, ds4);
+
+		CHECK_EQ(ds4.bSpecial, Ds4SpecialPs);
+		CHECK(ds4.wButtons & Ds4TriggerLeft);
+		CHECK(!(ds4.wButtons & Ds4TriggerRight));
+		CHECK_EQ(ds4.bTriggerL, 1);
+
+		XusbReport back{};
+		Ds4ToXusb(ds4, back);
+
+		CHECK_EQ(back.wButtons, XusbGuide);
+		CHECK_EQ(back.bLeftTrigger, 1);
+	}
+
+	void YAxesAreInverted()
+	{
+		XusbReport xusb{};
+		Ds4Report ds4{};
+
+		xusb.sThumbLY = 32767;
+		xusb.sThumbRY = -32768;
+		XusbToDs4(xusb, ds4);
+
+		CHECK_EQ(ds4.bThumbLY, 0x00);
+		CHECK_EQ(ds4.bThumbRY, 0xFF);
+		CHECK_EQ(ds4.bThumbLX, 0x80);
+
+		XusbReport back{};
+		Ds4ToXusb(ds4, back);
+
+		CHECK_EQ(back.sThumbLX, 0);
+		CHECK_EQ(back.sThumbLY, 32767);
+	}
+}
+
+int main()
+{
+	AxesRoundTrip();
+	CentersMapToEachOther();
+	DpadHatRoundTrip();
+	ButtonsRoundTrip();
+	GuideAndTriggers();
+	YAxesAreInverted();
+
+	return ViGEm::Tests::Result();
+}
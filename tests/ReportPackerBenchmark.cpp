@@ -0,0 +1,111 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <ViGEm/km/ReportPacker.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Time to pack a batch of pads into XUSB and DS4 reports, vectorized against
+// the scalar reference, for growing batch sizes
+// 
+namespace
+{
+	constexpr unsigned int MaxPads = 256;
+	constexpr unsigned int Rounds = 100000;
+
+	template <typename TPack>
+	double NanosecondsPerBatch(TPack Pack, unsigned char* Reports)
+	{
+		volatile unsigned char sink = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int r = 0; r < Rounds; r++)
+		{
+			Pack();
+			sink = sink + Reports[r % 8];
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / Rounds;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(45);
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+	std::vector<float> channels[6];
+	std::vector<unsigned short> buttons(MaxPads);
+	std::vector<unsigned char> special(MaxPads);
+
+	for (auto& channel : channels)
+	{
+		channel.resize(MaxPads);
+
+		for (auto& v : channel)
+			v = value(rng);
+	}
+
+	const ReportPacker::PadStates states
+	{
+		channels[0].data(), channels[1].data(), channels[2].data(), channels[3].data(),
+		channels[4].data(), channels[5].data(), buttons.data(), special.data()
+	};
+
+	std::vector<unsigned char> xusb(MaxPads * ReportPacker::XusbReportSize);
+	std::vector<unsigned char> ds4(MaxPads * ReportPacker::Ds4ReportSize);
+
+	std::printf("%u lanes\n", ReportPacker::Detail::Lanes);
+	std::printf("pads  xusb ns  scalar ns  ds4 ns  scalar ns\n");
+
+	for (unsigned int pads = 1; pads <= MaxPads; pads *= 4)
+	{
+		const double xusbVector = NanosecondsPerBatch([&] { ReportPacker::PackXusb(states, pads, xusb.data()); }, xusb.data());
+		const double xusbScalar = NanosecondsPerBatch([&] { ReportPacker::PackXusbScalar(states, pads, xusb.data()); }, xusb.data());
+		const double ds4Vector = NanosecondsPerBatch([&] { ReportPacker::PackDs4(states, pads, ds4.data()); }, ds4.data());
+		const double ds4Scalar = NanosecondsPerBatch([&] { ReportPacker::PackDs4Scalar(states, pads, ds4.data()); }, ds4.data());
+
+		std::printf("%4u  %7.0f  %9.0f  %6.0f  %9.0f\n", pads, xusbVector, xusbScalar, ds4Vector, ds4Scalar);
+	}
+
+	return 0;
+}
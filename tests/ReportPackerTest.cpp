@@ -0,0 +1,242 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <ViGEm/km/ReportPacker.hpp>
+
+#include "ReportConversion.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	//
+	// Odd count so the scalar tail after the vector blocks is exercised too
+	// 
+	constexpr unsigned int Pads = 1037;
+
+	struct Input
+	{
+		std::vector<float> Channels[6];
+		std::vector<unsigned short> Buttons;
+		std::vector<unsigned char> Special;
+
+		ReportPacker::PadStates States() const
+		{
+			return {
+				Channels[0].data(), Channels[1].data(), Channels[2].data(), Channels[3].data(),
+				Channels[4].data(), Channels[5].data(), Buttons.data(), Special.data()
+			};
+		}
+	};
+
+	Input RandomInput()
+	{
+		std::mt19937 rng(45);
+		std::uniform_real_distribution<float> value(-1.3f, 1.3f);
+		Input input;
+
+		for (auto& channel : input.Channels)
+		{
+			channel.resize(Pads);
+
+			for (auto& v : channel)
+				v = value(rng);
+		}
+
+		const float edges[] =
+		{
+			-1.0f, 1.0f, 0.0f, -0.0f,
+			std::numeric_limits<float>::quiet_NaN(),
+			std::numeric_limits<float>::infinity(),
+			-std::numeric_limits<float>::infinity(),
+			0.99999994f, -0.99999994f, 1e-30f, 0.5f, -0.5f, 1.0f / 255, 1.0f / 32767
+		};
+
+		for (unsigned int i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+			for (auto& channel : input.Channels)
+				channel[i] = edges[i];
+
+		for (unsigned int i = 0; i < Pads; i++)
+		{
+			input.Buttons.push_back(static_cast<unsigned short>(rng()));
+			input.Special.push_back(static_cast<unsigned char>(rng() & 3));
+		}
+
+		return input;
+	}
+
+	//
+	// Independent of the packer: clamp with NaN to the lower bound, scale, truncate
+	// 
+	int Reference(float Value, float Low, float Scale)
+	{
+		if (!(Value > Low))
+			Value = Low;
+		if (!(Value < 1.0f))
+			Value = 1.0f;
+
+		return static_cast<int>(std::trunc(Value * Scale));
+	}
+
+	void VectorizedMatchesScalar(const Input& In)
+	{
+		const auto states = In.States();
+
+		std::vector<unsigned char> xusb(Pads * ReportPacker::XusbReportSize);
+		std::vector<unsigned char> xusbScalar(xusb.size());
+		std::vector<unsigned char> ds4(Pads * ReportPacker::Ds4ReportSize, 0xCC);
+		std::vector<unsigned char> ds4Scalar(ds4.size(), 0xCC);
+
+		ReportPacker::PackXusb(states, Pads, xusb.data());
+		ReportPacker::PackXusbScalar(states, Pads, xusbScalar.data());
+		ReportPacker::PackDs4(states, Pads, ds4.data());
+		ReportPacker::PackDs4Scalar(states, Pads, ds4Scalar.data());
+
+		CHECK(xusb == xusbScalar);
+		CHECK(ds4 == ds4Scalar);
+	}
+
+	void XusbMatchesReference(const Input& In)
+	{
+		std::vector<unsigned char> reports(Pads * ReportPacker::XusbReportSize);
+
+		ReportPacker::PackXusb(In.States(), Pads, reports.data());
+
+		for (unsigned int i = 0; i < Pads; i++)
+		{
+			const unsigned char* report = &reports[i * ReportPacker::XusbReportSize];
+			short axes[4];
+
+			std::memcpy(axes, report + 4, sizeof(axes));
+
+			CHECK_EQ(report[0] | (report[1] << 8), In.Buttons[i]);
+			CHECK_EQ(report[2], Reference(In.Channels[4][i], 0.0f, 255.0f));
+			CHECK_EQ(report[3], Reference(In.Channels[5][i], 0.0f, 255.0f));
+
+			for (unsigned int a = 0; a < 4; a++)
+				CHECK_EQ(axes[a], Reference(In.Channels[a][i], -1.0f, 32767.0f));
+		}
+	}
+
+	//
+	// Same bytes as converting the packed XUSB report like the driver does
+	// 
+	void Ds4MatchesConversion(const Input& In)
+	{
+		const auto states = In.States();
+
+		std::vector<unsigned char> xusb(Pads * ReportPacker::XusbReportSize);
+		std::vector<unsigned char> ds4(Pads * ReportPacker::Ds4ReportSize, 0xCC);
+
+		ReportPacker::PackXusb(states, Pads, xusb.data());
+		ReportPacker::PackDs4(states, Pads, ds4.data());
+
+		for (unsigned int i = 0; i < Pads; i++)
+		{
+			const unsigned char* report = &ds4[i * ReportPacker::Ds4ReportSize];
+			short axes[4];
+
+			std::memcpy(axes, &xusb[i * ReportPacker::XusbReportSize + 4], sizeof(axes));
+
+			CHECK_EQ(report[0], ReportPacker::Ds4ReportId);
+			CHECK_EQ(report[Ds4ReportSchema::LeftThumbX.ByteOffset()], ReportConversion::AxisToDs4(axes[0]));
+			CHECK_EQ(report[Ds4ReportSchema::LeftThumbY.ByteOffset()], ReportConversion::AxisToDs4Inverted(axes[1]));
+			CHECK_EQ(report[Ds4ReportSchema::RightThumbX.ByteOffset()], ReportConversion::AxisToDs4(axes[2]));
+			CHECK_EQ(report[Ds4ReportSchema::RightThumbY.ByteOffset()], ReportConversion::AxisToDs4Inverted(axes[3]));
+			CHECK_EQ(Ds4ReportSchema::Get(report, Ds4ReportSchema::SpecialButtons), In.Special[i]);
+			CHECK_EQ(report[Ds4ReportSchema::LeftTrigger.ByteOffset()], xusb[i * ReportPacker::XusbReportSize + 2]);
+			CHECK_EQ(report[10], 0xCC);
+		}
+	}
+
+	//
+	// The special buttons share their byte with the frame counter the driver stamps
+	// 
+	void SpecialButtonsKeepFrameCounter()
+	{
+		const float zero = 0.0f;
+		const unsigned short buttons = 0x0008;
+		const unsigned char special = 0x03;
+		const ReportPacker::PadStates states{ &zero, &zero, &zero, &zero, &zero, &zero, &buttons, &special };
+
+		auto report = Ds4ReportSchema::NeutralReport();
+
+		Ds4ReportSchema::Set(report.Bytes, Ds4ReportSchema::FrameCounter, 0x2A);
+
+		ReportPacker::PackDs4(states, 1, report.Bytes);
+
+		CHECK_EQ(Ds4ReportSchema::Get(report.Bytes, Ds4ReportSchema::FrameCounter), 0x2Au);
+		CHECK_EQ(Ds4ReportSchema::Get(report.Bytes, Ds4ReportSchema::SpecialButtons), 0x03u);
+		CHECK_EQ(report.Bytes[Ds4ReportSchema::LeftThumbX.ByteOffset()], 0x80);
+		CHECK_EQ(report.Bytes[Ds4ReportSchema::LeftThumbY.ByteOffset()], 0x80);
+	}
+
+	void StrideLeavesGapsAlone(const Input& In)
+	{
+		constexpr unsigned int stride = 20;
+		const auto states = In.States();
+
+		std::vector<unsigned char> packed(Pads * ReportPacker::XusbReportSize);
+		std::vector<unsigned char> strided(Pads * stride, 0x5A);
+
+		ReportPacker::PackXusb(states, Pads, packed.data());
+		ReportPacker::PackXusb(states, Pads - 1, strided.data() + 8, stride);
+
+		for (unsigned int i = 0; i < Pads - 1; i++)
+		{
+			CHECK(std::memcmp(&strided[i * stride + 8], &packed[i * ReportPacker::XusbReportSize], ReportPacker::XusbReportSize) == 0);
+			CHECK_EQ(strided[i * stride], 0x5A);
+		}
+	}
+}
+
+int main()
+{
+	const auto input = RandomInput();
+
+	VectorizedMatchesScalar(input);
+	XusbMatchesReference(input);
+	Ds4MatchesConversion(input);
+	SpecialButtonsKeepFrameCounter();
+	StrideLeavesGapsAlone(input);
+
+	return ViGEm::Tests::Result();
+}
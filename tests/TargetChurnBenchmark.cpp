@@ -0,0 +1,173 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <vector>
+
+//
+// Nanoseconds per plug-in/unplug of a target object while other targets stay
+// plugged in, recycled through a cache against the general heap, both zeroing
+// the object like operator new does. This is a host model: ObjectCache only
+// mimics LOOKASIDE_LIST_EX (a depth-bounded LIFO in front of the allocator),
+// it does not measure the driver's lookaside path or the kernel pool.
+// 
+namespace
+{
+	constexpr unsigned int Rounds = 1000000;
+	constexpr unsigned int CacheDepth = 256;
+
+	//
+	// LOOKASIDE_LIST_EX model, a LIFO of freed entries up to a depth, the
+	// heap behind it
+	// 
+	class ObjectCache
+	{
+	public:
+		explicit ObjectCache(size_t Size) : _Size(Size) {}
+
+		~ObjectCache()
+		{
+			for (unsigned int i = 0; i < _Count; i++)
+				::operator delete(_Entries[i]);
+		}
+
+		void* Allocate()
+		{
+			void* entry = (_Count > 0) ? _Entries[--_Count] : ::operator new(_Size);
+
+			return std::memset(entry, 0, _Size);
+		}
+
+		void Free(void* Entry)
+		{
+			if (_Count < CacheDepth)
+				_Entries[_Count++] = Entry;
+			else
+				::operator delete(Entry);
+		}
+
+	private:
+		size_t _Size;
+		unsigned int _Count{};
+		void* _Entries[CacheDepth]{};
+	};
+
+	struct Heap
+	{
+		size_t Size;
+
+		void* Allocate() const
+		{
+			return std::memset(::operator new(Size), 0, Size);
+		}
+
+		void Free(void* Entry) const
+		{
+			::operator delete(Entry);
+		}
+	};
+
+	//
+	// Unplugs a random target and plugs a new one in its place, with some
+	// unrelated allocations of other sizes in between like a busy system has
+	// 
+	template <typename TAllocator>
+	double NanosecondsPerChurn(TAllocator& Allocator, unsigned int Plugged)
+	{
+		std::mt19937 rng(50);
+		std::vector<void*> targets(Plugged);
+		std::vector<void*> noise(64);
+		volatile unsigned char sink = 0;
+
+		for (auto& target : targets)
+			target = Allocator.Allocate();
+
+		for (auto& block : noise)
+			block = std::malloc(1 + rng() % 2048);
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int r = 0; r < Rounds; r++)
+		{
+			auto& target = targets[rng() % Plugged];
+			auto& block = noise[rng() % noise.size()];
+
+			Allocator.Free(target);
+
+			std::free(block);
+			block = std::malloc(1 + rng() % 2048);
+
+			target = Allocator.Allocate();
+			sink = sink + static_cast<unsigned char*>(target)[0];
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		for (auto target : targets)
+			Allocator.Free(target);
+
+		for (auto block : noise)
+			std::free(block);
+
+		return elapsed.count() / Rounds;
+	}
+}
+
+int main()
+{
+	const size_t sizes[] = { 1024, 4096, 16384 };
+	const unsigned int plugged[] = { 1, 16, 256 };
+
+	std::printf("object  plugged  cache ns  heap ns\n");
+
+	for (const auto size : sizes)
+	{
+		for (const auto count : plugged)
+		{
+			ObjectCache cache(size);
+			const Heap heap{ size };
+
+			const double cached = NanosecondsPerChurn(cache, count);
+			const double fresh = NanosecondsPerChurn(heap, count);
+
+			std::printf("%6zu  %7u  %8.1f  %7.1f\n", size, count, cached, fresh);
+		}
+	}
+
+	return 0;
+}
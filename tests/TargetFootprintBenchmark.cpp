@@ -0,0 +1,354 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "AxisInterpolation.hpp"
+#include "BlockPool.hpp"
+#include "InputMerge.hpp"
+#include "OrderedDelivery.hpp"
+#include "PlaybackScheduler.hpp"
+#include "ReportChannel.hpp"
+#include "SampleRing.hpp"
+#include "XusbBootSequence.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Host model of IOCTL_VIGEM_GET_MEMORY_FOOTPRINT: the target classes are
+// rebuilt with their cache-aligned member groups, the portable containers
+// are the driver's own, WDK types are stood in for by their x64 sizes
+// (marked below). The same offset arithmetic as AddFootprint sums 1, 16 and
+// 64 plugged targets of each type and times the bus walk, then compares
+// queue counts of input-only pads with and without on-demand queues. Not a
+// measurement of the driver; its numbers hold for x64 as far as the
+// stand-ins do.
+// 
+namespace
+{
+	constexpr unsigned int OrderedDeliveryMaxDepth = 32;	// VIGEM_ORDERED_DELIVERY_MAX_DEPTH
+	constexpr unsigned int MergeMaxLayers = 8;				// VIGEM_MERGE_MAX_LAYERS
+	constexpr unsigned int MirrorGroupMaxMembers = 8;		// VIGEM_MIRROR_GROUP_MAX_MEMBERS
+	constexpr unsigned int OutputBufferHardQuota = 64;
+	constexpr unsigned int PdoQueueCount = 3;
+
+	//
+	// Wait-ready and notification queues, created at plug-in until they became on-demand
+	// 
+	constexpr long EagerQueueCount = 2;
+	constexpr unsigned int PdoTimerCount = 1;
+
+	//
+	// x64 stand-ins for WDK types
+	// 
+	typedef unsigned long long KSPIN_LOCK;
+	typedef void* HANDLE;
+	struct KEVENT { unsigned char Bytes[24]; };
+	struct FAST_MUTEX { unsigned char Bytes[56]; };
+	struct EX_RUNDOWN_REF { void* Count; };
+	struct WDF_DEVICE_PNP_CAPABILITIES { unsigned int Fields[13]; };
+	struct WDF_DEVICE_POWER_CAPABILITIES { unsigned int Fields[24]; };
+
+	struct Footprint
+	{
+		unsigned int TargetCount;
+		unsigned long long SubmissionBytes;
+		unsigned long long OrderedDeliveryBytes;
+		unsigned long long MergeBytes;
+		unsigned long long OutputBytes;
+		unsigned long long PlaybackBytes;
+		unsigned long long SetupBytes;
+		unsigned long long TargetBytes;
+		unsigned int QueueCount;
+		unsigned int TimerCount;
+
+		unsigned long long Total() const
+		{
+			return SubmissionBytes + OrderedDeliveryBytes + MergeBytes + OutputBytes
+				+ PlaybackBytes + SetupBytes + TargetBytes;
+		}
+	};
+
+	class TargetModel
+	{
+	public:
+		virtual ~TargetModel() = default;
+
+		void AddFootprint(Footprint* Result) const
+		{
+			//
+			// Member groups start on their own cache line, so the
+			// distance between their first members is what they occupy
+			// 
+			Result->TargetCount++;
+			Result->SubmissionBytes += OffsetOf(&_ReportLock);
+			Result->OrderedDeliveryBytes += OffsetOf(&_MergeLock) - OffsetOf(&_ReportLock);
+			Result->MergeBytes += OffsetOf(&_OutputCallbackLock) - OffsetOf(&_MergeLock);
+			Result->OutputBytes += OffsetOf(&_PlaybackLock) - OffsetOf(&_OutputCallbackLock);
+			Result->PlaybackBytes += OffsetOf(&_PnpCapabilities) - OffsetOf(&_PlaybackLock);
+			Result->SetupBytes += sizeof(TargetModel) - OffsetOf(&_PnpCapabilities);
+			Result->QueueCount += PdoQueueCount + _OnDemandQueueCount;
+			Result->TimerCount += PdoTimerCount;
+
+			AddTargetFootprint(Result);
+		}
+
+	protected:
+		virtual void AddTargetFootprint(Footprint* Result) const = 0;
+
+	private:
+		//
+		// FIELD_OFFSET on the instance, offsetof isn't portable for a polymorphic class
+		// 
+		std::size_t OffsetOf(const void* Member) const
+		{
+			return static_cast<std::size_t>(static_cast<const char*>(Member) - reinterpret_cast<const char*>(this));
+		}
+
+	public:
+		// Submission path, read-mostly
+		unsigned int _SerialNo{};
+		unsigned int _OwnerProcessId{};
+		long _SessionId{};
+		int _TargetType{};
+		bool _OwnerIsDriver{};
+		bool _MergeEnabled{};
+		bool _OrderedDelivery{};
+		unsigned int _MirrorCount{};
+		HANDLE _PendingUsbInRequests{};
+		HANDLE _PdoDevice{};
+		HANDLE _ParentDevice{};
+
+		// Submission path, written per report
+		struct QueuedReport { unsigned char Data[64]; };
+		alignas(64) KSPIN_LOCK _ReportLock{};
+		OrderedDeliveryQueue<QueuedReport, OrderedDeliveryMaxDepth> _OrderedReports{};
+
+		// Submission path, input combination
+		alignas(64) KSPIN_LOCK _MergeLock{};
+		InputMerge::AxisRule _MergeAxisRule{};
+		long _MergeOwnerPriority{};
+		InputMerge::LayerSet<MergeMaxLayers> _Layers{};
+		KSPIN_LOCK _MirrorLock{};
+		unsigned int _MirrorSerialNo[MirrorGroupMaxMembers]{};
+
+		// Output path
+		struct OutputBuffer { unsigned int Block; unsigned int Length; };
+		alignas(64) KSPIN_LOCK _OutputCallbackLock{};
+		void* _OutputCallback{};
+		void* _OutputCallbackContext{};
+		long _OutputCallbackInvocations[2]{};
+		unsigned int _OutputCallbackSlot{};
+		KEVENT _OutputCallbackDrained{};
+		FAST_MUTEX _OutputCallbackRegistrationLock{};
+		EX_RUNDOWN_REF _OutputCallbackRundown{};
+		KSPIN_LOCK _OutputBufferLock{};
+		SampleRing<OutputBuffer, OutputBufferHardQuota> _OutputBuffers{};
+		PoolAccount _OutputAccount{};
+		volatile long long _Generation{};
+
+		// Scheduled playback
+		alignas(64) KSPIN_LOCK _PlaybackLock{};
+		HANDLE _PlaybackTimer{};
+		HANDLE _PendingPlaybackRequests{};
+		HANDLE _PlaybackRequest{};
+		void* _Playback{};
+		std::size_t _PlaybackOutputBufferSize{};
+		PlaybackScheduler _PlaybackScheduler{};
+
+		// Setup and teardown
+		WDF_DEVICE_PNP_CAPABILITIES _PnpCapabilities{};
+		WDF_DEVICE_POWER_CAPABILITIES _PowerCapabilities{};
+		unsigned short _VendorId{};
+		unsigned short _ProductId{};
+		HANDLE _WaitDeviceReadyRequests{};
+		HANDLE _PendingNotificationRequests{};
+		HANDLE _PendingAwaitOutputRequests{};
+		volatile long _OnDemandQueueCount{};
+		EX_RUNDOWN_REF _OnDemandQueueRundown{};
+		unsigned int _UsbConfigurationDescriptionSize{};
+		void* _EvtIoInternalDeviceControl{};
+		void* _EvtPendingNotificationQueueState{};
+		KEVENT _PdoBootNotificationEvent{};
+		bool _IsIndexed{};
+		volatile long _IsIndexRegistered{};
+		volatile long _IsReady{};
+		HANDLE _WaitDeviceReadyCompletionWorkerThreadHandle{};
+	};
+
+	template <typename TTarget, unsigned int QueueCount, unsigned int TimerCount>
+	class TargetOf : public TargetModel
+	{
+	protected:
+		void AddTargetFootprint(Footprint* Result) const override
+		{
+			Result->TargetBytes += sizeof(TTarget) - sizeof(TargetModel);
+			Result->QueueCount += QueueCount;
+			Result->TimerCount += TimerCount;
+		}
+	};
+
+	class XusbModel final : public TargetOf<XusbModel, 1, 0>
+	{
+		// Submission path, written per report
+		alignas(64) unsigned char _Packet[14]{};
+		bool _ReportPending{};
+		XusbBootSequence _BootSequence{};
+
+		// Output path
+		alignas(64) unsigned char _Rumble[8]{};
+		char _LedNumber{};
+
+		// Setup and teardown
+		HANDLE _HoldingUsbInRequests{};
+		bool _ReportedCapabilities{};
+	};
+
+	class Ds4Model final : public TargetOf<Ds4Model, 0, 1>
+	{
+		struct ImuSample { short Gyro[3]; short Accel[3]; };
+		struct InputReport { unsigned char Data[64]; };
+
+		// Submission path, written per report
+		alignas(64) unsigned char _Report[64]{};
+		AxisInterpolation::Interpolator<6> _Interpolator{};
+		SampleRing<ImuSample, 128> _ImuSamples{};
+		volatile long _ExclusiveRender{};
+		volatile long _FrameCounter{};
+
+		// Published report
+		alignas(64) ReportChannel<InputReport> _PublishedReport{};
+
+		// Output path, DS4_OUTPUT_REPORT and DS4_AWAIT_OUTPUT stand-ins
+		alignas(64) unsigned char _OutputReport[64]{};
+		unsigned char _AwaitOutputCache[72]{};
+		HANDLE _OutputReportNotify{};
+
+		// Setup and teardown
+		HANDLE _PendingUsbInRequestsTimer{};
+		unsigned char _TargetMacAddress[6]{};
+		unsigned char _HostMacAddress[6]{};
+	};
+
+	void Print(const char* Type, const Footprint& Result, double WalkNs)
+	{
+		std::printf("%-5s %3u targets  %8llu bytes  %5llu bytes/target  %3u queues  %3u timers  walk %7.1f ns\n",
+			Type,
+			Result.TargetCount,
+			Result.Total(),
+			Result.Total() / Result.TargetCount,
+			Result.QueueCount,
+			Result.TimerCount,
+			WalkNs);
+	}
+
+	//
+	// OnDemandQueues stands for the queues a target created after plug-in
+	// 
+	template <typename TTarget>
+	void Measure(const char* Type, unsigned int Count, long OnDemandQueues = 0)
+	{
+		constexpr unsigned int Walks = 100000;
+
+		std::vector<std::unique_ptr<TargetModel>> bus;
+
+		for (unsigned int i = 0; i < Count; i++)
+		{
+			bus.push_back(std::make_unique<TTarget>());
+			bus.back()->_OnDemandQueueCount = OnDemandQueues;
+		}
+
+		Footprint result{};
+		volatile unsigned long long sink = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int walk = 0; walk < Walks; walk++)
+		{
+			result = Footprint{};
+
+			for (const auto& target : bus)
+				target->AddFootprint(&result);
+
+			sink = sink + result.Total();
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		Print(Type, result, elapsed.count() / Walks);
+	}
+}
+
+int main()
+{
+	Footprint groups{};
+
+	XusbModel().AddFootprint(&groups);
+
+	std::printf("common groups: submission %llu, ordered %llu, merge %llu, output %llu, playback %llu, setup %llu\n",
+		groups.SubmissionBytes,
+		groups.OrderedDeliveryBytes,
+		groups.MergeBytes,
+		groups.OutputBytes,
+		groups.PlaybackBytes,
+		groups.SetupBytes);
+
+	//
+	// Input-only pads never wait for readiness nor ask for notifications, so
+	// they create neither queue on demand. For comparison the same pads with
+	// both queues created at plug-in. Framework queue objects are WDF pool,
+	// their bytes and the time WdfIoQueueCreate takes at plug-in aren't part
+	// of the model.
+	// 
+	std::printf("\ninput-only pads, queues created on demand\n");
+
+	for (const unsigned int count : { 1u, 16u, 64u })
+	{
+		Measure<XusbModel>("XUSB", count);
+		Measure<Ds4Model>("DS4", count);
+	}
+
+	std::printf("\ninput-only pads, queues created at plug-in\n");
+
+	for (const unsigned int count : { 1u, 16u, 64u })
+	{
+		Measure<XusbModel>("XUSB", count, EagerQueueCount);
+		Measure<Ds4Model>("DS4", count, EagerQueueCount);
+	}
+
+	return 0;
+}
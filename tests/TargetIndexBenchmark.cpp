@@ -0,0 +1,150 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "TargetIndexStripe.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Lookups per second with 1 to N threads, each submitting to its own target,
+// against one lock for all targets (the child list) and one lock per stripe
+// (the bus target index). Run with the thread count as the only argument.
+// 
+namespace
+{
+	constexpr unsigned int StripeCount = 32;
+	constexpr unsigned int SlotCount = 8;
+	constexpr auto Duration = std::chrono::milliseconds(500);
+
+	struct Target
+	{
+		unsigned int Serial;
+	};
+
+	struct alignas(64) LockedStripe
+	{
+		std::mutex Lock;
+
+		TargetIndexStripe<Target, SlotCount> Slots;
+	};
+
+	template <typename TLookup>
+	double Measure(unsigned int Threads, TLookup Lookup)
+	{
+		std::vector<std::thread> workers;
+		std::vector<unsigned long long> counts(Threads * 8);
+		const auto until = std::chrono::steady_clock::now() + Duration;
+
+		for (unsigned int t = 0; t < Threads; t++)
+			workers.emplace_back([&, t]
+			{
+				unsigned long long lookups = 0;
+
+				//
+				// Serials are assigned in ascending order starting at 1
+				// 
+				while (std::chrono::steady_clock::now() < until)
+				{
+					for (int i = 0; i < 1024; i++)
+						lookups += (Lookup(t + 1) != nullptr);
+				}
+
+				counts[t * 8] = lookups;
+			});
+
+		unsigned long long total = 0;
+
+		for (unsigned int t = 0; t < Threads; t++)
+		{
+			workers[t].join();
+			total += counts[t * 8];
+		}
+
+		return total / std::chrono::duration<double>(Duration).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned int maxThreads = (argc > 1)
+		? static_cast<unsigned int>(std::atoi(argv[1]))
+		: std::thread::hardware_concurrency();
+
+	std::vector<Target> targets(maxThreads);
+
+	std::mutex childListLock;
+	TargetIndexStripe<Target, SlotCount * StripeCount> childList{};
+
+	static LockedStripe index[StripeCount];
+
+	for (unsigned int i = 0; i < maxThreads; i++)
+	{
+		targets[i].Serial = i + 1;
+
+		childList.Insert(targets[i].Serial, &targets[i]);
+		index[targets[i].Serial % StripeCount].Slots.Insert(targets[i].Serial, &targets[i]);
+	}
+
+	std::printf("threads  single lock/s  striped/s\n");
+
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		const double single = Measure(threads, [&](unsigned int Serial)
+		{
+			Target* found;
+			std::lock_guard<std::mutex> guard(childListLock);
+			childList.Lookup(Serial, found);
+			return found;
+		});
+
+		const double striped = Measure(threads, [&](unsigned int Serial)
+		{
+			Target* found;
+			auto& stripe = index[Serial % StripeCount];
+			std::lock_guard<std::mutex> guard(stripe.Lock);
+			stripe.Slots.Lookup(Serial, found);
+			return found;
+		});
+
+		std::printf("%7u  %13.0f  %9.0f\n", threads, single, striped);
+	}
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "TargetIndexStripe.hpp"
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	struct Target
+	{
+		unsigned int Serial;
+	};
+
+	using Stripe = TargetIndexStripe<Target, 2>;
+
+	void InsertLookupRemove()
+	{
+		Stripe stripe{};
+		Target one{ 1 }, two{ 33 };
+		Target* found;
+
+		CHECK(stripe.Lookup(1, found) && found == nullptr);
+
+		CHECK(stripe.Insert(1, &one));
+		CHECK(stripe.Insert(33, &two));
+
+		CHECK(stripe.Lookup(1, found) && found == &one);
+		CHECK(stripe.Lookup(33, found) && found == &two);
+
+		stripe.Remove(&one, true);
+
+		CHECK(stripe.Lookup(1, found) && found == nullptr);
+		CHECK(stripe.Lookup(33, found) && found == &two);
+	}
+
+	//
+	// A serial plugged again before the old instance is cleaned up takes over
+	// its slot, the late removal of the old instance must not evict the new one
+	// 
+	void ReplugReplacesStaleEntry()
+	{
+		Stripe stripe{};
+		Target stale{ 1 }, fresh{ 1 };
+		Target* found;
+
+		CHECK(stripe.Insert(1, &stale));
+		CHECK(stripe.Insert(1, &fresh));
+
+		stripe.Remove(&stale, true);
+
+		CHECK(stripe.Lookup(1, found) && found == &fresh);
+	}
+
+	//
+	// Overflowed targets make the stripe defer to the caller's fallback
+	// until they are removed again
+	// 
+	void OverflowIsNotAuthoritative()
+	{
+		Stripe stripe{};
+		Target a{ 1 }, b{ 33 }, c{ 65 };
+		Target* found;
+
+		CHECK(stripe.Insert(1, &a));
+		CHECK(stripe.Insert(33, &b));
+		CHECK(!stripe.Insert(65, &c));
+		CHECK_EQ(stripe.Overflow, 1u);
+
+		CHECK(!stripe.Lookup(65, found) && found == nullptr);
+		CHECK(stripe.Lookup(1, found) && found == &a);
+
+		stripe.Remove(&c, false);
+
+		CHECK(stripe.Lookup(65, found) && found == nullptr);
+	}
+}
+
+int main()
+{
+	InsertLookupRemove();
+	ReplugReplacesStaleEntry();
+	OverflowIsNotAuthoritative();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,134 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+//
+// Models the EmulationTargetPDO member layout: submitters on every core read
+// the read-mostly group (identity, flags, queue handles) while the report path
+// keeps writing the per-report group. Reports reads per second with both
+// groups on one cache line and with each group on its own line, for 1 to N
+// reading threads. Run with the thread count as the only argument.
+// 
+namespace
+{
+	constexpr auto Duration = std::chrono::milliseconds(500);
+
+	struct PackedTarget
+	{
+		std::atomic<unsigned int> SerialNo;
+		std::atomic<unsigned int> Flags;
+
+		std::atomic<unsigned long long> ReportState;
+	};
+
+	struct SplitTarget
+	{
+		alignas(64) std::atomic<unsigned int> SerialNo;
+		std::atomic<unsigned int> Flags;
+
+		alignas(64) std::atomic<unsigned long long> ReportState;
+	};
+
+	template <typename TTarget>
+	double Measure(unsigned int Readers)
+	{
+		static TTarget target{};
+		std::atomic<bool> done{ false };
+		std::vector<std::thread> threads;
+		std::vector<unsigned long long> counts(Readers * 8);
+
+		target.SerialNo = 1;
+
+		//
+		// The report path, one writer per target
+		// 
+		threads.emplace_back([&]
+		{
+			while (!done.load(std::memory_order_relaxed))
+				target.ReportState.fetch_add(1, std::memory_order_relaxed);
+		});
+
+		for (unsigned int r = 0; r < Readers; r++)
+			threads.emplace_back([&, r]
+			{
+				unsigned long long reads = 0;
+
+				while (!done.load(std::memory_order_relaxed))
+				{
+					for (int i = 0; i < 1024; i++)
+						reads += target.SerialNo.load(std::memory_order_relaxed)
+							+ target.Flags.load(std::memory_order_relaxed);
+				}
+
+				counts[r * 8] = reads;
+			});
+
+		std::this_thread::sleep_for(Duration);
+		done = true;
+
+		unsigned long long total = 0;
+
+		for (auto& thread : threads)
+			thread.join();
+
+		for (unsigned int r = 0; r < Readers; r++)
+			total += counts[r * 8];
+
+		return total / std::chrono::duration<double>(Duration).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned int maxReaders = (argc > 1)
+		? static_cast<unsigned int>(std::atoi(argv[1]))
+		: (std::thread::hardware_concurrency() > 1) ? std::thread::hardware_concurrency() - 1 : 1;
+
+	std::printf("readers  shared line/s  own line/s\n");
+
+	for (unsigned int readers = 1; readers <= maxReaders; readers++)
+	{
+		const double packed = Measure<PackedTarget>(readers);
+		const double split = Measure<SplitTarget>(readers);
+
+		std::printf("%7u  %13.0f  %10.0f\n", readers, packed, split);
+	}
+
+	return 0;
+}
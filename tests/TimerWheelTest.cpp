@@ -0,0 +1,190 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TimerWheel.hpp"
+
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	using Wheel = TimerWheel<16>;
+
+	int CountChain(TimerWheelEntry* Entry)
+	{
+		int count = 0;
+
+		for (; Entry; Entry = Entry->Next)
+			count++;
+
+		return count;
+	}
+
+	void ExpiresExactlyAtDeadline()
+	{
+		static Wheel wheel;
+		TimerWheelEntry entry{};
+
+		wheel.Insert(&entry, 5);
+
+		CHECK(wheel.Advance(4) == nullptr);
+		CHECK(wheel.Advance(5) == &entry);
+		CHECK(wheel.IsEmpty());
+	}
+
+	void PastDeadlineExpiresOnNextAdvance()
+	{
+		static Wheel wheel;
+		TimerWheelEntry entry{};
+
+		wheel.Advance(10);
+		wheel.Insert(&entry, 3);
+
+		CHECK_EQ(entry.Deadline, 11ull);
+		CHECK(wheel.Advance(11) == &entry);
+	}
+
+	void RemovedEntriesNeverExpire()
+	{
+		static Wheel wheel;
+		TimerWheelEntry first{}, second{}, third{};
+
+		wheel.Insert(&first, 7);
+		wheel.Insert(&second, 7);
+		wheel.Insert(&third, 7);
+		wheel.Remove(&second);
+
+		TimerWheelEntry* expired = wheel.Advance(7);
+
+		CHECK_EQ(CountChain(expired), 2);
+		for (; expired; expired = expired->Next)
+			CHECK(expired != &second);
+		CHECK(wheel.IsEmpty());
+	}
+
+	//
+	// Deadlines more than one revolution out share slots with nearer ones
+	// 
+	void DistantDeadlinesWaitForTheirRevolution()
+	{
+		static Wheel wheel;
+		TimerWheelEntry nearEntry{}, farEntry{};
+
+		wheel.Insert(&nearEntry, 3);
+		wheel.Insert(&farEntry, 3 + 16 * 4);
+
+		CHECK(wheel.Advance(3) == &nearEntry);
+		CHECK(wheel.Advance(3 + 16) == nullptr);
+		CHECK(wheel.Advance(3 + 16 * 4 - 1) == nullptr);
+		CHECK(wheel.Advance(3 + 16 * 4) == &farEntry);
+	}
+
+	void LargeJumpsExpireEverythingDue()
+	{
+		static Wheel wheel;
+		TimerWheelEntry entries[40]{};
+
+		for (int i = 0; i < 40; i++)
+			wheel.Insert(&entries[i], 1 + i * 3);
+
+		CHECK_EQ(CountChain(wheel.Advance(1000)), 40);
+		CHECK(wheel.IsEmpty());
+	}
+
+	//
+	// Random inserts, cancellations and irregular advances: everything expires
+	// on the first advance reaching its deadline, once, and nothing is left behind
+	// 
+	void RandomizedAgainstDeadlines()
+	{
+		static TimerWheel<256> wheel;
+		constexpr int count = 5000;
+
+		std::mt19937 rng(29);
+		std::vector<TimerWheelEntry> entries(count);
+		std::vector<unsigned long long> deadlines(count);
+		std::vector<int> state(count, 0);
+		unsigned long long now = 1000;
+
+		wheel.Advance(now);
+
+		for (int i = 0; i < count; i++)
+		{
+			deadlines[i] = now + 1 + rng() % 3000;
+			wheel.Insert(&entries[i], deadlines[i]);
+			state[i] = 1;
+		}
+
+		for (int i = 0; i < count; i += 7)
+		{
+			wheel.Remove(&entries[i]);
+			state[i] = 2;
+		}
+
+		while (!wheel.IsEmpty())
+		{
+			const unsigned long long previous = now;
+
+			now += 1 + rng() % 40;
+
+			for (TimerWheelEntry* entry = wheel.Advance(now); entry; entry = entry->Next)
+			{
+				const auto i = entry - entries.data();
+
+				CHECK_EQ(state[i], 1);
+				CHECK(deadlines[i] > previous && deadlines[i] <= now);
+				state[i] = 3;
+			}
+		}
+
+		for (int i = 0; i < count; i++)
+			CHECK(state[i] != 1);
+	}
+}
+
+int main()
+{
+	ExpiresExactlyAtDeadline();
+	PastDeadlineExpiresOnNextAdvance();
+	RemovedEntriesNeverExpire();
+	DistantDeadlinesWaitForTheirRevolution();
+	LargeJumpsExpireEverythingDue();
+	RandomizedAgainstDeadlines();
+
+	return ViGEm::Tests::Result();
+}
@@ -0,0 +1,275 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+//
+// Cost per URB hop of the dispatch shapes the targets have had: a switch in
+// the base class calling virtual handlers, a table of handler pointers built
+// per final target type, and the switch instantiated per final target type
+// calling the handlers directly. The handlers live in the target's own
+// translation unit in the driver, so they are kept out of line here too.
+// The URB mix is dominated by interrupt transfers as it is for a polled
+// gamepad. A second pass does the same for the report cache update and
+// flush behind every submitted report.
+// 
+namespace
+{
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+	constexpr unsigned int TableSize = 0x40;
+	constexpr unsigned int Iterations = 50000000;
+
+	constexpr unsigned short SelectConfiguration = 0x0000;
+	constexpr unsigned short ControlTransfer = 0x0008;
+	constexpr unsigned short BulkOrInterruptTransfer = 0x0009;
+
+	struct Urb
+	{
+		unsigned short Function;
+		unsigned int Length;
+	};
+
+	class VirtualTarget
+	{
+	public:
+		virtual ~VirtualTarget() = default;
+
+		virtual long UsbControlTransfer(Urb* Request) = 0;
+		virtual long UsbBulkOrInterruptTransfer(Urb* Request) = 0;
+		virtual long UsbSelectConfiguration(Urb* Request) = 0;
+
+		virtual bool UpdateReportCache(const unsigned char* Report) = 0;
+		virtual long FlushReportCache() = 0;
+
+		long Dispatch(Urb* Request)
+		{
+			switch (Request->Function)
+			{
+			case ControlTransfer:
+				return UsbControlTransfer(Request);
+			case BulkOrInterruptTransfer:
+				return UsbBulkOrInterruptTransfer(Request);
+			case SelectConfiguration:
+				return UsbSelectConfiguration(Request);
+			default:
+				return -1;
+			}
+		}
+
+		long SubmitReport(const unsigned char* Report)
+		{
+			return UpdateReportCache(Report) ? FlushReportCache() : 0;
+		}
+	};
+
+	class Gamepad final : public VirtualTarget
+	{
+	public:
+		BENCH_NOINLINE long UsbControlTransfer(Urb* Request) override { return Request->Length; }
+		BENCH_NOINLINE long UsbBulkOrInterruptTransfer(Urb* Request) override { Request->Length = 64; return 0; }
+		BENCH_NOINLINE long UsbSelectConfiguration(Urb* Request) override { return Request->Length + 1; }
+
+		BENCH_NOINLINE bool UpdateReportCache(const unsigned char* Report) override
+		{
+			const bool changed = _Cache != Report[0];
+			_Cache = Report[0];
+			return changed;
+		}
+
+		BENCH_NOINLINE long FlushReportCache() override { return _Cache; }
+
+	private:
+		unsigned char _Cache{};
+	};
+
+	//
+	// Dispatch table shape, as the targets had it before the switch moved into the template
+	// 
+	template <typename TTarget>
+	using UrbHandler = long(*)(TTarget* Target, Urb* Request);
+
+	template <typename TTarget>
+	long UrbUnknown(TTarget*, Urb*) { return -1; }
+
+	template <typename TTarget>
+	long UrbControl(TTarget* Target, Urb* Request) { return Target->UsbControlTransfer(Request); }
+
+	template <typename TTarget>
+	long UrbInterrupt(TTarget* Target, Urb* Request) { return Target->UsbBulkOrInterruptTransfer(Request); }
+
+	template <typename TTarget>
+	long UrbSelect(TTarget* Target, Urb* Request) { return Target->UsbSelectConfiguration(Request); }
+
+	template <typename TTarget>
+	struct HandlerTable
+	{
+		UrbHandler<TTarget> Handlers[TableSize];
+
+		HandlerTable()
+		{
+			for (auto& handler : Handlers)
+				handler = UrbUnknown<TTarget>;
+
+			Handlers[ControlTransfer] = UrbControl<TTarget>;
+			Handlers[BulkOrInterruptTransfer] = UrbInterrupt<TTarget>;
+			Handlers[SelectConfiguration] = UrbSelect<TTarget>;
+		}
+	};
+
+	//
+	// Current shape, the switch instantiated on the final type
+	// 
+	template <typename TTarget>
+	long UrbDispatch(TTarget* Target, Urb* Request)
+	{
+		switch (Request->Function)
+		{
+		case ControlTransfer:
+			return Target->UsbControlTransfer(Request);
+		case BulkOrInterruptTransfer:
+			return Target->UsbBulkOrInterruptTransfer(Request);
+		case SelectConfiguration:
+			return Target->UsbSelectConfiguration(Request);
+		default:
+			return -1;
+		}
+	}
+
+	template <typename TTarget>
+	long SubmitReport(TTarget* Target, const unsigned char* Report)
+	{
+		return Target->UpdateReportCache(Report) ? Target->FlushReportCache() : 0;
+	}
+
+	//
+	// One control transfer in every 16 URBs, the rest are interrupt transfers
+	// 
+	unsigned short FunctionOf(unsigned int Index)
+	{
+		return (Index & 15) ? BulkOrInterruptTransfer : ControlTransfer;
+	}
+
+	template <typename TDispatch>
+	double NanosecondsPerUrb(TDispatch Dispatch)
+	{
+		Urb request{};
+		volatile long sink = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < Iterations; i++)
+		{
+			request.Function = FunctionOf(i);
+			request.Length = i;
+			sink = sink + Dispatch(&request);
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / Iterations;
+	}
+
+	template <typename TSubmit>
+	double NanosecondsPerReport(TSubmit Submit)
+	{
+		unsigned char report[64]{};
+		volatile long sink = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < Iterations; i++)
+		{
+			// Every other report changes, the rest are deduplicated
+			report[0] = static_cast<unsigned char>(i >> 1);
+			sink = sink + Submit(report);
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / Iterations;
+	}
+}
+
+int main(int argc, char*[])
+{
+	//
+	// Chosen at runtime so the compiler can't devirtualize, as in the driver
+	// 
+	std::unique_ptr<VirtualTarget> dynamicTarget;
+
+	if (argc > 0)
+		dynamicTarget = std::make_unique<Gamepad>();
+
+	Gamepad finalTarget;
+	static const HandlerTable<Gamepad> table;
+
+	const double virtualCost = NanosecondsPerUrb([&](Urb* Request)
+	{
+		return dynamicTarget->Dispatch(Request);
+	});
+
+	const double tableCost = NanosecondsPerUrb([&](Urb* Request)
+	{
+		return table.Handlers[Request->Function](&finalTarget, Request);
+	});
+
+	const double switchCost = NanosecondsPerUrb([&](Urb* Request)
+	{
+		return UrbDispatch(&finalTarget, Request);
+	});
+
+	const double virtualSubmit = NanosecondsPerReport([&](const unsigned char* Report)
+	{
+		return dynamicTarget->SubmitReport(Report);
+	});
+
+	const double finalSubmit = NanosecondsPerReport([&](const unsigned char* Report)
+	{
+		return SubmitReport(&finalTarget, Report);
+	});
+
+	std::printf("virtual switch   %.2f ns/URB\n", virtualCost);
+	std::printf("handler table    %.2f ns/URB\n", tableCost);
+	std::printf("final switch     %.2f ns/URB\n", switchCost);
+	std::printf("virtual submit   %.2f ns/report\n", virtualSubmit);
+	std::printf("final submit     %.2f ns/report\n", finalSubmit);
+
+	return 0;
+}
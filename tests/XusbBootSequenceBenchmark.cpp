@@ -0,0 +1,176 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "XusbBootSequence.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+using namespace ViGEm::Bus::Core;
+
+//
+// Time from a freshly plugged XUSB target to its first real report: six
+// data pipe requests answered from the boot sequence, then one report copied
+// from the cache. Compares the per-target blob stepped through by a switch
+// on the stage index with the shared constant table. The blob allocation
+// itself (a WdfMemoryCreate per plug-in) isn't part of the model.
+// 
+namespace
+{
+	constexpr unsigned int Iterations = 10000000;
+	constexpr unsigned int ReportSize = 14;
+
+	struct Transfer
+	{
+		unsigned int Length;
+		unsigned char Buffer[64];
+	};
+
+	//
+	// Previous shape, a blob owned by the target and offsets per stage
+	// 
+	class BlobTarget
+	{
+	public:
+		BlobTarget()
+		{
+			const unsigned char bytes[] =
+			{
+				0x01, 0x03, 0x0E, 0x02, 0x03, 0x00, 0x03, 0x03, 0x03, 0x08, 0x03, 0x00,
+				0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0xe4, 0xf2, 0xb3, 0xf8, 0x49, 0xf3,
+				0xb0, 0xfc, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x03, 0x03,
+			};
+
+			_Blob = std::make_unique<unsigned char[]>(0x2A);
+			std::memcpy(_Blob.get(), bytes, sizeof(bytes));
+		}
+
+		void Reset() { _Stage = 0; }
+
+		bool Answer(Transfer* Request)
+		{
+			switch (_Stage)
+			{
+			case 0: return Copy(Request, 0x00, 3);
+			case 1: return Copy(Request, 0x03, 3);
+			case 2: return Copy(Request, 0x06, 3);
+			case 3: return Copy(Request, 0x09, 3);
+			case 4: return Copy(Request, 0x0C, ReportSize);
+			case 5: return Copy(Request, 0x20, 3);
+			default:
+				Request->Length = ReportSize;
+				std::memcpy(Request->Buffer, _Report, ReportSize);
+				return false;
+			}
+		}
+
+	private:
+		bool Copy(Transfer* Request, unsigned int Offset, unsigned int Length)
+		{
+			Request->Length = Length;
+			std::memcpy(Request->Buffer, &_Blob[Offset], Length);
+			_Stage++;
+			return true;
+		}
+
+		std::unique_ptr<unsigned char[]> _Blob;
+		unsigned int _Stage{};
+		unsigned char _Report[ReportSize]{};
+	};
+
+	//
+	// Current shape, only the position is kept per target
+	// 
+	class TableTarget
+	{
+	public:
+		void Reset() { _BootSequence.Reset(); }
+
+		bool Answer(Transfer* Request)
+		{
+			if (const auto stage = _BootSequence.Next())
+			{
+				Request->Length = stage->Length;
+				stage->CopyTo(Request->Buffer);
+				return true;
+			}
+
+			Request->Length = ReportSize;
+			std::memcpy(Request->Buffer, _Report, ReportSize);
+			return false;
+		}
+
+	private:
+		XusbBootSequence _BootSequence{};
+		unsigned char _Report[ReportSize]{};
+	};
+
+	template <typename TTarget>
+	double NanosecondsToFirstReport(TTarget& Target)
+	{
+		Transfer request{};
+		volatile unsigned int sink = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < Iterations; i++)
+		{
+			Target.Reset();
+
+			while (Target.Answer(&request))
+				sink = sink + request.Buffer[0];
+
+			sink = sink + request.Length;
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+		return elapsed.count() / Iterations;
+	}
+}
+
+int main()
+{
+	BlobTarget blob;
+	TableTarget table;
+
+	const double blobCost = NanosecondsToFirstReport(blob);
+	const double tableCost = NanosecondsToFirstReport(table);
+
+	std::printf("per-target blob  %.2f ns to first report\n", blobCost);
+	std::printf("shared table     %.2f ns to first report\n", tableCost);
+
+	return 0;
+}
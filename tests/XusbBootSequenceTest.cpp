@@ -0,0 +1,183 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2022, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "XusbBootSequence.hpp"
+
+#include "Check.hpp"
+
+#include <cstring>
+
+using namespace ViGEm::Bus::Core;
+
+namespace
+{
+	//
+	// Blob every XUSB target used to fill in PdoInitContext, with the offsets
+	// and copy lengths the interrupt and control paths read it at
+	// 
+	constexpr unsigned char Blob[0x2A] =
+	{
+		// 0
+		0x01, 0x03, 0x0E,
+		// 1
+		0x02, 0x03, 0x00,
+		// 2
+		0x03, 0x03, 0x03,
+		// 3
+		0x08, 0x03, 0x00,
+		// 4
+		0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0xe4, 0xf2,
+		0xb3, 0xf8, 0x49, 0xf3, 0xb0, 0xfc, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00,
+		// 5
+		0x01, 0x03, 0x03,
+		// 6
+		0x05, 0x03, 0x00,
+		// 7
+		0x31, 0x3F, 0xCF, 0xDC
+	};
+
+	constexpr unsigned int InitStageSize = 0x03;
+	constexpr unsigned int InterruptInPacketSize = 14;
+
+	struct BlobStage
+	{
+		unsigned int Offset;
+		unsigned int Length;
+	};
+
+	constexpr BlobStage DataPipeStages[] =
+	{
+		{ 0x00, InitStageSize },
+		{ 0x03, InitStageSize },
+		{ 0x06, InitStageSize },
+		{ 0x09, InitStageSize },
+		{ 0x0C, InterruptInPacketSize },
+		{ 0x20, InitStageSize },
+	};
+
+	constexpr unsigned int CapabilitiesOffset = 0x23;
+	constexpr unsigned int XenonMagicOffset = 0x26;
+
+	void StagesMatchBlob()
+	{
+		static_assert(XusbBootSequence::StageCount == sizeof(DataPipeStages) / sizeof(DataPipeStages[0]),
+			"Same number of data pipe stages");
+
+		XusbBootSequence sequence{};
+
+		for (const auto& expected : DataPipeStages)
+		{
+			CHECK(!sequence.IsComplete());
+
+			const auto stage = sequence.Next();
+
+			CHECK(stage != nullptr);
+			if (stage == nullptr)
+				return;
+
+			CHECK_EQ(stage->Length, expected.Length);
+			CHECK(std::memcmp(stage->Bytes, &Blob[expected.Offset], expected.Length) == 0);
+		}
+
+		CHECK(sequence.IsComplete());
+		CHECK(sequence.Next() == nullptr);
+		CHECK(sequence.Next() == nullptr);
+	}
+
+	//
+	// The initial input packet used to sit in a 20 byte slot, only its first
+	// 14 bytes were ever handed out and the rest was zero
+	// 
+	void InitialInputPacketPaddingWasUnused()
+	{
+		for (unsigned int i = 0x0C + InterruptInPacketSize; i < 0x20; i++)
+			CHECK_EQ(Blob[i], 0);
+	}
+
+	void ControlPipeAnswersMatchBlob()
+	{
+		CHECK_EQ(sizeof(XusbBootSequence::Capabilities), InitStageSize);
+		CHECK(std::memcmp(XusbBootSequence::Capabilities, &Blob[CapabilitiesOffset], InitStageSize) == 0);
+
+		CHECK_EQ(sizeof(XusbBootSequence::XenonMagic), 4u);
+		CHECK(std::memcmp(XusbBootSequence::XenonMagic, &Blob[XenonMagicOffset], 4) == 0);
+	}
+
+	//
+	// Only Length bytes are written, the transfer buffer past them is left alone
+	// 
+	void CopiesExactlyTheStage()
+	{
+		for (const auto& expected : DataPipeStages)
+		{
+			unsigned char buffer[32];
+
+			std::memset(buffer, 0xAA, sizeof(buffer));
+
+			const auto& stage = XusbBootSequence::Stages[&expected - DataPipeStages];
+
+			stage.CopyTo(buffer);
+
+			CHECK(std::memcmp(buffer, &Blob[expected.Offset], expected.Length) == 0);
+
+			for (unsigned int i = expected.Length; i < sizeof(buffer); i++)
+				CHECK_EQ(buffer[i], 0xAA);
+		}
+	}
+
+	void ResetRestartsTheSequence()
+	{
+		XusbBootSequence sequence{};
+
+		while (sequence.Next() != nullptr)
+		{
+		}
+
+		sequence.Reset();
+
+		CHECK(!sequence.IsComplete());
+		CHECK(sequence.Next() == &XusbBootSequence::Stages[0]);
+	}
+}
+
+int main()
+{
+	StagesMatchBlob();
+	InitialInputPacketPaddingWasUnused();
+	ControlPipeAnswersMatchBlob();
+	CopiesExactlyTheStage();
+	ResetRestartsTheSequence();
+
+	return ViGEm::Tests::Result();
+}